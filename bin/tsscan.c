@@ -0,0 +1,210 @@
+/*****************************************************************************
+ * tsscan.c: MPEG-TS service and event listing without LibVLC
+ *****************************************************************************
+ * Copyright (C) 2004-2015 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/* The analysis core of the ts demuxer is linked in directly: no LibVLC
+ * instance, module bank or configuration is ever set up, so that listing
+ * a short recording costs little more than reading it. */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <vlc_common.h>
+#include <vlc_fs.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#ifdef HAVE_GETOPT_H
+# include <getopt.h>
+#endif
+
+#include "../modules/demux/mpeg/ts_output.h"
+#include "../modules/demux/mpeg/ts_scan.h"
+#include "../modules/demux/mpeg/ts_sync.h"
+
+static void version (void)
+{
+    puts ("MPEG-TS analyser version "VERSION);
+}
+
+static void usage (const char *path)
+{
+    printf (
+"Usage: %s [-f csv|json|binary] [-o <file>] [-j <threads>] [-n] <file>...\n"
+"Write the services, events, tables and pids of MPEG-TS files, as the\n"
+"ts demuxer does with --ts-analyse-only. With -n, as with --ts-network-si,\n"
+"also write the networks, bouquets, and the services and events of the\n"
+"other transport streams. With several files, each record starts with the\n"
+"file it comes from.\n"
+"\n"
+"The records are those the demuxer writes, in the same order. Its STATS,\n"
+"MDI and monitor records are not written.\n",
+            path);
+}
+
+/* Files too short for ts_sync_DetectPacketSize(): whole packets, all in sync */
+static int DetectShort (const uint8_t *head, size_t len, unsigned *header_size)
+{
+    static const unsigned sizes[] = { 188, 192, 204 };
+
+    for (size_t i = 0; i < ARRAY_SIZE(sizes); i++)
+    {
+        const unsigned hdr = sizes[i] == 192 ? 4 : 0;
+        size_t off = 0;
+
+        if (len % sizes[i] != 0)
+            continue;
+        while (off < len && head[off + hdr] == 0x47)
+            off += sizes[i];
+        if (off == len)
+        {
+            *header_size = hdr;
+            return sizes[i];
+        }
+    }
+    return -1;
+}
+
+static int Scan (ts_output_t *out, const char *path, unsigned threads,
+                 bool network_si)
+{
+    uint8_t head[4 * 204];
+    ssize_t len = -1;
+
+    int fd = vlc_open (path, O_RDONLY);
+    if (fd != -1)
+    {
+        len = read (fd, head, sizeof (head));
+        close (fd);
+    }
+    if (len < 188)
+    {
+        fprintf (stderr, "Cannot read %s\n", path);
+        return -1;
+    }
+
+    size_t sync;
+    unsigned header_size;
+    int packet_size = ts_sync_DetectPacketSize (head, len, &sync,
+                                                &header_size);
+    if (packet_size == -1 && (size_t)len < sizeof (head))
+    {
+        packet_size = DetectShort (head, len, &header_size);
+        sync = header_size;
+    }
+    if (packet_size == -1)
+    {
+        fprintf (stderr, "%s is not a transport stream\n", path);
+        return -1;
+    }
+
+    if (ts_scan_File (NULL, out, path, sync - header_size, packet_size,
+                      header_size, threads, network_si))
+    {
+        fprintf (stderr, "Cannot analyse %s\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+int main (int argc, char *argv[])
+{
+    static const struct option opts[] =
+    {
+        { "format",     required_argument, NULL, 'f' },
+        { "output",     required_argument, NULL, 'o' },
+        { "threads",    required_argument, NULL, 'j' },
+        { "network",    no_argument,       NULL, 'n' },
+        { "help",       no_argument,       NULL, 'h' },
+        { "version",    no_argument,       NULL, 'V' },
+        { NULL,         no_argument,       NULL, '\0'}
+    };
+
+    ts_output_format_t format = TS_OUTPUT_CSV;
+    const char *output = "-";
+    unsigned threads = vlc_GetCPUCount ();
+    bool network_si = false;
+    int c;
+
+    while ((c = getopt_long (argc, argv, "f:o:j:nhV", opts, NULL)) != -1)
+        switch (c)
+        {
+            case 'f':
+                format = ts_output_ParseFormat (optarg);
+                if (format == TS_OUTPUT_NONE)
+                {
+                    usage (argv[0]);
+                    return 1;
+                }
+                break;
+            case 'o':
+                output = optarg;
+                break;
+            case 'j':
+                threads = strtoul (optarg, NULL, 10);
+                break;
+            case 'n':
+                network_si = true;
+                break;
+            case 'h':
+                usage (argv[0]);
+                return 0;
+            case 'V':
+                version ();
+                return 0;
+            default:
+                usage (argv[0]);
+                return 1;
+        }
+
+    if (optind >= argc)
+    {
+        usage (argv[0]);
+        return 1;
+    }
+
+    ts_output_t *out = ts_output_New (NULL, format, output);
+    if (out == NULL)
+        return 1;
+
+    int ret = 0;
+    for (int i = optind; i < argc; i++)
+    {
+        const char *path = argv[i];
+
+        if (argc - optind == 1)
+        {
+            if (Scan (out, path, threads, network_si))
+                ret = 1;
+            continue;
+        }
+
+        ts_output_t *input = ts_output_NewInput (out, path);
+        if (input == NULL || Scan (input, path, threads, network_si))
+            ret = 1;
+        if (input != NULL)
+            ts_output_Delete (input);
+    }
+
+    ts_output_Delete (out);
+    return ret;
+}
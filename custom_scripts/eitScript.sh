@@ -1,19 +1,9 @@
 #!/bin/bash
 
-input=$1
+# Service names are joined to the EIT rows by the demux
+# (--ts-analyser-output=csv), only the event rows have to be kept:
+#   EIT,"service","sid.tsid.onid",sid,tsid,onid,event_id,start,duration,"name"
 
-for line in `egrep "SDT" $input | sed 's/ /£/g' | awk -F"," '{print $2","$6}'`; do
-#for line in `egrep "SDT" $input | awk -F"," '{print $2","$6}'`; do
-	echo "$line" | sed 's/£/ /g'
-#	echo "$line"
-#	sed -i.bak 's///g' $input
-	uniqueComb=$(echo "$line" | awk -F"," '{print $1}')
-	channelName=$(echo "$line" | sed 's/£/ /g' | awk -F"," '{print $2}')
-	echo $uniqueComb " --- " "$channelName"
-	
-	eval "sed -i.bak 's/^EIT,xxx,$uniqueComb/$channelName,$uniqueComb/g' $input"
-	
-	
-done
+input=$1
 
-	sed -i.bak 's/^SDT.*//g' $input
+sed -i.bak -n 's/^EIT,//p' $input
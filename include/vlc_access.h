@@ -44,6 +44,7 @@ enum access_query_e
     ACCESS_CAN_CONTROL_PACE,/* arg1= bool*    cannot fail */
     ACCESS_GET_SIZE=6,      /* arg1= uin64_t* */
     ACCESS_IS_DIRECTORY,    /* arg1= bool *, arg2= bool *, res=can fail */
+    ACCESS_IS_MAPPED,       /* arg1= bool *, blocks are memory mappings, res=can fail */
 
     /* */
     ACCESS_GET_PTS_DELAY = 0x101,/* arg1= int64_t*       cannot fail */
@@ -56,6 +57,8 @@ enum access_query_e
     ACCESS_GET_CONTENT_TYPE,/* arg1=char **ppsz_content_type res=can fail */
 
     ACCESS_GET_SIGNAL,      /* arg1=double *pf_quality, arg2=double *pf_strength   res=can fail */
+    ACCESS_GET_NET_STATS,   /* arg1=stream_net_stats_t *   res=can fail */
+    ACCESS_GET_BUFFERED,    /* arg1=uint64_t *pi_size, arg2=bool *pb_eof   res=can fail */
 
     /* */
     ACCESS_SET_PAUSE_STATE = 0x200, /* arg1= bool           can fail */
@@ -69,6 +72,7 @@ enum access_query_e
     ACCESS_SET_PRIVATE_ID_STATE = 0x1000, /* arg1= int i_private_data, bool b_selected    res=can fail */
     ACCESS_SET_PRIVATE_ID_CA,             /* arg1= int i_program_number, uint16_t i_vpid, uint16_t i_apid1, uint16_t i_apid2, uint16_t i_apid3, uint8_t i_length, uint8_t *p_data */
     ACCESS_GET_PRIVATE_ID_STATE,          /* arg1=int i_private_data arg2=bool *          res=can fail */
+    ACCESS_SET_PRIVATE_ID_SECTION,        /* arg1= int i_private_data, int i_table_id, int i_mask, int i_extension (-1 for any), bool b_selected res=can fail */
 };
 
 struct access_t
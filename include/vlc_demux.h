@@ -99,6 +99,36 @@ typedef struct demux_meta_t
     input_attachment_t **attachments;    /**< array of attachments */
 } demux_meta_t;
 
+/* Statistics of one MPEG-TS pid, see DEMUX_GET_TS_STATS.
+ * Counters accumulate from the start, rates cover the last window. */
+typedef struct
+{
+    uint16_t i_pid;
+    uint64_t i_packets;
+    uint64_t i_bytes;
+    uint64_t i_bitrate;             /**< bits per second */
+    uint64_t i_cc_errors;           /**< continuity counter errors */
+    uint64_t i_tei_errors;          /**< transport_error_indicator set */
+    uint64_t i_discontinuities;     /**< discontinuity_indicator set */
+    uint64_t i_scrambled;           /**< packets with scrambling control set */
+    uint64_t i_pcrs;
+    uint64_t i_pcr_interval_errors; /**< PCR intervals above 40 ms */
+    uint64_t i_pcr_discontinuity_errors; /**< unsignalled PCR jumps */
+    mtime_t  i_pcr_interval_max;    /**< microseconds, 0 without PCR */
+    uint64_t i_pcr_accuracy_errors; /**< PCR jitter above 500 ns */
+    int64_t  i_pcr_accuracy_max;    /**< absolute PCR jitter, nanoseconds */
+} demux_ts_pid_stats_t;
+
+typedef struct
+{
+    mtime_t  i_date;                /**< mdate() of the last window */
+    uint64_t i_packets;
+    uint64_t i_bitrate;             /**< bits per second */
+    uint64_t i_sync_losses;
+    size_t   i_pids;
+    demux_ts_pid_stats_t *p_pids;   /**< in pid order, same allocation */
+} demux_ts_stats_t;
+
 enum demux_query_e
 {
     /* I. Common queries to access_demux and demux */
@@ -150,6 +180,9 @@ enum demux_query_e
     DEMUX_GET_SIGNAL, /* arg1=double *pf_quality, arg2=double *pf_strength
                          res=can fail */
 
+    /* MPEG-TS per pid statistics, the snapshot is released with free() */
+    DEMUX_GET_TS_STATS, /* arg1= demux_ts_stats_t ** res=can fail */
+
     /* II. Specific access_demux queries */
     /* PAUSE you are ensured that it is never called twice with the same state */
     DEMUX_CAN_PAUSE = 0x1000,   /* arg1= bool*    can fail (assume false)*/
@@ -39,5 +39,17 @@ struct libvlc_int_t
 
     /* Structure storing the action name / key associations */
     const struct hotkey *p_hotkeys;
+
+    /* Most verbose message type the logger outputs, see msg_Enabled().
+     * Set up with the logger, then read without lock by every message */
+    int i_log_verbosity;
 };
 
+/* See msg_Enabled(). Messages without an object are always passed on. */
+static inline bool vlc_msg_Enabled(const vlc_object_t *obj, int type)
+{
+    return obj == NULL
+        || (!(obj->i_flags & OBJECT_FLAGS_QUIET)
+         && type <= obj->p_libvlc->i_log_verbosity);
+}
+
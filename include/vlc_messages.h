@@ -69,13 +69,38 @@ VLC_API void vlc_Log(vlc_object_t *obj, int prio, const char *module,
 VLC_API void vlc_vaLog(vlc_object_t *obj, int prio, const char *module,
                        const char *file, unsigned line, const char *func,
                        const char *format, va_list ap);
+/**
+ * Sets the most verbose message type output by the logger of the instance,
+ * for the logger modules that filter messages by verbosity themselves.
+ */
+VLC_API void vlc_LogSetVerbosity(vlc_object_t *obj, int type);
+
+/**
+ * Most verbose message type built in. Defining it, for instance to
+ * VLC_MSG_WARN, before vlc_common.h is included, or in the CPPFLAGS, builds
+ * the more verbose messages of a file out, arguments included.
+ */
+#ifndef VLC_MSG_MAX
+# define VLC_MSG_MAX VLC_MSG_DBG
+#endif
+
+/**
+ * Whether a message of type p from object o reaches the logger at all.
+ * The msg_*() macros check it before evaluating their arguments; code that
+ * works only to build a message should check it too.
+ */
+#define msg_Enabled(o, p) \
+    ((p) <= VLC_MSG_MAX && vlc_msg_Enabled(VLC_OBJECT(o), p))
+
 #define msg_GenericVa(o, p, fmt, ap) \
-    vlc_vaLog(VLC_OBJECT(o), p, MODULE_STRING, __FILE__, __LINE__, __func__, \
-              fmt, ap)
+    (msg_Enabled(o, p) ? \
+     vlc_vaLog(VLC_OBJECT(o), p, MODULE_STRING, __FILE__, __LINE__, \
+               __func__, fmt, ap) : (void)0)
 
 #define msg_Generic(o, p, ...) \
-    vlc_Log(VLC_OBJECT(o), p, MODULE_STRING, __FILE__, __LINE__, \
-            __func__, __VA_ARGS__)
+    (msg_Enabled(o, p) ? \
+     vlc_Log(VLC_OBJECT(o), p, MODULE_STRING, __FILE__, __LINE__, \
+             __func__, __VA_ARGS__) : (void)0)
 #define msg_Info(p_this, ...) \
     msg_Generic(p_this, VLC_MSG_INFO, __VA_ARGS__)
 #define msg_Err(p_this, ...) \
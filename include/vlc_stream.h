@@ -57,6 +57,10 @@ struct stream_t
 
     /* */
     ssize_t     (*pf_read)(stream_t *, void *, size_t);
+    /* Returns the next data in its natural block size, without copying it,
+     * or NULL if none is available yet, or at the end (sets *eof). Can be
+     * NULL, then the data is read with pf_read. */
+    block_t    *(*pf_block)(stream_t *, bool *restrict eof);
     input_item_t *(*pf_readdir)( stream_t * );
     int         (*pf_seek)(stream_t *, uint64_t);
     int         (*pf_control)( stream_t *, int i_query, va_list );
@@ -68,6 +72,31 @@ struct stream_t
     input_thread_t *p_input;
 };
 
+/**
+ * Reception quality of a datagram stream, see STREAM_GET_NET_STATS.
+ * Counters accumulate from the start, the others cover the last second.
+ */
+#define STREAM_NET_IAT_BUCKETS 16
+
+typedef struct
+{
+    uint64_t i_datagrams;
+    uint64_t i_bytes;
+    uint64_t i_ts_lost;         /**< TS packets missing from the continuity counters */
+    uint64_t i_rtp_lost;        /**< RTP sequence numbers skipped */
+    uint64_t i_rtp_reordered;   /**< RTP datagrams behind the sequence */
+    /** Inter-arrival times: the first bucket counts those under 64us, the
+     * n-th those from 2^(n+5)us, and the last one those from about 1s up */
+    uint64_t pi_iat[STREAM_NET_IAT_BUCKETS];
+
+    uint64_t i_bitrate;         /**< bits per second */
+    mtime_t  i_iat_max;         /**< longest inter-arrival time */
+    unsigned i_burst_max;       /**< most datagrams in a row less than 100us apart */
+    unsigned i_gap_max;         /**< most RTP datagrams lost in a row */
+    mtime_t  i_delay_factor;    /**< RFC 4445 MDI delay factor */
+    uint64_t i_loss_rate;       /**< RFC 4445 MDI media loss rate, TS packets per second */
+} stream_net_stats_t;
+
 /**
  * Possible commands to send to stream_Control() and stream_vaControl()
  */
@@ -81,6 +110,7 @@ enum stream_query_e
     /* */
     STREAM_GET_SIZE=6,          /**< arg1= uint64_t *     res=can fail */
     STREAM_IS_DIRECTORY,        /**< arg1= bool *, arg2= bool *, res=can fail*/
+    STREAM_IS_MAPPED,           /**< arg1= bool *: blocks are memory mappings, not worth caching   res=can fail */
 
     /* */
     STREAM_GET_PTS_DELAY = 0x101,/**< arg1= int64_t* res=cannot fail */
@@ -90,6 +120,8 @@ enum stream_query_e
     STREAM_GET_META,        /**< arg1= vlc_meta_t **       res=can fail */
     STREAM_GET_CONTENT_TYPE,    /**< arg1= char **         res=can fail */
     STREAM_GET_SIGNAL,      /**< arg1=double *pf_quality, arg2=double *pf_strength   res=can fail */
+    STREAM_GET_NET_STATS,   /**< arg1=stream_net_stats_t *   res=can fail */
+    STREAM_GET_BUFFERED,    /**< arg1=uint64_t *pi_size, arg2=bool *pb_eof: bytes readable without waiting, and whether the stream ends after them   res=can fail */
 
     STREAM_SET_PAUSE_STATE = 0x200, /**< arg1= bool        res=can fail */
     STREAM_SET_TITLE,       /**< arg1= int          res=can fail */
@@ -101,6 +133,7 @@ enum stream_query_e
     STREAM_SET_PRIVATE_ID_STATE = 0x1000, /* arg1= int i_private_data, bool b_selected    res=can fail */
     STREAM_SET_PRIVATE_ID_CA,             /* arg1= int i_program_number, uint16_t i_vpid, uint16_t i_apid1, uint16_t i_apid2, uint16_t i_apid3, uint8_t i_length, uint8_t *p_data */
     STREAM_GET_PRIVATE_ID_STATE,          /* arg1=int i_private_data arg2=bool *          res=can fail */
+    STREAM_SET_PRIVATE_ID_SECTION,        /* arg1= int i_private_data, int i_table_id, int i_mask, int i_extension (-1 for any), bool b_selected res=can fail */
     STREAM_GET_PRIVATE_BLOCK, /**< arg1= block_t **b, arg2=bool *eof */
 };
 
@@ -137,6 +170,18 @@ VLC_API ssize_t stream_Read(stream_t *, void *, size_t) VLC_USED;
  */
 VLC_API ssize_t stream_Peek(stream_t *, const uint8_t **, size_t) VLC_USED;
 
+/**
+ * Reads the next block of data from a byte stream.
+ *
+ * Unlike stream_Block(), the size of the block is not chosen by the caller,
+ * but by the stream: the data is handed over as it is buffered, or as the
+ * access produces it (e.g. a memory-mapped window of a file), without any
+ * copy whenever possible. The block may be modified in place.
+ *
+ * \return a block of data, or NULL at the end of the stream or on error
+ */
+VLC_API block_t *stream_ReadBlock(stream_t *) VLC_USED;
+
 /**
  * Tells the current stream position.
  *
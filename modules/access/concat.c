@@ -197,6 +197,7 @@ static int Control(access_t *access, int query, va_list args)
             break;
 
         case ACCESS_GET_SIGNAL:
+        case ACCESS_GET_NET_STATS:
         case ACCESS_SET_PAUSE_STATE:
             return access_vaControl(sys->access, query, args);
 
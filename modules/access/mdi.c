@@ -0,0 +1,298 @@
+/*****************************************************************************
+ * mdi.c: reception quality of datagram streams
+ *****************************************************************************
+ * Copyright (C) 2004-2015 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <vlc_common.h>
+#include <vlc_atomic.h>
+
+#include "mdi.h"
+
+/* Datagrams closer than this belong to the same burst */
+#define MDI_BURST_IAT   100
+#define MDI_WINDOW      CLOCK_FREQ
+#define MDI_NO_CC       0xff
+
+struct mdi_t
+{
+    /* Published, written by the receiving thread only */
+    atomic_uint_least64_t i_datagrams;
+    atomic_uint_least64_t i_bytes;
+    atomic_uint_least64_t i_ts_lost;
+    atomic_uint_least64_t i_rtp_lost;
+    atomic_uint_least64_t i_rtp_reordered;
+    atomic_uint_least64_t pi_iat[STREAM_NET_IAT_BUCKETS];
+    atomic_uint_least64_t i_bitrate;
+    atomic_uint_least64_t i_iat_max;
+    atomic_uint           i_burst_max;
+    atomic_uint           i_gap_max;
+    atomic_uint_least64_t i_delay_factor;
+    atomic_uint_least64_t i_loss_rate;
+
+    /* Private to the receiving thread */
+    mtime_t  i_last;
+    unsigned i_burst;
+    bool     b_rtp_seq;
+    uint16_t i_rtp_seq;             /* next expected */
+
+    struct
+    {
+        mtime_t  i_start;
+        uint64_t i_bytes;
+        uint64_t i_ts_lost;
+        mtime_t  i_iat_max;
+        unsigned i_burst_max;
+        unsigned i_gap_max;
+        /* RFC 4445 virtual buffer, in bytes * CLOCK_FREQ, drained at the
+         * rate of the previous window */
+        uint64_t i_rate;            /* bytes per second */
+        int64_t  i_vb_min;
+        int64_t  i_vb_max;
+    } window;
+
+    uint8_t  pi_cc[8192];           /* last continuity counter of each pid */
+};
+
+/* There is a single writer: no need for locked read-modify-write */
+static inline void Add( atomic_uint_least64_t *p_counter, uint64_t i_add )
+{
+    atomic_store_explicit( p_counter,
+        atomic_load_explicit( p_counter, memory_order_relaxed ) + i_add,
+        memory_order_relaxed );
+}
+
+static inline void Set( atomic_uint_least64_t *p_value, uint64_t i_value )
+{
+    atomic_store_explicit( p_value, i_value, memory_order_relaxed );
+}
+
+static inline uint64_t Get( atomic_uint_least64_t *p_value )
+{
+    return atomic_load_explicit( p_value, memory_order_relaxed );
+}
+
+static void WindowReset( mdi_t *p_mdi, mtime_t i_date, uint64_t i_rate )
+{
+    p_mdi->window.i_start = i_date;
+    p_mdi->window.i_bytes = 0;
+    p_mdi->window.i_ts_lost = 0;
+    p_mdi->window.i_iat_max = 0;
+    p_mdi->window.i_burst_max = 0;
+    p_mdi->window.i_gap_max = 0;
+    p_mdi->window.i_rate = i_rate;
+    p_mdi->window.i_vb_min = INT64_MAX;
+    p_mdi->window.i_vb_max = INT64_MIN;
+}
+
+mdi_t *mdi_New( void )
+{
+    mdi_t *p_mdi = malloc( sizeof(*p_mdi) );
+    if( !p_mdi )
+        return NULL;
+
+    atomic_init( &p_mdi->i_datagrams, 0 );
+    atomic_init( &p_mdi->i_bytes, 0 );
+    atomic_init( &p_mdi->i_ts_lost, 0 );
+    atomic_init( &p_mdi->i_rtp_lost, 0 );
+    atomic_init( &p_mdi->i_rtp_reordered, 0 );
+    for( unsigned i = 0; i < STREAM_NET_IAT_BUCKETS; i++ )
+        atomic_init( &p_mdi->pi_iat[i], 0 );
+    atomic_init( &p_mdi->i_bitrate, 0 );
+    atomic_init( &p_mdi->i_iat_max, 0 );
+    atomic_init( &p_mdi->i_burst_max, 0 );
+    atomic_init( &p_mdi->i_gap_max, 0 );
+    atomic_init( &p_mdi->i_delay_factor, 0 );
+    atomic_init( &p_mdi->i_loss_rate, 0 );
+
+    p_mdi->i_last = VLC_TS_INVALID;
+    p_mdi->i_burst = 0;
+    p_mdi->b_rtp_seq = false;
+    p_mdi->i_rtp_seq = 0;
+    WindowReset( p_mdi, VLC_TS_INVALID, 0 );
+    memset( p_mdi->pi_cc, MDI_NO_CC, sizeof(p_mdi->pi_cc) );
+    return p_mdi;
+}
+
+void mdi_Delete( mdi_t *p_mdi )
+{
+    free( p_mdi );
+}
+
+/* Publishes the second that ended at i_date */
+static void WindowClose( mdi_t *p_mdi, mtime_t i_date )
+{
+    const mtime_t i_duration = i_date - p_mdi->window.i_start;
+    const uint64_t i_rate = p_mdi->window.i_bytes * CLOCK_FREQ / i_duration;
+
+    Set( &p_mdi->i_bitrate, i_rate * 8 );
+    Set( &p_mdi->i_iat_max, p_mdi->window.i_iat_max );
+    atomic_store_explicit( &p_mdi->i_burst_max, p_mdi->window.i_burst_max,
+                           memory_order_relaxed );
+    atomic_store_explicit( &p_mdi->i_gap_max, p_mdi->window.i_gap_max,
+                           memory_order_relaxed );
+    if( p_mdi->window.i_rate > 0 && p_mdi->window.i_vb_max >= p_mdi->window.i_vb_min )
+        Set( &p_mdi->i_delay_factor,
+             ( p_mdi->window.i_vb_max - p_mdi->window.i_vb_min ) / p_mdi->window.i_rate );
+    Set( &p_mdi->i_loss_rate, p_mdi->window.i_ts_lost * CLOCK_FREQ / i_duration );
+
+    WindowReset( p_mdi, i_date, i_rate );
+}
+
+static void InterArrival( mdi_t *p_mdi, mtime_t i_date )
+{
+    if( p_mdi->i_last == VLC_TS_INVALID )
+    {
+        p_mdi->i_last = i_date;
+        p_mdi->i_burst = 1;
+        return;
+    }
+
+    /* Kernel dates may come slightly out of order between CPUs */
+    const mtime_t i_iat = __MAX( i_date - p_mdi->i_last, 0 );
+    p_mdi->i_last = i_date;
+
+    unsigned i_bucket = STREAM_NET_IAT_BUCKETS - 1;
+    if( i_iat < 64 )
+        i_bucket = 0;
+    else if( i_iat < ( 64 << ( STREAM_NET_IAT_BUCKETS - 1 ) ) )
+        i_bucket = 31 - clz32( i_iat ) - 5;
+    Add( &p_mdi->pi_iat[i_bucket], 1 );
+
+    if( i_iat > p_mdi->window.i_iat_max )
+        p_mdi->window.i_iat_max = i_iat;
+
+    p_mdi->i_burst = i_iat < MDI_BURST_IAT ? p_mdi->i_burst + 1 : 1;
+    if( p_mdi->i_burst > p_mdi->window.i_burst_max )
+        p_mdi->window.i_burst_max = p_mdi->i_burst;
+}
+
+/* Returns the size of the RTP header, 0 if the datagram is raw TS */
+static size_t RTPSequence( mdi_t *p_mdi, const uint8_t *p_data, size_t i_data )
+{
+    /* A TS sync byte is not RTP version 2 */
+    if( i_data < 12 || ( p_data[0] & 0xC0 ) != 0x80 )
+        return 0;
+
+    size_t i_header = 12 + 4 * ( p_data[0] & 0x0F );
+    if( ( p_data[0] & 0x10 ) && i_header + 4 <= i_data )
+        i_header += 4 + 4 * GetWBE( &p_data[i_header + 2] );
+
+    const uint16_t i_seq = GetWBE( &p_data[2] );
+    if( p_mdi->b_rtp_seq )
+    {
+        const int16_t i_delta = i_seq - p_mdi->i_rtp_seq;
+        if( i_delta < 0 )
+        {
+            Add( &p_mdi->i_rtp_reordered, 1 );
+            return i_header;
+        }
+        if( i_delta > 0 )
+        {
+            Add( &p_mdi->i_rtp_lost, i_delta );
+            if( (unsigned)i_delta > p_mdi->window.i_gap_max )
+                p_mdi->window.i_gap_max = i_delta;
+        }
+    }
+    p_mdi->b_rtp_seq = true;
+    p_mdi->i_rtp_seq = i_seq + 1;
+    return i_header;
+}
+
+static void TSContinuity( mdi_t *p_mdi, const uint8_t *p_data, size_t i_data )
+{
+    uint64_t i_lost = 0;
+
+    for( ; i_data >= 188 && p_data[0] == 0x47; p_data += 188, i_data -= 188 )
+    {
+        const uint16_t i_pid = ( ( p_data[1] & 0x1F ) << 8 ) | p_data[2];
+        if( i_pid == 0x1FFF || !( p_data[3] & 0x10 ) )
+            continue;
+
+        const uint8_t i_cc = p_data[3] & 0x0F;
+        const uint8_t i_last = p_mdi->pi_cc[i_pid];
+        p_mdi->pi_cc[i_pid] = i_cc;
+
+        const bool b_discontinuity = ( p_data[3] & 0x20 ) && p_data[4] > 0 &&
+                                     ( p_data[5] & 0x80 );
+        if( i_last != MDI_NO_CC && i_cc != i_last && !b_discontinuity )
+            i_lost += ( i_cc - i_last - 1 ) & 0x0F;
+    }
+
+    if( i_lost )
+    {
+        Add( &p_mdi->i_ts_lost, i_lost );
+        p_mdi->window.i_ts_lost += i_lost;
+    }
+}
+
+void mdi_Datagram( mdi_t *p_mdi, const uint8_t *p_data, size_t i_data,
+                   mtime_t i_date )
+{
+    Add( &p_mdi->i_datagrams, 1 );
+    Add( &p_mdi->i_bytes, i_data );
+
+    if( i_date != VLC_TS_INVALID )
+    {
+        if( p_mdi->window.i_start == VLC_TS_INVALID )
+            p_mdi->window.i_start = i_date;
+        else if( i_date - p_mdi->window.i_start >= MDI_WINDOW )
+            WindowClose( p_mdi, i_date );
+
+        InterArrival( p_mdi, i_date );
+
+        /* Virtual buffer before and after the arrival */
+        if( p_mdi->window.i_rate > 0 )
+        {
+            const int64_t i_vb = (int64_t)p_mdi->window.i_bytes * CLOCK_FREQ -
+                                 (int64_t)p_mdi->window.i_rate * ( i_date - p_mdi->window.i_start );
+            if( i_vb < p_mdi->window.i_vb_min )
+                p_mdi->window.i_vb_min = i_vb;
+            const int64_t i_vb_after = i_vb + (int64_t)i_data * CLOCK_FREQ;
+            if( i_vb_after > p_mdi->window.i_vb_max )
+                p_mdi->window.i_vb_max = i_vb_after;
+        }
+        p_mdi->window.i_bytes += i_data;
+    }
+
+    const size_t i_header = RTPSequence( p_mdi, p_data, i_data );
+    if( i_header < i_data )
+        TSContinuity( p_mdi, &p_data[i_header], i_data - i_header );
+}
+
+void mdi_Get( mdi_t *p_mdi, stream_net_stats_t *p_stats )
+{
+    p_stats->i_datagrams = Get( &p_mdi->i_datagrams );
+    p_stats->i_bytes = Get( &p_mdi->i_bytes );
+    p_stats->i_ts_lost = Get( &p_mdi->i_ts_lost );
+    p_stats->i_rtp_lost = Get( &p_mdi->i_rtp_lost );
+    p_stats->i_rtp_reordered = Get( &p_mdi->i_rtp_reordered );
+    for( unsigned i = 0; i < STREAM_NET_IAT_BUCKETS; i++ )
+        p_stats->pi_iat[i] = Get( &p_mdi->pi_iat[i] );
+    p_stats->i_bitrate = Get( &p_mdi->i_bitrate );
+    p_stats->i_iat_max = Get( &p_mdi->i_iat_max );
+    p_stats->i_burst_max = atomic_load_explicit( &p_mdi->i_burst_max,
+                                                 memory_order_relaxed );
+    p_stats->i_gap_max = atomic_load_explicit( &p_mdi->i_gap_max,
+                                               memory_order_relaxed );
+    p_stats->i_delay_factor = Get( &p_mdi->i_delay_factor );
+    p_stats->i_loss_rate = Get( &p_mdi->i_loss_rate );
+}
@@ -0,0 +1,45 @@
+/*****************************************************************************
+ * mdi.h: reception quality of datagram streams
+ *****************************************************************************
+ * Copyright (C) 2004-2015 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifndef VLC_ACCESS_MDI_H
+#define VLC_ACCESS_MDI_H
+
+#include <vlc_stream.h>
+
+/* Inter-arrival times, bursts, RTP sequence gaps, TS continuity losses and
+ * the RFC 4445 Media Delivery Index of the datagrams of one socket.
+ *
+ * mdi_Datagram() is called by the receiving thread alone, and publishes its
+ * counters with plain atomic stores, so that it never waits for a reader.
+ * mdi_Get() may be called from any thread; its fields are each consistent,
+ * but may come from two consecutive datagrams. */
+typedef struct mdi_t mdi_t;
+
+mdi_t *mdi_New( void );
+void mdi_Delete( mdi_t * );
+
+/* Accounts for a datagram received at i_date, RTP or raw TS. The dates of a
+ * socket must all come from the same clock: a datagram without one,
+ * VLC_TS_INVALID, is counted but left out of the timing. */
+void mdi_Datagram( mdi_t *, const uint8_t *p_data, size_t i_data,
+                   mtime_t i_date );
+
+void mdi_Get( mdi_t *, stream_net_stats_t * );
+
+#endif
@@ -0,0 +1,249 @@
+/*****************************************************************************
+ * mmap.c: memory-mapped file input
+ *****************************************************************************
+ * Copyright (C) 2004-2015 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <vlc_common.h>
+#include <vlc_plugin.h>
+#include <vlc_access.h>
+#include <vlc_input.h>
+#include <vlc_dialog.h>
+#include <vlc_fs.h>
+
+#include <assert.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+/* Size of the mapped windows: large enough to amortize the mapping and
+ * the page faults, small enough for 32-bits address spaces */
+#define MMAP_WINDOW (4 << 20)
+
+#define FILE_MMAP_TEXT N_("Use file memory mapping")
+#define FILE_MMAP_LONGTEXT N_( \
+    "Read local files through memory mapping, so that the demuxers work " \
+    "directly on the page cache rather than on copies. A file must not be " \
+    "truncated while it is read this way.")
+
+static int Open (vlc_object_t *);
+static void Close (vlc_object_t *);
+
+vlc_module_begin ()
+    set_shortname (N_("MMap"))
+    set_description (N_("Memory-mapped file input"))
+    set_category (CAT_INPUT)
+    set_subcategory (SUBCAT_INPUT_ACCESS)
+    set_capability ("access", 52)
+    add_shortcut ("file", "mmap")
+    add_bool ("file-mmap", false, FILE_MMAP_TEXT, FILE_MMAP_LONGTEXT, true)
+    set_callbacks (Open, Close)
+vlc_module_end ()
+
+struct access_sys_t
+{
+    size_t   page_mask;
+    uint64_t offset;
+    int      fd;
+};
+
+#ifndef HAVE_POSIX_FADVISE
+# define posix_fadvise(fd, off, len, adv)
+#endif
+
+static block_t *Block (access_t *);
+static int Seek (access_t *, uint64_t);
+static int Control (access_t *, int, va_list);
+
+static int Open (vlc_object_t *p_this)
+{
+    access_t *p_access = (access_t *)p_this;
+    const char *path = p_access->psz_filepath;
+
+    /* Growing or truncated files would fault: only map on request */
+    if (strcmp (p_access->psz_access, "mmap")
+     && !var_InheritBool (p_this, "file-mmap"))
+        return VLC_EGENERIC;
+    if (path == NULL)
+        return VLC_EGENERIC;
+
+    int fd = vlc_open (path, O_RDONLY | O_NOCTTY);
+    if (fd == -1)
+    {
+        msg_Warn (p_access, "cannot open %s: %s", path,
+                  vlc_strerror_c(errno));
+        return VLC_EGENERIC;
+    }
+
+    /* mmap() is only safe on regular files, leave the others (directories,
+     * devices, pipes...) to the other file access modules. */
+    struct stat st;
+    if (fstat (fd, &st) || !S_ISREG (st.st_mode))
+        goto error;
+
+    access_sys_t *p_sys = malloc (sizeof (*p_sys));
+    if (unlikely(p_sys == NULL))
+        goto error;
+
+    p_sys->page_mask = sysconf (_SC_PAGE_SIZE) - 1;
+    assert ((p_sys->page_mask & (p_sys->page_mask + 1)) == 0);
+    p_sys->offset = 0;
+    p_sys->fd = fd;
+
+    access_InitFields (p_access);
+    ACCESS_SET_CALLBACKS (NULL, Block, Control, Seek);
+    p_access->p_sys = p_sys;
+
+    /* The file is read once, sequentially; demuxers probe the start */
+    posix_fadvise (fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    posix_fadvise (fd, 0, MMAP_WINDOW, POSIX_FADV_WILLNEED);
+    msg_Dbg (p_access, "mapping file %s", path);
+    return VLC_SUCCESS;
+
+error:
+    close (fd);
+    return VLC_EGENERIC;
+}
+
+static void Close (vlc_object_t *p_this)
+{
+    access_t *p_access = (access_t *)p_this;
+    access_sys_t *p_sys = p_access->p_sys;
+
+    close (p_sys->fd);
+    free (p_sys);
+}
+
+/* Maps the next window of the file. The pages are private and writable, as
+ * the demuxers may modify the data in place (e.g. to descramble it): only
+ * the modified pages are then copied, never the file. */
+static block_t *Block (access_t *p_access)
+{
+    access_sys_t *p_sys = p_access->p_sys;
+    struct stat st;
+
+    /* The file size is checked for each window, as it may be growing */
+    if (fstat (p_sys->fd, &st))
+    {
+        msg_Err (p_access, "cannot stat file: %s", vlc_strerror_c(errno));
+        goto fatal;
+    }
+
+    if (p_sys->offset >= (uint64_t)st.st_size)
+    {
+        p_access->info.b_eof = true;
+        return NULL;
+    }
+
+    const uint64_t inner = p_sys->offset & p_sys->page_mask;
+    const uint64_t outer = p_sys->offset - inner;
+    size_t length = MMAP_WINDOW;
+
+    if ((uint64_t)st.st_size - outer < length)
+        length = st.st_size - outer;
+
+    void *addr = mmap (NULL, length, PROT_READ|PROT_WRITE, MAP_PRIVATE,
+                       p_sys->fd, outer);
+    if (addr == MAP_FAILED)
+    {
+        msg_Err (p_access, "memory mapping failed: %s",
+                 vlc_strerror_c(errno));
+        goto fatal;
+    }
+
+    /* Read this window ahead and drop it behind, and start reading the
+     * next one while this one is demuxed. */
+    posix_madvise (addr, length, POSIX_MADV_SEQUENTIAL);
+    posix_madvise (addr, length, POSIX_MADV_WILLNEED);
+    posix_fadvise (p_sys->fd, outer + length, MMAP_WINDOW,
+                   POSIX_FADV_WILLNEED);
+
+    block_t *block = block_mmap_Alloc (addr, length);
+    if (unlikely(block == NULL))
+    {
+        munmap (addr, length);
+        return NULL;
+    }
+
+    block->p_buffer += inner;
+    block->i_buffer -= inner;
+    p_sys->offset = outer + length;
+    return block;
+
+fatal:
+    dialog_Fatal (p_access, _("File reading failed"),
+                  _("VLC could not read the file (%s)."),
+                  vlc_strerror(errno));
+    p_access->info.b_eof = true;
+    return NULL;
+}
+
+static int Seek (access_t *p_access, uint64_t pos)
+{
+    access_sys_t *p_sys = p_access->p_sys;
+
+    p_sys->offset = pos;
+    p_access->info.b_eof = false;
+    posix_fadvise (p_sys->fd, pos & ~(uint64_t)p_sys->page_mask,
+                   MMAP_WINDOW, POSIX_FADV_WILLNEED);
+    return VLC_SUCCESS;
+}
+
+static int Control (access_t *p_access, int query, va_list args)
+{
+    access_sys_t *p_sys = p_access->p_sys;
+
+    switch (query)
+    {
+        case ACCESS_CAN_SEEK:
+        case ACCESS_CAN_FASTSEEK:
+        case ACCESS_CAN_PAUSE:
+        case ACCESS_CAN_CONTROL_PACE:
+        case ACCESS_IS_MAPPED:
+            *va_arg(args, bool *) = true;
+            break;
+
+        case ACCESS_GET_SIZE:
+        {
+            struct stat st;
+
+            if (fstat (p_sys->fd, &st))
+                return VLC_EGENERIC;
+            *va_arg(args, uint64_t *) = st.st_size;
+            break;
+        }
+
+        case ACCESS_GET_PTS_DELAY:
+            *va_arg(args, int64_t *) = INT64_C(1000) *
+                var_InheritInteger (p_access, "file-caching");
+            break;
+
+        case ACCESS_SET_PAUSE_STATE:
+            break;
+
+        default:
+            return VLC_EGENERIC;
+    }
+    return VLC_SUCCESS;
+}
@@ -45,7 +45,18 @@
 #include <vlc_interrupt.h>
 #include <fcntl.h>
 
-#define MTU 65535
+#include "mdi.h"
+#include "../demux/mpeg/ts_filter.h"
+
+/* Datagrams are received into blocks of the Ethernet MTU, recycled by the
+ * block allocator, until a larger one shows up */
+#define MTU 1500
+#define MTU_MAX 65535
+
+#ifdef HAVE_RECVMMSG
+/* Datagrams received at once */
+# define BATCH 64
+#endif
 
 /*****************************************************************************
  * Module descriptor
@@ -55,6 +66,19 @@ static void Close( vlc_object_t * );
 
 #define BUFFER_TEXT N_("Receive buffer")
 #define BUFFER_LONGTEXT N_("UDP receive buffer size (bytes)" )
+#define TIMESTAMPS_TEXT N_("Kernel receive timestamps")
+#define TIMESTAMPS_LONGTEXT N_( \
+    "Date each datagram with its reception time by the kernel, as the " \
+    "DTS of its block." )
+#define STATS_TEXT N_("Reception quality statistics")
+#define STATS_LONGTEXT N_( \
+    "Measure the datagrams inter-arrival times and bursts, the RTP " \
+    "sequence gaps and the Media Delivery Index (RFC 4445), for the " \
+    "stream analysers." )
+#define PID_FILTER_TEXT N_("Filter MPEG-TS pids")
+#define PID_FILTER_LONGTEXT N_( \
+    "Drop the TS packets of the programs and tables not used by the " \
+    "demuxer as soon as they are received, for multi-program streams." )
 
 vlc_module_begin ()
     set_shortname( N_("UDP" ) )
@@ -64,6 +88,12 @@ vlc_module_begin ()
 
     add_obsolete_integer( "server-port" ) /* since 2.0.0 */
     add_integer( "udp-buffer", 0x400000, BUFFER_TEXT, BUFFER_LONGTEXT, true )
+#ifdef HAVE_RECVMMSG
+    add_bool( "udp-timestamps", false, TIMESTAMPS_TEXT, TIMESTAMPS_LONGTEXT, true )
+#endif
+    add_bool( "udp-stats", false, STATS_TEXT, STATS_LONGTEXT, true )
+    add_bool( "udp-pid-filter", false, PID_FILTER_TEXT, PID_FILTER_LONGTEXT,
+              true )
 
     set_capability( "access", 0 )
     add_shortcut( "udp", "udpstream", "udp4", "udp6" )
@@ -74,10 +104,19 @@ vlc_module_end ()
 struct access_sys_t
 {
     int fd;
+    size_t mtu;
     size_t fifo_size;
     block_fifo_t *fifo;
+    block_t *pending; /* dequeued, not returned yet */
     vlc_sem_t semaphore;
     vlc_thread_t thread;
+    mdi_t *mdi; /* reception statistics, or NULL */
+    ts_filter_t *filter; /* TS pid filter, or NULL */
+#ifdef HAVE_RECVMMSG
+    bool timestamps; /* kernel dates as block DTS */
+    bool dates; /* kernel dates enabled */
+    block_t *ring[BATCH]; /* blocks for the next recvmmsg() */
+#endif
 };
 
 /*****************************************************************************
@@ -86,6 +125,9 @@ struct access_sys_t
 static block_t *BlockUDP( access_t * );
 static int Control( access_t *, int, va_list );
 static void* ThreadRead( void *data );
+#ifdef HAVE_RECVMMSG
+static void* ThreadReadBatch( void *data );
+#endif
 
 /*****************************************************************************
  * Open: open the socket
@@ -178,13 +220,49 @@ static int Open( vlc_object_t *p_this )
         goto error;
     }
 
+    sys->mtu = MTU;
     sys->fifo_size = var_InheritInteger( p_access, "udp-buffer");
+    sys->pending = NULL;
+    sys->mdi = NULL;
+    if( var_InheritBool( p_access, "udp-stats" ) )
+        sys->mdi = mdi_New();
+    sys->filter = NULL;
+    if( var_InheritBool( p_access, "udp-pid-filter" ) )
+        sys->filter = ts_filter_New();
     vlc_sem_init( &sys->semaphore, 0 );
 
+#ifdef HAVE_RECVMMSG
+    for( unsigned i = 0; i < BATCH; i++ )
+        sys->ring[i] = NULL;
+    sys->timestamps = false;
+    sys->dates = false;
+# ifdef SO_TIMESTAMPNS
+    /* The statistics need the dates of the datagrams within a batch */
+    sys->timestamps = var_InheritBool( p_access, "udp-timestamps" );
+    if( sys->timestamps || sys->mdi != NULL )
+    {
+        sys->dates = !setsockopt( sys->fd, SOL_SOCKET, SO_TIMESTAMPNS,
+                                  &(int){ 1 }, sizeof (int) );
+        if( !sys->dates )
+            msg_Warn( p_access, "kernel receive timestamps not supported" );
+        sys->timestamps = sys->timestamps && sys->dates;
+    }
+# endif
+#endif
+
+#ifdef HAVE_RECVMMSG
+    if( vlc_clone( &sys->thread, ThreadReadBatch, p_access,
+                   VLC_THREAD_PRIORITY_INPUT ) )
+#else
     if( vlc_clone( &sys->thread, ThreadRead, p_access,
                    VLC_THREAD_PRIORITY_INPUT ) )
+#endif
     {
         vlc_sem_destroy( &sys->semaphore );
+        if( sys->mdi != NULL )
+            mdi_Delete( sys->mdi );
+        if( sys->filter != NULL )
+            ts_filter_Delete( sys->filter );
         block_FifoRelease( sys->fifo );
         net_Close( sys->fd );
 error:
@@ -205,6 +283,17 @@ static void Close( vlc_object_t *p_this )
 
     vlc_cancel( sys->thread );
     vlc_join( sys->thread, NULL );
+#ifdef HAVE_RECVMMSG
+    for( unsigned i = 0; i < BATCH; i++ )
+        if( sys->ring[i] != NULL )
+            block_Release( sys->ring[i] );
+#endif
+    if( sys->pending != NULL )
+        block_ChainRelease( sys->pending );
+    if( sys->mdi != NULL )
+        mdi_Delete( sys->mdi );
+    if( sys->filter != NULL )
+        ts_filter_Delete( sys->filter );
     vlc_sem_destroy( &sys->semaphore );
     block_FifoRelease( sys->fifo );
     net_Close( sys->fd );
@@ -216,6 +305,7 @@ static void Close( vlc_object_t *p_this )
  *****************************************************************************/
 static int Control( access_t *p_access, int i_query, va_list args )
 {
+    access_sys_t *sys = p_access->p_sys;
     bool    *pb_bool;
     int64_t *pi_64;
 
@@ -235,6 +325,69 @@ static int Control( access_t *p_access, int i_query, va_list args )
                    * var_InheritInteger(p_access, "network-caching");
             break;
 
+        case ACCESS_GET_NET_STATS:
+            if( sys->mdi == NULL )
+                return VLC_EGENERIC;
+            mdi_Get( sys->mdi, va_arg( args, stream_net_stats_t * ) );
+            break;
+
+        case ACCESS_GET_BUFFERED:
+        {
+            uint64_t *pi_size = va_arg( args, uint64_t * );
+            size_t i_pending;
+
+            block_ChainProperties( sys->pending, NULL, &i_pending, NULL );
+            vlc_fifo_Lock( sys->fifo );
+            *pi_size = i_pending + vlc_fifo_GetBytes( sys->fifo );
+            vlc_fifo_Unlock( sys->fifo );
+            *va_arg( args, bool * ) = false;
+            break;
+        }
+
+        case ACCESS_SET_PRIVATE_ID_STATE:
+        {
+            if( sys->filter == NULL )
+                return VLC_EGENERIC;
+
+            unsigned i_pid = va_arg( args, int );
+            bool b_selected = va_arg( args, int );
+
+            if( unlikely(i_pid > 0x1FFF) )
+                return VLC_EGENERIC;
+            ts_filter_SetPID( sys->filter, i_pid, b_selected );
+            break;
+        }
+
+        case ACCESS_GET_PRIVATE_ID_STATE:
+        {
+            if( sys->filter == NULL )
+                return VLC_EGENERIC;
+
+            unsigned i_pid = va_arg( args, int );
+            bool *pb_selected = va_arg( args, bool * );
+
+            *pb_selected = likely(i_pid <= 0x1FFF)
+                         ? ts_filter_GetPID( sys->filter, i_pid ) : false;
+            break;
+        }
+
+        case ACCESS_SET_PRIVATE_ID_SECTION:
+        {
+            if( sys->filter == NULL )
+                return VLC_EGENERIC;
+
+            unsigned i_pid = va_arg( args, int );
+            int i_table_id = va_arg( args, int );
+            int i_mask = va_arg( args, int );
+            int i_extension = va_arg( args, int );
+            bool b_selected = va_arg( args, int );
+
+            if( unlikely(i_pid > 0x1FFF) )
+                return VLC_EGENERIC;
+            return ts_filter_SetSection( sys->filter, i_pid, i_table_id,
+                                         i_mask, i_extension, b_selected );
+        }
+
         default:
             return VLC_EGENERIC;
     }
@@ -247,17 +400,79 @@ static int Control( access_t *p_access, int i_query, va_list args )
 static block_t *BlockUDP( access_t *p_access )
 {
     access_sys_t *sys = p_access->p_sys;
-    block_t *block;
+    block_t *block = sys->pending;
 
     if (p_access->info.b_eof)
         return NULL;
 
-    vlc_sem_wait_i11e(&sys->semaphore);
+    /* Take all the queued datagrams at once, the semaphore is only posted
+     * once per batch */
+    if (block == NULL)
+    {
+        vlc_sem_wait_i11e(&sys->semaphore);
+        vlc_fifo_Lock(sys->fifo);
+        block = vlc_fifo_DequeueAllUnlocked(sys->fifo);
+        vlc_fifo_Unlock(sys->fifo);
+        if (block == NULL)
+            return NULL;
+    }
+
+    sys->pending = block->p_next;
+    block->p_next = NULL;
+    return block;
+}
+
+/*****************************************************************************
+ * Enqueue: hand datagrams over to BlockUDP()
+ *****************************************************************************/
+static void Enqueue( access_sys_t *sys, block_t *chain, size_t len )
+{
     vlc_fifo_Lock(sys->fifo);
-    block = vlc_fifo_DequeueUnlocked(sys->fifo);
+    /* Discard old buffers on overflow */
+    while (vlc_fifo_GetBytes(sys->fifo) > 0
+        && vlc_fifo_GetBytes(sys->fifo) + len > sys->fifo_size)
+    {
+        int canc = vlc_savecancel();
+        block_Release(vlc_fifo_DequeueUnlocked(sys->fifo));
+        vlc_restorecancel(canc);
+    }
+
+    vlc_fifo_QueueUnlocked(sys->fifo, chain);
     vlc_fifo_Unlock(sys->fifo);
+    vlc_sem_post(&sys->semaphore);
+}
 
-    return block;
+/*****************************************************************************
+ * Filter: drop the TS packets the demuxer did not select from a datagram of
+ * raw or RTP (RFC 2250) encapsulated packets. Returns false if nothing is
+ * left of it.
+ *****************************************************************************/
+static bool Filter( access_sys_t *sys, block_t *pkt )
+{
+    size_t header = 0;
+
+    if (sys->filter == NULL || (pkt->i_flags & BLOCK_FLAG_CORRUPTED))
+        return true;
+
+    if (pkt->i_buffer % 188 != 0)
+    {   /* RTP version 2, without padding, CSRC nor extension */
+        if (pkt->i_buffer < 12 || (pkt->i_buffer - 12) % 188 != 0
+         || pkt->p_buffer[0] != 0x80)
+            return true;
+        header = 12;
+    }
+
+    uint8_t *p = pkt->p_buffer + header;
+    size_t size = pkt->i_buffer - header, done;
+    size_t kept = ts_filter_Packets(sys->filter, p, size, 188, 0, &done);
+
+    /* Out of sync: the rest is left to the demuxer */
+    memmove(p + kept, p + done, size - done);
+    kept += size - done;
+
+    /* The RTP headers are kept, for the sequence numbers */
+    pkt->i_buffer = header + kept;
+    return pkt->i_buffer > 0;
 }
 
 /*****************************************************************************
@@ -270,7 +485,7 @@ static void* ThreadRead( void *data )
 
     for(;;)
     {
-        block_t *pkt = block_Alloc(MTU);
+        block_t *pkt = block_Alloc(sys->mtu);
         if (unlikely(pkt == NULL))
         {   /* OOM - dequeue and discard one packet */
             char dummy;
@@ -278,6 +493,14 @@ static void* ThreadRead( void *data )
             continue;
         }
 
+        struct iovec iov = {
+            .iov_base = pkt->p_buffer,
+            .iov_len = sys->mtu,
+        };
+        struct msghdr msg = {
+            .msg_iov = &iov,
+            .msg_iovlen = 1,
+        };
         ssize_t len;
 
         block_cleanup_push(pkt);
@@ -287,26 +510,185 @@ static void* ThreadRead( void *data )
             struct pollfd ufd = { .fd = sys->fd, .events = POLLIN };
             while (poll(&ufd, 1, -1) <= 0); /* cancellation point */
 #endif
-            len = recv(sys->fd, pkt->p_buffer, MTU, 0);
+            len = recvmsg(sys->fd, &msg, 0);
         }
         while (len == -1);
         vlc_cleanup_pop();
 
+        if (msg.msg_flags & MSG_TRUNC)
+        {
+            msg_Err(access, "%zd bytes packet truncated (MTU was %zu)",
+                    len, sys->mtu);
+            pkt->i_flags |= BLOCK_FLAG_CORRUPTED;
+            sys->mtu = MTU_MAX;
+        }
         pkt->i_buffer = len;
+        if (sys->mdi != NULL)
+            mdi_Datagram(sys->mdi, pkt->p_buffer, len, mdate());
 
-        vlc_fifo_Lock(sys->fifo);
-        /* Discard old buffers on overflow */
-        while (vlc_fifo_GetBytes(sys->fifo) + len > sys->fifo_size)
+        if (!Filter(sys, pkt))
         {
-            int canc = vlc_savecancel();
-            block_Release(vlc_fifo_DequeueUnlocked(sys->fifo));
-            vlc_restorecancel(canc);
+            block_Release(pkt);
+            continue;
         }
+        Enqueue(sys, pkt, pkt->i_buffer);
+    }
 
-        vlc_fifo_QueueUnlocked(sys->fifo, pkt);
-        vlc_fifo_Unlock(sys->fifo);
-        vlc_sem_post(&sys->semaphore);
+    return NULL;
+}
+
+#ifdef HAVE_RECVMMSG
+/* Kernel reception date of the datagram, VLC_TS_INVALID if missing */
+static mtime_t Timestamp( struct msghdr *msg )
+{
+# ifdef SO_TIMESTAMPNS
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(msg); cmsg != NULL;
+         cmsg = CMSG_NXTHDR(msg, cmsg))
+    {
+        if (cmsg->cmsg_level == SOL_SOCKET
+         && cmsg->cmsg_type == SCM_TIMESTAMPNS)
+        {
+            struct timespec ts;
+
+            memcpy(&ts, CMSG_DATA(cmsg), sizeof (ts));
+            return INT64_C(1000000) * ts.tv_sec + ts.tv_nsec / 1000;
+        }
+    }
+# else
+    (void) msg;
+# endif
+    return VLC_TS_INVALID;
+}
+
+/*****************************************************************************
+ * ThreadReadBatch: Pull as many packets as available with one system call,
+ * into blocks allocated beforehand, and queue them at once.
+ *****************************************************************************/
+static void* ThreadReadBatch( void *data )
+{
+    access_t *access = data;
+    access_sys_t *sys = access->p_sys;
+    struct mmsghdr msgs[BATCH];
+    struct iovec iovs[BATCH];
+    union
+    {
+        struct cmsghdr hdr;
+        char buf[CMSG_SPACE(sizeof (struct timespec))];
+    } controls[BATCH];
+
+    for(;;)
+    {
+        unsigned count = 0;
+
+        /* Replace the blocks queued by the previous batch */
+        while (count < BATCH)
+        {
+            if (sys->ring[count] == NULL
+             && (sys->ring[count] = block_Alloc(sys->mtu)) == NULL)
+                break;
+
+            iovs[count].iov_base = sys->ring[count]->p_buffer;
+            iovs[count].iov_len = sys->mtu;
+            msgs[count].msg_hdr = (struct msghdr) {
+                .msg_iov = &iovs[count],
+                .msg_iovlen = 1,
+                .msg_control = sys->dates ? controls[count].buf : NULL,
+                .msg_controllen = sys->dates ? sizeof (controls[count]) : 0,
+            };
+            count++;
+        }
+
+        if (unlikely(count == 0))
+        {   /* OOM - dequeue and discard one packet */
+            char dummy;
+            recv(sys->fd, &dummy, 1, 0);
+            continue;
+        }
+
+        int n;
+        do
+        {
+#ifndef LIBVLC_USE_PTHREAD
+            struct pollfd ufd = { .fd = sys->fd, .events = POLLIN };
+            while (poll(&ufd, 1, -1) <= 0); /* cancellation point */
+#endif
+            n = recvmmsg(sys->fd, msgs, count, MSG_WAITFORONE, NULL);
+        }
+        while (n == -1 && errno != ENOSYS);
+
+        if (n == -1)
+        {
+            msg_Warn(access, "recvmmsg() not supported, receiving datagrams "
+                     "one by one");
+            /* Dated with mdate() from now on, and only with it */
+            sys->timestamps = sys->dates = false;
+            return ThreadRead(data);
+        }
+
+        block_t *chain = NULL, **pp = &chain;
+        size_t len = 0;
+        bool truncated = false;
+        /* Without kernel dates, the whole batch is dated on arrival */
+        const mtime_t now = sys->mdi != NULL && !sys->dates ? mdate()
+                                                             : VLC_TS_INVALID;
+
+        for (int i = 0; i < n; i++)
+        {
+            block_t *pkt = sys->ring[i];
+
+            sys->ring[i] = NULL;
+            pkt->i_buffer = msgs[i].msg_len;
+            if (msgs[i].msg_hdr.msg_flags & MSG_TRUNC)
+            {
+                msg_Err(access, "%u bytes packet truncated (MTU was %zu)",
+                        msgs[i].msg_len, sys->mtu);
+                pkt->i_flags |= BLOCK_FLAG_CORRUPTED;
+                truncated = true;
+            }
+            if (sys->dates)
+            {
+                const mtime_t date = Timestamp(&msgs[i].msg_hdr);
+                if (sys->timestamps)
+                    pkt->i_dts = date;
+                /* A datagram missing its kernel date is left out of the
+                 * timing, rather than dated with another clock */
+                if (sys->mdi != NULL)
+                    mdi_Datagram(sys->mdi, pkt->p_buffer, pkt->i_buffer, date);
+            }
+            else if (sys->mdi != NULL)
+                mdi_Datagram(sys->mdi, pkt->p_buffer, pkt->i_buffer, now);
+
+            if (!Filter(sys, pkt))
+            {
+                block_Release(pkt);
+                continue;
+            }
+            len += pkt->i_buffer;
+            *pp = pkt;
+            pp = &pkt->p_next;
+        }
+
+        if (truncated)
+        {   /* The blocks left are too small now */
+            sys->mtu = MTU_MAX;
+            for (unsigned i = n; i < count; i++)
+            {
+                block_Release(sys->ring[i]);
+                sys->ring[i] = NULL;
+            }
+        }
+
+        /* The blocks left for the next batch go first */
+        for (unsigned i = n; i < BATCH; i++)
+        {
+            sys->ring[i - n] = sys->ring[i];
+            sys->ring[i] = NULL;
+        }
+
+        if (chain != NULL)
+            Enqueue(sys, chain, len);
     }
 
     return NULL;
 }
+#endif
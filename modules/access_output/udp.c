@@ -49,7 +49,7 @@
 
 #include <vlc_network.h>
 
-#define MAX_EMPTY_BLOCKS 200
+#include "udp_sender.h"
 
 /*****************************************************************************
  * Module descriptor
@@ -107,21 +107,10 @@ static ssize_t Write   ( sout_access_out_t *, block_t * );
 static int  Seek    ( sout_access_out_t *, off_t  );
 static int Control( sout_access_out_t *, int, va_list );
 
-static void* ThreadWrite( void * );
-static block_t *NewUDPPacket( sout_access_out_t *, mtime_t );
-
 struct sout_access_out_sys_t
 {
-    mtime_t       i_caching;
     int           i_handle;
-    bool          b_mtu_warning;
-    size_t        i_mtu;
-
-    block_fifo_t *p_fifo;
-    block_fifo_t *p_empty_blocks;
-    block_t      *p_buffer;
-
-    vlc_thread_t  thread;
+    udp_sender_t *p_sender;
 };
 
 #define DEFAULT_PORT 1234
@@ -205,21 +194,15 @@ static int Open( vlc_object_t *p_this )
     }
     shutdown( i_handle, SHUT_RD );
 
-    p_sys->i_caching = UINT64_C(1000)
-                     * var_GetInteger( p_access, SOUT_CFG_PREFIX "caching");
     p_sys->i_handle = i_handle;
-    p_sys->i_mtu = var_CreateGetInteger( p_this, "mtu" );
-    p_sys->b_mtu_warning = false;
-    p_sys->p_fifo = block_FifoNew();
-    p_sys->p_empty_blocks = block_FifoNew();
-    p_sys->p_buffer = NULL;
-
-    if( vlc_clone( &p_sys->thread, ThreadWrite, p_access,
-                           VLC_THREAD_PRIORITY_HIGHEST ) )
+    p_sys->p_sender = udp_sender_New( p_this, i_handle,
+                        var_CreateGetInteger( p_this, "mtu" ),
+                        UINT64_C(1000)
+                         * var_GetInteger( p_access, SOUT_CFG_PREFIX "caching"),
+                        var_GetInteger( p_access, SOUT_CFG_PREFIX "group" ) );
+    if( p_sys->p_sender == NULL )
     {
         msg_Err( p_access, "cannot spawn sout access thread" );
-        block_FifoRelease( p_sys->p_fifo );
-        block_FifoRelease( p_sys->p_empty_blocks );
         net_Close (i_handle);
         free (p_sys);
         return VLC_EGENERIC;
@@ -240,13 +223,7 @@ static void Close( vlc_object_t * p_this )
     sout_access_out_t     *p_access = (sout_access_out_t*)p_this;
     sout_access_out_sys_t *p_sys = p_access->p_sys;
 
-    vlc_cancel( p_sys->thread );
-    vlc_join( p_sys->thread, NULL );
-    block_FifoRelease( p_sys->p_fifo );
-    block_FifoRelease( p_sys->p_empty_blocks );
-
-    if( p_sys->p_buffer ) block_Release( p_sys->p_buffer );
-
+    udp_sender_Delete( p_sys->p_sender );
     net_Close( p_sys->i_handle );
     free( p_sys );
 }
@@ -268,87 +245,13 @@ static int Control( sout_access_out_t *p_access, int i_query, va_list args )
 }
 
 /*****************************************************************************
- * Write: standard write on a file descriptor.
+ * Write: queue the packets in datagrams, sent by the sender thread.
  *****************************************************************************/
 static ssize_t Write( sout_access_out_t *p_access, block_t *p_buffer )
 {
     sout_access_out_sys_t *p_sys = p_access->p_sys;
-    int i_len = 0;
-
-    while( p_buffer )
-    {
-        block_t *p_next;
-        int i_packets = 0;
-        mtime_t now = mdate();
-
-        if( !p_sys->b_mtu_warning && p_buffer->i_buffer > p_sys->i_mtu )
-        {
-            msg_Warn( p_access, "packet size > MTU, you should probably "
-                      "increase the MTU" );
-            p_sys->b_mtu_warning = true;
-        }
-
-        /* Check if there is enough space in the buffer */
-        if( p_sys->p_buffer &&
-            p_sys->p_buffer->i_buffer + p_buffer->i_buffer > p_sys->i_mtu )
-        {
-            if( p_sys->p_buffer->i_dts + p_sys->i_caching < now )
-            {
-                msg_Dbg( p_access, "late packet for UDP input (%"PRId64 ")",
-                         now - p_sys->p_buffer->i_dts
-                          - p_sys->i_caching );
-            }
-            block_FifoPut( p_sys->p_fifo, p_sys->p_buffer );
-            p_sys->p_buffer = NULL;
-        }
-
-        i_len += p_buffer->i_buffer;
-        while( p_buffer->i_buffer )
-        {
-            size_t i_payload_size = p_sys->i_mtu;
-            size_t i_write = __MIN( p_buffer->i_buffer, i_payload_size );
-
-            i_packets++;
-
-            if( !p_sys->p_buffer )
-            {
-                p_sys->p_buffer = NewUDPPacket( p_access, p_buffer->i_dts );
-                if( !p_sys->p_buffer ) break;
-            }
-
-            memcpy( p_sys->p_buffer->p_buffer + p_sys->p_buffer->i_buffer,
-                    p_buffer->p_buffer, i_write );
-
-            p_sys->p_buffer->i_buffer += i_write;
-            p_buffer->p_buffer += i_write;
-            p_buffer->i_buffer -= i_write;
-            if ( p_buffer->i_flags & BLOCK_FLAG_CLOCK )
-            {
-                if ( p_sys->p_buffer->i_flags & BLOCK_FLAG_CLOCK )
-                    msg_Warn( p_access, "putting two PCRs at once" );
-                p_sys->p_buffer->i_flags |= BLOCK_FLAG_CLOCK;
-            }
-
-            if( p_sys->p_buffer->i_buffer == p_sys->i_mtu || i_packets > 1 )
-            {
-                /* Flush */
-                if( p_sys->p_buffer->i_dts + p_sys->i_caching < now )
-                {
-                    msg_Dbg( p_access, "late packet for udp input (%"PRId64 ")",
-                             mdate() - p_sys->p_buffer->i_dts
-                              - p_sys->i_caching );
-                }
-                block_FifoPut( p_sys->p_fifo, p_sys->p_buffer );
-                p_sys->p_buffer = NULL;
-            }
-        }
-
-        p_next = p_buffer->p_next;
-        block_Release( p_buffer );
-        p_buffer = p_next;
-    }
 
-    return i_len;
+    return udp_sender_Write( p_sys->p_sender, p_buffer );
 }
 
 /*****************************************************************************
@@ -360,108 +263,3 @@ static int Seek( sout_access_out_t *p_access, off_t i_pos )
     msg_Err( p_access, "UDP sout access cannot seek" );
     return -1;
 }
-
-/*****************************************************************************
- * NewUDPPacket: allocate a new UDP packet of size p_sys->i_mtu
- *****************************************************************************/
-static block_t *NewUDPPacket( sout_access_out_t *p_access, mtime_t i_dts)
-{
-    sout_access_out_sys_t *p_sys = p_access->p_sys;
-    block_t *p_buffer;
-
-    while ( block_FifoCount( p_sys->p_empty_blocks ) > MAX_EMPTY_BLOCKS )
-    {
-        p_buffer = block_FifoGet( p_sys->p_empty_blocks );
-        block_Release( p_buffer );
-    }
-
-    if( block_FifoCount( p_sys->p_empty_blocks ) == 0 )
-    {
-        p_buffer = block_Alloc( p_sys->i_mtu );
-    }
-    else
-    {
-        p_buffer = block_FifoGet(p_sys->p_empty_blocks );
-        p_buffer->i_flags = 0;
-        p_buffer = block_Realloc( p_buffer, 0, p_sys->i_mtu );
-    }
-
-    p_buffer->i_dts = i_dts;
-    p_buffer->i_buffer = 0;
-
-    return p_buffer;
-}
-
-/*****************************************************************************
- * ThreadWrite: Write a packet on the network at the good time.
- *****************************************************************************/
-static void* ThreadWrite( void *data )
-{
-    sout_access_out_t *p_access = data;
-    sout_access_out_sys_t *p_sys = p_access->p_sys;
-    mtime_t i_date_last = -1;
-    const unsigned i_group = var_GetInteger( p_access,
-                                             SOUT_CFG_PREFIX "group" );
-    mtime_t i_to_send = i_group;
-    unsigned i_dropped_packets = 0;
-
-    for (;;)
-    {
-        block_t *p_pk = block_FifoGet( p_sys->p_fifo );
-        mtime_t       i_date, i_sent;
-
-        i_date = p_sys->i_caching + p_pk->i_dts;
-        if( i_date_last > 0 )
-        {
-            if( i_date - i_date_last > 2000000 )
-            {
-                if( !i_dropped_packets )
-                    msg_Dbg( p_access, "mmh, hole (%"PRId64" > 2s) -> drop",
-                             i_date - i_date_last );
-
-                block_FifoPut( p_sys->p_empty_blocks, p_pk );
-
-                i_date_last = i_date;
-                i_dropped_packets++;
-                continue;
-            }
-            else if( i_date - i_date_last < -1000 )
-            {
-                if( !i_dropped_packets )
-                    msg_Dbg( p_access, "mmh, packets in the past (%"PRId64")",
-                             i_date_last - i_date );
-            }
-        }
-
-        block_cleanup_push( p_pk );
-        i_to_send--;
-        if( !i_to_send || (p_pk->i_flags & BLOCK_FLAG_CLOCK) )
-        {
-            mwait( i_date );
-            i_to_send = i_group;
-        }
-        if ( send( p_sys->i_handle, p_pk->p_buffer, p_pk->i_buffer, 0 ) == -1 )
-            msg_Warn( p_access, "send error: %s", vlc_strerror_c(errno) );
-        vlc_cleanup_pop();
-
-        if( i_dropped_packets )
-        {
-            msg_Dbg( p_access, "dropped %i packets", i_dropped_packets );
-            i_dropped_packets = 0;
-        }
-
-#if 1
-        i_sent = mdate();
-        if ( i_sent > i_date + 20000 )
-        {
-            msg_Dbg( p_access, "packet has been sent too late (%"PRId64 ")",
-                     i_sent - i_date );
-        }
-#endif
-
-        block_FifoPut( p_sys->p_empty_blocks, p_pk );
-
-        i_date_last = i_date;
-    }
-    return NULL;
-}
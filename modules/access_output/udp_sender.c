@@ -0,0 +1,487 @@
+/*****************************************************************************
+ * udp_sender.c: paced and batched sending of UDP datagrams
+ *****************************************************************************
+ * Copyright (C) 2004-2015 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <vlc_common.h>
+#include <vlc_block.h>
+
+#include <assert.h>
+#include <errno.h>
+
+#ifdef _WIN32
+#   include <winsock2.h>
+#   include <ws2tcpip.h>
+#else
+#   include <sys/socket.h>
+#   include <netinet/in.h>
+#   include <netinet/udp.h>
+#endif
+#ifdef __linux__
+#   include <sys/prctl.h>
+#endif
+
+#include <vlc_network.h>
+
+#include "udp_sender.h"
+
+/* The ring takes this much address space, only committed as it fills */
+#define UDP_RING_BYTES (8 << 20)
+#define UDP_RING_MIN   64
+
+/* Datagrams sent by one system call */
+#define UDP_BATCH 64
+
+#if defined(HAVE_SENDMMSG) && defined(UDP_SEGMENT)
+/* Limits of one segmentation offload buffer */
+# define UDP_GSO_SEGMENTS 64
+# define UDP_GSO_SIZE     65000
+#endif
+
+typedef struct
+{
+    mtime_t  i_dts;   /* of its first block */
+    size_t   i_size;
+    bool     b_clock;
+    uint8_t *p_data;  /* i_mtu bytes in the ring */
+} udp_datagram_t;
+
+struct udp_sender_t
+{
+    vlc_object_t *p_obj;
+    int           i_fd;
+    size_t        i_mtu;
+    mtime_t       i_delay;
+    unsigned      i_group;
+    bool          b_mtu_warning;
+    bool          b_mmsg;
+    bool          b_gso;
+
+    vlc_mutex_t   lock;
+    vlc_cond_t    wait_ready;
+    vlc_cond_t    wait_space;
+    unsigned      i_read;  /* first datagram to send */
+    unsigned      i_write; /* datagram being filled */
+
+    udp_datagram_t *p_fill; /* owned by the writer until published */
+
+    vlc_thread_t  thread;
+    uint8_t      *p_buffer;
+    unsigned      i_slots; /* power of 2 */
+    udp_datagram_t ring[];
+};
+
+static udp_datagram_t *Datagram( udp_sender_t *p_sys, unsigned i_index )
+{
+    return &p_sys->ring[i_index & (p_sys->i_slots - 1)];
+}
+
+/*****************************************************************************
+ * Writer side
+ *****************************************************************************/
+static void Reserve( udp_sender_t *p_sys, mtime_t i_dts )
+{
+    vlc_mutex_lock( &p_sys->lock );
+    while( p_sys->i_write - p_sys->i_read >= p_sys->i_slots )
+        vlc_cond_wait( &p_sys->wait_space, &p_sys->lock );
+    p_sys->p_fill = Datagram( p_sys, p_sys->i_write );
+    vlc_mutex_unlock( &p_sys->lock );
+
+    p_sys->p_fill->i_dts = i_dts;
+    p_sys->p_fill->i_size = 0;
+    p_sys->p_fill->b_clock = false;
+}
+
+static void Publish( udp_sender_t *p_sys, mtime_t now )
+{
+    if( p_sys->p_fill->i_dts + p_sys->i_delay < now )
+    {
+        msg_Dbg( p_sys->p_obj, "late packet for udp input (%"PRId64 ")",
+                 now - p_sys->p_fill->i_dts - p_sys->i_delay );
+    }
+
+    vlc_mutex_lock( &p_sys->lock );
+    p_sys->i_write++;
+    vlc_cond_signal( &p_sys->wait_ready );
+    vlc_mutex_unlock( &p_sys->lock );
+    p_sys->p_fill = NULL;
+}
+
+ssize_t udp_sender_Write( udp_sender_t *p_sys, block_t *p_buffer )
+{
+    ssize_t i_len = 0;
+
+    while( p_buffer )
+    {
+        block_t *p_next;
+        int i_packets = 0;
+        mtime_t now = mdate();
+
+        if( !p_sys->b_mtu_warning && p_buffer->i_buffer > p_sys->i_mtu )
+        {
+            msg_Warn( p_sys->p_obj, "packet size > MTU, you should probably "
+                      "increase the MTU" );
+            p_sys->b_mtu_warning = true;
+        }
+
+        /* Check if there is enough space in the datagram */
+        if( p_sys->p_fill &&
+            p_sys->p_fill->i_size + p_buffer->i_buffer > p_sys->i_mtu )
+            Publish( p_sys, now );
+
+        i_len += p_buffer->i_buffer;
+        while( p_buffer->i_buffer )
+        {
+            size_t i_write = __MIN( p_buffer->i_buffer, p_sys->i_mtu );
+
+            i_packets++;
+
+            if( !p_sys->p_fill )
+                Reserve( p_sys, p_buffer->i_dts );
+
+            udp_datagram_t *p_dg = p_sys->p_fill;
+            memcpy( p_dg->p_data + p_dg->i_size, p_buffer->p_buffer, i_write );
+
+            p_dg->i_size += i_write;
+            p_buffer->p_buffer += i_write;
+            p_buffer->i_buffer -= i_write;
+            if ( p_buffer->i_flags & BLOCK_FLAG_CLOCK )
+            {
+                if ( p_dg->b_clock )
+                    msg_Warn( p_sys->p_obj, "putting two PCRs at once" );
+                p_dg->b_clock = true;
+            }
+
+            if( p_dg->i_size == p_sys->i_mtu || i_packets > 1 )
+                Publish( p_sys, now );
+        }
+
+        p_next = p_buffer->p_next;
+        block_Release( p_buffer );
+        p_buffer = p_next;
+    }
+
+    return i_len;
+}
+
+/*****************************************************************************
+ * Sender side
+ *****************************************************************************/
+static void SendOneByOne( udp_sender_t *p_sys, unsigned i_first,
+                          unsigned i_count )
+{
+    for( unsigned i = 0; i < i_count; i++ )
+    {
+        const udp_datagram_t *p_dg = Datagram( p_sys, i_first + i );
+
+        if( send( p_sys->i_fd, p_dg->p_data, p_dg->i_size, 0 ) == -1 )
+            msg_Warn( p_sys->p_obj, "send error: %s", vlc_strerror_c(errno) );
+    }
+}
+
+/* Sends the i_count datagrams at the head of the ring */
+static void Send( udp_sender_t *p_sys, unsigned i_count )
+{
+#ifdef HAVE_SENDMMSG
+    struct mmsghdr msgs[UDP_BATCH];
+    struct iovec iovs[UDP_BATCH];
+# ifdef UDP_SEGMENT
+    union
+    {
+        struct cmsghdr hdr;
+        char buf[CMSG_SPACE(sizeof (uint16_t))];
+    } controls[UDP_BATCH];
+# endif
+    unsigned i_msgs = 0;
+
+    if( !p_sys->b_mmsg )
+    {
+        SendOneByOne( p_sys, p_sys->i_read, i_count );
+        return;
+    }
+
+    assert( i_count <= UDP_BATCH );
+    for( unsigned i = 0; i < i_count; )
+    {
+        const udp_datagram_t *p_dg = Datagram( p_sys, p_sys->i_read + i );
+        unsigned i_segs = 1;
+
+        iovs[i].iov_base = p_dg->p_data;
+        iovs[i].iov_len = p_dg->i_size;
+        msgs[i_msgs].msg_hdr = (struct msghdr) {
+            .msg_iov = &iovs[i],
+            .msg_iovlen = 1,
+        };
+# ifdef UDP_SEGMENT
+        /* The datagrams of the same size make one buffer for the kernel
+         * to cut, the last one of it possibly shorter */
+        while( p_sys->b_gso && i + i_segs < i_count
+            && i_segs < UDP_GSO_SEGMENTS
+            && (i_segs + 1) * p_dg->i_size <= UDP_GSO_SIZE )
+        {
+            const udp_datagram_t *p_seg =
+                Datagram( p_sys, p_sys->i_read + i + i_segs );
+            if( p_seg->i_size > p_dg->i_size )
+                break;
+
+            iovs[i + i_segs].iov_base = p_seg->p_data;
+            iovs[i + i_segs].iov_len = p_seg->i_size;
+            i_segs++;
+            if( p_seg->i_size < p_dg->i_size )
+                break;
+        }
+
+        if( i_segs > 1 )
+        {
+            struct cmsghdr *cmsg = &controls[i_msgs].hdr;
+            const uint16_t i_segment = p_dg->i_size;
+
+            cmsg->cmsg_level = IPPROTO_UDP;
+            cmsg->cmsg_type = UDP_SEGMENT;
+            cmsg->cmsg_len = CMSG_LEN(sizeof (i_segment));
+            memcpy( CMSG_DATA(cmsg), &i_segment, sizeof (i_segment) );
+            msgs[i_msgs].msg_hdr.msg_iovlen = i_segs;
+            msgs[i_msgs].msg_hdr.msg_control = controls[i_msgs].buf;
+            msgs[i_msgs].msg_hdr.msg_controllen = sizeof (controls[i_msgs]);
+        }
+# endif
+        i += i_segs;
+        i_msgs++;
+    }
+
+    for( unsigned i = 0; i < i_msgs; )
+    {
+        int n = sendmmsg( p_sys->i_fd, &msgs[i], i_msgs - i, 0 );
+        if( n > 0 )
+        {
+            i += n;
+            continue;
+        }
+
+        /* The first message failed: find out why with plain send() */
+        const struct msghdr *hdr = &msgs[i].msg_hdr;
+        const unsigned i_first = hdr->msg_iov - iovs;
+        if( n == -1 && errno == ENOSYS )
+        {
+            msg_Warn( p_sys->p_obj, "sendmmsg() not supported, sending "
+                      "datagrams one by one" );
+            p_sys->b_mmsg = false;
+            SendOneByOne( p_sys, p_sys->i_read + i_first, i_count - i_first );
+            break;
+        }
+# ifdef UDP_SEGMENT
+        /* Only the errors of the offload itself disable it, not those of
+         * the network */
+        else if( hdr->msg_iovlen > 1
+              && ( errno == EINVAL || errno == EIO || errno == EOPNOTSUPP ) )
+        {
+            msg_Warn( p_sys->p_obj, "segmentation offload failed (%s), "
+                      "sending datagrams one by one",
+                      vlc_strerror_c(errno) );
+            p_sys->b_gso = false;
+        }
+# endif
+        SendOneByOne( p_sys, p_sys->i_read + i_first, hdr->msg_iovlen );
+        i++;
+    }
+#else
+    SendOneByOne( p_sys, p_sys->i_read, i_count );
+#endif
+}
+
+/* Waits for datagrams to send, and returns how many there are */
+static unsigned WaitReady( udp_sender_t *p_sys )
+{
+    unsigned i_count;
+
+    vlc_mutex_lock( &p_sys->lock );
+    mutex_cleanup_push( &p_sys->lock );
+    while( p_sys->i_read == p_sys->i_write )
+        vlc_cond_wait( &p_sys->wait_ready, &p_sys->lock );
+    i_count = p_sys->i_write - p_sys->i_read;
+    vlc_cleanup_pop();
+    vlc_mutex_unlock( &p_sys->lock );
+    return i_count;
+}
+
+static void Consume( udp_sender_t *p_sys, unsigned i_count )
+{
+    vlc_mutex_lock( &p_sys->lock );
+    p_sys->i_read += i_count;
+    vlc_cond_signal( &p_sys->wait_space );
+    vlc_mutex_unlock( &p_sys->lock );
+}
+
+/*****************************************************************************
+ * Thread: Write the datagrams on the network at the good time.
+ *****************************************************************************/
+static void *Thread( void *data )
+{
+    udp_sender_t *p_sys = data;
+    mtime_t i_date_last = -1;
+    unsigned i_dropped_packets = 0;
+
+#ifdef PR_SET_TIMERSLACK
+    /* Wake up within a microsecond of the date, rather than 50 */
+    prctl( PR_SET_TIMERSLACK, 1000UL );
+#endif
+
+    for (;;)
+    {
+        const unsigned i_count = WaitReady( p_sys );
+        const udp_datagram_t *p_dg = Datagram( p_sys, p_sys->i_read );
+        mtime_t i_date = p_sys->i_delay + p_dg->i_dts;
+
+        if( i_date_last > 0 )
+        {
+            if( i_date - i_date_last > 2000000 )
+            {
+                if( !i_dropped_packets )
+                    msg_Dbg( p_sys->p_obj, "mmh, hole (%"PRId64" > 2s) -> drop",
+                             i_date - i_date_last );
+
+                Consume( p_sys, 1 );
+                i_date_last = i_date;
+                i_dropped_packets++;
+                continue;
+            }
+            else if( i_date - i_date_last < -1000 )
+            {
+                if( !i_dropped_packets )
+                    msg_Dbg( p_sys->p_obj, "mmh, packets in the past (%"PRId64")",
+                             i_date_last - i_date );
+            }
+        }
+
+        mwait( i_date );
+
+        /* Along with the datagrams due by now, send the rest of the group,
+         * but for a PCR, which goes out at its own date */
+        const mtime_t now = mdate();
+        unsigned i_batch = 1;
+
+        i_date_last = i_date;
+        while( i_batch < i_count && i_batch < UDP_BATCH )
+        {
+            p_dg = Datagram( p_sys, p_sys->i_read + i_batch );
+
+            const mtime_t i_next = p_sys->i_delay + p_dg->i_dts;
+            if( i_next > now && (i_batch >= p_sys->i_group || p_dg->b_clock) )
+                break;
+            if( i_next - i_date_last > 2000000 )
+                break; /* a hole, dropped as the head of the next batch */
+            i_date_last = i_next;
+            i_batch++;
+        }
+
+        Send( p_sys, i_batch );
+
+        if( i_dropped_packets )
+        {
+            msg_Dbg( p_sys->p_obj, "dropped %i packets", i_dropped_packets );
+            i_dropped_packets = 0;
+        }
+
+        mtime_t i_sent = mdate();
+        if ( i_sent > i_date + 20000 )
+        {
+            msg_Dbg( p_sys->p_obj, "packet has been sent too late (%"PRId64 ")",
+                     i_sent - i_date );
+        }
+
+        Consume( p_sys, i_batch );
+    }
+    return NULL;
+}
+
+udp_sender_t *udp_sender_New( vlc_object_t *p_obj, int i_fd, size_t i_mtu,
+                              mtime_t i_delay, unsigned i_group )
+{
+    if( i_mtu == 0 )
+    {
+        msg_Err( p_obj, "invalid MTU of 0 bytes" );
+        return NULL;
+    }
+
+    unsigned i_slots = UDP_RING_MIN;
+    while( (size_t)i_slots * 2 * i_mtu <= UDP_RING_BYTES )
+        i_slots *= 2;
+
+    udp_sender_t *p_sys = malloc( sizeof( *p_sys )
+                                  + i_slots * sizeof( udp_datagram_t ) );
+    if( unlikely(p_sys == NULL) )
+        return NULL;
+
+    p_sys->p_buffer = malloc( i_slots * i_mtu );
+    if( unlikely(p_sys->p_buffer == NULL) )
+    {
+        free( p_sys );
+        return NULL;
+    }
+    for( unsigned i = 0; i < i_slots; i++ )
+        p_sys->ring[i].p_data = p_sys->p_buffer + i * i_mtu;
+
+    p_sys->p_obj = p_obj;
+    p_sys->i_fd = i_fd;
+    p_sys->i_mtu = i_mtu;
+    p_sys->i_delay = i_delay;
+    p_sys->i_group = i_group ? i_group : 1;
+    p_sys->b_mtu_warning = false;
+    p_sys->b_mmsg = true;
+    p_sys->b_gso = false;
+#if defined(HAVE_SENDMMSG) && defined(UDP_SEGMENT)
+    /* Only the kernels knowing segmentation offload accept the option */
+    int i_segment = 0;
+    p_sys->b_gso = setsockopt( i_fd, IPPROTO_UDP, UDP_SEGMENT, &i_segment,
+                               sizeof (i_segment) ) == 0;
+#endif
+    vlc_mutex_init( &p_sys->lock );
+    vlc_cond_init( &p_sys->wait_ready );
+    vlc_cond_init( &p_sys->wait_space );
+    p_sys->i_read = p_sys->i_write = 0;
+    p_sys->p_fill = NULL;
+    p_sys->i_slots = i_slots;
+
+    if( vlc_clone( &p_sys->thread, Thread, p_sys,
+                   VLC_THREAD_PRIORITY_HIGHEST ) )
+    {
+        vlc_cond_destroy( &p_sys->wait_space );
+        vlc_cond_destroy( &p_sys->wait_ready );
+        vlc_mutex_destroy( &p_sys->lock );
+        free( p_sys->p_buffer );
+        free( p_sys );
+        return NULL;
+    }
+    return p_sys;
+}
+
+void udp_sender_Delete( udp_sender_t *p_sys )
+{
+    vlc_cancel( p_sys->thread );
+    vlc_join( p_sys->thread, NULL );
+
+    vlc_cond_destroy( &p_sys->wait_space );
+    vlc_cond_destroy( &p_sys->wait_ready );
+    vlc_mutex_destroy( &p_sys->lock );
+    free( p_sys->p_buffer );
+    free( p_sys );
+}
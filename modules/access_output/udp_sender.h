@@ -0,0 +1,38 @@
+/*****************************************************************************
+ * udp_sender.h: paced and batched sending of UDP datagrams
+ *****************************************************************************
+ * Copyright (C) 2004-2015 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifndef VLC_UDP_SENDER_H
+#define VLC_UDP_SENDER_H
+
+/* The written blocks, usually TS packets, are packed into datagrams of up
+ * to the MTU, in a ring allocated once. A thread sends each datagram at
+ * the date of its first block plus the delay; the datagrams already due
+ * by then, and up to "group" datagrams in all, go out with one system
+ * call, as one UDP segmentation offload buffer when they are of the same
+ * size. */
+typedef struct udp_sender_t udp_sender_t;
+
+udp_sender_t *udp_sender_New( vlc_object_t *, int i_fd, size_t i_mtu,
+                              mtime_t i_delay, unsigned i_group );
+void udp_sender_Delete( udp_sender_t * );
+
+/* Takes a chain of blocks, and waits while the ring is full */
+ssize_t udp_sender_Write( udp_sender_t *, block_t * );
+
+#endif
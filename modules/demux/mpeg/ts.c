@@ -40,8 +40,8 @@
 #include <vlc_demux.h>
 #include <vlc_meta.h>
 #include <vlc_epg.h>
-#include <vlc_charset.h>   /* FromCharset, for EIT */
 #include <vlc_bits.h>
+#include <vlc_atomic.h>
 
 #include "../../mux/mpeg/csa.h"
 
@@ -72,6 +72,17 @@
 
 #include "pes.h"
 #include "mpeg4_iod.h"
+#include "ts_output.h"
+#include "ts_eit.h"
+#include "ts_index.h"
+#include "ts_scan.h"
+#include "ts_stats.h"
+#include "ts_records.h"
+#include "ts_text.h"
+#include "ts_monitor.h"
+#include "ts_sync.h"
+#include "ts_si.h"
+#include "ts_analyser.h"
 
 #ifdef HAVE_ARIBB24
  #include <aribb24/aribb24.h>
@@ -129,6 +140,12 @@ static void Close ( vlc_object_t * );
     "Separate teletex/dvbs pages into independent ES. " \
     "It can be useful to turn off this option when using stream output." )
 
+#define SEEK_INDEX_TEXT N_("Seek index")
+#define SEEK_INDEX_LONGTEXT N_( \
+    "Seek local recordings with an index of their PCRs instead of probing " \
+    "them. It is built in the background on the first playback and kept " \
+    "beside the recording, in a file with the .tsidx extension." )
+
 #define SEEK_PERCENT_TEXT N_("Seek based on percent not time")
 #define SEEK_PERCENT_LONGTEXT N_( \
     "Seek and position based on a percent byte position, not a PCR generated " \
@@ -137,6 +154,62 @@ static void Close ( vlc_object_t * );
 #define PCR_TEXT N_("Trust in-stream PCR")
 #define PCR_LONGTEXT N_("Use the stream PCR as a reference.")
 
+#define ANALYSE_ONLY_TEXT N_("Analyse tables only")
+#define ANALYSE_ONLY_LONGTEXT N_( \
+    "Only parse the PSI/SI tables, as fast as the input allows. " \
+    "No elementary stream is created and the stream is not clocked." )
+
+#define ANALYSE_THREADS_TEXT N_("Analysis threads")
+#define ANALYSE_THREADS_LONGTEXT N_( \
+    "When only analysing a local file, split it between that many threads " \
+    "(0 for one per CPU, 1 to read it sequentially). The threads do not " \
+    "run the TR 101 290 monitor nor write the statistics records, so the " \
+    "file is read sequentially when either is enabled." )
+
+#define SI_THREAD_TEXT N_("Parse SI tables on a separate thread")
+#define SI_THREAD_LONGTEXT N_( \
+    "Hand the SDT/EIT/TDT packets over to a dedicated thread, so that " \
+    "EPG decoding does not hold back the elementary streams." )
+
+#define NETWORK_SI_TEXT N_("Analyse the SI of the whole network")
+#define NETWORK_SI_LONGTEXT N_( \
+    "Also write the records of the NIT, the BAT, and the SDT and EIT of " \
+    "the other transport streams to the analyser output." )
+
+#define MONITOR_TEXT N_("TR 101 290 monitor")
+#define MONITOR_LONGTEXT N_( \
+    "Check the ETSI TR 101 290 priority 1, 2 and 3 indicators and write " \
+    "an alarm record to the analyser output for every error. The access " \
+    "then passes every pid." )
+
+#define ANALYSER_STATS_TEXT N_("Write the statistics records")
+#define ANALYSER_STATS_LONGTEXT N_( \
+    "Write the per pid statistics to the analyser output, periodically " \
+    "and when the stream is closed. The access then passes every pid." )
+
+#define ANALYSER_OUTPUT_TEXT N_("Analyser output format")
+#define ANALYSER_OUTPUT_LONGTEXT N_( \
+    "Format of the service and event records written by the analyser." )
+
+#define ANALYSER_FILE_TEXT N_("Analyser output file")
+#define ANALYSER_FILE_LONGTEXT N_( \
+    "File the analyser records are written to (\"-\" for standard output)." )
+
+#define ANALYSER_INPUTS_TEXT N_("Analyser inputs list")
+#define ANALYSER_INPUTS_LONGTEXT N_( \
+    "File listing the inputs the analyser interface monitors, one MRL or " \
+    "path per line." )
+
+#define ANALYSER_WORKERS_TEXT N_("Analyser worker threads")
+#define ANALYSER_WORKERS_LONGTEXT N_( \
+    "Number of threads demultiplexing the inputs of the analyser interface " \
+    "(0 for one per CPU)." )
+
+static const char *const ppsz_analyser_output[] =
+  { "none", "csv", "json", "binary" };
+static const char *const ppsz_analyser_output_text[] =
+  { N_("None"), N_("CSV"), N_("JSON lines"), N_("Binary") };
+
 static const int const arib_mode_list[] =
   { ARIBMODE_AUTO, ARIBMODE_ENABLED, ARIBMODE_DISABLED };
 static const char *const arib_mode_list_text[] =
@@ -169,15 +242,36 @@ vlc_module_begin ()
 
     add_bool( "ts-split-es", true, SPLIT_ES_TEXT, SPLIT_ES_LONGTEXT, false )
     add_bool( "ts-seek-percent", false, SEEK_PERCENT_TEXT, SEEK_PERCENT_LONGTEXT, true )
+    add_bool( "ts-seek-index", false, SEEK_INDEX_TEXT, SEEK_INDEX_LONGTEXT, true )
 
     add_integer( "ts-arib", ARIBMODE_AUTO, SUPPORT_ARIB_TEXT, SUPPORT_ARIB_LONGTEXT, false )
         change_integer_list( arib_mode_list, arib_mode_list_text )
 
+    add_bool( "ts-analyse-only", false, ANALYSE_ONLY_TEXT, ANALYSE_ONLY_LONGTEXT, true )
+    add_integer_with_range( "ts-analyse-threads", 1, 0, 64, ANALYSE_THREADS_TEXT, ANALYSE_THREADS_LONGTEXT, true )
+    add_bool( "ts-si-thread", false, SI_THREAD_TEXT, SI_THREAD_LONGTEXT, true )
+    add_bool( "ts-network-si", false, NETWORK_SI_TEXT, NETWORK_SI_LONGTEXT, true )
+    add_bool( "ts-monitor", false, MONITOR_TEXT, MONITOR_LONGTEXT, true )
+    add_bool( "ts-analyser-stats", false, ANALYSER_STATS_TEXT, ANALYSER_STATS_LONGTEXT, true )
+    add_string( "ts-analyser-output", "csv", ANALYSER_OUTPUT_TEXT, ANALYSER_OUTPUT_LONGTEXT, true )
+        change_string_list( ppsz_analyser_output, ppsz_analyser_output_text )
+    add_savefile( "ts-analyser-file", "-", ANALYSER_FILE_TEXT, ANALYSER_FILE_LONGTEXT, true )
+
     add_obsolete_bool( "ts-silent" );
 
     set_capability( "demux", 10 )
     set_callbacks( Open, Close )
     add_shortcut( "ts" )
+
+    add_submodule ()
+        set_description( N_("MPEG Transport Stream multiple inputs analyser") )
+        set_category( CAT_INTERFACE )
+        set_subcategory( SUBCAT_INTERFACE_CONTROL )
+        add_loadfile( "ts-analyser-inputs", NULL, ANALYSER_INPUTS_TEXT, ANALYSER_INPUTS_LONGTEXT, false )
+        add_integer_with_range( "ts-analyser-workers", 0, 0, 64, ANALYSER_WORKERS_TEXT, ANALYSER_WORKERS_LONGTEXT, true )
+        set_capability( "interface", 0 )
+        set_callbacks( AnalyserOpen, AnalyserClose )
+        add_shortcut( "tsanalyser" )
 vlc_module_end ()
 
 /*****************************************************************************
@@ -254,8 +348,11 @@ typedef struct
     ts_es_data_type_t data_type;
     int         i_data_size;
     int         i_data_gathered;
+    /* The payloads are copied from the packets into a single block, sized
+     * from the PES_packet_length, or from the previous unbounded PES */
     block_t     *p_data;
-    block_t     **pp_last;
+    size_t      i_data_alloc;
+    size_t      i_data_hint;
 
     block_t *   p_prepcr_outqueue;
 
@@ -273,6 +370,7 @@ typedef struct
     /* for special PAT/SDT case */
     dvbpsi_t       *handle; /* PAT/SDT/EIT */
     int             i_version;
+    ts_eit_filter_t *p_eit_filter; /* EIT, drops the repeated sections */
 
 } ts_psi_t;
 
@@ -325,16 +423,16 @@ struct ts_pid_t
         ts_pes_t    *p_pes;
         ts_psi_t    *p_psi;
     } u;
-
-    struct
-    {
-        vlc_fourcc_t i_fourcc;
-        int i_type;
-        int i_pcr_count;
-    } probed;
-
 };
 
+/* Probing state, kept apart from the per packet ts_pid_t */
+typedef struct
+{
+    vlc_fourcc_t i_fourcc;
+    int i_type;
+    int i_pcr_count;
+} ts_pid_probed_t;
+
 typedef struct
 {
     int i_service;
@@ -344,7 +442,21 @@ typedef struct
 #define MAX_ES_PID 8190
 #define MIN_PAT_INTERVAL CLOCK_FREQ // DVB is 500ms
 
-#define PID_ALLOC_CHUNK 16
+#define TS_PID_COUNT 8192
+
+/* Decoded strings of one service or one event, each at most 255 bytes
+ * of source text that ARIB expands the most */
+#define TS_TEXT_ARENA_SIZE 4096
+
+/* es_out update of the SI thread, waiting for the demux thread */
+typedef struct ts_si_out_t ts_si_out_t;
+struct ts_si_out_t
+{
+    ts_si_out_t *p_next;
+    int          i_query;   /* ES_OUT_SET_GROUP_META or ES_OUT_SET_GROUP_EPG */
+    int          i_group;
+    void        *p_data;    /* vlc_meta_t or vlc_epg_t */
+};
 
 struct demux_sys_t
 {
@@ -362,6 +474,21 @@ struct demux_sys_t
     /* how many TS packet we read at once */
     unsigned    i_ts_read;
 
+    /* Packets are read by batches into one slab and walked in place,
+     * a block is only created for data that has to be gathered. Memory
+     * mapped streams are walked in their own blocks instead, only the
+     * packets straddling two blocks are copied to the slab. */
+    struct
+    {
+        uint8_t    *p_slab;
+        block_t    *p_block;    /* stream block walked in place, or NULL */
+        uint8_t    *p_data;     /* slab or block data */
+        size_t      i_size;     /* valid bytes in data */
+        size_t      i_offset;   /* next packet in data */
+        size_t      i_descrambled; /* end of the packets descrambled ahead */
+        bool        b_mapped;   /* read stream blocks without copy */
+    } batch;
+
     bool        b_force_seek_per_percent;
 
     struct
@@ -373,18 +500,11 @@ struct demux_sys_t
         stream_t     *b25stream;
     } arib;
 
-    /* All pid */
+    /* All pid, directly indexed by pid value */
     struct
     {
-        ts_pid_t pat;
-        ts_pid_t dummy;
-        /* all non commons ones, dynamically allocated */
-        ts_pid_t **pp_all;
-        int        i_all;
-        int        i_all_alloc;
-        /* last recently used */
-        uint16_t   i_last_pid;
-        ts_pid_t  *p_last;
+        ts_pid_t        *p_all;     /* TS_PID_COUNT entries */
+        ts_pid_probed_t *p_probed;  /* TS_PID_COUNT entries */
     } pids;
 
     bool        b_user_pmt;
@@ -415,11 +535,60 @@ struct demux_sys_t
 
     /* */
     bool        b_dvb_meta;
+    bool        b_network_si; /* NIT, BAT, SDT and EIT other */
     int64_t     i_tdt_delta;
     int64_t     i_dvb_start;
     int64_t     i_dvb_length;
     bool        b_broken_charset; /* True if broken encoding is used in EPG/SDT */
 
+    /* SDT/EIT text decoding, in the SI callbacks. The arena holds the
+     * strings of one service or one event */
+    ts_text_t  *p_text;
+    char        p_text_arena[TS_TEXT_ARENA_SIZE];
+
+    /* SDT/EIT/TDT parsing thread, fed through a single producer/consumer
+     * ring of packets. The SI callbacks run with lock held, the demux thread
+     * takes it to change the state they read (programs, es_creation, PAT
+     * version) and to read the state they write (dvb event and tdt times).
+     * The es_out updates of the callbacks are queued, and sent by the demux
+     * thread. */
+    struct
+    {
+        bool            b_running;
+        vlc_thread_t    thread;
+        vlc_mutex_t     lock;
+        vlc_sem_t       data;       /* packets were queued */
+        vlc_sem_t       space;      /* packets were consumed */
+        uint8_t        *p_ring;     /* TS_SI_RING_PACKETS packets */
+        atomic_uint     i_read;
+        atomic_uint     i_write;
+        atomic_bool     b_exit;
+        ts_si_out_t    *p_out;      /* es_out updates not sent yet */
+        ts_si_out_t   **pp_out_last;
+    } si;
+
+    /* Seek index, mapped from the sidecar file or built by the thread.
+     * The lock protects p_index until the thread is done */
+    struct
+    {
+        bool            b_running;
+        vlc_thread_t    thread;
+        vlc_mutex_t     lock;
+        atomic_bool     b_stop;
+        ts_index_t     *p_index;
+    } index;
+
+    /* Per pid statistics of every packet read */
+    ts_stats_t       *p_stats;
+    ts_monitor_t     *p_monitor; /* only with an analyser output */
+    bool              b_output_stats; /* STATS records to the analyser output */
+
+    /* Analyser records */
+    bool              b_analyse_only; /* tables only, no ES and no clock */
+    unsigned          i_analyse_threads; /* > 1 to scan the whole file at once */
+    ts_output_t      *p_output;
+    ts_records_t     *p_records; /* tables, services, events and pids */
+
     /* Selected programs */
     DECL_ARRAY( int ) programs; /* List of selected/access-filtered programs */
     bool        b_default_selection; /* True if set by default to first pmt seen (to get data from filtered access) */
@@ -462,8 +631,23 @@ static void ts_pes_Del( demux_t *, ts_pes_t * );
 static ts_psi_t *ts_psi_New( demux_t * );
 static void ts_psi_Del( demux_t *, ts_psi_t * );
 
+static void OutputStats( demux_sys_t * );
+static const char *RecordText( void *, ts_text_arena_t *, const uint8_t *, size_t, bool );
+
 /* Helpers */
-static ts_pid_t *GetPID( demux_sys_t *, uint16_t i_pid );
+static inline ts_pid_t *GetPID( demux_sys_t *p_sys, uint16_t i_pid )
+{
+    assert( i_pid < TS_PID_COUNT );
+    return &p_sys->pids.p_all[i_pid];
+}
+static inline ts_pid_probed_t *GetPIDProbed( demux_sys_t *p_sys, const ts_pid_t *pid )
+{
+    return &p_sys->pids.p_probed[pid->i_pid];
+}
+static inline bool IsPSIPID( const ts_pid_t *pid )
+{
+    return pid->type != TYPE_FREE && pid->type != TYPE_PES;
+}
 static ts_pmt_t * GetProgramByID( demux_sys_t *, int i_program );
 static bool ProgramIsSelected( demux_sys_t *, uint16_t i_pgrm );
 static void UpdatePESFilters( demux_t *p_demux, bool b_all );
@@ -474,16 +658,21 @@ static inline int PIDGet( block_t *p )
     return ( (p->p_buffer[1]&0x1f)<<8 )|p->p_buffer[2];
 }
 
-static bool GatherData( demux_t *p_demux, ts_pid_t *pid, block_t *p_bk );
+static bool GatherData( demux_t *p_demux, ts_pid_t *pid, uint8_t *p_pkt );
 static void AddAndCreateES( demux_t *p_demux, ts_pid_t *pid, bool );
 static void ProgramSetPCR( demux_t *p_demux, ts_pmt_t *p_prg, mtime_t i_pcr );
 
 static block_t* ReadTSPacket( demux_t *p_demux );
+static uint8_t *ReadTSPacketBatched( demux_t *p_demux );
+static void FlushTSPacketBatch( demux_sys_t *p_sys );
+static int64_t TSPacketBatchTell( demux_sys_t *p_sys );
 static int ProbeStart( demux_t *p_demux, int i_program );
 static int ProbeEnd( demux_t *p_demux, int i_program );
 static int SeekToTime( demux_t *p_demux, ts_pmt_t *, int64_t time );
 static void ReadyQueuesPostSeek( demux_t *p_demux );
-static void PCRHandle( demux_t *p_demux, ts_pid_t *, block_t * );
+static void IndexThreadStart( demux_t *p_demux );
+static void IndexThreadStop( demux_sys_t *p_sys );
+static void PCRHandle( demux_t *p_demux, ts_pid_t *, const uint8_t * );
 static void PCRFixHandle( demux_t *, ts_pmt_t *, block_t * );
 static int64_t TimeStampWrapAround( ts_pmt_t *, int64_t );
 
@@ -497,6 +686,7 @@ static bool SetupISO14496LogicalStream( demux_t *, const decoder_config_descript
 static int UserPmt( demux_t *p_demux, const char * );
 
 static int  SetPIDFilter( demux_sys_t *, ts_pid_t *, bool b_selected );
+static int  SetSectionFilter( demux_sys_t *, uint16_t i_pid, uint8_t i_table_id, uint8_t i_mask );
 
 #define TS_PACKET_SIZE_188 188
 #define TS_PACKET_SIZE_192 192
@@ -504,49 +694,43 @@ static int  SetPIDFilter( demux_sys_t *, ts_pid_t *, bool b_selected );
 #define TS_PACKET_SIZE_MAX 204
 #define TS_HEADER_SIZE 4
 
+/* Number of packets read at once into the batch slab */
+#define TS_READ_BATCH_PACKETS 512
+
+/* Smallest buffer an unbounded PES is gathered into */
+#define TS_GATHER_MIN_SIZE 4096
+
+/* Number of SI packets the demux thread can be ahead of the SI thread,
+ * must be a power of 2 */
+#define TS_SI_RING_PACKETS 1024
+
+static void SIThreadStart( demux_t *p_demux );
+static void SIThreadStop( demux_t *p_demux );
+static void SIOutControl( demux_t *p_demux, int i_query, int i_group, void *p_data );
+static void SIOutFlush( demux_t *p_demux );
+static void SIQueuePacket( demux_sys_t *p_sys, const uint8_t *p_pkt );
+static void SIPushPacket( ts_pid_t *p_pid, const uint8_t *p_pkt );
+
 static int DetectPacketSize( demux_t *p_demux, unsigned *pi_header_size, int i_offset )
 {
     const uint8_t *p_peek;
-
-    if( stream_Peek( p_demux->s,
-                     &p_peek, i_offset + TS_PACKET_SIZE_MAX ) < i_offset + TS_PACKET_SIZE_MAX )
+    size_t i_sync;
+    unsigned i_header_size;
+
+    /* Enough for a sync byte within the first TS_PACKET_SIZE_MAX bytes and
+     * the next 3 ones at the largest packet size */
+    int i_peek = stream_Peek( p_demux->s, &p_peek,
+                              i_offset + TS_PACKET_SIZE_MAX * 4 );
+    if( i_peek < i_offset + TS_PACKET_SIZE_MAX )
         return -1;
 
-    for( int i_sync = 0; i_sync < TS_PACKET_SIZE_MAX; i_sync++ )
-    {
-        if( p_peek[i_offset + i_sync] != 0x47 )
-            continue;
-
-        /* Check next 3 sync bytes */
-        int i_peek = i_offset + TS_PACKET_SIZE_MAX * 3 + i_sync + 1;
-        if( ( stream_Peek( p_demux->s, &p_peek, i_peek ) ) < i_peek )
-        {
-            msg_Err( p_demux, "cannot peek" );
-            return -1;
-        }
-        if( p_peek[i_offset + i_sync + 1 * TS_PACKET_SIZE_188] == 0x47 &&
-            p_peek[i_offset + i_sync + 2 * TS_PACKET_SIZE_188] == 0x47 &&
-            p_peek[i_offset + i_sync + 3 * TS_PACKET_SIZE_188] == 0x47 )
-        {
-            return TS_PACKET_SIZE_188;
-        }
-        else if( p_peek[i_offset + i_sync + 1 * TS_PACKET_SIZE_192] == 0x47 &&
-                 p_peek[i_offset + i_sync + 2 * TS_PACKET_SIZE_192] == 0x47 &&
-                 p_peek[i_offset + i_sync + 3 * TS_PACKET_SIZE_192] == 0x47 )
-        {
-            if( i_sync == 4 )
-            {
-                *pi_header_size = 4; /* BluRay TS packets have 4-byte header */
-            }
-            return TS_PACKET_SIZE_192;
-        }
-        else if( p_peek[i_offset + i_sync + 1 * TS_PACKET_SIZE_204] == 0x47 &&
-                 p_peek[i_offset + i_sync + 2 * TS_PACKET_SIZE_204] == 0x47 &&
-                 p_peek[i_offset + i_sync + 3 * TS_PACKET_SIZE_204] == 0x47 )
-        {
-            return TS_PACKET_SIZE_204;
-        }
-    }
+    const int i_size = ts_sync_DetectPacketSize( p_peek + i_offset,
+                                                 i_peek - i_offset,
+                                                 &i_sync, &i_header_size );
+    if( i_header_size )
+        *pi_header_size = i_header_size; /* BluRay TS packets have 4-byte header */
+    if( i_size != -1 )
+        return i_size;
 
     if( p_demux->b_force )
     {
@@ -655,7 +839,8 @@ static void ProbePES( demux_t *p_demux, ts_pid_t *pid, const uint8_t *p_pesstart
 {
     demux_sys_t *p_sys = p_demux->p_sys;
     const uint8_t *p_pes = p_pesstart;
-    pid->probed.i_type = -1;
+    ts_pid_probed_t *p_probed = GetPIDProbed( p_sys, pid );
+    p_probed->i_type = -1;
 
     if( b_adaptfield )
     {
@@ -674,7 +859,7 @@ static void ProbePES( demux_t *p_demux, ts_pid_t *pid, const uint8_t *p_pesstart
             if( i_data < len )
                 return;
             if( len >= 7 && (p_pes[1] & 0x10) )
-                pid->probed.i_pcr_count++;
+                p_probed->i_pcr_count++;
             p_pes += len;
             i_data -= len;
         }
@@ -757,13 +942,13 @@ static void ProbePES( demux_t *p_demux, ts_pid_t *pid, const uint8_t *p_pesstart
     {
         if( !memcmp( p_data, "\x7F\xFE\x80\x01", 4 ) )
         {
-            pid->probed.i_type = 0x06;
-            pid->probed.i_fourcc = VLC_CODEC_DTS;
+            p_probed->i_type = 0x06;
+            p_probed->i_fourcc = VLC_CODEC_DTS;
         }
         else if( !memcmp( p_data, "\x0B\x77", 2 ) )
         {
-            pid->probed.i_type = 0x06;
-            pid->probed.i_fourcc = VLC_CODEC_EAC3;
+            p_probed->i_type = 0x06;
+            p_probed->i_fourcc = VLC_CODEC_EAC3;
         }
     }
     /* MPEG AUDIO STREAM */
@@ -776,10 +961,10 @@ static void ProbePES( demux_t *p_demux, ts_pid_t *pid, const uint8_t *p_pesstart
             /* 10 - MPEG Version 2 (ISO/IEC 13818-3)
                11 - MPEG Version 1 (ISO/IEC 11172-3) */
                 case 0x10:
-                    pid->probed.i_type = 0x04;
+                    p_probed->i_type = 0x04;
                     break;
                 case 0x18:
-                    pid->probed.i_type = 0x03;
+                    p_probed->i_type = 0x03;
                 default:
                     break;
             }
@@ -790,16 +975,16 @@ static void ProbePES( demux_t *p_demux, ts_pid_t *pid, const uint8_t *p_pesstart
                10 - Layer II
                11 - Layer I */
                 case 0x06:
-                    pid->probed.i_type = 0x04;
-                    pid->probed.i_fourcc = VLC_CODEC_MPGA;
+                    p_probed->i_type = 0x04;
+                    p_probed->i_fourcc = VLC_CODEC_MPGA;
                     break;
                 case 0x04:
-                    pid->probed.i_type = 0x04;
-                    pid->probed.i_fourcc = VLC_CODEC_MP2;
+                    p_probed->i_type = 0x04;
+                    p_probed->i_fourcc = VLC_CODEC_MP2;
                     break;
                 case 0x02:
-                    pid->probed.i_type = 0x04;
-                    pid->probed.i_fourcc = VLC_CODEC_MP3;
+                    p_probed->i_type = 0x04;
+                    p_probed->i_fourcc = VLC_CODEC_MP3;
                 default:
                     break;
             }
@@ -810,13 +995,13 @@ static void ProbePES( demux_t *p_demux, ts_pid_t *pid, const uint8_t *p_pesstart
     {
         if( !memcmp( p_data, "\x00\x00\x00\x01", 4 ) )
         {
-            pid->probed.i_type = 0x1b;
-            pid->probed.i_fourcc = VLC_CODEC_H264;
+            p_probed->i_type = 0x1b;
+            p_probed->i_fourcc = VLC_CODEC_H264;
         }
         else if( !memcmp( p_data, "\x00\x00\x01", 4 ) )
         {
-            pid->probed.i_type = 0x02;
-            pid->probed.i_fourcc = VLC_CODEC_MPGV;
+            p_probed->i_type = 0x02;
+            p_probed->i_fourcc = VLC_CODEC_MPGV;
         }
     }
 
@@ -873,15 +1058,16 @@ static void MissingPATPMTFixup( demux_t *p_demux )
         }
     }
 
-    for( int i=0; i<p_sys->pids.i_all; i++ )
+    for( int i=1; i<0x1FFF; i++ )
     {
-        const ts_pid_t *p_pid = p_sys->pids.pp_all[i];
+        const ts_pid_t *p_pid = GetPID( p_sys, i );
+        const ts_pid_probed_t *p_probed = GetPIDProbed( p_sys, p_pid );
         if( !SEEN(p_pid) ||
-            p_pid->probed.i_type == -1 )
+            p_probed->i_type == -1 )
             continue;
 
-        if( i_pcr_pid == 0x1FFF && ( p_pid->probed.i_type == 0x03 ||
-                                     p_pid->probed.i_pcr_count ) )
+        if( i_pcr_pid == 0x1FFF && ( p_probed->i_type == 0x03 ||
+                                     p_probed->i_pcr_count ) )
             i_pcr_pid = p_pid->i_pid;
 
         i_num_pes++;
@@ -905,7 +1091,7 @@ static void MissingPATPMTFixup( demux_t *p_demux )
     };
 
     BuildPAT( GetPID(p_sys, 0)->u.p_pat->handle,
-            &p_sys->pids.pat, BuildPATCallback,
+            GetPID(p_sys, 0), BuildPATCallback,
             0, 1,
             &patstream,
             1, &pmtprogramstream, &i_program_number );
@@ -928,16 +1114,17 @@ static void MissingPATPMTFixup( demux_t *p_demux )
     if( esstreams && mapped )
     {
         int j=0;
-        for( int i=0; i<p_sys->pids.i_all; i++ )
+        for( int i=1; i<0x1FFF; i++ )
         {
-            const ts_pid_t *p_pid = p_sys->pids.pp_all[i];
+            const ts_pid_t *p_pid = GetPID( p_sys, i );
+            const ts_pid_probed_t *p_probed = GetPIDProbed( p_sys, p_pid );
 
             if( !SEEN(p_pid) ||
-                p_pid->probed.i_type == -1 )
+                p_probed->i_type == -1 )
                 continue;
 
-            esstreams[j].pes.i_codec = p_pid->probed.i_fourcc;
-            esstreams[j].pes.i_stream_type = p_pid->probed.i_type;
+            esstreams[j].pes.i_codec = p_probed->i_fourcc;
+            esstreams[j].pes.i_stream_type = p_probed->i_type;
             esstreams[j].ts.i_pid = p_pid->i_pid;
             mapped[j].pes = &esstreams[j].pes;
             mapped[j].ts = &esstreams[j].ts;
@@ -983,12 +1170,14 @@ static int Open( vlc_object_t *p_this )
         return VLC_ENOMEM;
     memset( p_sys, 0, sizeof( demux_sys_t ) );
     vlc_mutex_init( &p_sys->csa_lock );
+    vlc_mutex_init( &p_sys->si.lock );
 
     p_demux->pf_demux = Demux;
     p_demux->pf_control = Control;
 
     /* Init p_sys field */
     p_sys->b_dvb_meta = true;
+    p_sys->b_network_si = var_InheritBool( p_demux, "ts-network-si" );
     p_sys->b_access_control = true;
     p_sys->b_end_preparse = false;
     ARRAY_INIT( p_sys->programs );
@@ -1003,13 +1192,44 @@ static int Open( vlc_object_t *p_this )
     p_sys->stream = p_demux->s;
 
     p_sys->b_broken_charset = false;
-
-    p_sys->pids.dummy.i_pid = 8191;
-    p_sys->pids.dummy.i_flags = FLAG_SEEN;
+    p_sys->p_output = NULL;
+    p_sys->p_monitor = NULL;
+    p_sys->b_output_stats = false;
+    p_sys->p_records = NULL;
+
+    p_sys->pids.p_all = calloc( TS_PID_COUNT, sizeof(ts_pid_t) );
+    p_sys->pids.p_probed = calloc( TS_PID_COUNT, sizeof(ts_pid_probed_t) );
+    p_sys->p_stats = ts_stats_New();
+    p_sys->p_text = ts_text_New();
+    if( !p_sys->pids.p_all || !p_sys->pids.p_probed || !p_sys->p_stats ||
+        !p_sys->p_text )
+    {
+        free( p_sys->pids.p_all );
+        free( p_sys->pids.p_probed );
+        if( p_sys->p_stats )
+            ts_stats_Delete( p_sys->p_stats );
+        if( p_sys->p_text )
+            ts_text_Delete( p_sys->p_text );
+        vlc_mutex_destroy( &p_sys->si.lock );
+        vlc_mutex_destroy( &p_sys->csa_lock );
+        free( p_sys );
+        return VLC_ENOMEM;
+    }
+    for( int i = 0; i < TS_PID_COUNT; i++ )
+        p_sys->pids.p_all[i].i_pid = i;
+    GetPID(p_sys, 0x1FFF)->i_flags = FLAG_SEEN;
 
     p_sys->i_packet_size = i_packet_size;
     p_sys->i_packet_header_size = i_packet_header_size;
     p_sys->i_ts_read = 50;
+    p_sys->batch.p_slab = NULL;
+    p_sys->batch.p_block = NULL;
+    p_sys->batch.p_data = NULL;
+    p_sys->batch.i_size = 0;
+    p_sys->batch.i_offset = 0;
+    p_sys->batch.i_descrambled = 0;
+    p_sys->batch.b_mapped = false;
+    stream_Control( p_sys->stream, STREAM_IS_MAPPED, &p_sys->batch.b_mapped );
     p_sys->csa = NULL;
     p_sys->b_start_record = false;
 
@@ -1029,6 +1249,9 @@ static int Open( vlc_object_t *p_this )
     patpid = GetPID(p_sys, 0);
     if ( !PIDSetup( p_demux, TYPE_PAT, patpid, NULL ) )
     {
+        free( p_sys->pids.p_all );
+        free( p_sys->pids.p_probed );
+        vlc_mutex_destroy( &p_sys->si.lock );
         vlc_mutex_destroy( &p_sys->csa_lock );
         free( p_sys );
         return VLC_ENOMEM;
@@ -1036,16 +1259,56 @@ static int Open( vlc_object_t *p_this )
     if( !dvbpsi_pat_attach( patpid->u.p_pat->handle, PATCallBack, p_demux ) )
     {
         PIDRelease( p_demux, patpid );
+        free( p_sys->pids.p_all );
+        free( p_sys->pids.p_probed );
+        vlc_mutex_destroy( &p_sys->si.lock );
         vlc_mutex_destroy( &p_sys->csa_lock );
         free( p_sys );
         return VLC_EGENERIC;
     }
 
+    char *psz_string = var_InheritString( p_demux, "ts-analyser-output" );
+    ts_output_format_t output_format = ts_output_ParseFormat( psz_string );
+    free( psz_string );
+    /* The multiple inputs analyser merges the records of its demuxers */
+    ts_output_t *p_shared = var_InheritAddress( p_demux, "ts-analyser-shared" );
+    if( p_shared )
+        p_sys->p_output = ts_output_NewInput( p_shared, p_demux->s->psz_url );
+    else if( output_format != TS_OUTPUT_NONE )
+    {
+        psz_string = var_InheritString( p_demux, "ts-analyser-file" );
+        p_sys->p_output = ts_output_New( p_this, output_format, psz_string );
+        free( psz_string );
+    }
+
+    if( var_InheritBool( p_demux, "ts-monitor" ) )
+    {
+        if( p_sys->p_output )
+            p_sys->p_monitor = ts_monitor_New( p_this, p_sys->p_output );
+        else
+            msg_Warn( p_demux, "TR 101 290 monitor needs an analyser output" );
+    }
+    p_sys->b_output_stats = p_sys->p_output &&
+                            var_InheritBool( p_demux, "ts-analyser-stats" );
+    /* Same records as vlc-ts-scan and the parallel scan of the file */
+    if( p_sys->p_output )
+        p_sys->p_records = ts_records_New( p_sys->p_output, p_sys->b_network_si,
+                                           RecordText, p_demux );
+
+    /* The monitor, the statistics and the network wide tables account for
+     * every pid: nothing is filtered upstream of them. The table, service
+     * and event records only need the pids the access is told about anyway. */
+    if( p_sys->p_monitor || p_sys->b_output_stats || p_sys->b_network_si )
+    {
+        msg_Dbg( p_demux, "access pid and section filtering disabled "
+                 "for the analyser" );
+        p_sys->b_access_control = false;
+    }
+
     if( p_sys->b_dvb_meta )
     {
           if( !PIDSetup( p_demux, TYPE_SDT, GetPID(p_sys, 0x11), NULL ) ||
               !PIDSetup( p_demux, TYPE_EIT, GetPID(p_sys, 0x12), NULL ) ||
-			  //!PIDSetup( p_demux, TYPE_EIT, GetPID(p_sys, 0x10), NULL ) ||
               !PIDSetup( p_demux, TYPE_TDT, GetPID(p_sys, 0x14), NULL ) )
           {
               PIDRelease( p_demux, GetPID(p_sys, 0x11) );
@@ -1064,6 +1327,15 @@ static int Open( vlc_object_t *p_this )
                     SetPIDFilter( p_sys, GetPID(p_sys, 0x12), true ) )
                  )
                      p_sys->b_access_control = false;
+              /* Without the network wide tables, only the tables of the
+               * actual stream are needed: let the access drop the others,
+               * which are most of the EIT. Not every access can. */
+              if( p_sys->b_access_control && !p_sys->b_network_si )
+              {
+                  SetSectionFilter( p_sys, 0x11, 0x42, 0xff );  /* SDT actual */
+                  SetSectionFilter( p_sys, 0x12, 0x4e, 0xff );  /* EIT p/f actual */
+                  SetSectionFilter( p_sys, 0x12, 0x50, 0xf0 );  /* EIT schedule actual */
+              }
           }
     }
 
@@ -1079,7 +1351,7 @@ static int Open( vlc_object_t *p_this )
     p_sys->b_trust_pcr = var_CreateGetBool( p_demux, "ts-trust-pcr" );
 
     /* We handle description of an extra PMT */
-    char* psz_string = var_CreateGetString( p_demux, "ts-extra-pmt" );
+    psz_string = var_CreateGetString( p_demux, "ts-extra-pmt" );
     p_sys->b_user_pmt = false;
     if( psz_string && *psz_string )
         UserPmt( p_demux, psz_string );
@@ -1140,11 +1412,38 @@ static int Open( vlc_object_t *p_this )
 
     p_sys->arib.e_mode = var_InheritInteger( p_demux, "ts-arib" );
 
+    p_sys->b_analyse_only = var_InheritBool( p_demux, "ts-analyse-only" );
+    p_sys->i_analyse_threads = var_InheritInteger( p_demux, "ts-analyse-threads" );
+    if( p_sys->i_analyse_threads == 0 )
+        p_sys->i_analyse_threads = vlc_GetCPUCount();
+
     stream_Control( p_sys->stream, STREAM_CAN_SEEK, &p_sys->b_canseek );
     stream_Control( p_sys->stream, STREAM_CAN_FASTSEEK, &p_sys->b_canfastseek );
 
+    /* Before preparsing, so that the programs boundaries come from it */
+    vlc_mutex_init( &p_sys->index.lock );
+    p_sys->index.b_running = false;
+    p_sys->index.p_index = NULL;
+    if( p_demux->psz_file && p_sys->b_canseek && !p_sys->b_analyse_only &&
+        var_InheritBool( p_demux, "ts-seek-index" ) )
+    {
+        p_sys->index.p_index = ts_index_Load( p_this, p_demux->psz_file,
+                                              p_sys->i_packet_size );
+        if( p_sys->index.p_index )
+            msg_Dbg( p_demux, "using the seek index of %s", p_demux->psz_file );
+        else
+            IndexThreadStart( p_demux );
+    }
+
     /* Preparse time */
-    if( p_sys->b_canseek )
+    if( p_sys->b_analyse_only )
+    {
+        /* Nothing to preparse, as no ES will ever be created.
+         * Walk a whole slab per call as there is no frame to stop at. */
+        p_sys->i_ts_read = TS_READ_BATCH_PACKETS;
+        p_sys->es_creation = CREATE_ES;
+    }
+    else if( p_sys->b_canseek )
     {
         p_sys->es_creation = NO_ES;
         while( !p_sys->i_pmt_es && !p_sys->b_end_preparse )
@@ -1155,6 +1454,10 @@ static int Open( vlc_object_t *p_this )
     else
         p_sys->es_creation = ( p_sys->b_access_control ? CREATE_ES : DELAY_ES );
 
+    /* Preparsing is done synchronously, the SI thread only takes over now */
+    if( p_sys->b_dvb_meta && var_InheritBool( p_demux, "ts-si-thread" ) )
+        SIThreadStart( p_demux );
+
     return VLC_SUCCESS;
 }
 
@@ -1166,6 +1469,14 @@ static void Close( vlc_object_t *p_this )
     demux_t     *p_demux = (demux_t*)p_this;
     demux_sys_t *p_sys = p_demux->p_sys;
 
+    /* Parses any SI still queued */
+    SIThreadStop( p_demux );
+
+    IndexThreadStop( p_sys );
+    if( p_sys->index.p_index )
+        ts_index_Delete( p_sys->index.p_index );
+    vlc_mutex_destroy( &p_sys->index.lock );
+
     PIDRelease( p_demux, GetPID(p_sys, 0) );
 
     if( p_sys->b_dvb_meta )
@@ -1198,18 +1509,35 @@ static void Close( vlc_object_t *p_this )
     }
 
     vlc_mutex_destroy( &p_sys->csa_lock );
+    vlc_mutex_destroy( &p_sys->si.lock );
+
+    if( p_sys->batch.p_block )
+        block_Release( p_sys->batch.p_block );
+    vlc_free( p_sys->batch.p_slab );
 
-    /* Release all non default pids */
-    for( int i = 0; i < p_sys->pids.i_all; i++ )
+    if( p_sys->p_records )
+        ts_records_Delete( p_sys->p_records, p_sys->p_stats );
+    if( p_sys->p_monitor )
+        ts_monitor_Delete( p_sys->p_monitor );
+    if( p_sys->p_output )
     {
-        ts_pid_t *pid = p_sys->pids.pp_all[i];
+        if( p_sys->b_output_stats )
+            OutputStats( p_sys );
+        ts_output_Delete( p_sys->p_output );
+    }
+    ts_stats_Delete( p_sys->p_stats );
+    ts_text_Delete( p_sys->p_text );
+
 #ifndef NDEBUG
+    for( int i = 0; i < TS_PID_COUNT; i++ )
+    {
+        const ts_pid_t *pid = GetPID( p_sys, i );
         if( pid->type != TYPE_FREE )
             msg_Err( p_demux, "PID %d type %d not freed", pid->i_pid, pid->type );
-#endif
-        free( pid );
     }
-    free( p_sys->pids.pp_all );
+#endif
+    free( p_sys->pids.p_all );
+    free( p_sys->pids.p_probed );
 
     free( p_sys );
 }
@@ -1244,6 +1572,30 @@ static int Demux( demux_t *p_demux )
     demux_sys_t *p_sys = p_demux->p_sys;
     bool b_wait_es = p_sys->i_pmt_es <= 0;
 
+    /* A local file can be analysed at once by several threads, which only
+     * write the tables and the per pid counters: neither the monitor alarms
+     * nor the statistics records would be output */
+    if( p_sys->b_analyse_only && p_sys->i_analyse_threads > 1 )
+    {
+        const unsigned i_threads = p_sys->i_analyse_threads;
+        p_sys->i_analyse_threads = 1; /* whatever happens, only try once */
+        if( p_sys->p_records && !p_sys->p_monitor && !p_sys->b_output_stats &&
+            p_demux->psz_file && !p_sys->arib.b25stream &&
+            p_sys->arib.e_mode != ARIBMODE_ENABLED &&
+            ts_scan_File( VLC_OBJECT(p_demux), p_sys->p_output, p_demux->psz_file,
+                          TSPacketBatchTell( p_sys ), p_sys->i_packet_size,
+                          p_sys->i_packet_header_size, i_threads,
+                          p_sys->b_network_si ) == VLC_SUCCESS )
+            return VLC_DEMUXER_EOF;
+        msg_Dbg( p_demux, "cannot analyse the file in parallel, reading it" );
+    }
+
+    if( ts_stats_Tick( p_sys->p_stats, mdate() ) && p_sys->b_output_stats )
+        OutputStats( p_sys );
+
+    if( p_sys->si.b_running )
+        SIOutFlush( p_demux );
+
     /* If we had no PAT within MIN_PAT_INTERVAL, create PAT/PMT from probed streams */
     if( p_sys->i_pmt_es == 0 && !SEEN(GetPID(p_sys, 0)) && p_sys->patfix.status == PAT_MISSING )
     {
@@ -1251,13 +1603,17 @@ static int Demux( demux_t *p_demux )
         p_sys->patfix.status = PAT_FIXTRIED;
     }
 
+    bool b_si_queued = false;
+
     /* We read at most 100 TS packet or until a frame is completed */
     for( unsigned i_pkt = 0; i_pkt < p_sys->i_ts_read; i_pkt++ )
     {
         bool         b_frame = false;
-        block_t     *p_pkt;
-        if( !(p_pkt = ReadTSPacket( p_demux )) )
+        uint8_t     *p_pkt;
+        if( !(p_pkt = ReadTSPacketBatched( p_demux )) )
         {
+            if( b_si_queued )
+                vlc_sem_post( &p_sys->si.data );
             return VLC_DEMUXER_EOF;
         }
 
@@ -1268,13 +1624,25 @@ static int Demux( demux_t *p_demux )
             p_sys->b_start_record = false;
         }
 
+        const unsigned i_events = ts_stats_Packet( p_sys->p_stats, p_pkt );
+        if( p_sys->p_monitor )
+            ts_monitor_Packet( p_sys->p_monitor, p_sys->p_stats, p_pkt, i_events );
+        if( p_sys->p_records )
+            ts_records_Packet( p_sys->p_records, p_pkt,
+                               TSPacketBatchTell( p_sys ) - p_sys->i_packet_size,
+                               i_events & TS_STATS_CC_ERROR );
+
         /* Parse the TS packet */
-        ts_pid_t *p_pid = GetPID( p_sys, PIDGet( p_pkt ) );
+        ts_pid_t *p_pid = GetPID( p_sys, ( (p_pkt[1]&0x1f)<<8 )|p_pkt[2] );
 
-        if( (p_pkt->p_buffer[1] & 0x40) && (p_pkt->p_buffer[3] & 0x10) &&
-            !SCRAMBLED(*p_pid) != !(p_pkt->p_buffer[3] & 0x80) )
+        /* Only tables are wanted, drop anything else on its header */
+        if( p_sys->b_analyse_only && !IsPSIPID( p_pid ) )
+            continue;
+
+        if( (p_pkt[1] & 0x40) && (p_pkt[3] & 0x10) &&
+            !SCRAMBLED(*p_pid) != !(p_pkt[3] & 0x80) )
         {
-            UpdateScrambledState( p_demux, p_pid, p_pkt->p_buffer[3] & 0x80 );
+            UpdateScrambledState( p_demux, p_pid, p_pkt[3] & 0x80 );
         }
 
         if( !SEEN(p_pid) )
@@ -1287,33 +1655,31 @@ static int Demux( demux_t *p_demux )
         if ( SCRAMBLED(*p_pid) && !p_demux->p_sys->csa )
         {
             PCRHandle( p_demux, p_pid, p_pkt );
-            block_Release( p_pkt );
             continue;
         }
 
         /* Probe streams to build PAT/PMT after MIN_PAT_INTERVAL in case we don't see any PAT */
         if( !SEEN( GetPID( p_sys, 0 ) ) &&
-            (p_pid->probed.i_type == 0 || p_pid->i_pid == p_sys->patfix.i_timesourcepid) &&
-            (p_pkt->p_buffer[1] & 0xC0) == 0x40 && /* Payload start but not corrupt */
-            (p_pkt->p_buffer[3] & 0xD0) == 0x10 )  /* Has payload but is not encrypted */
+            (GetPIDProbed( p_sys, p_pid )->i_type == 0 || p_pid->i_pid == p_sys->patfix.i_timesourcepid) &&
+            (p_pkt[1] & 0xC0) == 0x40 && /* Payload start but not corrupt */
+            (p_pkt[3] & 0xD0) == 0x10 )  /* Has payload but is not encrypted */
         {
-            ProbePES( p_demux, p_pid, p_pkt->p_buffer + TS_HEADER_SIZE,
-                      p_pkt->i_buffer - TS_HEADER_SIZE, p_pkt->p_buffer[3] & 0x20 /* Adaptation field */);
+            ProbePES( p_demux, p_pid, p_pkt + TS_HEADER_SIZE,
+                      TS_PACKET_SIZE_188 - TS_HEADER_SIZE, p_pkt[3] & 0x20 /* Adaptation field */);
         }
 
         switch( p_pid->type )
         {
         case TYPE_PAT:
-            dvbpsi_packet_push( p_pid->u.p_pat->handle, p_pkt->p_buffer );
-            block_Release( p_pkt );
+            dvbpsi_packet_push( p_pid->u.p_pat->handle, p_pkt );
             break;
 
         case TYPE_PMT:
-            dvbpsi_packet_push( p_pid->u.p_pmt->handle, p_pkt->p_buffer );
-            block_Release( p_pkt );
+            dvbpsi_packet_push( p_pid->u.p_pmt->handle, p_pkt );
             break;
 
         case TYPE_PES:
+        {
             p_sys->b_end_preparse = true;
 
             if( p_sys->es_creation == DELAY_ES ) /* No longer delay ES since that pid's program sends data */
@@ -1325,25 +1691,31 @@ static int Demux( demux_t *p_demux )
             if( !p_sys->b_access_control && !(p_pid->i_flags & FLAG_FILTERED) )
             {
                 /* That packet is for an unselected ES, don't waste time/memory gathering its data */
-                block_Release( p_pkt );
                 continue;
             }
 
             b_frame = GatherData( p_demux, p_pid, p_pkt );
             break;
+        }
 
+        case TYPE_NIT:
         case TYPE_SDT:
         case TYPE_TDT:
         case TYPE_EIT:
-            if( p_sys->b_dvb_meta )
-                dvbpsi_packet_push( p_pid->u.p_psi->handle, p_pkt->p_buffer );
-            block_Release( p_pkt );
+            if( !p_sys->b_dvb_meta )
+                break;
+            if( p_sys->si.b_running )
+            {
+                SIQueuePacket( p_sys, p_pkt );
+                b_si_queued = true;
+            }
+            else
+                SIPushPacket( p_pid, p_pkt );
             break;
 
         default:
             /* We have to handle PCR if present */
             PCRHandle( p_demux, p_pid, p_pkt );
-            block_Release( p_pkt );
             break;
         }
 
@@ -1351,6 +1723,9 @@ static int Demux( demux_t *p_demux )
             break;
     }
 
+    if( b_si_queued )
+        vlc_sem_post( &p_sys->si.data );
+
     demux_UpdateTitleFromStream( p_demux );
     return VLC_DEMUXER_SUCCESS;
 }
@@ -1366,6 +1741,8 @@ static int DVBEventInformation( demux_t *p_demux, int64_t *pi_time, int64_t *pi_
     if( pi_time )
         *pi_time = 0;
 
+    int i_ret = VLC_EGENERIC;
+    vlc_mutex_lock( &p_sys->si.lock );
     if( p_sys->i_dvb_length > 0 )
     {
         const int64_t t = mdate() + p_sys->i_tdt_delta;
@@ -1376,10 +1753,11 @@ static int DVBEventInformation( demux_t *p_demux, int64_t *pi_time, int64_t *pi_
                 *pi_length = p_sys->i_dvb_length;
             if( pi_time )
                 *pi_time   = t - p_sys->i_dvb_start;
-            return VLC_SUCCESS;
+            i_ret = VLC_SUCCESS;
         }
     }
-    return VLC_EGENERIC;
+    vlc_mutex_unlock( &p_sys->si.lock );
+    return i_ret;
 }
 
 static void UpdatePESFilters( demux_t *p_demux, bool b_all )
@@ -1423,6 +1801,9 @@ static void UpdatePESFilters( demux_t *p_demux, bool b_all )
                     b_stream_selected = false;
             }
 
+            if( p_sys->b_analyse_only )
+                b_stream_selected = false;
+
             if( b_stream_selected )
                 msg_Dbg( p_demux, "enabling pid %d from program %d", espid->i_pid, p_pmt->i_number );
 
@@ -1432,7 +1813,7 @@ static void UpdatePESFilters( demux_t *p_demux, bool b_all )
         }
 
         /* Select pcr last in case it is handled by unselected ES */
-        if( p_pmt->i_pid_pcr > 0 )
+        if( p_pmt->i_pid_pcr > 0 && !p_sys->b_analyse_only )
         {
             SetPIDFilter( p_sys, GetPID(p_sys, p_pmt->i_pid_pcr), b_program_selected );
             if( b_program_selected )
@@ -1502,7 +1883,7 @@ static int Control( demux_t *p_demux, int i_query, va_list args )
 
         if( (i64 = stream_Size( p_sys->stream) ) > 0 )
         {
-            int64_t offset = stream_Tell( p_sys->stream );
+            int64_t offset = TSPacketBatchTell( p_sys );
             *pf = (double)offset / (double)i64;
             return VLC_SUCCESS;
         }
@@ -1624,22 +2005,28 @@ static int Control( demux_t *p_demux, int i_query, va_list args )
             if( i_int != -1 )
             {
                 p_sys->b_es_all = false;
+                vlc_mutex_lock( &p_sys->si.lock );
                 ARRAY_APPEND( p_sys->programs, i_int );
+                vlc_mutex_unlock( &p_sys->si.lock );
                 UpdatePESFilters( p_demux, false );
             }
             else if( likely( p_list != NULL ) )
             {
                 p_sys->b_es_all = false;
+                vlc_mutex_lock( &p_sys->si.lock );
                 for( int i = 0; i < p_list->i_count; i++ )
                    ARRAY_APPEND( p_sys->programs, p_list->p_values[i].i_int );
+                vlc_mutex_unlock( &p_sys->si.lock );
                 UpdatePESFilters( p_demux, false );
             }
             else // All ES Mode
             {
                 p_sys->b_es_all = true;
                 ts_pat_t *p_pat = GetPID(p_sys, 0)->u.p_pat;
+                vlc_mutex_lock( &p_sys->si.lock );
                 for( int i = 0; i < p_pat->programs.i_size; i++ )
                    ARRAY_APPEND( p_sys->programs, p_pat->programs.p_elems[i]->i_pid );
+                vlc_mutex_unlock( &p_sys->si.lock );
                 UpdatePESFilters( p_demux, true );
             }
 
@@ -1671,9 +2058,11 @@ static int Control( demux_t *p_demux, int i_query, va_list args )
     }
 
     case DEMUX_SET_TITLE:
+        FlushTSPacketBatch( p_sys );
         return stream_vaControl( p_sys->stream, STREAM_SET_TITLE, args );
 
     case DEMUX_SET_SEEKPOINT:
+        FlushTSPacketBatch( p_sys );
         return stream_vaControl( p_sys->stream, STREAM_SET_SEEKPOINT, args );
 
     case DEMUX_GET_META:
@@ -1695,6 +2084,13 @@ static int Control( demux_t *p_demux, int i_query, va_list args )
     case DEMUX_GET_SIGNAL:
         return stream_vaControl( p_sys->stream, STREAM_GET_SIGNAL, args );
 
+    case DEMUX_GET_TS_STATS:
+    {
+        demux_ts_stats_t **pp_stats = va_arg( args, demux_ts_stats_t ** );
+        *pp_stats = ts_stats_Get( p_sys->p_stats );
+        return *pp_stats ? VLC_SUCCESS : VLC_ENOMEM;
+    }
+
     default:
         break;
     }
@@ -1846,6 +2242,18 @@ static int SetPIDFilter( demux_sys_t *p_sys, ts_pid_t *p_pid, bool b_selected )
                            p_pid->i_pid, b_selected );
 }
 
+/* Restricts a pid to the sections of some tables, all the others being
+ * dropped by the access when it supports it */
+static int SetSectionFilter( demux_sys_t *p_sys, uint16_t i_pid,
+                             uint8_t i_table_id, uint8_t i_mask )
+{
+    if( !p_sys->b_access_control )
+        return VLC_EGENERIC;
+
+    return stream_Control( p_sys->stream, STREAM_SET_PRIVATE_ID_SECTION,
+                           (int)i_pid, (int)i_table_id, (int)i_mask, -1, true );
+}
+
 static void PIDReset( ts_pid_t *pid )
 {
     assert(pid->i_refcount == 0);
@@ -1890,6 +2298,7 @@ static bool PIDSetup( demux_t *p_demux, ts_pid_type_t i_type, ts_pid_t *pid, ts_
                 return false;
             break;
 
+        case TYPE_NIT:
         case TYPE_SDT:
         case TYPE_TDT:
         case TYPE_EIT:
@@ -1897,13 +2306,10 @@ static bool PIDSetup( demux_t *p_demux, ts_pid_type_t i_type, ts_pid_t *pid, ts_
             pid->u.p_psi = ts_psi_New( p_demux );
             if( !pid->u.p_psi )
                 return false;
-            break;
-
-        case TYPE_NIT:
-            PIDReset( pid );
-            pid->u.p_psi = ts_psi_New( p_demux );
-            if( !pid->u.p_psi )
-                return false;
+            /* Without the filter, every section is decoded again */
+            if( i_type == TYPE_EIT )
+                pid->u.p_psi->p_eit_filter =
+                    ts_eit_filter_New( false );
             break;
 
         default:
@@ -1970,6 +2376,7 @@ static void PIDRelease( demux_t *p_demux, ts_pid_t *pid )
             pid->u.p_pes = NULL;
             break;
 
+        case TYPE_NIT:
         case TYPE_SDT:
         case TYPE_TDT:
         case TYPE_EIT:
@@ -2105,7 +2512,7 @@ static void ParsePES( demux_t *p_demux, ts_pid_t *pid, block_t *p_pes )
     const int i_max = block_ChainExtract( p_pes, header, 34 );
     if ( i_max < 4 )
     {
-        block_ChainRelease( p_pes );
+        block_Release( p_pes );
         return;
     }
 
@@ -2114,14 +2521,14 @@ static void ParsePES( demux_t *p_demux, ts_pid_t *pid, block_t *p_pes )
         if ( !SCRAMBLED(*pid) )
             msg_Warn( p_demux, "invalid header [0x%02x:%02x:%02x:%02x] (pid: %d)",
                         header[0], header[1],header[2],header[3], pid->i_pid );
-        block_ChainRelease( p_pes );
+        block_Release( p_pes );
         return;
     }
 
     if( ParsePESHeader( VLC_OBJECT(p_demux), (uint8_t*)&header, i_max, &i_skip,
                         &i_dts, &i_pts, &i_stream_id ) == VLC_EGENERIC )
     {
-        block_ChainRelease( p_pes );
+        block_Release( p_pes );
         return;
     }
     else
@@ -2168,22 +2575,15 @@ static void ParsePES( demux_t *p_demux, ts_pid_t *pid, block_t *p_pes )
     }
 
     /* skip header */
-    while( p_pes && i_skip > 0 )
+    if( p_pes->i_buffer <= i_skip )
     {
-        if( p_pes->i_buffer <= i_skip )
-        {
-            block_t *p_next = p_pes->p_next;
-
-            i_skip -= p_pes->i_buffer;
-            block_Release( p_pes );
-            p_pes = p_next;
-        }
-        else
-        {
-            p_pes->i_buffer -= i_skip;
-            p_pes->p_buffer += i_skip;
-            break;
-        }
+        block_Release( p_pes );
+        p_pes = NULL;
+    }
+    else
+    {
+        p_pes->i_buffer -= i_skip;
+        p_pes->p_buffer += i_skip;
     }
 
     /* ISO/IEC 13818-1 2.7.5: if no pts and no dts, then dts == pts */
@@ -2202,7 +2602,7 @@ static void ParsePES( demux_t *p_demux, ts_pid_t *pid, block_t *p_pes )
 
         p_pes->i_length = i_length * 100 / 9;
 
-        p_block = block_ChainGather( p_pes );
+        p_block = p_pes;
         if( pid->u.p_pes->es.fmt.i_codec == VLC_CODEC_SUBT )
         {
             if( i_pes_size > 0 && p_block->i_buffer > i_pes_size )
@@ -2373,9 +2773,8 @@ static void ParsePES( demux_t *p_demux, ts_pid_t *pid, block_t *p_pes )
     }
 }
 
-static void ParseTableSection( demux_t *p_demux, ts_pid_t *pid, block_t *p_data )
+static void ParseTableSection( demux_t *p_demux, ts_pid_t *pid, block_t *p_content )
 {
-    block_t *p_content = block_ChainGather( p_data );
 
     if( p_content->i_buffer <= 9 || pid->type != TYPE_PES )
     {
@@ -2493,10 +2892,12 @@ static void ParseData( demux_t *p_demux, ts_pid_t *pid )
         return;
 
     /* remove the pes from pid */
+    if( pid->u.p_pes->i_data_size == 0 )
+        pid->u.p_pes->i_data_hint = pid->u.p_pes->i_data_gathered;
     pid->u.p_pes->p_data = NULL;
+    pid->u.p_pes->i_data_alloc = 0;
     pid->u.p_pes->i_data_size = 0;
     pid->u.p_pes->i_data_gathered = 0;
-    pid->u.p_pes->pp_last = &pid->u.p_pes->p_data;
 
     if( pid->u.p_pes->data_type == TS_ES_DATA_PES )
     {
@@ -2508,7 +2909,7 @@ static void ParseData( demux_t *p_demux, ts_pid_t *pid )
     }
     else
     {
-        block_ChainRelease( p_data );
+        block_Release( p_data );
     }
 }
 
@@ -2554,25 +2955,20 @@ static block_t* ReadTSPacket( demux_t *p_demux )
 
             i_peek = stream_Peek( p_sys->stream, &p_peek,
                     p_sys->i_packet_size * 10 );
-            if( i_peek < 0 || (unsigned)i_peek < p_sys->i_packet_size + 1 )
+            if( i_peek < 0 || (unsigned)i_peek < p_sys->i_packet_header_size +
+                                    p_sys->i_packet_size + 1 )
             {
                 msg_Dbg( p_demux, "eof ?" );
                 return NULL;
             }
 
-            while( i_skip < i_peek - p_sys->i_packet_size )
-            {
-                if( p_peek[i_skip + p_sys->i_packet_header_size] == 0x47 &&
-                        p_peek[i_skip + p_sys->i_packet_header_size + p_sys->i_packet_size] == 0x47 )
-                {
-                    break;
-                }
-                i_skip++;
-            }
+            const size_t i_scan = i_peek - p_sys->i_packet_header_size;
+            i_skip = ts_sync_Find( &p_peek[p_sys->i_packet_header_size], i_scan,
+                                   p_sys->i_packet_size, 2 );
             msg_Dbg( p_demux, "skipping %d bytes of garbage", i_skip );
             stream_Read( p_sys->stream, NULL, i_skip );
 
-            if( i_skip < i_peek - p_sys->i_packet_size )
+            if( i_skip < ts_sync_Candidates( i_scan, p_sys->i_packet_size, 2 ) )
             {
                 break;
             }
@@ -2586,6 +2982,184 @@ static block_t* ReadTSPacket( demux_t *p_demux )
     return p_pkt;
 }
 
+static void FlushTSPacketBatch( demux_sys_t *p_sys )
+{
+    if( p_sys->batch.p_block )
+    {
+        block_Release( p_sys->batch.p_block );
+        p_sys->batch.p_block = NULL;
+    }
+    p_sys->batch.i_size = 0;
+    p_sys->batch.i_offset = 0;
+    p_sys->batch.i_descrambled = 0;
+}
+
+/* Stream position of the next packet to be demuxed */
+static int64_t TSPacketBatchTell( demux_sys_t *p_sys )
+{
+    return stream_Tell( p_sys->stream ) -
+           (int64_t)( p_sys->batch.i_size - p_sys->batch.i_offset );
+}
+
+static bool FillTSPacketBatch( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    const size_t i_slab = TS_READ_BATCH_PACKETS * p_sys->i_packet_size;
+
+    if( unlikely(p_sys->batch.p_slab == NULL) )
+    {
+        p_sys->batch.p_slab = vlc_memalign( 64, i_slab );
+        if( !p_sys->batch.p_slab )
+            return false;
+    }
+
+    /* ARIB descrambling replaces the stream once the PMT is parsed,
+     * so nothing must be read ahead of the demuxed packet there */
+    const bool b_mapped = p_sys->batch.b_mapped &&
+                          p_sys->arib.e_mode != ARIBMODE_ENABLED;
+
+    size_t i_left = p_sys->batch.i_size - p_sys->batch.i_offset;
+    if( i_left == 0 && b_mapped )
+    {
+        if( p_sys->batch.p_block )
+            block_Release( p_sys->batch.p_block );
+        p_sys->batch.p_block = stream_ReadBlock( p_sys->stream );
+        if( p_sys->batch.p_block == NULL )
+            return false;
+
+        p_sys->batch.p_data = p_sys->batch.p_block->p_buffer;
+        p_sys->batch.i_size = p_sys->batch.p_block->i_buffer;
+        p_sys->batch.i_offset = 0;
+        p_sys->batch.i_descrambled = 0;
+        if( p_sys->batch.i_size >= p_sys->i_packet_size )
+            return true;
+        i_left = p_sys->batch.i_size;
+    }
+
+    /* Keep the trailing bytes not yet consumed */
+    if( i_left > 0 )
+        memmove( p_sys->batch.p_slab,
+                 &p_sys->batch.p_data[p_sys->batch.i_offset], i_left );
+    if( p_sys->batch.p_block )
+    {
+        block_Release( p_sys->batch.p_block );
+        p_sys->batch.p_block = NULL;
+    }
+    p_sys->batch.p_data = p_sys->batch.p_slab;
+    p_sys->batch.i_descrambled -= __MIN( p_sys->batch.i_descrambled,
+                                         p_sys->batch.i_offset );
+    p_sys->batch.i_offset = 0;
+    p_sys->batch.i_size = i_left;
+
+    size_t i_want = i_slab;
+    if( p_sys->arib.e_mode == ARIBMODE_ENABLED )
+        i_want = i_left + p_sys->i_packet_size;
+    else if( b_mapped )
+    {   /* Only complete the straddling packet, and go back to the blocks */
+        i_want = ( i_left / p_sys->i_packet_size + 1 ) * p_sys->i_packet_size;
+    }
+
+    ssize_t i_read = stream_Read( p_sys->stream, &p_sys->batch.p_slab[i_left],
+                                  i_want - i_left );
+    if( i_read <= 0 )
+        return false;
+    p_sys->batch.i_size += i_read;
+
+    return p_sys->batch.i_size >= p_sys->i_packet_size;
+}
+
+/* Descrambles the batch from the next packet up to the first lost sync, or
+ * a slab worth of packets, the run the demuxer will walk, so that packets
+ * sharing a key are processed together. Their transport_scrambling_control
+ * is left as read for the statistics and the scrambled state, GatherData()
+ * clears it. */
+static void DescrambleTSPacketBatch( demux_sys_t *p_sys )
+{
+    const size_t i_packet_size = p_sys->i_packet_size;
+    const size_t i_header_size = p_sys->i_packet_header_size;
+    uint8_t *pp_pkts[TS_READ_BATCH_PACKETS];
+    uint8_t pi_control[TS_READ_BATCH_PACKETS];
+    int i_pkts = 0;
+
+    size_t i_offset = p_sys->batch.i_offset;
+    const size_t i_end = __MIN( p_sys->batch.i_size,
+                                i_offset + TS_READ_BATCH_PACKETS * i_packet_size );
+    for( ; i_offset + i_packet_size <= i_end; i_offset += i_packet_size )
+    {
+        uint8_t *p_pkt = &p_sys->batch.p_data[i_offset + i_header_size];
+        if( p_pkt[0] != 0x47 )
+            break;
+        if( p_pkt[3] & 0x80 )
+        {
+            pi_control[i_pkts] = p_pkt[3] & 0xc0;
+            pp_pkts[i_pkts++] = p_pkt;
+        }
+    }
+    p_sys->batch.i_descrambled = i_offset;
+
+    if( i_pkts == 0 )
+        return;
+
+    vlc_mutex_lock( &p_sys->csa_lock );
+    csa_DecryptBatch( p_sys->csa, pp_pkts, i_pkts, p_sys->i_csa_pkt_size );
+    vlc_mutex_unlock( &p_sys->csa_lock );
+
+    for( int i = 0; i < i_pkts; i++ )
+        pp_pkts[i][3] |= pi_control[i];
+}
+
+/* Returns the next packet (sync byte first), pointing into the batch data.
+ * It is only valid until the next call. */
+static uint8_t *ReadTSPacketBatched( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    const size_t i_packet_size = p_sys->i_packet_size;
+    const size_t i_header_size = p_sys->i_packet_header_size;
+
+    if( p_sys->batch.i_size - p_sys->batch.i_offset < i_packet_size &&
+        !FillTSPacketBatch( p_demux ) )
+    {
+        if( stream_Tell( p_sys->stream ) == stream_Size( p_sys->stream ) )
+            msg_Dbg( p_demux, "EOF at %"PRId64, stream_Tell( p_sys->stream ) );
+        else
+            msg_Dbg( p_demux, "Can't read TS packet at %"PRId64, stream_Tell(p_sys->stream) );
+        return NULL;
+    }
+
+    /* Check sync byte and re-sync if needed */
+    if( p_sys->batch.p_data[p_sys->batch.i_offset + i_header_size] != 0x47 )
+    {
+        msg_Warn( p_demux, "lost synchro" );
+        p_sys->p_stats->i_sync_losses++;
+        for( ;; )
+        {
+            const uint8_t *p_peek = &p_sys->batch.p_data[p_sys->batch.i_offset];
+            const size_t i_peek = p_sys->batch.i_size - p_sys->batch.i_offset;
+            const size_t i_scan = i_peek > i_header_size ? i_peek - i_header_size : 0;
+            const size_t i_skip = ts_sync_Find( &p_peek[i_header_size], i_scan,
+                                                i_packet_size, 2 );
+            msg_Dbg( p_demux, "skipping %zu bytes of garbage", i_skip );
+            p_sys->batch.i_offset += i_skip;
+
+            if( i_skip < ts_sync_Candidates( i_scan, i_packet_size, 2 ) )
+                break;
+
+            if( !FillTSPacketBatch( p_demux ) )
+            {
+                msg_Dbg( p_demux, "eof ?" );
+                return NULL;
+            }
+        }
+    }
+
+    if( p_sys->csa && p_sys->batch.i_offset >= p_sys->batch.i_descrambled )
+        DescrambleTSPacketBatch( p_sys );
+
+    uint8_t *p_pkt = &p_sys->batch.p_data[p_sys->batch.i_offset + i_header_size];
+    p_sys->batch.i_offset += i_packet_size;
+    return p_pkt;
+}
+
 static int64_t TimeStampWrapAround( ts_pmt_t *p_pmt, int64_t i_time )
 {
     int64_t i_adjust = 0;
@@ -2595,10 +3169,8 @@ static int64_t TimeStampWrapAround( ts_pmt_t *p_pmt, int64_t i_time )
     return i_time + i_adjust;
 }
 
-static mtime_t GetPCR( block_t *p_pkt )
+static mtime_t GetPCR( const uint8_t *p )
 {
-    const uint8_t *p = p_pkt->p_buffer;
-
     mtime_t i_pcr = -1;
 
     if( ( p[3]&0x20 ) && /* adaptation */
@@ -2646,9 +3218,8 @@ static inline void FlushESBuffer( ts_pes_t *p_pes )
     if( p_pes->p_data )
     {
         p_pes->i_data_gathered = p_pes->i_data_size = 0;
-        block_ChainRelease( p_pes->p_data );
+        block_Release( p_pes->p_data );
         p_pes->p_data = NULL;
-        p_pes->pp_last = &p_pes->p_data;
     }
 
     if( p_pes->sl.p_data )
@@ -2663,6 +3234,9 @@ static void ReadyQueuesPostSeek( demux_t *p_demux )
 {
     demux_sys_t *p_sys = p_demux->p_sys;
 
+    /* Packets read ahead are from before the seek point */
+    FlushTSPacketBatch( p_sys );
+
     ts_pat_t *p_pat = GetPID(p_sys, 0)->u.p_pat;
     for( int i=0; i< p_pat->programs.i_size; i++ )
     {
@@ -2699,6 +3273,24 @@ static void ReadyQueuesPostSeek( demux_t *p_demux )
     }
 }
 
+/* With the index, a seek is a lookup and no probe is read */
+static int SeekToTimeIndexed( demux_t *p_demux, ts_pmt_t *p_pmt, int64_t i_scaledtime )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    uint64_t i_offset;
+    bool b_found = false;
+
+    vlc_mutex_lock( &p_sys->index.lock );
+    if( p_sys->index.p_index )
+        b_found = ts_index_Find( p_sys->index.p_index, p_pmt->i_pid_pcr,
+                                 i_scaledtime, &i_offset );
+    vlc_mutex_unlock( &p_sys->index.lock );
+
+    if( !b_found )
+        return VLC_EGENERIC;
+    return stream_Seek( p_sys->stream, i_offset );
+}
+
 static int SeekToTime( demux_t *p_demux, ts_pmt_t *p_pmt, int64_t i_scaledtime )
 {
     demux_sys_t *p_sys = p_demux->p_sys;
@@ -2707,6 +3299,9 @@ static int SeekToTime( demux_t *p_demux, ts_pmt_t *p_pmt, int64_t i_scaledtime )
     if( p_pmt->pcr.i_first == i_scaledtime && p_sys->b_canseek )
         return stream_Seek( p_sys->stream, 0 );
 
+    if( SeekToTimeIndexed( p_demux, p_pmt, i_scaledtime ) == VLC_SUCCESS )
+        return VLC_SUCCESS;
+
     if( !p_sys->b_canfastseek )
         return VLC_EGENERIC;
 
@@ -2754,7 +3349,7 @@ static int SeekToTime( demux_t *p_demux, ts_pmt_t *p_pmt, int64_t i_scaledtime )
                 {
                     if( p_pkt->i_buffer >= 4 + 2 + 5 )
                     {
-                        i_pcr = GetPCR( p_pkt );
+                        i_pcr = GetPCR( p_pkt->p_buffer );
                         i_skip += 1 + p_pkt->p_buffer[4];
                     }
                 }
@@ -2800,56 +3395,6 @@ static int SeekToTime( demux_t *p_demux, ts_pmt_t *p_pmt, int64_t i_scaledtime )
     return VLC_SUCCESS;
 }
 
-static ts_pid_t *GetPID( demux_sys_t *p_sys, uint16_t i_pid )
-{
-    switch( i_pid )
-    {
-        case 0:
-            return &p_sys->pids.pat;
-        case 0x1FFF:
-            return &p_sys->pids.dummy;
-        default:
-            if( p_sys->pids.i_last_pid == i_pid )
-                return p_sys->pids.p_last;
-        break;
-    }
-
-    for( int i=0; i < p_sys->pids.i_all; i++ )
-    {
-        if( p_sys->pids.pp_all[i]->i_pid == i_pid )
-        {
-            p_sys->pids.p_last = p_sys->pids.pp_all[i];
-            p_sys->pids.i_last_pid = i_pid;
-            return p_sys->pids.p_last;
-        }
-    }
-
-    if( p_sys->pids.i_all >= p_sys->pids.i_all_alloc )
-    {
-        ts_pid_t **p_realloc = realloc( p_sys->pids.pp_all,
-                                       (p_sys->pids.i_all_alloc + PID_ALLOC_CHUNK) * sizeof(ts_pid_t *) );
-        if( !p_realloc )
-            return NULL;
-        p_sys->pids.pp_all = p_realloc;
-        p_sys->pids.i_all_alloc += PID_ALLOC_CHUNK;
-    }
-
-    ts_pid_t *p_pid = calloc( 1, sizeof(*p_pid) );
-    if( !p_pid )
-    {
-        abort();
-        //return NULL;
-    }
-
-    p_pid->i_pid = i_pid;
-    p_sys->pids.pp_all[p_sys->pids.i_all++] = p_pid;
-
-    p_sys->pids.p_last = p_pid;
-    p_sys->pids.i_last_pid = i_pid;
-
-    return p_pid;
-}
-
 static ts_pmt_t * GetProgramByID( demux_sys_t *p_sys, int i_program )
 {
     if(unlikely(GetPID(p_sys, 0)->type != TYPE_PAT))
@@ -2866,6 +3411,27 @@ static ts_pmt_t * GetProgramByID( demux_sys_t *p_sys, int i_program )
     return NULL;
 }
 
+/* Program boundaries from the index, without reading anything */
+static bool ProbeIndex( demux_t *p_demux, ts_pmt_t *p_pmt )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    int64_t i_first, i_last;
+    bool b_found = false;
+
+    vlc_mutex_lock( &p_sys->index.lock );
+    if( p_sys->index.p_index )
+        b_found = ts_index_GetRange( p_sys->index.p_index, p_pmt->i_pid_pcr,
+                                     &i_first, &i_last );
+    vlc_mutex_unlock( &p_sys->index.lock );
+
+    if( !b_found )
+        return false;
+    if( p_pmt->pcr.i_first == -1 )
+        p_pmt->pcr.i_first = i_first;
+    p_pmt->i_last_dts = i_last; /* already unwrapped */
+    return true;
+}
+
 #define PROBE_CHUNK_COUNT 250
 
 static int ProbeChunk( demux_t *p_demux, int i_program, bool b_end, int64_t *pi_pcr, bool *pb_found )
@@ -2894,7 +3460,7 @@ static int ProbeChunk( demux_t *p_demux, int i_program, bool b_end, int64_t *pi_
             bool b_adaptfield = p_pkt->p_buffer[3] & 0x20;
 
             if( b_adaptfield && p_pkt->i_buffer >= 4 + 2 + 5 )
-                *pi_pcr = GetPCR( p_pkt );
+                *pi_pcr = GetPCR( p_pkt->p_buffer );
 
             if( *pi_pcr == -1 &&
                 (p_pkt->p_buffer[1] & 0xC0) == 0x40 && /* payload start */
@@ -3065,15 +3631,15 @@ static void ProgramSetPCR( demux_t *p_demux, ts_pmt_t *p_pmt, mtime_t i_pcr )
     }
 }
 
-static void PCRHandle( demux_t *p_demux, ts_pid_t *pid, block_t *p_bk )
+static void PCRHandle( demux_t *p_demux, ts_pid_t *pid, const uint8_t *p_pkt )
 {
     demux_sys_t   *p_sys = p_demux->p_sys;
 
-    mtime_t i_pcr = GetPCR( p_bk );
+    mtime_t i_pcr = GetPCR( p_pkt );
     if( i_pcr < 0 )
         return;
 
-    pid->probed.i_pcr_count++;
+    GetPIDProbed( p_sys, pid )->i_pcr_count++;
 
     if( p_sys->i_pmt_es <= 0 )
         return;
@@ -3109,7 +3675,7 @@ static void PCRHandle( demux_t *p_demux, ts_pid_t *pid, block_t *p_bk )
     }
 }
 
-static int FindPCRCandidate( ts_pmt_t *p_pmt )
+static int FindPCRCandidate( demux_sys_t *p_sys, ts_pmt_t *p_pmt )
 {
     ts_pid_t *p_cand = NULL;
     int i_previous = p_pmt->i_pid_pcr;
@@ -3120,9 +3686,10 @@ static int FindPCRCandidate( ts_pmt_t *p_pmt )
         if( SEEN(p_pid) &&
             (!p_cand || p_cand->i_pid != i_previous) )
         {
-            if( p_pid->probed.i_pcr_count ) /* check PCR frequency first */
+            const int i_pcr_count = GetPIDProbed( p_sys, p_pid )->i_pcr_count;
+            if( i_pcr_count ) /* check PCR frequency first */
             {
-                if( !p_cand || p_pid->probed.i_pcr_count > p_cand->probed.i_pcr_count )
+                if( !p_cand || i_pcr_count > GetPIDProbed( p_sys, p_cand )->i_pcr_count )
                 {
                     p_cand = p_pid;
                     continue;
@@ -3151,6 +3718,8 @@ static int FindPCRCandidate( ts_pmt_t *p_pmt )
 /* Tries to reselect a new PCR when none has been received */
 static void PCRFixHandle( demux_t *p_demux, ts_pmt_t *p_pmt, block_t *p_block )
 {
+    demux_sys_t *p_sys = p_demux->p_sys;
+
     if ( p_pmt->pcr.b_disable || p_pmt->pcr.b_fix_done )
     {
         return;
@@ -3163,28 +3732,69 @@ static void PCRFixHandle( demux_t *p_demux, ts_pmt_t *p_pmt, block_t *p_block )
     else if( p_block->i_dts - p_pmt->pcr.i_first_dts > CLOCK_FREQ / 2 ) /* "PCR repeat rate shall not exceed 100ms" */
     {
         if( p_pmt->pcr.i_current < 0 &&
-            GetPID( p_demux->p_sys, p_pmt->i_pid_pcr )->probed.i_pcr_count == 0 )
+            GetPIDProbed( p_sys, GetPID( p_sys, p_pmt->i_pid_pcr ) )->i_pcr_count == 0 )
         {
-            int i_cand = FindPCRCandidate( p_pmt );
+            int i_cand = FindPCRCandidate( p_sys, p_pmt );
             p_pmt->i_pid_pcr = i_cand;
-            if ( GetPID( p_demux->p_sys, p_pmt->i_pid_pcr )->probed.i_pcr_count == 0 )
+            if ( GetPIDProbed( p_sys, GetPID( p_sys, p_pmt->i_pid_pcr ) )->i_pcr_count == 0 )
                 p_pmt->pcr.b_disable = true;
             msg_Warn( p_demux, "No PCR received for program %d, set up workaround using pid %d",
                       p_pmt->i_number, i_cand );
-            UpdatePESFilters( p_demux, p_demux->p_sys->b_es_all );
+            UpdatePESFilters( p_demux, p_sys->b_es_all );
         }
         p_pmt->pcr.b_fix_done = true;
     }
 }
 
-static bool GatherData( demux_t *p_demux, ts_pid_t *pid, block_t *p_bk )
+/* Starts a new PES or section with room for i_size bytes. The payloads
+ * are then copied once, from the slab into that block */
+static void GatherStart( ts_pes_t *p_pes, size_t i_size )
+{
+    assert( p_pes->p_data == NULL );
+
+    p_pes->p_data = block_Alloc( i_size );
+    if( likely(p_pes->p_data) )
+    {
+        p_pes->p_data->i_buffer = 0;
+        p_pes->i_data_alloc = i_size;
+    }
+}
+
+static void GatherAppend( ts_pes_t *p_pes, const uint8_t *p_buf, size_t i_buf )
 {
-    const uint8_t *p = p_bk->p_buffer;
+    block_t *p_data = p_pes->p_data;
+    const size_t i_used = p_data->i_buffer;
+
+    if( i_used + i_buf > p_pes->i_data_alloc )
+    {
+        /* Unbounded, or longer than announced: grow geometrically */
+        const size_t i_alloc = __MAX( 2 * p_pes->i_data_alloc, i_used + i_buf );
+        p_data = block_Realloc( p_data, 0, i_alloc );
+        p_pes->p_data = p_data;
+        if( unlikely(p_data == NULL) )
+        {
+            p_pes->i_data_alloc = 0;
+            p_pes->i_data_size = p_pes->i_data_gathered = 0;
+            return;
+        }
+        p_data->i_buffer = i_used;
+        p_pes->i_data_alloc = i_alloc;
+    }
+
+    memcpy( &p_data->p_buffer[i_used], p_buf, i_buf );
+    p_data->i_buffer += i_buf;
+    p_pes->i_data_gathered += i_buf;
+}
+
+static bool GatherData( demux_t *p_demux, ts_pid_t *pid, uint8_t *p_pkt )
+{
+    const uint8_t *p = p_pkt;
     const bool b_unit_start = p[1]&0x40;
     const bool b_adaptation = p[3]&0x20;
     const bool b_payload    = p[3]&0x10;
     const int  i_cc         = p[3]&0x0f; /* continuity counter */
     bool       b_discontinuity = false;  /* discontinuity */
+    ts_pes_t  *p_pes = pid->u.p_pes;
 
     /* transport_scrambling_control is ignored */
     int         i_skip = 0;
@@ -3196,24 +3806,17 @@ static bool GatherData( demux_t *p_demux, ts_pid_t *pid, block_t *p_bk )
              b_payload, i_cc );
 #endif
 
-    /* For now, ignore additional error correction
-     * TODO: handle Reed-Solomon 204,188 error correction */
-    p_bk->i_buffer = TS_PACKET_SIZE_188;
-
     if( p[1]&0x80 )
     {
         msg_Dbg( p_demux, "transport_error_indicator set (pid=%d)",
                  pid->i_pid );
-        if( pid->u.p_pes->p_data ) //&& pid->es->fmt.i_cat == VIDEO_ES )
-            pid->u.p_pes->p_data->i_flags |= BLOCK_FLAG_CORRUPTED;
+        if( p_pes->p_data ) //&& pid->es->fmt.i_cat == VIDEO_ES )
+            p_pes->p_data->i_flags |= BLOCK_FLAG_CORRUPTED;
     }
 
-    if( p_demux->p_sys->csa )
-    {
-        vlc_mutex_lock( &p_demux->p_sys->csa_lock );
-        csa_Decrypt( p_demux->p_sys->csa, p_bk->p_buffer, p_demux->p_sys->i_csa_pkt_size );
-        vlc_mutex_unlock( &p_demux->p_sys->csa_lock );
-    }
+    /* The payload was descrambled in the batch */
+    if( p_demux->p_sys->csa && (p_pkt[3]&0x80) )
+        p_pkt[3] &= 0x3f;
 
     if( !b_adaptation )
     {
@@ -3229,11 +3832,11 @@ static bool GatherData( demux_t *p_demux, ts_pid_t *pid, block_t *p_bk )
         {
             /* discontinuity indicator found in stream */
             b_discontinuity = (p[5]&0x80) ? true : false;
-            if( b_discontinuity && pid->u.p_pes->p_data )
+            if( b_discontinuity && p_pes->p_data )
             {
                 msg_Warn( p_demux, "discontinuity indicator (pid=%d) ",
                             pid->i_pid );
-                pid->u.p_pes->p_data->i_flags |= BLOCK_FLAG_DISCONTINUITY;
+                p_pes->p_data->i_flags |= BLOCK_FLAG_DISCONTINUITY;
             }
 #if 0
             if( p[5]&0x40 )
@@ -3268,94 +3871,89 @@ static bool GatherData( demux_t *p_demux, ts_pid_t *pid, block_t *p_bk )
                       i_cc, ( pid->i_cc + 1 )&0x0f, pid->i_pid );
 
             pid->i_cc = i_cc;
-            if( pid->u.p_pes->p_data && pid->u.p_pes->es.fmt.i_cat != VIDEO_ES &&
-                pid->u.p_pes->es.fmt.i_cat != AUDIO_ES )
+            if( p_pes->p_data && p_pes->es.fmt.i_cat != VIDEO_ES &&
+                p_pes->es.fmt.i_cat != AUDIO_ES )
             {
                 /* Small audio/video artifacts are usually better than
                  * dropping full frames */
-                pid->u.p_pes->p_data->i_flags |= BLOCK_FLAG_CORRUPTED;
+                p_pes->p_data->i_flags |= BLOCK_FLAG_CORRUPTED;
             }
         }
     }
 
-    PCRHandle( p_demux, pid, p_bk );
+    PCRHandle( p_demux, pid, p_pkt );
 
-    if( i_skip >= 188 )
-    {
-        block_Release( p_bk );
+    if( i_skip >= TS_PACKET_SIZE_188 )
         return i_ret;
-    }
 
-    /* We have to gather it */
-    p_bk->p_buffer += i_skip;
-    p_bk->i_buffer -= i_skip;
+    /* We have to gather it. For now, ignore additional error correction
+     * TODO: handle Reed-Solomon 204,188 error correction */
+    const uint8_t *p_payload = &p_pkt[i_skip];
+    size_t i_payload = TS_PACKET_SIZE_188 - i_skip;
 
     if( b_unit_start )
     {
-        if( pid->u.p_pes->data_type == TS_ES_DATA_TABLE_SECTION && p_bk->i_buffer > 0 )
+        if( p_pes->data_type == TS_ES_DATA_TABLE_SECTION && i_payload > 0 )
         {
-            int i_pointer_field = __MIN( p_bk->p_buffer[0], p_bk->i_buffer - 1 );
-            block_t *p = block_Duplicate( p_bk );
-            if( p )
-            {
-                p->i_buffer = i_pointer_field;
-                p->p_buffer++;
-                block_ChainLastAppend( &pid->u.p_pes->pp_last, p );
-            }
-            p_bk->i_buffer -= 1 + i_pointer_field;
-            p_bk->p_buffer += 1 + i_pointer_field;
+            size_t i_pointer_field = __MIN( p_payload[0], i_payload - 1 );
+            if( p_pes->p_data )
+                GatherAppend( p_pes, &p_payload[1], i_pointer_field );
+            i_payload -= 1 + i_pointer_field;
+            p_payload += 1 + i_pointer_field;
         }
-        if( pid->u.p_pes->p_data )
+        if( p_pes->p_data )
         {
             ParseData( p_demux, pid );
             i_ret = true;
         }
 
-        block_ChainLastAppend( &pid->u.p_pes->pp_last, p_bk );
-        if( pid->u.p_pes->data_type == TS_ES_DATA_PES )
+        if( p_pes->data_type == TS_ES_DATA_PES )
         {
-            if( p_bk->i_buffer > 6 )
+            if( i_payload > 6 )
             {
-                pid->u.p_pes->i_data_size = GetWBE( &p_bk->p_buffer[4] );
-                if( pid->u.p_pes->i_data_size > 0 )
+                p_pes->i_data_size = GetWBE( &p_payload[4] );
+                if( p_pes->i_data_size > 0 )
                 {
-                    pid->u.p_pes->i_data_size += 6;
+                    p_pes->i_data_size += 6;
                 }
             }
         }
-        else if( pid->u.p_pes->data_type == TS_ES_DATA_TABLE_SECTION )
+        else if( p_pes->data_type == TS_ES_DATA_TABLE_SECTION )
         {
-            if( p_bk->i_buffer > 3 && p_bk->p_buffer[0] != 0xff )
+            if( i_payload > 3 && p_payload[0] != 0xff )
             {
-                pid->u.p_pes->i_data_size = 3 + (((p_bk->p_buffer[1] & 0xf) << 8) | p_bk->p_buffer[2]);
+                p_pes->i_data_size = 3 + (((p_payload[1] & 0xf) << 8) | p_payload[2]);
             }
         }
-        pid->u.p_pes->i_data_gathered += p_bk->i_buffer;
-        if( pid->u.p_pes->i_data_size > 0 &&
-            pid->u.p_pes->i_data_gathered >= pid->u.p_pes->i_data_size )
+
+        size_t i_alloc = p_pes->i_data_size;
+        if( i_alloc == 0 )
+            i_alloc = __MAX( p_pes->i_data_hint + p_pes->i_data_hint / 8,
+                             TS_GATHER_MIN_SIZE );
+        GatherStart( p_pes, __MAX( i_alloc, i_payload ) );
+        if( unlikely(p_pes->p_data == NULL) )
+        {
+            p_pes->i_data_size = 0;
+            return i_ret;
+        }
+        GatherAppend( p_pes, p_payload, i_payload );
+
+        if( p_pes->i_data_size > 0 &&
+            p_pes->i_data_gathered >= p_pes->i_data_size )
         {
             ParseData( p_demux, pid );
             i_ret = true;
         }
     }
-    else
+    else if( p_pes->p_data ) /* else broken packet */
     {
-        if( pid->u.p_pes->p_data == NULL )
-        {
-            /* msg_Dbg( p_demux, "broken packet" ); */
-            block_Release( p_bk );
-        }
-        else
-        {
-            block_ChainLastAppend( &pid->u.p_pes->pp_last, p_bk );
-            pid->u.p_pes->i_data_gathered += p_bk->i_buffer;
+        GatherAppend( p_pes, p_payload, i_payload );
 
-            if( pid->u.p_pes->i_data_size > 0 &&
-                pid->u.p_pes->i_data_gathered >= pid->u.p_pes->i_data_size )
-            {
-                ParseData( p_demux, pid );
-                i_ret = true;
-            }
+        if( p_pes->i_data_size > 0 &&
+            p_pes->i_data_gathered >= p_pes->i_data_size )
+        {
+            ParseData( p_demux, pid );
+            i_ret = true;
         }
     }
 
@@ -3464,18 +4062,245 @@ static void ValidateDVBMeta( demux_t *p_demux, int i_pid )
     /* This doesn't look like a DVB stream so don't try
      * parsing the SDT/EDT/TDT */
 
+    SIThreadStop( p_demux );
     PIDRelease( p_demux, GetPID(p_sys, 0x11) );
     PIDRelease( p_demux, GetPID(p_sys, 0x12) );
     PIDRelease( p_demux, GetPID(p_sys, 0x14) );
     p_sys->b_dvb_meta = false;
 }
 
-#include "../dvb-text.h"
+/*****************************************************************************
+ * Seek index thread
+ *****************************************************************************/
+static void *IndexThread( void *data )
+{
+    demux_t     *p_demux = data;
+    demux_sys_t *p_sys = p_demux->p_sys;
+
+    ts_index_t *p_index = ts_index_Build( VLC_OBJECT(p_demux), p_demux->psz_file,
+                                          p_sys->i_packet_size,
+                                          p_sys->i_packet_header_size,
+                                          &p_sys->index.b_stop );
+    if( !p_index )
+        return NULL;
+
+    /* Read-only media or folder: the index is only kept until closing */
+    ts_index_Save( VLC_OBJECT(p_demux), p_index, p_demux->psz_file );
+
+    vlc_mutex_lock( &p_sys->index.lock );
+    p_sys->index.p_index = p_index;
+    vlc_mutex_unlock( &p_sys->index.lock );
+    msg_Dbg( p_demux, "seek index of %s built", p_demux->psz_file );
+    return NULL;
+}
+
+static void IndexThreadStart( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+
+    atomic_init( &p_sys->index.b_stop, false );
+    if( vlc_clone( &p_sys->index.thread, IndexThread, p_demux, VLC_THREAD_PRIORITY_LOW ) )
+    {
+        msg_Warn( p_demux, "cannot start the seek index thread" );
+        return;
+    }
+    p_sys->index.b_running = true;
+}
+
+static void IndexThreadStop( demux_sys_t *p_sys )
+{
+    if( !p_sys->index.b_running )
+        return;
+
+    atomic_store( &p_sys->index.b_stop, true );
+    vlc_join( p_sys->index.thread, NULL );
+    p_sys->index.b_running = false;
+}
+
+/*****************************************************************************
+ * SI thread
+ *****************************************************************************/
+static void SIDecodePacket( void *p_handle, const uint8_t *p_pkt )
+{
+    dvbpsi_packet_push( p_handle, (uint8_t *)p_pkt );
+}
+
+/* Hands a NIT/SDT/EIT/TDT packet over to its decoder, from the SI thread
+ * if it runs */
+static void SIPushPacket( ts_pid_t *p_pid, const uint8_t *p_pkt )
+{
+    ts_psi_t *p_psi = p_pid->u.p_psi;
+
+    if( p_psi->p_eit_filter )
+        ts_eit_filter_Push( p_psi->p_eit_filter, p_pkt,
+                            SIDecodePacket, p_psi->handle );
+    else
+        SIDecodePacket( p_psi->handle, p_pkt );
+}
+
+static void *SIThread( void *data )
+{
+    demux_t     *p_demux = data;
+    demux_sys_t *p_sys = p_demux->p_sys;
+
+    for( ;; )
+    {
+        vlc_sem_wait( &p_sys->si.data );
+
+        /* Nothing is queued anymore once exit is requested */
+        const bool b_exit = atomic_load( &p_sys->si.b_exit );
+        unsigned i_read = atomic_load_explicit( &p_sys->si.i_read, memory_order_relaxed );
+        const unsigned i_write = atomic_load_explicit( &p_sys->si.i_write, memory_order_acquire );
+        if( i_read != i_write )
+        {
+            vlc_mutex_lock( &p_sys->si.lock );
+            for( ; i_read != i_write; i_read++ )
+            {
+                uint8_t *p_pkt = &p_sys->si.p_ring[(i_read % TS_SI_RING_PACKETS) * TS_PACKET_SIZE_188];
+                ts_pid_t *p_pid = GetPID( p_sys, ( (p_pkt[1]&0x1f)<<8 )|p_pkt[2] );
+                SIPushPacket( p_pid, p_pkt );
+            }
+            vlc_mutex_unlock( &p_sys->si.lock );
+
+            atomic_store_explicit( &p_sys->si.i_read, i_read, memory_order_release );
+            vlc_sem_post( &p_sys->si.space );
+        }
+
+        if( b_exit )
+            break;
+    }
+
+    return NULL;
+}
+
+static void SIThreadStart( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+
+    p_sys->si.p_ring = malloc( TS_SI_RING_PACKETS * TS_PACKET_SIZE_188 );
+    if( !p_sys->si.p_ring )
+        return;
+
+    atomic_init( &p_sys->si.i_read, 0 );
+    atomic_init( &p_sys->si.i_write, 0 );
+    atomic_init( &p_sys->si.b_exit, false );
+    p_sys->si.p_out = NULL;
+    p_sys->si.pp_out_last = &p_sys->si.p_out;
+    vlc_sem_init( &p_sys->si.data, 0 );
+    vlc_sem_init( &p_sys->si.space, 0 );
+
+    if( vlc_clone( &p_sys->si.thread, SIThread, p_demux, VLC_THREAD_PRIORITY_INPUT ) )
+    {
+        msg_Warn( p_demux, "cannot start SI thread, parsing SI synchronously" );
+        vlc_sem_destroy( &p_sys->si.space );
+        vlc_sem_destroy( &p_sys->si.data );
+        free( p_sys->si.p_ring );
+        p_sys->si.p_ring = NULL;
+        return;
+    }
+    p_sys->si.b_running = true;
+}
+
+static void SIThreadStop( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+
+    if( !p_sys->si.b_running )
+        return;
+
+    /* The thread parses whatever is still queued before leaving */
+    atomic_store( &p_sys->si.b_exit, true );
+    vlc_sem_post( &p_sys->si.data );
+    vlc_join( p_sys->si.thread, NULL );
+    SIOutFlush( p_demux );
+
+    vlc_sem_destroy( &p_sys->si.space );
+    vlc_sem_destroy( &p_sys->si.data );
+    free( p_sys->si.p_ring );
+    p_sys->si.p_ring = NULL;
+    p_sys->si.b_running = false;
+}
+
+static void SIOutRelease( int i_query, void *p_data )
+{
+    if( i_query == ES_OUT_SET_GROUP_META )
+        vlc_meta_Delete( p_data );
+    else
+        vlc_epg_Delete( p_data );
+}
+
+/* Sends, and releases, the meta or EPG of a group. From the SI thread, the
+ * update is queued with the SI lock held, and left to SIOutFlush(). */
+static void SIOutControl( demux_t *p_demux, int i_query, int i_group, void *p_data )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+
+    if( !p_sys->si.b_running )
+    {
+        es_out_Control( p_demux->out, i_query, i_group, p_data );
+        SIOutRelease( i_query, p_data );
+        return;
+    }
+
+    ts_si_out_t *p_out = malloc( sizeof(*p_out) );
+    if( unlikely(p_out == NULL) )
+    {
+        SIOutRelease( i_query, p_data );
+        return;
+    }
+    p_out->p_next = NULL;
+    p_out->i_query = i_query;
+    p_out->i_group = i_group;
+    p_out->p_data = p_data;
+    *p_sys->si.pp_out_last = p_out;
+    p_sys->si.pp_out_last = &p_out->p_next;
+}
 
-static char *EITConvertToUTF8( demux_t *p_demux,
-                               const unsigned char *psz_instring,
-                               size_t i_length,
-                               bool b_broken )
+/* Sends the updates queued by the SI thread, from the demux thread */
+static void SIOutFlush( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+
+    vlc_mutex_lock( &p_sys->si.lock );
+    ts_si_out_t *p_out = p_sys->si.p_out;
+    p_sys->si.p_out = NULL;
+    p_sys->si.pp_out_last = &p_sys->si.p_out;
+    vlc_mutex_unlock( &p_sys->si.lock );
+
+    while( p_out != NULL )
+    {
+        ts_si_out_t *p_next = p_out->p_next;
+
+        es_out_Control( p_demux->out, p_out->i_query, p_out->i_group, p_out->p_data );
+        SIOutRelease( p_out->i_query, p_out->p_data );
+        free( p_out );
+        p_out = p_next;
+    }
+}
+
+static void SIQueuePacket( demux_sys_t *p_sys, const uint8_t *p_pkt )
+{
+    const unsigned i_write = atomic_load_explicit( &p_sys->si.i_write, memory_order_relaxed );
+
+    /* Ring is full: wake the SI thread up and wait for it */
+    while( i_write - atomic_load_explicit( &p_sys->si.i_read, memory_order_acquire )
+           >= TS_SI_RING_PACKETS )
+    {
+        vlc_sem_post( &p_sys->si.data );
+        vlc_sem_wait( &p_sys->si.space );
+    }
+
+    memcpy( &p_sys->si.p_ring[(i_write % TS_SI_RING_PACKETS) * TS_PACKET_SIZE_188],
+            p_pkt, TS_PACKET_SIZE_188 );
+    atomic_store_explicit( &p_sys->si.i_write, i_write + 1, memory_order_release );
+}
+
+/* The string is valid until the arena is reset */
+static const char *EITConvertToUTF8( demux_t *p_demux,
+                                     ts_text_arena_t *p_arena,
+                                     const unsigned char *psz_instring,
+                                     size_t i_length,
+                                     bool b_broken )
 {
     demux_sys_t *p_sys = p_demux->p_sys;
 #ifdef HAVE_ARIBB24
@@ -3489,23 +4314,20 @@ static char *EITConvertToUTF8( demux_t *p_demux,
         if ( !p_decoder )
             return NULL;
 
-        char *psz_outstring = NULL;
-        size_t i_out;
-
-        i_out = i_length * 4;
-        psz_outstring = (char*) calloc( i_out + 1, sizeof(char) );
-        if( !psz_outstring )
+        const size_t i_out = i_length * 4;
+        if( p_arena->i_size - p_arena->i_used < i_out + 1 )
             return NULL;
+        char *psz_outstring = &p_arena->p_buf[p_arena->i_used];
+        memset( psz_outstring, 0, i_out + 1 );
 
         arib_initialize_decoder( p_decoder );
-        i_out = arib_decode_buffer( p_decoder, psz_instring, i_length,
-                                    psz_outstring, i_out );
+        arib_decode_buffer( p_decoder, psz_instring, i_length,
+                            psz_outstring, i_out );
         arib_finalize_decoder( p_decoder );
 
+        p_arena->i_used += strlen( psz_outstring ) + 1;
         return psz_outstring;
     }
-#else
-    VLC_UNUSED(p_sys);
 #endif
     /* Deal with no longer broken providers (no switch byte
       but sending ISO_8859-1 instead of ISO_6937) without
@@ -3515,8 +4337,82 @@ static char *EITConvertToUTF8( demux_t *p_demux,
     b_broken = b_broken && i_length && *psz_instring > 0x20;
 
     if( b_broken )
-        return FromCharset( "ISO_8859-1", psz_instring, i_length );
-    return vlc_from_EIT( psz_instring, i_length );
+        return ts_text_DecodeLatin1( p_arena, psz_instring, i_length );
+    return ts_text_Decode( p_sys->p_text, p_arena, psz_instring, i_length );
+}
+
+/* Texts of the records, decoded as those of the EPG. The SI thread may be
+ * decoding at the same time */
+static const char *RecordText( void *p_cb_data, ts_text_arena_t *p_arena,
+                               const uint8_t *p, size_t i, bool b_broken )
+{
+    demux_t *p_demux = p_cb_data;
+    demux_sys_t *p_sys = p_demux->p_sys;
+
+    vlc_mutex_lock( &p_sys->si.lock );
+    const char *psz = EITConvertToUTF8( p_demux, p_arena, p, i, b_broken );
+    vlc_mutex_unlock( &p_sys->si.lock );
+    return psz;
+}
+
+/* One record per pid, with the counters so far and the last window rate,
+ * and one for the network reception */
+static void OutputStats( demux_sys_t *p_sys )
+{
+    demux_ts_stats_t *p_stats = ts_stats_Get( p_sys->p_stats );
+    if( !p_stats )
+        return;
+
+    for( size_t i = 0; i < p_stats->i_pids; i++ )
+    {
+        const demux_ts_pid_stats_t *p_pid = &p_stats->p_pids[i];
+        const ts_output_field_t fields[] = {
+            TS_OUTPUT_INT( "date", p_stats->i_date ),
+            TS_OUTPUT_INT( "pid", p_pid->i_pid ),
+            TS_OUTPUT_INT( "packets", p_pid->i_packets ),
+            TS_OUTPUT_INT( "bitrate", p_pid->i_bitrate ),
+            TS_OUTPUT_INT( "cc_errors", p_pid->i_cc_errors ),
+            TS_OUTPUT_INT( "tei_errors", p_pid->i_tei_errors ),
+            TS_OUTPUT_INT( "discontinuities", p_pid->i_discontinuities ),
+            TS_OUTPUT_INT( "scrambled", p_pid->i_scrambled ),
+            TS_OUTPUT_INT( "pcrs", p_pid->i_pcrs ),
+            TS_OUTPUT_INT( "pcr_interval_max", p_pid->i_pcr_interval_max ),
+            TS_OUTPUT_INT( "pcr_interval_errors", p_pid->i_pcr_interval_errors ),
+            TS_OUTPUT_INT( "pcr_discontinuity_errors", p_pid->i_pcr_discontinuity_errors ),
+            TS_OUTPUT_INT( "pcr_accuracy_max", p_pid->i_pcr_accuracy_max ),
+            TS_OUTPUT_INT( "pcr_accuracy_errors", p_pid->i_pcr_accuracy_errors ),
+        };
+        ts_output_Record( p_sys->p_output, "STATS", fields, ARRAY_SIZE(fields) );
+    }
+
+    /* Reception quality, when the access measures it */
+    stream_net_stats_t net;
+    if( stream_Control( p_sys->stream, STREAM_GET_NET_STATS, &net ) == VLC_SUCCESS )
+    {
+        char psz_iat[STREAM_NET_IAT_BUCKETS * 21];
+        size_t i_iat = 0;
+        for( unsigned i = 0; i < STREAM_NET_IAT_BUCKETS; i++ )
+            i_iat += snprintf( &psz_iat[i_iat], sizeof(psz_iat) - i_iat, "%s%"PRIu64,
+                               i ? "," : "", net.pi_iat[i] );
+
+        const ts_output_field_t fields[] = {
+            TS_OUTPUT_INT( "date", p_stats->i_date ),
+            TS_OUTPUT_INT( "datagrams", net.i_datagrams ),
+            TS_OUTPUT_INT( "bytes", net.i_bytes ),
+            TS_OUTPUT_INT( "bitrate", net.i_bitrate ),
+            TS_OUTPUT_INT( "delay_factor", net.i_delay_factor ),
+            TS_OUTPUT_INT( "loss_rate", net.i_loss_rate ),
+            TS_OUTPUT_INT( "ts_lost", net.i_ts_lost ),
+            TS_OUTPUT_INT( "rtp_lost", net.i_rtp_lost ),
+            TS_OUTPUT_INT( "rtp_reordered", net.i_rtp_reordered ),
+            TS_OUTPUT_INT( "rtp_gap_max", net.i_gap_max ),
+            TS_OUTPUT_INT( "burst_max", net.i_burst_max ),
+            TS_OUTPUT_INT( "iat_max", net.i_iat_max ),
+            TS_OUTPUT_STR( "iat", psz_iat ),
+        };
+        ts_output_Record( p_sys->p_output, "MDI", fields, ARRAY_SIZE(fields) );
+    }
+    free( p_stats );
 }
 
 static void SDTCallBack( demux_t *p_demux, dvbpsi_sdt_t *p_sdt )
@@ -3592,8 +4488,10 @@ static void SDTCallBack( demux_t *p_demux, dvbpsi_sdt_t *p_sdt )
                     "DVB MHP service"
                 };
                 dvbpsi_service_dr_t *pD = dvbpsi_DecodeServiceDr( p_dr );
-                char *str1 = NULL;
-                char *str2 = NULL;
+                const char *str1 = NULL;
+                const char *str2 = NULL;
+                ts_text_arena_t arena;
+                ts_text_ArenaInit( &arena, p_sys->p_text_arena, TS_TEXT_ARENA_SIZE );
 
                 /* Workarounds for broadcasters with broken EPG */
 
@@ -3618,11 +4516,11 @@ static void SDTCallBack( demux_t *p_demux, dvbpsi_sdt_t *p_sdt )
 
                 /* FIXME: Digital+ ES also uses ISO8859-1 */
 
-                str1 = EITConvertToUTF8(p_demux,
+                str1 = EITConvertToUTF8(p_demux, &arena,
                                         pD->i_service_provider_name,
                                         pD->i_service_provider_name_length,
                                         p_sys->b_broken_charset );
-                str2 = EITConvertToUTF8(p_demux,
+                str2 = EITConvertToUTF8(p_demux, &arena,
                                         pD->i_service_name,
                                         pD->i_service_name_length,
                                         p_sys->b_broken_charset );
@@ -3630,19 +4528,12 @@ static void SDTCallBack( demux_t *p_demux, dvbpsi_sdt_t *p_sdt )
                 msg_Dbg( p_demux, "    - type=%d provider=%s name=%s",
                          pD->i_service_type, str1, str2 );
 
-                msg_Err( p_demux, "## Arun    - type=%d provider=%s name=%s",
-                                         pD->i_service_type, str1, str2 );
-
                 //fprintf( stderr, "\n## Arun    - type=%d provider=%s name=%s", pD->i_service_type, str1, str2 );
-                //ServiceID, TSID, ONID
-                fprintf (stdout, "\nSDT,%x.%x.%x,%x,%x,%x,%s",p_srv->i_service_id, p_sdt->i_extension,p_sdt->i_network_id, p_srv->i_service_id, p_sdt->i_extension,p_sdt->i_network_id,str2);
 
                 vlc_meta_SetTitle( p_meta, str2 );
                 vlc_meta_SetPublisher( p_meta, str1 );
                 if( pD->i_service_type >= 0x01 && pD->i_service_type <= 0x10 )
                     psz_type = ppsz_type[pD->i_service_type];
-                free( str1 );
-                free( str2 );
             }
         }
 
@@ -3663,74 +4554,14 @@ static void SDTCallBack( demux_t *p_demux, dvbpsi_sdt_t *p_sdt )
         if( psz_status )
             vlc_meta_AddExtra( p_meta, "Status", psz_status );
 
-        es_out_Control( p_demux->out, ES_OUT_SET_GROUP_META,
-                        p_srv->i_service_id, p_meta );
-        vlc_meta_Delete( p_meta );
+        SIOutControl( p_demux, ES_OUT_SET_GROUP_META,
+                      p_srv->i_service_id, p_meta );
     }
 
     sdt->u.p_psi->i_version = p_sdt->i_version;
     dvbpsi_sdt_delete( p_sdt );
 }
 
-/* i_year: year - 1900  i_month: 0-11  i_mday: 1-31 i_hour: 0-23 i_minute: 0-59 i_second: 0-59 */
-static int64_t vlc_timegm( int i_year, int i_month, int i_mday, int i_hour, int i_minute, int i_second )
-{
-    static const int pn_day[12+1] = { 0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334 };
-    int64_t i_day;
-
-    if( i_year < 70 ||
-        i_month < 0 || i_month > 11 || i_mday < 1 || i_mday > 31 ||
-        i_hour < 0 || i_hour > 23 || i_minute < 0 || i_minute > 59 || i_second < 0 || i_second > 59 )
-        return -1;
-
-    /* Count the number of days */
-    i_day = 365 * (i_year-70) + pn_day[i_month] + i_mday - 1;
-#define LEAP(y) ( ((y)%4) == 0 && (((y)%100) != 0 || ((y)%400) == 0) ? 1 : 0)
-    for( int i = 70; i < i_year; i++ )
-        i_day += LEAP(1900+i);
-    if( i_month > 1 )
-        i_day += LEAP(1900+i_year);
-#undef LEAP
-    /**/
-    return ((24*i_day + i_hour)*60 + i_minute)*60 + i_second;
-}
-
-static void EITDecodeMjd( int i_mjd, int *p_y, int *p_m, int *p_d )
-{
-    const int yp = (int)( ( (double)i_mjd - 15078.2)/365.25 );
-    const int mp = (int)( ((double)i_mjd - 14956.1 - (int)(yp * 365.25)) / 30.6001 );
-    const int c = ( mp == 14 || mp == 15 ) ? 1 : 0;
-
-    *p_y = 1900 + yp + c*1;
-    *p_m = mp - 1 - c*12;
-    *p_d = i_mjd - 14956 - (int)(yp*365.25) - (int)(mp*30.6001);
-}
-#define CVT_FROM_BCD(v) ((((v) >> 4)&0xf)*10 + ((v)&0xf))
-static int64_t EITConvertStartTime( uint64_t i_date )
-{
-    const int i_mjd = i_date >> 24;
-    const int i_hour   = CVT_FROM_BCD(i_date >> 16);
-    const int i_minute = CVT_FROM_BCD(i_date >>  8);
-    const int i_second = CVT_FROM_BCD(i_date      );
-    int i_year;
-    int i_month;
-    int i_day;
-
-    /* if all 40 bits are 1, the start is unknown */
-    if( i_date == UINT64_C(0xffffffffff) )
-        return -1;
-
-    EITDecodeMjd( i_mjd, &i_year, &i_month, &i_day );
-    return vlc_timegm( i_year - 1900, i_month - 1, i_day, i_hour, i_minute, i_second );
-}
-static int EITConvertDuration( uint32_t i_duration )
-{
-    return CVT_FROM_BCD(i_duration >> 16) * 3600 +
-           CVT_FROM_BCD(i_duration >> 8 ) * 60 +
-           CVT_FROM_BCD(i_duration      );
-}
-#undef CVT_FROM_BCD
-
 static void TDTCallBack( demux_t *p_demux, dvbpsi_tot_t *p_tdt )
 {
     demux_sys_t        *p_sys = p_demux->p_sys;
@@ -3755,13 +4586,6 @@ static void EITCallBack( demux_t *p_demux,
         return;
     }
     //fprintf (stderr, "################# Arun's Debug: EIT version\n");
-    msg_Err( p_demux, "ARUN !!!! new EIT service_id=%d version=%d current_next=%d "
-                 "ts_id=%d network_id=%d segment_last_section_number=%d "
-                 "last_table_id=%d",
-                 p_eit->i_extension,
-                 p_eit->i_version, p_eit->b_current_next,
-                 p_eit->i_ts_id, p_eit->i_network_id,
-                 p_eit->i_segment_last_section_number, p_eit->i_last_table_id );
     //msg_Err( p_demux, "ARUN ----- EITCallBack ");
     msg_Dbg( p_demux, "new EIT service_id=%d version=%d current_next=%d "
              "ts_id=%d network_id=%d segment_last_section_number=%d "
@@ -3775,9 +4599,10 @@ static void EITCallBack( demux_t *p_demux,
     for( p_evt = p_eit->p_first_event; p_evt; p_evt = p_evt->p_next )
     {
         dvbpsi_descriptor_t *p_dr;
-        char                *psz_name = NULL;
-        char                *psz_text = NULL;
+        const char          *psz_name = NULL;
+        const char          *psz_text = NULL;
         char                *psz_extra = strdup("");
+        ts_text_arena_t      arena;
         int64_t i_start;
         int i_duration;
         int i_min_age = 0;
@@ -3785,6 +4610,7 @@ static void EITCallBack( demux_t *p_demux,
 
         i_start = EITConvertStartTime( p_evt->i_start_time );
         i_duration = EITConvertDuration( p_evt->i_duration );
+        ts_text_ArenaInit( &arena, p_sys->p_text_arena, TS_TEXT_ARENA_SIZE );
 
         if( p_sys->arib.e_mode == ARIBMODE_ENABLED )
         {
@@ -3823,11 +4649,10 @@ static void EITCallBack( demux_t *p_demux,
                    for epg atm*/
                 if( pE && psz_name == NULL )
                 {
-                    psz_name = EITConvertToUTF8( p_demux,
+                    psz_name = EITConvertToUTF8( p_demux, &arena,
                                                  pE->i_event_name, pE->i_event_name_length,
                                                  p_sys->b_broken_charset );
-                    free( psz_text );
-                    psz_text = EITConvertToUTF8( p_demux,
+                    psz_text = EITConvertToUTF8( p_demux, &arena,
                                                  pE->i_text, pE->i_text_length,
                                                  p_sys->b_broken_charset );
                     msg_Dbg( p_demux, "    - short event lang=%3.3s '%s' : '%s'",
@@ -3845,9 +4670,12 @@ static void EITCallBack( demux_t *p_demux,
                              pE->i_iso_639_code,
                              pE->i_descriptor_number, pE->i_last_descriptor_number );
 
+                    /* The strings below are not kept */
+                    const size_t i_arena_mark = arena.i_used;
+
                     if( pE->i_text_length > 0 )
                     {
-                        char *psz_text = EITConvertToUTF8( p_demux,
+                        const char *psz_text = EITConvertToUTF8( p_demux, &arena,
                                                            pE->i_text, pE->i_text_length,
                                                            p_sys->b_broken_charset );
                         if( psz_text )
@@ -3857,17 +4685,19 @@ static void EITCallBack( demux_t *p_demux,
                             psz_extra = xrealloc( psz_extra,
                                    strlen(psz_extra) + strlen(psz_text) + 1 );
                             strcat( psz_extra, psz_text );
-                            free( psz_text );
                         }
+                        arena.i_used = i_arena_mark;
                     }
 
-                    for( int i = 0; i < pE->i_entry_count; i++ )
+                    /* The items are only traced */
+                    for( int i = 0; i < pE->i_entry_count &&
+                                    msg_Enabled( p_demux, VLC_MSG_DBG ); i++ )
                     {
-                        char *psz_dsc = EITConvertToUTF8( p_demux,
+                        const char *psz_dsc = EITConvertToUTF8( p_demux, &arena,
                                                           pE->i_item_description[i],
                                                           pE->i_item_description_length[i],
                                                           p_sys->b_broken_charset );
-                        char *psz_itm = EITConvertToUTF8( p_demux,
+                        const char *psz_itm = EITConvertToUTF8( p_demux, &arena,
                                                           pE->i_item[i], pE->i_item_length[i],
                                                           p_sys->b_broken_charset );
 
@@ -3885,8 +4715,7 @@ static void EITCallBack( demux_t *p_demux,
                             strcat( psz_extra, ")" );
 #endif
                         }
-                        free( psz_dsc );
-                        free( psz_itm );
+                        arena.i_used = i_arena_mark;
                     }
                 }
             }
@@ -3918,23 +4747,13 @@ static void EITCallBack( demux_t *p_demux,
             }
         }
 
-        /* */
-        if( i_start > 0 && psz_name && psz_text)
-        	//ServiceID, TSID, ONID
-        	if(!b_current_following)
-        	{
-        		fprintf(stdout, "\nEIT,xxx,%x.%x.%x,%x,%x,%x,%x,%d,%d,\"%s\"", p_eit->i_extension, p_eit->i_ts_id, p_eit->i_network_id,p_eit->i_extension, p_eit->i_ts_id, p_eit->i_network_id,p_evt->i_event_id,i_start, i_duration, psz_name);
-        	}
-            vlc_epg_AddEvent( p_epg, i_start, i_duration, psz_name, psz_text,
-                              *psz_extra ? psz_extra : NULL, i_min_age );
+        vlc_epg_AddEvent( p_epg, i_start, i_duration, psz_name, psz_text,
+                          *psz_extra ? psz_extra : NULL, i_min_age );
 
         /* Update "now playing" field */
         if( p_evt->i_running_status == 0x04 && i_start > 0  && psz_name && psz_text )
             vlc_epg_SetCurrent( p_epg, i_start );
 
-        free( psz_name );
-        free( psz_text );
-
         free( psz_extra );
     }
     if( p_epg->i_event > 0 )
@@ -3954,11 +4773,11 @@ static void EITCallBack( demux_t *p_demux,
                 p_sys->i_dvb_length = CLOCK_FREQ * p_epg->p_current->i_duration;
             }
         }
-        es_out_Control( p_demux->out, ES_OUT_SET_GROUP_EPG,
-                        p_eit->i_extension,
-                        p_epg );
+        SIOutControl( p_demux, ES_OUT_SET_GROUP_EPG,
+                      p_eit->i_extension, p_epg );
     }
-    vlc_epg_Delete( p_epg );
+    else
+        vlc_epg_Delete( p_epg );
 
     dvbpsi_eit_delete( p_eit );
 }
@@ -3989,24 +4808,6 @@ static void PSINewTableCallBack( dvbpsi_t *h, uint8_t i_table_id,
         if( !dvbpsi_sdt_attach( h, i_table_id, i_extension, (dvbpsi_sdt_callback)SDTCallBack, p_demux ) )
             msg_Err( p_demux, "PSINewTableCallback: failed attaching SDTCallback" );
     }
-//    if( GetPID(p_sys, 0)->u.p_psi->i_version != -1 &&
-//                (i_table_id == 0x42 || i_table_id == 0x46) )
-//        {
-//             msg_Dbg( p_demux, "PSINewTableCallBack: table 0x%x(%d) ext=0x%x(%d)",
-//                     i_table_id, i_table_id, i_extension, i_extension );
-//             //fprintf( stderr, "SDT PSINewTableCallBack: table 0x%x(%d) ext=0x%x(%d)",
-//                    //              i_table_id, i_table_id, i_extension, i_extension );
-//            if( !dvbpsi_sdt_attach( h, i_table_id, i_extension, (dvbpsi_sdt_callback)SDTCallBack, p_demux ) )
-//                msg_Err( p_demux, "PSINewTableCallback: failed attaching SDTCallback" );
-//        }
-//    else if( GetPID(p_sys, 0)->u.p_pat->i_version != -1 && i_table_id == 0x46 )
-//    {
-//        msg_Dbg( p_demux, "PSINewTableCallBack: table 0x%x(%d) ext=0x%x(%d)",
-//                 i_table_id, i_table_id, i_extension, i_extension );
-//
-//        if( !dvbpsi_sdt_attach( h, i_table_id, i_extension, (dvbpsi_sdt_callback)SDTCallBack, p_demux ) )
-//            msg_Err( p_demux, "PSINewTableCallback: failed attaching SDTCallback" );
-//    }
     else if( GetPID(p_sys, 0x11)->u.p_psi->i_version != -1 &&
              ( i_table_id == 0x4e || /* Current/Following */
                (i_table_id >= 0x50 && i_table_id <= 0x5f) ) ) /* Schedule */
@@ -4021,20 +4822,6 @@ static void PSINewTableCallBack( dvbpsi_t *h, uint8_t i_table_id,
         if( !dvbpsi_eit_attach( h, i_table_id, i_extension, cb, p_demux ) )
             msg_Err( p_demux, "PSINewTableCallback: failed attaching EITCallback" );
     }
-//    else if( GetPID(p_sys, 0x11)->u.p_psi->i_version != -1 &&
-//             ( i_table_id == 0x4f || /* Other Current/Following */
-//               (i_table_id >= 0x60 && i_table_id <= 0x6f) ) ) /* Other Schedule */
-//    {
-//        msg_Dbg( p_demux, "PSINewTableCallBack: table 0x%x(%d) ext=0x%x(%d)",
-//                 i_table_id, i_table_id, i_extension, i_extension );
-//
-//        dvbpsi_eit_callback cb = i_table_id == 0x4f ?
-//                                    (dvbpsi_eit_callback)EITCallBackCurrentFollowing :
-//                                    (dvbpsi_eit_callback)EITCallBackSchedule;
-//
-//        if( !dvbpsi_eit_attach( h, i_table_id, i_extension, cb, p_demux ) )
-//            msg_Err( p_demux, "PSINewTableCallback: failed attaching EITCallback" );
-//    }
     else if( GetPID(p_sys, 0x11)->u.p_psi->i_version != -1 &&
             (i_table_id == 0x70 /* TDT */ || i_table_id == 0x73 /* TOT */) )
     {
@@ -5024,9 +5811,13 @@ static void AddAndCreateES( demux_t *p_demux, ts_pid_t *pid, bool b_create_delay
     demux_sys_t  *p_sys = p_demux->p_sys;
 
     if( b_create_delayed )
+    {
+        vlc_mutex_lock( &p_sys->si.lock );
         p_sys->es_creation = CREATE_ES;
+        vlc_mutex_unlock( &p_sys->si.lock );
+    }
 
-    if( pid && p_sys->es_creation == CREATE_ES )
+    if( pid && p_sys->es_creation == CREATE_ES && !p_sys->b_analyse_only )
     {
         /* FIXME: other owners / shared pid */
         pid->u.p_pes->es.id = es_out_Add( p_demux->out, &pid->u.p_pes->es.fmt );
@@ -5043,8 +5834,10 @@ static void AddAndCreateES( demux_t *p_demux, ts_pid_t *pid, bool b_create_delay
         {
             p_sys->b_default_selection = false;
             assert(p_sys->programs.i_size == 1);
+            vlc_mutex_lock( &p_sys->si.lock );
             if( p_sys->programs.p_elems[0] != pid->p_parent->u.p_pmt->i_number )
                 p_sys->programs.p_elems[0] = pid->p_parent->u.p_pmt->i_number;
+            vlc_mutex_unlock( &p_sys->si.lock );
             msg_Dbg( p_demux, "Default program is %d", pid->p_parent->u.p_pmt->i_number );
         }
     }
@@ -5143,7 +5936,7 @@ static void PMTCallBack( void *data, dvbpsi_pmt_t *p_dvbpsipmt )
 
     ValidateDVBMeta( p_demux, p_pmt->i_pid_pcr );
 
-    if( ProgramIsSelected( p_sys, p_pmt->i_number ) )
+    if( !p_sys->b_analyse_only && ProgramIsSelected( p_sys, p_pmt->i_number ) )
         SetPIDFilter( p_sys, GetPID(p_sys, p_pmt->i_pid_pcr), true ); /* Set demux filter */
 
     /* Parse PMT descriptors */
@@ -5487,7 +6280,7 @@ static void PMTCallBack( void *data, dvbpsi_pmt_t *p_dvbpsipmt )
 
     if( !p_sys->b_trust_pcr )
     {
-        int i_cand = FindPCRCandidate( p_pmt );
+        int i_cand = FindPCRCandidate( p_sys, p_pmt );
         p_pmt->i_pid_pcr = i_cand;
         p_pmt->pcr.b_disable = true;
         msg_Warn( p_demux, "PCR not trusted for program %d, set up workaround using pid %d",
@@ -5495,7 +6288,8 @@ static void PMTCallBack( void *data, dvbpsi_pmt_t *p_dvbpsipmt )
     }
 
     /* Probe Boundaries */
-    if( p_sys->b_canfastseek && p_pmt->i_last_dts == -1 )
+    if( p_pmt->i_last_dts == -1 && !ProbeIndex( p_demux, p_pmt ) &&
+        p_sys->b_canfastseek )
     {
         p_pmt->i_last_dts = 0;
         ProbeStart( p_demux, p_pmt->i_number );
@@ -5603,16 +6397,25 @@ static void PATCallBack( void *data, dvbpsi_pat_t *p_dvbpsipat )
             {
                 msg_Dbg( p_demux, "temporary receiving program %d", p_program->i_number );
                 p_sys->b_default_selection = true;
+                vlc_mutex_lock( &p_sys->si.lock );
                 ARRAY_APPEND( p_sys->programs, p_program->i_number );
+                vlc_mutex_unlock( &p_sys->si.lock );
             }
 
             if( SetPIDFilter( p_sys, pmtpid, true ) )
                 p_sys->b_access_control = false;
             else if ( p_sys->es_creation == DELAY_ES )
+            {
+                vlc_mutex_lock( &p_sys->si.lock );
                 p_sys->es_creation = CREATE_ES;
+                vlc_mutex_unlock( &p_sys->si.lock );
+            }
         }
     }
+    /* The SDT is only attached once the PAT is known */
+    vlc_mutex_lock( &p_sys->si.lock );
     p_pat->i_version = p_dvbpsipat->i_version;
+    vlc_mutex_unlock( &p_sys->si.lock );
     p_pat->i_ts_id = p_dvbpsipat->i_ts_id;
 
     for(int i=0; i<old_pmt_rm.i_size; i++)
@@ -5732,7 +6535,8 @@ static ts_pes_t *ts_pes_New( demux_t *p_demux )
     pes->i_data_size = 0;
     pes->i_data_gathered = 0;
     pes->p_data = NULL;
-    pes->pp_last = &pes->p_data;
+    pes->i_data_alloc = 0;
+    pes->i_data_hint = 0;
     pes->p_prepcr_outqueue = NULL;
     pes->sl.p_data = NULL;
     pes->sl.pp_last = &pes->sl.p_data;
@@ -5751,7 +6555,7 @@ static void ts_pes_Del( demux_t *p_demux, ts_pes_t *pes )
     }
 
     if( pes->p_data )
-        block_ChainRelease( pes->p_data );
+        block_Release( pes->p_data );
 
     if( pes->p_prepcr_outqueue )
         block_ChainRelease( pes->p_prepcr_outqueue );
@@ -5786,13 +6590,21 @@ static ts_psi_t *ts_psi_New( demux_t *p_demux )
     }
 
     psi->i_version  = -1;
+    psi->p_eit_filter = NULL;
 
     return psi;
 }
 
 static void ts_psi_Del( demux_t *p_demux, ts_psi_t *psi )
 {
-    VLC_UNUSED(p_demux);
+    if( psi->p_eit_filter )
+    {
+        uint64_t i_new, i_dropped;
+        ts_eit_filter_GetCounts( psi->p_eit_filter, &i_new, &i_dropped );
+        msg_Dbg( p_demux, "EIT sections: %"PRIu64" decoded, %"PRIu64" repeated",
+                 i_new, i_dropped );
+        ts_eit_filter_Delete( psi->p_eit_filter );
+    }
     if( dvbpsi_decoder_present( psi->handle ) )
         dvbpsi_DetachDemux( psi->handle );
     dvbpsi_delete( psi->handle );
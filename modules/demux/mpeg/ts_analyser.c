@@ -0,0 +1,491 @@
+/*****************************************************************************
+ * ts_analyser.c: MPEG-TS analysis of many inputs in one process
+ *****************************************************************************
+ * Copyright (C) 2004-2015 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/*****************************************************************************
+ * Preamble
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <vlc_common.h>
+#include <vlc_interface.h>
+#include <vlc_demux.h>
+#include <vlc_stream.h>
+#include <vlc_es_out.h>
+#include <vlc_interrupt.h>
+#include <vlc_atomic.h>
+#include <vlc_fs.h>
+#include <vlc_url.h>
+
+#include <ctype.h>
+#include <errno.h>
+
+#include "ts_output.h"
+#include "ts_analyser.h"
+
+/* An input is run once it has a whole slab of the ts demuxer buffered, at
+ * the largest packet size, so that its reads do not hold the worker */
+#define ANALYSER_READY_SIZE (512 * 204)
+/* Slabs demultiplexed before the worker turns to its next input */
+#define ANALYSER_QUANTUM    8
+/* Wait of a worker that found no input ready */
+#define ANALYSER_POLL       (CLOCK_FREQ / 200)
+
+typedef struct
+{
+    char     *psz_url;
+    stream_t *p_stream;
+    demux_t  *p_demux;
+} analyser_input_t;
+
+/* Inputs waiting for a worker, the owner takes the oldest one, the
+ * thieves the one that ran last */
+typedef struct
+{
+    vlc_mutex_t lock;
+    unsigned   *pi_inputs;
+    unsigned    i_first;
+    unsigned    i_count;
+} analyser_queue_t;
+
+typedef struct
+{
+    intf_thread_t    *p_intf;
+    unsigned          i_index;
+    vlc_thread_t      thread;
+    bool              b_started;
+    vlc_interrupt_t  *p_interrupt;
+    analyser_queue_t  queue;
+} analyser_worker_t;
+
+struct intf_sys_t
+{
+    ts_output_t       *p_output;
+    es_out_t           out;
+
+    analyser_input_t  *p_inputs;
+    unsigned           i_inputs;
+    atomic_uint        i_running;  /* inputs not over yet */
+
+    analyser_worker_t *p_workers;
+    unsigned           i_workers;
+    atomic_bool        b_exit;
+};
+
+enum
+{
+    INPUT_WAITING,
+    INPUT_RAN,
+    INPUT_OVER,
+};
+
+/*****************************************************************************
+ * Queues
+ *****************************************************************************/
+static void QueuePush( analyser_queue_t *p_queue, unsigned i_input,
+                       unsigned i_max )
+{
+    vlc_mutex_lock( &p_queue->lock );
+    p_queue->pi_inputs[( p_queue->i_first + p_queue->i_count++ ) % i_max] = i_input;
+    vlc_mutex_unlock( &p_queue->lock );
+}
+
+static bool QueuePop( analyser_queue_t *p_queue, unsigned *pi_input,
+                      unsigned i_max )
+{
+    bool b_found = false;
+
+    vlc_mutex_lock( &p_queue->lock );
+    if( p_queue->i_count > 0 )
+    {
+        *pi_input = p_queue->pi_inputs[p_queue->i_first];
+        p_queue->i_first = ( p_queue->i_first + 1 ) % i_max;
+        p_queue->i_count--;
+        b_found = true;
+    }
+    vlc_mutex_unlock( &p_queue->lock );
+    return b_found;
+}
+
+static bool QueueSteal( analyser_queue_t *p_queue, unsigned *pi_input,
+                        unsigned i_max )
+{
+    bool b_found = false;
+
+    vlc_mutex_lock( &p_queue->lock );
+    if( p_queue->i_count > 0 )
+    {
+        p_queue->i_count--;
+        *pi_input = p_queue->pi_inputs[( p_queue->i_first + p_queue->i_count ) % i_max];
+        b_found = true;
+    }
+    vlc_mutex_unlock( &p_queue->lock );
+    return b_found;
+}
+
+/*****************************************************************************
+ * Inputs
+ *****************************************************************************/
+static es_out_id_t *EsOutAdd( es_out_t *out, const es_format_t *p_fmt )
+{
+    VLC_UNUSED(out); VLC_UNUSED(p_fmt);
+    return NULL;
+}
+
+static int EsOutSend( es_out_t *out, es_out_id_t *id, block_t *p_block )
+{
+    VLC_UNUSED(out); VLC_UNUSED(id);
+    block_Release( p_block );
+    return VLC_SUCCESS;
+}
+
+static void EsOutDel( es_out_t *out, es_out_id_t *id )
+{
+    VLC_UNUSED(out); VLC_UNUSED(id);
+}
+
+static int EsOutControl( es_out_t *out, int i_query, va_list args )
+{
+    VLC_UNUSED(out); VLC_UNUSED(i_query); VLC_UNUSED(args);
+    return VLC_EGENERIC;
+}
+
+/* Whether reading a slab would not wait for the network */
+static bool InputIsReady( stream_t *p_stream )
+{
+    uint64_t i_size;
+    bool b_eof;
+
+    if( stream_Control( p_stream, STREAM_GET_BUFFERED, &i_size, &b_eof ) )
+        return true; /* cannot tell: let the read wait */
+    return b_eof || i_size >= ANALYSER_READY_SIZE;
+}
+
+static void InputClose( analyser_input_t *p_input )
+{
+    if( p_input->p_demux )
+        demux_Delete( p_input->p_demux );
+    if( p_input->p_stream )
+        stream_Delete( p_input->p_stream );
+    p_input->p_demux = NULL;
+    p_input->p_stream = NULL;
+}
+
+static int InputRun( intf_thread_t *p_intf, analyser_input_t *p_input )
+{
+    intf_sys_t *p_sys = p_intf->p_sys;
+
+    if( p_input->p_stream == NULL )
+    {
+        p_input->p_stream = stream_UrlNew( p_intf, p_input->psz_url );
+        if( p_input->p_stream == NULL )
+            return INPUT_OVER;
+    }
+
+    if( !InputIsReady( p_input->p_stream ) )
+        return INPUT_WAITING;
+
+    if( p_input->p_demux == NULL )
+    {
+        const char *psz_location = strstr( p_input->psz_url, "://" ) + 3;
+        p_input->p_demux = demux_New( VLC_OBJECT(p_intf), "ts", psz_location,
+                                      p_input->p_stream, &p_sys->out );
+        if( p_input->p_demux == NULL )
+        {
+            msg_Err( p_intf, "cannot analyse %s", p_input->psz_url );
+            return INPUT_OVER;
+        }
+    }
+
+    for( unsigned i = 0; i < ANALYSER_QUANTUM; i++ )
+    {
+        if( i > 0 && !InputIsReady( p_input->p_stream ) )
+            break;
+        if( demux_Demux( p_input->p_demux ) <= 0 )
+            return INPUT_OVER;
+    }
+    return INPUT_RAN;
+}
+
+/*****************************************************************************
+ * Workers
+ *****************************************************************************/
+static bool WorkerNext( analyser_worker_t *p_worker, unsigned *pi_input )
+{
+    intf_sys_t *p_sys = p_worker->p_intf->p_sys;
+
+    if( QueuePop( &p_worker->queue, pi_input, p_sys->i_inputs ) )
+        return true;
+
+    for( unsigned i = 1; i < p_sys->i_workers; i++ )
+    {
+        analyser_worker_t *p_victim =
+            &p_sys->p_workers[( p_worker->i_index + i ) % p_sys->i_workers];
+        if( QueueSteal( &p_victim->queue, pi_input, p_sys->i_inputs ) )
+            return true;
+    }
+    return false;
+}
+
+static void *WorkerThread( void *data )
+{
+    analyser_worker_t *p_worker = data;
+    intf_thread_t *p_intf = p_worker->p_intf;
+    intf_sys_t *p_sys = p_intf->p_sys;
+    unsigned i_waiting = 0;
+
+    vlc_interrupt_set( p_worker->p_interrupt );
+
+    while( !atomic_load( &p_sys->b_exit ) )
+    {
+        unsigned i_input;
+
+        /* Nothing ready anywhere for a whole round: let data come */
+        if( i_waiting >= p_sys->i_inputs || !WorkerNext( p_worker, &i_input ) )
+        {
+            i_waiting = 0;
+            vlc_mwait_i11e( mdate() + ANALYSER_POLL );
+            continue;
+        }
+
+        analyser_input_t *p_input = &p_sys->p_inputs[i_input];
+        switch( InputRun( p_intf, p_input ) )
+        {
+            case INPUT_WAITING:
+                i_waiting++;
+                QueuePush( &p_worker->queue, i_input, p_sys->i_inputs );
+                break;
+            case INPUT_RAN:
+                i_waiting = 0;
+                QueuePush( &p_worker->queue, i_input, p_sys->i_inputs );
+                break;
+            case INPUT_OVER:
+                msg_Dbg( p_intf, "%s analysed", p_input->psz_url );
+                InputClose( p_input );
+                if( atomic_fetch_sub( &p_sys->i_running, 1 ) == 1 )
+                    libvlc_Quit( p_intf->p_libvlc );
+                break;
+        }
+    }
+    return NULL;
+}
+
+/*****************************************************************************
+ * Open/Close
+ *****************************************************************************/
+/* One MRL or path per line, # starting comments */
+static int ReadInputs( intf_thread_t *p_intf, const char *psz_path )
+{
+    intf_sys_t *p_sys = p_intf->p_sys;
+
+    FILE *p_file = vlc_fopen( psz_path, "rt" );
+    if( p_file == NULL )
+    {
+        msg_Err( p_intf, "cannot read the inputs list %s: %s", psz_path,
+                 vlc_strerror_c(errno) );
+        return VLC_EGENERIC;
+    }
+
+    char *psz_line = NULL;
+    size_t i_line = 0;
+    while( getline( &psz_line, &i_line, p_file ) != -1 )
+    {
+        char *psz = psz_line;
+        while( isspace( (unsigned char)*psz ) )
+            psz++;
+        size_t i_len = strlen( psz );
+        while( i_len > 0 && isspace( (unsigned char)psz[i_len - 1] ) )
+            psz[--i_len] = '\0';
+        if( i_len == 0 || *psz == '#' )
+            continue;
+
+        analyser_input_t *p_inputs = realloc( p_sys->p_inputs,
+                                (p_sys->i_inputs + 1) * sizeof(*p_inputs) );
+        if( unlikely(p_inputs == NULL) )
+            break;
+        p_sys->p_inputs = p_inputs;
+
+        analyser_input_t *p_input = &p_inputs[p_sys->i_inputs];
+        p_input->psz_url = strstr( psz, "://" ) ? strdup( psz )
+                                                : vlc_path2uri( psz, NULL );
+        p_input->p_stream = NULL;
+        p_input->p_demux = NULL;
+        if( p_input->psz_url == NULL )
+        {
+            msg_Err( p_intf, "invalid input %s", psz );
+            continue;
+        }
+        p_sys->i_inputs++;
+    }
+    free( psz_line );
+    fclose( p_file );
+    return VLC_SUCCESS;
+}
+
+int AnalyserOpen( vlc_object_t *p_this )
+{
+    intf_thread_t *p_intf = (intf_thread_t *)p_this;
+
+    char *psz_list = var_InheritString( p_intf, "ts-analyser-inputs" );
+    if( psz_list == NULL )
+    {
+        msg_Err( p_intf, "no inputs list to analyse (ts-analyser-inputs)" );
+        return VLC_EGENERIC;
+    }
+
+    char *psz_format = var_InheritString( p_intf, "ts-analyser-output" );
+    const ts_output_format_t format = ts_output_ParseFormat( psz_format );
+    free( psz_format );
+    if( format == TS_OUTPUT_NONE )
+    {
+        msg_Err( p_intf, "the analyser needs an output (ts-analyser-output)" );
+        free( psz_list );
+        return VLC_EGENERIC;
+    }
+
+    intf_sys_t *p_sys = calloc( 1, sizeof(*p_sys) );
+    if( unlikely(p_sys == NULL) )
+    {
+        free( psz_list );
+        return VLC_ENOMEM;
+    }
+    p_intf->p_sys = p_sys;
+
+    int i_ret = ReadInputs( p_intf, psz_list );
+    free( psz_list );
+    if( i_ret != VLC_SUCCESS || p_sys->i_inputs == 0 )
+    {
+        msg_Err( p_intf, "no inputs to analyse" );
+        goto error;
+    }
+
+    char *psz_file = var_InheritString( p_intf, "ts-analyser-file" );
+    p_sys->p_output = ts_output_New( p_this, format, psz_file );
+    free( psz_file );
+    if( p_sys->p_output == NULL )
+        goto error;
+
+    p_sys->out.pf_add = EsOutAdd;
+    p_sys->out.pf_send = EsOutSend;
+    p_sys->out.pf_del = EsOutDel;
+    p_sys->out.pf_control = EsOutControl;
+    p_sys->out.pf_destroy = NULL;
+    p_sys->out.p_sys = NULL;
+
+    /* Inherited by the demuxers */
+    var_Create( p_intf, "ts-analyse-only", VLC_VAR_BOOL );
+    var_SetBool( p_intf, "ts-analyse-only", true );
+    var_Create( p_intf, "ts-analyser-shared", VLC_VAR_ADDRESS );
+    var_SetAddress( p_intf, "ts-analyser-shared", p_sys->p_output );
+
+    unsigned i_workers = var_InheritInteger( p_intf, "ts-analyser-workers" );
+    if( i_workers == 0 )
+        i_workers = vlc_GetCPUCount();
+    i_workers = __MIN( i_workers, p_sys->i_inputs );
+
+    p_sys->p_workers = calloc( i_workers, sizeof(*p_sys->p_workers) );
+    if( unlikely(p_sys->p_workers == NULL) )
+        goto error;
+    atomic_init( &p_sys->i_running, p_sys->i_inputs );
+    atomic_init( &p_sys->b_exit, false );
+
+    for( unsigned i = 0; i < i_workers; i++ )
+    {
+        analyser_worker_t *p_worker = &p_sys->p_workers[i];
+        p_worker->p_intf = p_intf;
+        p_worker->i_index = i;
+        p_worker->p_interrupt = vlc_interrupt_create();
+        p_worker->queue.pi_inputs = malloc( p_sys->i_inputs *
+                                            sizeof(*p_worker->queue.pi_inputs) );
+        if( unlikely(p_worker->p_interrupt == NULL ||
+                     p_worker->queue.pi_inputs == NULL) )
+        {
+            if( p_worker->p_interrupt )
+                vlc_interrupt_destroy( p_worker->p_interrupt );
+            free( p_worker->queue.pi_inputs );
+            break;
+        }
+        vlc_mutex_init( &p_worker->queue.lock );
+        p_worker->queue.i_first = 0;
+        p_worker->queue.i_count = 0;
+        p_sys->i_workers++;
+    }
+    if( p_sys->i_workers == 0 )
+        goto error;
+
+    /* Spread the inputs, the stealing balances them afterwards */
+    for( unsigned i = 0; i < p_sys->i_inputs; i++ )
+        QueuePush( &p_sys->p_workers[i % p_sys->i_workers].queue, i,
+                   p_sys->i_inputs );
+
+    for( unsigned i = 0; i < p_sys->i_workers; i++ )
+    {
+        analyser_worker_t *p_worker = &p_sys->p_workers[i];
+        /* Otherwise the inputs of its queue go to the running workers */
+        p_worker->b_started = !vlc_clone( &p_worker->thread, WorkerThread,
+                                          p_worker, VLC_THREAD_PRIORITY_INPUT );
+        if( !p_worker->b_started )
+            msg_Err( p_intf, "cannot start analyser worker %u", i );
+    }
+
+    msg_Dbg( p_intf, "analysing %u inputs with %u workers", p_sys->i_inputs,
+             p_sys->i_workers );
+    return VLC_SUCCESS;
+
+error:
+    AnalyserClose( p_this );
+    return VLC_EGENERIC;
+}
+
+void AnalyserClose( vlc_object_t *p_this )
+{
+    intf_thread_t *p_intf = (intf_thread_t *)p_this;
+    intf_sys_t *p_sys = p_intf->p_sys;
+
+    atomic_store( &p_sys->b_exit, true );
+    for( unsigned i = 0; i < p_sys->i_workers; i++ )
+        vlc_interrupt_kill( p_sys->p_workers[i].p_interrupt );
+    for( unsigned i = 0; i < p_sys->i_workers; i++ )
+    {
+        analyser_worker_t *p_worker = &p_sys->p_workers[i];
+        if( p_worker->b_started )
+            vlc_join( p_worker->thread, NULL );
+        vlc_interrupt_destroy( p_worker->p_interrupt );
+        vlc_mutex_destroy( &p_worker->queue.lock );
+        free( p_worker->queue.pi_inputs );
+    }
+    free( p_sys->p_workers );
+
+    /* The demuxers write their last records before the output goes */
+    for( unsigned i = 0; i < p_sys->i_inputs; i++ )
+    {
+        InputClose( &p_sys->p_inputs[i] );
+        free( p_sys->p_inputs[i].psz_url );
+    }
+    free( p_sys->p_inputs );
+
+    if( p_sys->p_output )
+        ts_output_Delete( p_sys->p_output );
+    var_Destroy( p_intf, "ts-analyser-shared" );
+    var_Destroy( p_intf, "ts-analyse-only" );
+    free( p_sys );
+}
@@ -0,0 +1,34 @@
+/*****************************************************************************
+ * ts_analyser.h: MPEG-TS analysis of many inputs in one process
+ *****************************************************************************
+ * Copyright (C) 2004-2015 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifndef VLC_TS_ANALYSER_H
+#define VLC_TS_ANALYSER_H
+
+/* Interface reading the inputs listed in the ts-analyser-inputs file, each
+ * with its own access and ts demuxer in analysis only mode, all of them
+ * demultiplexed by a fixed pool of ts-analyser-workers threads.
+ *
+ * Each worker runs the inputs of its queue in turn, for as long as they
+ * have a slab of data ready, and steals from the queues of the others
+ * once its own has nothing to run. The records of all the demuxers are
+ * merged into the one analyser output, with the input they come from. */
+int  AnalyserOpen( vlc_object_t * );
+void AnalyserClose( vlc_object_t * );
+
+#endif
@@ -0,0 +1,259 @@
+/*****************************************************************************
+ * ts_eit.c: MPEG-TS EIT section repetition filter
+ *****************************************************************************
+ * Copyright (C) 2004-2015 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/*****************************************************************************
+ * Preamble
+ *****************************************************************************/
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <vlc_common.h>
+
+#include "ts_section.h"
+#include "ts_eit.h"
+
+#define EIT_HEADER_SIZE   14
+#define CACHE_MIN_BITS    10
+
+/* Open addressing hash table of section keys, with the version seen */
+typedef struct
+{
+    uint64_t *p_keys;
+    uint8_t  *p_versions;  /* 0 for a free slot, else 0x80 | version */
+    unsigned  i_bits;
+    size_t    i_count;
+} eit_cache_t;
+
+struct ts_eit_filter_t
+{
+    ts_section_t section;
+    eit_cache_t  cache;
+    uint8_t      i_cc;
+    bool         b_other;
+    uint64_t     i_new;
+    uint64_t     i_dropped;
+
+    /* Current Push() call */
+    ts_eit_packet_cb pf_packet;
+    void            *p_cb_data;
+};
+
+static inline size_t CacheSlot( uint64_t i_key, unsigned i_bits )
+{
+    return ( i_key * UINT64_C(0x9e3779b97f4a7c15) ) >> ( 64 - i_bits );
+}
+
+static bool CacheInit( eit_cache_t *c, unsigned i_bits )
+{
+    c->p_keys = malloc( sizeof(*c->p_keys) << i_bits );
+    c->p_versions = calloc( (size_t)1 << i_bits, sizeof(*c->p_versions) );
+    if( !c->p_keys || !c->p_versions )
+    {
+        free( c->p_keys );
+        free( c->p_versions );
+        return false;
+    }
+    c->i_bits = i_bits;
+    c->i_count = 0;
+    return true;
+}
+
+static void CacheClean( eit_cache_t *c )
+{
+    free( c->p_keys );
+    free( c->p_versions );
+}
+
+/* Returns the slot of the key, or the free slot where it belongs */
+static size_t CacheFind( const eit_cache_t *c, uint64_t i_key )
+{
+    const size_t i_mask = ( (size_t)1 << c->i_bits ) - 1;
+    size_t i = CacheSlot( i_key, c->i_bits );
+
+    while( c->p_versions[i] && c->p_keys[i] != i_key )
+        i = ( i + 1 ) & i_mask;
+    return i;
+}
+
+static void CacheGrow( eit_cache_t *c )
+{
+    eit_cache_t grown;
+    if( !CacheInit( &grown, c->i_bits + 1 ) )
+        return; /* keep going, fuller */
+
+    for( size_t i = 0; i < ( (size_t)1 << c->i_bits ); i++ )
+    {
+        if( !c->p_versions[i] )
+            continue;
+        const size_t j = CacheFind( &grown, c->p_keys[i] );
+        grown.p_keys[j] = c->p_keys[i];
+        grown.p_versions[j] = c->p_versions[i];
+        grown.i_count++;
+    }
+    CacheClean( c );
+    *c = grown;
+}
+
+/* Returns true if the key was not stored with that version yet */
+static bool CacheUpdate( eit_cache_t *c, uint64_t i_key, uint8_t i_version )
+{
+    size_t i = CacheFind( c, i_key );
+
+    if( c->p_versions[i] == ( 0x80 | i_version ) )
+        return false;
+    if( !c->p_versions[i] )
+    {
+        /* Keep one slot free at least for the lookups to end */
+        if( c->i_count + 1 >= ( (size_t)1 << c->i_bits ) )
+            return true;
+        c->i_count++;
+        c->p_keys[i] = i_key;
+    }
+    c->p_versions[i] = 0x80 | i_version;
+
+    if( c->i_count > ( (size_t)3 << c->i_bits ) / 4 )
+        CacheGrow( c );
+    return true;
+}
+
+/* Sends the section in as many packets as needed, stuffed with 0xff */
+static void Packetize( ts_eit_filter_t *f, uint16_t i_pid,
+                       const uint8_t *p, size_t i )
+{
+    bool b_first = true;
+
+    while( i > 0 )
+    {
+        uint8_t pkt[188];
+        size_t i_header = 4;
+
+        pkt[0] = 0x47;
+        pkt[1] = ( b_first ? 0x40 : 0x00 ) | ( i_pid >> 8 );
+        pkt[2] = i_pid & 0xff;
+        pkt[3] = 0x10 | f->i_cc;
+        f->i_cc = ( f->i_cc + 1 ) & 0x0f;
+        if( b_first )
+            pkt[i_header++] = 0; /* pointer_field */
+
+        const size_t i_copy = __MIN( i, 188 - i_header );
+        memcpy( &pkt[i_header], p, i_copy );
+        memset( &pkt[i_header + i_copy], 0xff, 188 - i_header - i_copy );
+        p += i_copy;
+        i -= i_copy;
+        b_first = false;
+
+        f->pf_packet( f->p_cb_data, pkt );
+    }
+}
+
+static void SectionDone( void *p_cb_data, uint16_t i_pid,
+                         const uint8_t *p, size_t i )
+{
+    ts_eit_filter_t *f = p_cb_data;
+
+    /* Only complete and valid sections can be remembered, the decoder
+     * would reject the others anyway */
+    if( i < EIT_HEADER_SIZE + 4 || !(p[1] & 0x80) )
+        return;
+
+    /* Other transport streams, usually most of the pid, not even checked */
+    if( !f->b_other && ( p[0] == 0x4f || p[0] >= 0x60 ) )
+    {
+        f->i_dropped++;
+        return;
+    }
+
+    if( ts_section_CRC( p, i ) != 0 )
+        return;
+
+    /* Next tables are ignored by the decoder */
+    if( !(p[5] & 0x01) )
+    {
+        f->i_dropped++;
+        return;
+    }
+
+    const uint64_t i_key = ( (uint64_t)GetWBE( &p[10] ) << 48 ) | /* onid */
+                           ( (uint64_t)GetWBE( &p[8] ) << 32 ) |  /* tsid */
+                           ( (uint64_t)GetWBE( &p[3] ) << 16 ) |  /* sid */
+                           ( (uint64_t)p[0] << 8 ) | p[6];         /* table, section */
+    const uint8_t i_version = ( p[5] >> 1 ) & 0x1f;
+
+    if( !CacheUpdate( &f->cache, i_key, i_version ) )
+    {
+        f->i_dropped++;
+        return;
+    }
+    f->i_new++;
+    Packetize( f, i_pid, p, i );
+}
+
+ts_eit_filter_t *ts_eit_filter_New( bool b_other )
+{
+    ts_eit_filter_t *f = malloc( sizeof(*f) );
+    if( !f )
+        return NULL;
+
+    if( !CacheInit( &f->cache, CACHE_MIN_BITS ) )
+    {
+        free( f );
+        return NULL;
+    }
+    ts_section_Reset( &f->section );
+    f->i_cc = 0;
+    f->b_other = b_other;
+    f->i_new = 0;
+    f->i_dropped = 0;
+    return f;
+}
+
+void ts_eit_filter_Delete( ts_eit_filter_t *f )
+{
+    CacheClean( &f->cache );
+    free( f );
+}
+
+void ts_eit_filter_Push( ts_eit_filter_t *f, const uint8_t *p_pkt,
+                         ts_eit_packet_cb pf_packet, void *p_cb_data )
+{
+    /* Damaged, scrambled or without payload */
+    if( (p_pkt[1] & 0x80) || (p_pkt[3] & 0xc0) || !(p_pkt[3] & 0x10) )
+        return;
+
+    size_t i_offset = 4;
+    if( p_pkt[3] & 0x20 )
+        i_offset += 1 + p_pkt[4];
+    if( i_offset >= 188 )
+        return;
+
+    f->pf_packet = pf_packet;
+    f->p_cb_data = p_cb_data;
+    ts_section_Push( &f->section, ( (p_pkt[1] & 0x1f) << 8 ) | p_pkt[2],
+                     &p_pkt[i_offset], 188 - i_offset, p_pkt[1] & 0x40,
+                     SectionDone, f );
+}
+
+void ts_eit_filter_GetCounts( const ts_eit_filter_t *f, uint64_t *pi_new,
+                              uint64_t *pi_dropped )
+{
+    *pi_new = f->i_new;
+    *pi_dropped = f->i_dropped;
+}
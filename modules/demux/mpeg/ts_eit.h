@@ -0,0 +1,48 @@
+/*****************************************************************************
+ * ts_eit.h: MPEG-TS EIT section repetition filter
+ *****************************************************************************
+ * Copyright (C) 2004-2015 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifndef VLC_TS_EIT_H
+#define VLC_TS_EIT_H
+
+/* Drops the EIT sections that were already seen with the same version,
+ * keyed on original_network_id, transport_stream_id, service_id, table_id
+ * and section_number, from their header only. Carousels repeat the whole
+ * schedule every few seconds, so the table decoder, the descriptor decoding
+ * and the charset conversions then only see each section once per version.
+ *
+ * The sections that go through are packetized again on the same pid, with
+ * their own continuity counter, and handed over to pf_packet. */
+typedef struct ts_eit_filter_t ts_eit_filter_t;
+
+typedef void (*ts_eit_packet_cb)( void *p_cb_data, const uint8_t *p_pkt );
+
+/* Without b_other, the sections about the other transport streams
+ * (tables 0x4f and 0x60 to 0x6f) are dropped too */
+ts_eit_filter_t *ts_eit_filter_New( bool b_other );
+void ts_eit_filter_Delete( ts_eit_filter_t * );
+
+/* p_pkt is a whole 188 bytes packet */
+void ts_eit_filter_Push( ts_eit_filter_t *, const uint8_t *p_pkt,
+                         ts_eit_packet_cb pf_packet, void *p_cb_data );
+
+/* Number of sections handed over and dropped so far */
+void ts_eit_filter_GetCounts( const ts_eit_filter_t *, uint64_t *pi_new,
+                              uint64_t *pi_dropped );
+
+#endif
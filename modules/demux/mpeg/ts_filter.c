@@ -0,0 +1,343 @@
+/*****************************************************************************
+ * ts_filter.c: MPEG-TS software pid and section filter
+ *****************************************************************************
+ * Copyright (C) 2004-2015 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/*****************************************************************************
+ * Preamble
+ *****************************************************************************/
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <vlc_common.h>
+
+#include "ts_filter.h"
+
+#define TS_PACKET_SIZE 188
+
+typedef struct
+{
+    uint16_t i_pid;
+    uint8_t  i_table_id;
+    uint8_t  i_mask;
+    int      i_extension;   /* -1 for any */
+} ts_filter_section_t;
+
+/* Pids with section filters */
+typedef struct
+{
+    uint16_t i_pid;
+    uint16_t i_rules;
+    bool     b_keep;        /* the section in progress is passed */
+    bool     b_keep_prev;   /* b_keep before the last packet */
+    bool     b_last;        /* the last packet was passed */
+    bool     b_lost;        /* packets were lost since the last one passed */
+    uint8_t  i_cc_in;       /* last continuity counter read, 0xff if none */
+    uint8_t  i_cc_out;      /* last continuity counter written */
+} ts_filter_state_t;
+
+struct ts_filter_t
+{
+    vlc_mutex_t lock;
+    bool        b_enabled;
+    uint32_t    pids[8192 / 32];
+
+    unsigned            i_sections;
+    ts_filter_section_t sections[TS_FILTER_SECTIONS];
+    unsigned            i_states;
+    ts_filter_state_t   states[TS_FILTER_SECTIONS];
+};
+
+static inline bool TestPID( const ts_filter_t *p_filter, uint16_t i_pid )
+{
+    return p_filter->pids[i_pid >> 5] & ( 1u << ( i_pid & 31 ) );
+}
+
+ts_filter_t *ts_filter_New( void )
+{
+    ts_filter_t *p_filter = calloc( 1, sizeof( *p_filter ) );
+    if( unlikely(p_filter == NULL) )
+        return NULL;
+    vlc_mutex_init( &p_filter->lock );
+    /* The PAT is always needed, to find the programs again */
+    p_filter->pids[0] = 1;
+    return p_filter;
+}
+
+void ts_filter_Delete( ts_filter_t *p_filter )
+{
+    vlc_mutex_destroy( &p_filter->lock );
+    free( p_filter );
+}
+
+void ts_filter_SetPID( ts_filter_t *p_filter, uint16_t i_pid, bool b_selected )
+{
+    i_pid &= 0x1fff;
+
+    vlc_mutex_lock( &p_filter->lock );
+    p_filter->b_enabled = true;
+    if( b_selected )
+        p_filter->pids[i_pid >> 5] |= 1u << ( i_pid & 31 );
+    else if( i_pid != 0 )
+        p_filter->pids[i_pid >> 5] &= ~( 1u << ( i_pid & 31 ) );
+    vlc_mutex_unlock( &p_filter->lock );
+}
+
+bool ts_filter_GetPID( ts_filter_t *p_filter, uint16_t i_pid )
+{
+    vlc_mutex_lock( &p_filter->lock );
+    const bool b_selected = !p_filter->b_enabled || TestPID( p_filter, i_pid & 0x1fff );
+    vlc_mutex_unlock( &p_filter->lock );
+    return b_selected;
+}
+
+static ts_filter_state_t *GetState( ts_filter_t *p_filter, uint16_t i_pid )
+{
+    for( unsigned i = 0; i < p_filter->i_states; i++ )
+        if( p_filter->states[i].i_pid == i_pid )
+            return &p_filter->states[i];
+    return NULL;
+}
+
+int ts_filter_SetSection( ts_filter_t *p_filter, uint16_t i_pid, uint8_t i_table_id,
+                          uint8_t i_mask, int i_extension, bool b_selected )
+{
+    ts_filter_state_t *p_st;
+    int i_ret = VLC_SUCCESS;
+
+    i_pid &= 0x1fff;
+    if( i_extension < 0 )
+        i_extension = -1;
+
+    vlc_mutex_lock( &p_filter->lock );
+    p_st = GetState( p_filter, i_pid );
+
+    unsigned i;
+    for( i = 0; i < p_filter->i_sections; i++ )
+    {
+        const ts_filter_section_t *p_sec = &p_filter->sections[i];
+        if( p_sec->i_pid == i_pid && p_sec->i_table_id == i_table_id &&
+            p_sec->i_mask == i_mask && p_sec->i_extension == i_extension )
+            break;
+    }
+
+    if( !b_selected )
+    {
+        if( i < p_filter->i_sections )
+        {
+            p_filter->sections[i] = p_filter->sections[--p_filter->i_sections];
+            /* Without any filter left, all the sections are passed again */
+            if( --p_st->i_rules == 0 )
+                *p_st = p_filter->states[--p_filter->i_states];
+        }
+    }
+    else if( i == p_filter->i_sections )
+    {
+        if( p_filter->i_sections >= TS_FILTER_SECTIONS )
+            i_ret = VLC_ENOMEM;
+        else
+        {
+            if( p_st == NULL )
+            {
+                p_st = &p_filter->states[p_filter->i_states++];
+                p_st->i_pid = i_pid;
+                p_st->i_rules = 0;
+                p_st->b_keep = false;
+                p_st->b_keep_prev = false;
+                p_st->b_last = false;
+                p_st->b_lost = false;
+                p_st->i_cc_in = 0xff;
+                p_st->i_cc_out = 0xff;
+            }
+            p_st->i_rules++;
+
+            ts_filter_section_t *p_sec = &p_filter->sections[p_filter->i_sections++];
+            p_sec->i_pid = i_pid;
+            p_sec->i_table_id = i_table_id;
+            p_sec->i_mask = i_mask;
+            p_sec->i_extension = i_extension;
+        }
+    }
+    vlc_mutex_unlock( &p_filter->lock );
+    return i_ret;
+}
+
+static bool MatchSection( const ts_filter_t *p_filter, uint16_t i_pid,
+                          uint8_t i_table_id, int i_extension )
+{
+    for( unsigned i = 0; i < p_filter->i_sections; i++ )
+    {
+        const ts_filter_section_t *p_sec = &p_filter->sections[i];
+        if( p_sec->i_pid == i_pid &&
+            ( ( i_table_id ^ p_sec->i_table_id ) & p_sec->i_mask ) == 0 &&
+            ( p_sec->i_extension < 0 || p_sec->i_extension == i_extension ) )
+            return true;
+    }
+    return false;
+}
+
+/* Walks the sections starting in a packet, and tells whether any part of
+ * the packet is wanted. An unwanted section continuing in the next packets
+ * is overwritten with stuffing when the packet is passed anyway. */
+static bool FilterUnitStart( const ts_filter_t *p_filter, ts_filter_state_t *p_st,
+                             uint8_t *p )
+{
+    size_t i = 4;
+
+    if( p[3] & 0x20 )
+        i += 1 + p[4];
+    if( i >= TS_PACKET_SIZE || i + 1 + p[i] > TS_PACKET_SIZE )
+    {
+        /* Broken: leave it to the demuxer */
+        p_st->b_keep = true;
+        return true;
+    }
+
+    /* The tail of the section in progress */
+    bool b_pass = p_st->b_keep && p[i] > 0;
+    i += 1 + p[i];
+    p_st->b_keep = false;
+
+    while( i < TS_PACKET_SIZE && p[i] != 0xff )
+    {
+        if( i + 3 > TS_PACKET_SIZE ||
+            ( ( p[i + 1] & 0x80 ) && i + 5 > TS_PACKET_SIZE ) )
+        {
+            /* The header is cut: nothing is known of the section */
+            p_st->b_keep = true;
+            return true;
+        }
+
+        const int i_extension = ( p[i + 1] & 0x80 ) ? GetWBE( &p[i + 3] ) : -1;
+        const bool b_match = MatchSection( p_filter, p_st->i_pid, p[i],
+                                           i_extension );
+        const size_t i_end = i + 3 + ( GetWBE( &p[i + 1] ) & 0xfff );
+
+        if( i_end > TS_PACKET_SIZE )
+        {
+            /* Continued in the next packets */
+            p_st->b_keep = b_match;
+            if( b_match )
+                return true;
+            if( b_pass )
+                memset( &p[i], 0xff, TS_PACKET_SIZE - i );
+            return b_pass;
+        }
+        b_pass |= b_match;
+        i = i_end;
+    }
+    return b_pass;
+}
+
+static bool FilterSections( ts_filter_t *p_filter, ts_filter_state_t *p_st,
+                            uint8_t *p )
+{
+    const uint8_t i_cc = p[3] & 0x0f;
+
+    /* Without payload, the counter does not increase */
+    if( !( p[3] & 0x10 ) )
+    {
+        if( p_st->i_cc_out != 0xff )
+            p[3] = ( p[3] & 0xf0 ) | p_st->i_cc_out;
+        return true;
+    }
+
+    /* Duplicate packets share the fate, and the stuffing, of the original */
+    if( i_cc == p_st->i_cc_in )
+    {
+        if( !p_st->b_last )
+            return false;
+        if( ( p[1] & 0xc0 ) == 0x40 )
+        {
+            p_st->b_keep = p_st->b_keep_prev;
+            FilterUnitStart( p_filter, p_st, p );
+        }
+        p[3] = ( p[3] & 0xf0 ) | p_st->i_cc_out;
+        return true;
+    }
+
+    if( p_st->i_cc_in != 0xff && i_cc != ( ( p_st->i_cc_in + 1 ) & 0x0f ) )
+        p_st->b_lost = true;
+    p_st->i_cc_in = i_cc;
+    p_st->b_keep_prev = p_st->b_keep;
+
+    bool b_keep;
+    if( p[1] & 0x80 )
+        b_keep = true;  /* transport error: leave it to the demuxer */
+    else if( p[1] & 0x40 )
+        b_keep = FilterUnitStart( p_filter, p_st, p );
+    else
+        b_keep = p_st->b_keep;
+
+    p_st->b_last = b_keep;
+    if( !b_keep )
+        return false;
+
+    /* Renumber the packets passed, keeping the losses visible */
+    if( p_st->i_cc_out == 0xff )
+        p_st->i_cc_out = i_cc;
+    else
+        p_st->i_cc_out = ( p_st->i_cc_out + ( p_st->b_lost ? 2 : 1 ) ) & 0x0f;
+    p_st->b_lost = false;
+    p[3] = ( p[3] & 0xf0 ) | p_st->i_cc_out;
+    return true;
+}
+
+size_t ts_filter_Packets( ts_filter_t *p_filter, uint8_t *p_buf, size_t i_size,
+                          size_t i_packet_size, unsigned i_header,
+                          size_t *pi_read )
+{
+    size_t i_in = 0, i_out = 0;
+
+    vlc_mutex_lock( &p_filter->lock );
+    if( !p_filter->b_enabled )
+    {
+        vlc_mutex_unlock( &p_filter->lock );
+        i_in = i_size - i_size % i_packet_size;
+        *pi_read = i_in;
+        return i_in;
+    }
+
+    for( ; i_in + i_packet_size <= i_size; i_in += i_packet_size )
+    {
+        uint8_t *p = &p_buf[i_in + i_header];
+        if( p[0] != 0x47 )
+            break;
+
+        const uint16_t i_pid = ( ( p[1] & 0x1f ) << 8 ) | p[2];
+        if( !TestPID( p_filter, i_pid ) )
+            continue;
+
+        /* Scrambled sections cannot be parsed */
+        if( p_filter->i_states > 0 && !( p[3] & 0xc0 ) )
+        {
+            ts_filter_state_t *p_st = GetState( p_filter, i_pid );
+            if( p_st != NULL && !FilterSections( p_filter, p_st, p ) )
+                continue;
+        }
+
+        if( i_out != i_in )
+            memmove( &p_buf[i_out], &p_buf[i_in], i_packet_size );
+        i_out += i_packet_size;
+    }
+    vlc_mutex_unlock( &p_filter->lock );
+
+    *pi_read = i_in;
+    return i_out;
+}
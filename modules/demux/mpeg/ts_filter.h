@@ -0,0 +1,57 @@
+/*****************************************************************************
+ * ts_filter.h: MPEG-TS software pid and section filter
+ *****************************************************************************
+ * Copyright (C) 2004-2015 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifndef VLC_TS_FILTER_H
+#define VLC_TS_FILTER_H
+
+/* Section filters, for all the pids together */
+#define TS_FILTER_SECTIONS 16
+
+/* Drops the packets of the pids the demuxer did not select, as DVB
+ * hardware filters do, for the accesses without any. The pids are set
+ * from the demuxer thread, while the packets are filtered by the access
+ * thread. */
+typedef struct ts_filter_t ts_filter_t;
+
+ts_filter_t *ts_filter_New( void );
+void ts_filter_Delete( ts_filter_t * );
+
+/* Every packet is passed until a first pid is set. From then on, only the
+ * packets of the selected pids, and of the PAT, are. */
+void ts_filter_SetPID( ts_filter_t *, uint16_t i_pid, bool b_selected );
+bool ts_filter_GetPID( ts_filter_t *, uint16_t i_pid );
+
+/* Adds or removes a section filter. Once a pid has one, only the sections
+ * of the pid whose table_id matches i_table_id on the bits of i_mask, and
+ * whose table_id_extension is i_extension unless it is negative, are
+ * passed. Returns VLC_ENOMEM when all the section filters are used. */
+int ts_filter_SetSection( ts_filter_t *, uint16_t i_pid, uint8_t i_table_id,
+                          uint8_t i_mask, int i_extension, bool b_selected );
+
+/* Filters the whole packets at the start of p_buf, of i_packet_size bytes
+ * with the sync byte at i_header, up to the first packet out of sync, and
+ * moves the packets passed to the front. The size of the packets read is
+ * stored in *pi_read, and the size of those passed is returned.
+ * The continuity counters of the pids with section filters are rewritten,
+ * so that the sections dropped do not look like packet losses. */
+size_t ts_filter_Packets( ts_filter_t *, uint8_t *p_buf, size_t i_size,
+                          size_t i_packet_size, unsigned i_header,
+                          size_t *pi_read );
+
+#endif
@@ -0,0 +1,563 @@
+/*****************************************************************************
+ * ts_index.c: MPEG-TS seek index
+ *****************************************************************************
+ * Copyright (C) 2004-2015 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/*****************************************************************************
+ * Preamble
+ *****************************************************************************/
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <vlc_common.h>
+#include <vlc_atomic.h>
+#include <vlc_fs.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef HAVE_MMAP
+# include <sys/mman.h>
+#endif
+#include <unistd.h>
+
+#include "ts_index.h"
+#include "ts_sync.h"
+
+#define INDEX_PID_COUNT     8192
+#define INDEX_READ_PACKETS  4096
+#define INDEX_RAP_WINDOW    90000 /* how far back a random access point is looked for */
+#define INDEX_RAP           (UINT64_C(1) << 63) /* in the entry offset */
+#define PCR_WRAP            (INT64_C(1) << 33)
+
+/* Sidecar layout, in the byte order of the machine that wrote it (the
+ * version reads back wrong otherwise): the header, the pids, then the
+ * entries of every pid in a row */
+static const char psz_magic[8] = { 'V','L','C','T','S','I','D','X' };
+#define INDEX_VERSION       1
+
+typedef struct
+{
+    char     magic[8];
+    uint32_t i_version;
+    uint32_t i_packet_size;
+    uint64_t i_file_size;
+    int64_t  i_file_mtime;
+    uint32_t i_pids;
+    uint32_t i_reserved;
+} index_header_t;
+
+typedef struct
+{
+    uint16_t i_pid;
+    uint16_t i_reserved;
+    uint32_t i_count;
+    uint64_t i_first; /* entry number */
+} index_pid_header_t;
+
+typedef struct
+{
+    uint64_t i_offset; /* | INDEX_RAP */
+    int64_t  i_time;
+} index_entry_t;
+
+typedef struct
+{
+    uint16_t       i_pid;
+    size_t         i_count;
+    size_t         i_alloc;  /* 0 when mapped */
+    index_entry_t *p_entries;
+    /* Unwrapping */
+    int64_t        i_last_pcr;
+    int64_t        i_wrap;
+    /* Last PCR, even if too close to the last entry */
+    uint64_t       i_last_offset;
+    int64_t        i_last_time;
+} index_pid_t;
+
+struct ts_index_t
+{
+    unsigned     i_packet_size;
+    uint64_t     i_file_size;
+    int64_t      i_file_mtime;
+
+    index_pid_t *p_pids;
+    size_t       i_pids;
+    uint16_t    *pi_slot; /* INDEX_PID_COUNT, p_pids index + 1, only to build */
+
+    void        *p_map;
+    size_t       i_map;
+};
+
+ts_index_t *ts_index_New( unsigned i_packet_size )
+{
+    ts_index_t *p_index = calloc( 1, sizeof(*p_index) );
+    if( !p_index )
+        return NULL;
+    p_index->i_packet_size = i_packet_size;
+    return p_index;
+}
+
+void ts_index_Delete( ts_index_t *p_index )
+{
+    for( size_t i = 0; i < p_index->i_pids; i++ )
+        if( p_index->p_pids[i].i_alloc )
+            free( p_index->p_pids[i].p_entries );
+    free( p_index->p_pids );
+    free( p_index->pi_slot );
+#ifdef HAVE_MMAP
+    if( p_index->p_map )
+        munmap( p_index->p_map, p_index->i_map );
+#else
+    free( p_index->p_map );
+#endif
+    free( p_index );
+}
+
+static index_pid_t *AddPID( ts_index_t *p_index, uint16_t i_pid )
+{
+    if( !p_index->pi_slot )
+    {
+        p_index->pi_slot = calloc( INDEX_PID_COUNT, sizeof(*p_index->pi_slot) );
+        if( !p_index->pi_slot )
+            return NULL;
+    }
+    if( p_index->pi_slot[i_pid] )
+        return &p_index->p_pids[p_index->pi_slot[i_pid] - 1];
+
+    index_pid_t *p_pids = realloc( p_index->p_pids,
+                                   (p_index->i_pids + 1) * sizeof(*p_pids) );
+    if( !p_pids )
+        return NULL;
+    p_index->p_pids = p_pids;
+
+    index_pid_t *p = &p_pids[p_index->i_pids];
+    memset( p, 0, sizeof(*p) );
+    p->i_pid = i_pid;
+    p->i_last_pcr = -1;
+    p_index->pi_slot[i_pid] = ++p_index->i_pids;
+    return p;
+}
+
+static bool Append( index_pid_t *p, uint64_t i_offset, int64_t i_time,
+                    bool b_random_access )
+{
+    if( p->i_count == p->i_alloc )
+    {
+        const size_t i_alloc = p->i_alloc ? 2 * p->i_alloc : 1024;
+        index_entry_t *p_entries = realloc( p->p_entries,
+                                            i_alloc * sizeof(*p_entries) );
+        if( !p_entries )
+            return false;
+        p->p_entries = p_entries;
+        p->i_alloc = i_alloc;
+    }
+    p->p_entries[p->i_count].i_offset = i_offset | ( b_random_access ? INDEX_RAP : 0 );
+    p->p_entries[p->i_count].i_time = i_time;
+    p->i_count++;
+    return true;
+}
+
+bool ts_index_Add( ts_index_t *p_index, uint16_t i_pid, uint64_t i_offset,
+                   int64_t i_pcr, bool b_random_access )
+{
+    index_pid_t *p = AddPID( p_index, i_pid & 0x1fff );
+    if( !p )
+        return false;
+
+    /* Going back by more than half the range is a wrap around */
+    if( p->i_last_pcr >= 0 && i_pcr < p->i_last_pcr - PCR_WRAP / 2 )
+        p->i_wrap += PCR_WRAP;
+    p->i_last_pcr = i_pcr;
+    const int64_t i_time = i_pcr + p->i_wrap;
+
+    if( p->i_count > 0 )
+    {
+        /* Only increasing times can be looked up */
+        const index_entry_t *p_last = &p->p_entries[p->i_count - 1];
+        if( i_time <= p_last->i_time )
+            return true;
+        p->i_last_offset = i_offset;
+        p->i_last_time = i_time;
+        if( !b_random_access && i_time - p_last->i_time < TS_INDEX_INTERVAL )
+            return true;
+    }
+    return Append( p, i_offset, i_time, b_random_access );
+}
+
+/*****************************************************************************
+ * Build
+ *****************************************************************************/
+static bool IndexPackets( ts_index_t *p_index, const uint8_t *p_buf, size_t i_size,
+                          uint64_t i_offset, unsigned i_header_size, size_t *pi_used )
+{
+    const unsigned i_packet_size = p_index->i_packet_size;
+    size_t i = 0;
+
+    while( i + i_packet_size <= i_size )
+    {
+        const uint8_t *p = &p_buf[i + i_header_size];
+        if( p[0] != 0x47 )
+        {
+            /* Resync on two sync bytes one packet apart */
+            const size_t i_scan = i_size - i - i_header_size;
+            const size_t i_skip = ts_sync_Find( p, i_scan, i_packet_size, 2 );
+            i += i_skip;
+            if( i_skip < ts_sync_Candidates( i_scan, i_packet_size, 2 ) )
+                continue;
+            break;
+        }
+
+        /* Not corrupt, with a PCR */
+        if( !(p[1] & 0x80) && (p[3] & 0x20) && p[4] >= 7 && (p[5] & 0x10) )
+        {
+            const int64_t i_pcr = ( (int64_t)p[6] << 25 ) | ( p[7] << 17 ) |
+                                  ( p[8] << 9 ) | ( p[9] << 1 ) | ( p[10] >> 7 );
+            if( !ts_index_Add( p_index, ( (p[1] & 0x1f) << 8 ) | p[2],
+                               i_offset + i, i_pcr, p[5] & 0x40 ) )
+                return false;
+        }
+        i += i_packet_size;
+    }
+    *pi_used = i;
+    return true;
+}
+
+ts_index_t *ts_index_Build( vlc_object_t *p_obj, const char *psz_path,
+                            unsigned i_packet_size, unsigned i_header_size,
+                            atomic_bool *pb_stop )
+{
+    int fd = vlc_open( psz_path, O_RDONLY );
+    if( fd == -1 )
+        return NULL;
+
+    struct stat st;
+    if( fstat( fd, &st ) || !S_ISREG( st.st_mode ) )
+    {
+        close( fd );
+        return NULL;
+    }
+
+    const size_t i_buf = INDEX_READ_PACKETS * i_packet_size;
+    uint8_t *p_buf = malloc( i_buf );
+    ts_index_t *p_index = ts_index_New( i_packet_size );
+    if( !p_buf || !p_index )
+        goto error;
+    p_index->i_file_size = st.st_size;
+    p_index->i_file_mtime = st.st_mtime;
+
+    /* The file may grow while it is read: only its size at start counts */
+    uint64_t i_offset = 0;
+    size_t i_left = 0;
+    while( i_offset + i_left < p_index->i_file_size )
+    {
+        if( atomic_load( pb_stop ) )
+            goto error;
+
+        const size_t i_want = __MIN( i_buf - i_left,
+                                     p_index->i_file_size - i_offset - i_left );
+        const ssize_t i_read = read( fd, &p_buf[i_left], i_want );
+        if( i_read < 0 && errno == EINTR )
+            continue;
+        if( i_read <= 0 )
+        {
+            msg_Dbg( p_obj, "cannot index %s: %s", psz_path,
+                     i_read ? vlc_strerror_c(errno) : "truncated" );
+            goto error;
+        }
+
+        const size_t i_size = i_left + i_read;
+        size_t i_used;
+        if( !IndexPackets( p_index, p_buf, i_size, i_offset, i_header_size, &i_used ) )
+            goto error;
+
+        /* Keep the incomplete packet, or the bytes still to resync on */
+        if( i_used == 0 && i_size == i_buf )
+            i_used = i_size - i_packet_size;
+        i_left = i_size - i_used;
+        memmove( p_buf, &p_buf[i_used], i_left );
+        i_offset += i_used;
+    }
+
+    /* The last PCR too, for the duration */
+    for( size_t i = 0; i < p_index->i_pids; i++ )
+    {
+        index_pid_t *p = &p_index->p_pids[i];
+        if( p->i_count > 0 && p->i_last_time > p->p_entries[p->i_count - 1].i_time &&
+            !Append( p, p->i_last_offset, p->i_last_time, false ) )
+            goto error;
+    }
+
+    free( p_buf );
+    close( fd );
+    free( p_index->pi_slot );
+    p_index->pi_slot = NULL;
+    return p_index;
+
+error:
+    if( p_index )
+        ts_index_Delete( p_index );
+    free( p_buf );
+    close( fd );
+    return NULL;
+}
+
+/*****************************************************************************
+ * Sidecar
+ *****************************************************************************/
+static char *SidecarPath( const char *psz_path )
+{
+    char *psz_sidecar;
+    if( asprintf( &psz_sidecar, "%s"TS_INDEX_SUFFIX, psz_path ) == -1 )
+        return NULL;
+    return psz_sidecar;
+}
+
+static bool WriteAll( int fd, const void *p_data, size_t i_size )
+{
+    const uint8_t *p = p_data;
+    while( i_size > 0 )
+    {
+        const ssize_t i_written = write( fd, p, i_size );
+        if( i_written < 0 && errno == EINTR )
+            continue;
+        if( i_written <= 0 )
+            return false;
+        p += i_written;
+        i_size -= i_written;
+    }
+    return true;
+}
+
+int ts_index_Save( vlc_object_t *p_obj, const ts_index_t *p_index,
+                   const char *psz_path )
+{
+    char *psz_sidecar = SidecarPath( psz_path );
+    char *psz_temp = NULL;
+    if( !psz_sidecar || asprintf( &psz_temp, "%s.part", psz_sidecar ) == -1 )
+    {
+        free( psz_sidecar );
+        return VLC_ENOMEM;
+    }
+
+    /* Written aside then renamed, a reader never sees half a file */
+    int fd = vlc_open( psz_temp, O_WRONLY | O_CREAT | O_TRUNC, 0666 );
+    if( fd == -1 )
+    {
+        msg_Dbg( p_obj, "cannot create %s: %s", psz_temp, vlc_strerror_c(errno) );
+        free( psz_temp );
+        free( psz_sidecar );
+        return VLC_EGENERIC;
+    }
+
+    index_header_t hdr = {
+        .i_version = INDEX_VERSION,
+        .i_packet_size = p_index->i_packet_size,
+        .i_file_size = p_index->i_file_size,
+        .i_file_mtime = p_index->i_file_mtime,
+        .i_pids = p_index->i_pids,
+    };
+    memcpy( hdr.magic, psz_magic, sizeof(hdr.magic) );
+    bool b_ok = WriteAll( fd, &hdr, sizeof(hdr) );
+
+    uint64_t i_first = 0;
+    for( size_t i = 0; i < p_index->i_pids && b_ok; i++ )
+    {
+        const index_pid_header_t pid = {
+            .i_pid = p_index->p_pids[i].i_pid,
+            .i_count = p_index->p_pids[i].i_count,
+            .i_first = i_first,
+        };
+        b_ok = WriteAll( fd, &pid, sizeof(pid) );
+        i_first += pid.i_count;
+    }
+    for( size_t i = 0; i < p_index->i_pids && b_ok; i++ )
+        b_ok = WriteAll( fd, p_index->p_pids[i].p_entries,
+                         p_index->p_pids[i].i_count * sizeof(index_entry_t) );
+
+    if( close( fd ) )
+        b_ok = false;
+    if( b_ok && vlc_rename( psz_temp, psz_sidecar ) )
+        b_ok = false;
+    if( !b_ok )
+    {
+        msg_Dbg( p_obj, "cannot write %s: %s", psz_sidecar, vlc_strerror_c(errno) );
+        vlc_unlink( psz_temp );
+    }
+    free( psz_temp );
+    free( psz_sidecar );
+    return b_ok ? VLC_SUCCESS : VLC_EGENERIC;
+}
+
+static void *MapFile( int fd, size_t i_size )
+{
+#ifdef HAVE_MMAP
+    void *p_map = mmap( NULL, i_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    return p_map != MAP_FAILED ? p_map : NULL;
+#else
+    uint8_t *p_map = malloc( i_size );
+    if( !p_map )
+        return NULL;
+    for( size_t i_done = 0; i_done < i_size; )
+    {
+        const ssize_t i_read = read( fd, &p_map[i_done], i_size - i_done );
+        if( i_read < 0 && errno == EINTR )
+            continue;
+        if( i_read <= 0 )
+        {
+            free( p_map );
+            return NULL;
+        }
+        i_done += i_read;
+    }
+    return p_map;
+#endif
+}
+
+ts_index_t *ts_index_Load( vlc_object_t *p_obj, const char *psz_path,
+                           unsigned i_packet_size )
+{
+    struct stat st;
+    if( vlc_stat( psz_path, &st ) )
+        return NULL;
+
+    char *psz_sidecar = SidecarPath( psz_path );
+    if( !psz_sidecar )
+        return NULL;
+    int fd = vlc_open( psz_sidecar, O_RDONLY );
+    free( psz_sidecar );
+    if( fd == -1 )
+        return NULL;
+
+    struct stat st_index;
+    ts_index_t *p_index = NULL;
+    if( fstat( fd, &st_index ) || (uint64_t)st_index.st_size < sizeof(index_header_t) ||
+        (uint64_t)st_index.st_size > SIZE_MAX ||
+        !( p_index = ts_index_New( i_packet_size ) ) )
+        goto error;
+
+    p_index->i_map = st_index.st_size;
+    p_index->p_map = MapFile( fd, p_index->i_map );
+    if( !p_index->p_map )
+        goto error;
+    close( fd );
+    fd = -1;
+
+    const index_header_t *p_hdr = p_index->p_map;
+    if( memcmp( p_hdr->magic, psz_magic, sizeof(psz_magic) ) ||
+        p_hdr->i_version != INDEX_VERSION ||
+        p_hdr->i_packet_size != i_packet_size )
+        goto error;
+    if( p_hdr->i_file_size != (uint64_t)st.st_size ||
+        p_hdr->i_file_mtime != (int64_t)st.st_mtime )
+    {
+        msg_Dbg( p_obj, "seek index of %s is out of date", psz_path );
+        goto error;
+    }
+
+    /* Everything must lie within the file */
+    if( p_hdr->i_pids > INDEX_PID_COUNT )
+        goto error;
+    const size_t i_pids_end = sizeof(*p_hdr) +
+                              p_hdr->i_pids * sizeof(index_pid_header_t);
+    if( i_pids_end > p_index->i_map )
+        goto error;
+    const size_t i_entries = ( p_index->i_map - i_pids_end ) / sizeof(index_entry_t);
+
+    p_index->p_pids = calloc( p_hdr->i_pids, sizeof(*p_index->p_pids) );
+    if( p_hdr->i_pids && !p_index->p_pids )
+        goto error;
+
+    const index_pid_header_t *p_pid = (const index_pid_header_t *)&p_hdr[1];
+    index_entry_t *p_entries = (index_entry_t *)&((uint8_t *)p_index->p_map)[i_pids_end];
+    for( size_t i = 0; i < p_hdr->i_pids; i++ )
+    {
+        if( p_pid[i].i_first > i_entries || p_pid[i].i_count > i_entries - p_pid[i].i_first )
+            goto error;
+        index_pid_t *p = &p_index->p_pids[i];
+        p->i_pid = p_pid[i].i_pid;
+        p->i_count = p_pid[i].i_count;
+        p->p_entries = &p_entries[p_pid[i].i_first];
+        p_index->i_pids++;
+    }
+    p_index->i_file_size = p_hdr->i_file_size;
+    p_index->i_file_mtime = p_hdr->i_file_mtime;
+    return p_index;
+
+error:
+    if( p_index )
+        ts_index_Delete( p_index );
+    if( fd != -1 )
+        close( fd );
+    return NULL;
+}
+
+/*****************************************************************************
+ * Lookups
+ *****************************************************************************/
+static const index_pid_t *FindPID( const ts_index_t *p_index, uint16_t i_pid )
+{
+    for( size_t i = 0; i < p_index->i_pids; i++ )
+        if( p_index->p_pids[i].i_pid == i_pid )
+            return p_index->p_pids[i].i_count ? &p_index->p_pids[i] : NULL;
+    return NULL;
+}
+
+bool ts_index_GetRange( const ts_index_t *p_index, uint16_t i_pid,
+                        int64_t *pi_first, int64_t *pi_last )
+{
+    const index_pid_t *p = FindPID( p_index, i_pid );
+    if( !p )
+        return false;
+    *pi_first = p->p_entries[0].i_time;
+    *pi_last = p->p_entries[p->i_count - 1].i_time;
+    return true;
+}
+
+bool ts_index_Find( const ts_index_t *p_index, uint16_t i_pid, int64_t i_time,
+                    uint64_t *pi_offset )
+{
+    const index_pid_t *p = FindPID( p_index, i_pid );
+    if( !p || i_time > p->p_entries[p->i_count - 1].i_time + TS_INDEX_INTERVAL )
+        return false;
+
+    /* Last entry at or before i_time, or the first one */
+    size_t i_low = 0, i_high = p->i_count;
+    while( i_high - i_low > 1 )
+    {
+        const size_t i_mid = i_low + ( i_high - i_low ) / 2;
+        if( p->p_entries[i_mid].i_time <= i_time )
+            i_low = i_mid;
+        else
+            i_high = i_mid;
+    }
+
+    for( size_t i = i_low + 1; i-- > 0 &&
+         i_time - p->p_entries[i].i_time <= INDEX_RAP_WINDOW; )
+    {
+        if( p->p_entries[i].i_offset & INDEX_RAP )
+        {
+            i_low = i;
+            break;
+        }
+    }
+    *pi_offset = p->p_entries[i_low].i_offset & ~INDEX_RAP;
+    return true;
+}
@@ -0,0 +1,63 @@
+/*****************************************************************************
+ * ts_index.h: MPEG-TS seek index
+ *****************************************************************************
+ * Copyright (C) 2004-2015 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifndef VLC_TS_INDEX_H
+#define VLC_TS_INDEX_H
+
+/* Byte offsets of the PCRs of a recording, per PCR pid, about every
+ * TS_INDEX_INTERVAL and at every random access point. Times are 90kHz PCR
+ * bases, unwrapped from the first one, so that they keep increasing.
+ *
+ * The index is built by reading the whole file, once, and saved beside it
+ * with TS_INDEX_SUFFIX appended to its name. The next opens map that file
+ * as long as the recording size and date still match. */
+#define TS_INDEX_SUFFIX     ".tsidx"
+#define TS_INDEX_INTERVAL   (90000 / 2)
+
+typedef struct ts_index_t ts_index_t;
+
+ts_index_t *ts_index_New( unsigned i_packet_size );
+void ts_index_Delete( ts_index_t * );
+
+/* Entries must come in file order. Returns false on allocation error */
+bool ts_index_Add( ts_index_t *, uint16_t i_pid, uint64_t i_offset,
+                   int64_t i_pcr, bool b_random_access );
+
+/* Reads the file from its start, i_header_size bytes before each sync
+ * byte. Returns NULL on error, or once *pb_stop is set */
+ts_index_t *ts_index_Build( vlc_object_t *, const char *psz_path,
+                            unsigned i_packet_size, unsigned i_header_size,
+                            atomic_bool *pb_stop );
+
+/* Sidecar file of the recording at psz_path */
+int ts_index_Save( vlc_object_t *, const ts_index_t *, const char *psz_path );
+ts_index_t *ts_index_Load( vlc_object_t *, const char *psz_path,
+                           unsigned i_packet_size );
+
+/* First and last time of the pid */
+bool ts_index_GetRange( const ts_index_t *, uint16_t i_pid,
+                        int64_t *pi_first, int64_t *pi_last );
+
+/* Offset to read from to reach i_time: the last random access point up to
+ * a second before it, or else the last entry before it. Returns false past
+ * the indexed range */
+bool ts_index_Find( const ts_index_t *, uint16_t i_pid, int64_t i_time,
+                    uint64_t *pi_offset );
+
+#endif
@@ -0,0 +1,660 @@
+/*****************************************************************************
+ * ts_monitor.c: MPEG-TS ETSI TR 101 290 monitor
+ *****************************************************************************
+ * Copyright (C) 2004-2015 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/*****************************************************************************
+ * Preamble
+ *****************************************************************************/
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <vlc_common.h>
+#include <vlc_demux.h>
+
+#include "ts_output.h"
+#include "ts_section.h"
+#include "ts_stats.h"
+#include "ts_monitor.h"
+
+#define MONITOR_PID_COUNT     8192
+#define PACKET_BITS           (188 * 8)
+
+/* Timers are checked every MONITOR_SWEEP_PACKETS, if MONITOR_SWEEP_PERIOD
+ * has elapsed since they were last */
+#define MONITOR_SWEEP_PACKETS 128
+#define MONITOR_SWEEP_PERIOD  (CLOCK_FREQ / 20)
+
+/* Repetition limits */
+#define PAT_INTERVAL          (CLOCK_FREQ / 2)
+#define PMT_INTERVAL          (CLOCK_FREQ / 2)
+#define PID_INTERVAL          (5 * CLOCK_FREQ) /* user specified in TR 101 290 */
+#define PTS_INTERVAL          (CLOCK_FREQ * 7 / 10)
+#define NIT_INTERVAL          (10 * CLOCK_FREQ)
+#define SDT_INTERVAL          (2 * CLOCK_FREQ)
+#define EIT_INTERVAL          (2 * CLOCK_FREQ)
+#define TDT_INTERVAL          (30 * CLOCK_FREQ)
+#define SI_MIN_INTERVAL       (CLOCK_FREQ / 40)
+#define UNREFERENCED_INTERVAL (CLOCK_FREQ / 2)
+
+typedef enum
+{
+    TS_SYNC_LOSS = 0,
+    SYNC_BYTE_ERROR,
+    PAT_ERROR,
+    CONTINUITY_COUNT_ERROR,
+    PMT_ERROR,
+    PID_ERROR,
+    TRANSPORT_ERROR,
+    CRC_ERROR,
+    PCR_REPETITION_ERROR,
+    PCR_DISCONTINUITY_ERROR,
+    PCR_ACCURACY_ERROR,
+    PTS_ERROR,
+    CAT_ERROR,
+    NIT_ERROR,
+    SI_REPETITION_ERROR,
+    UNREFERENCED_PID,
+    SDT_ERROR,
+    EIT_ERROR,
+    TDT_ERROR,
+    INDICATOR_COUNT
+} indicator_e;
+
+static const struct
+{
+    const char *psz_name;
+    uint8_t     i_priority;
+} indicators[INDICATOR_COUNT] =
+{
+    [TS_SYNC_LOSS]              = { "TS_sync_loss", 1 },
+    [SYNC_BYTE_ERROR]           = { "Sync_byte_error", 1 },
+    [PAT_ERROR]                 = { "PAT_error", 1 },
+    [CONTINUITY_COUNT_ERROR]    = { "Continuity_count_error", 1 },
+    [PMT_ERROR]                 = { "PMT_error", 1 },
+    [PID_ERROR]                 = { "PID_error", 1 },
+    [TRANSPORT_ERROR]           = { "Transport_error", 2 },
+    [CRC_ERROR]                 = { "CRC_error", 2 },
+    [PCR_REPETITION_ERROR]      = { "PCR_repetition_error", 2 },
+    [PCR_DISCONTINUITY_ERROR]   = { "PCR_discontinuity_indicator_error", 2 },
+    [PCR_ACCURACY_ERROR]        = { "PCR_accuracy_error", 2 },
+    [PTS_ERROR]                 = { "PTS_error", 2 },
+    [CAT_ERROR]                 = { "CAT_error", 2 },
+    [NIT_ERROR]                 = { "NIT_error", 3 },
+    [SI_REPETITION_ERROR]       = { "SI_repetition_error", 3 },
+    [UNREFERENCED_PID]          = { "Unreferenced_PID", 3 },
+    [SDT_ERROR]                 = { "SDT_error", 3 },
+    [EIT_ERROR]                 = { "EIT_error", 3 },
+    [TDT_ERROR]                 = { "TDT_error", 3 },
+};
+
+/* Pid roles */
+#define ROLE_PAT    0x01
+#define ROLE_CAT    0x02
+#define ROLE_PMT    0x04
+#define ROLE_NIT    0x08
+#define ROLE_SDT    0x10
+#define ROLE_EIT    0x20
+#define ROLE_TDT    0x40
+#define ROLE_ES     0x80 /* elementary stream or PCR of a program */
+#define ROLE_TABLES ( ROLE_PAT|ROLE_CAT|ROLE_PMT|ROLE_NIT|ROLE_SDT|ROLE_EIT|ROLE_TDT )
+
+/* Section repetition timer of a table pid */
+typedef struct
+{
+    mtime_t     i_limit;
+    uint8_t     i_indicator;
+    uint8_t     i_table_id;     /* the table timed on that pid */
+    bool        b_late;         /* alarm raised until the next section */
+    uint64_t    i_packet;       /* of the last section, or of the start */
+    /* Previous section, for the minimum repetition of SI */
+    uint16_t    i_last_key;     /* table_id_extension ^ section_number */
+    uint64_t    i_last_packet;
+} monitor_timer_t;
+
+typedef struct
+{
+    uint8_t     i_roles;
+    bool        b_listed;       /* in the sweep list */
+    bool        b_late;         /* PID_error or Unreferenced_PID raised */
+    bool        b_pts;          /* has carried a PTS */
+    bool        b_pts_late;
+    uint64_t    i_first_packet;
+    uint64_t    i_last_packet;  /* or of when it was referenced */
+    uint64_t    i_pts_packet;
+    ts_section_t    *p_section; /* table pids */
+    monitor_timer_t *p_timer;   /* timed table pids */
+} monitor_pid_t;
+
+struct ts_monitor_t
+{
+    vlc_object_t *p_obj;
+    ts_output_t  *p_out;
+
+    monitor_pid_t *p_pids;      /* MONITOR_PID_COUNT */
+    DECL_ARRAY( uint16_t ) listed; /* pids seen or referenced, in order */
+
+    uint64_t    i_packets;
+    uint64_t    i_sync_losses;
+    uint64_t    i_current;      /* packet being checked */
+    bool        b_scrambled;    /* scrambled packets seen */
+    bool        b_cat;          /* CAT seen */
+    bool        b_cat_late;
+    bool        b_pat;          /* PAT seen */
+
+    /* Clock: time of a packet, from the transport rate */
+    int         i_rate_pid;     /* PCR pid giving the rate, -1 for none */
+    uint64_t    i_rate;         /* bits per second */
+    mtime_t     i_time_base;
+    uint64_t    i_packet_base;
+    mtime_t     i_start_date;   /* to measure the reading rate */
+    mtime_t     i_sweep_time;
+
+    uint64_t    pi_counts[INDICATOR_COUNT];
+};
+
+/*****************************************************************************
+ * Clock
+ *****************************************************************************/
+static mtime_t PacketTime( const ts_monitor_t *m, uint64_t i_packet )
+{
+    if( m->i_rate == 0 )
+        return 0;
+    return m->i_time_base + ( (int64_t)i_packet - (int64_t)m->i_packet_base ) *
+                            PACKET_BITS * CLOCK_FREQ / (int64_t)m->i_rate;
+}
+
+/* Keeps the time continuous across rate changes. The first rate is
+ * extrapolated back to the start of the stream */
+static void SetRate( ts_monitor_t *m, uint64_t i_rate )
+{
+    if( m->i_rate > 0 )
+    {
+        m->i_time_base = PacketTime( m, m->i_current );
+        m->i_packet_base = m->i_current;
+    }
+    m->i_rate = i_rate;
+}
+
+/*****************************************************************************
+ * Alarms
+ *****************************************************************************/
+static void Alarm( ts_monitor_t *m, indicator_e i_indicator, int i_pid,
+                   const char *psz_number, const char *psz_fmt, ... )
+{
+    char *psz_text;
+    va_list ap;
+
+    va_start( ap, psz_fmt );
+    if( vasprintf( &psz_text, psz_fmt, ap ) == -1 )
+        psz_text = NULL;
+    va_end( ap );
+
+    m->pi_counts[i_indicator]++;
+
+    const ts_output_field_t fields[] = {
+        TS_OUTPUT_INT( "time", PacketTime( m, m->i_current ) ),
+        TS_OUTPUT_INT( "priority", indicators[i_indicator].i_priority ),
+        TS_OUTPUT_STR( "indicator", psz_number ),
+        TS_OUTPUT_STR( "name", indicators[i_indicator].psz_name ),
+        TS_OUTPUT_INT( "pid", i_pid ),
+        TS_OUTPUT_STR( "text", psz_text ),
+    };
+    ts_output_Record( m->p_out, "ALARM", fields, ARRAY_SIZE(fields) );
+    free( psz_text );
+}
+
+/*****************************************************************************
+ * Pids
+ *****************************************************************************/
+static void WatchTable( ts_monitor_t *m, uint16_t i_pid, uint8_t i_role )
+{
+    monitor_pid_t *p = &m->p_pids[i_pid];
+
+    p->i_roles |= i_role;
+    if( p->p_section )
+        return;
+    p->p_section = malloc( sizeof(*p->p_section) );
+    if( p->p_section )
+        ts_section_Reset( p->p_section );
+}
+
+static void TimeTable( ts_monitor_t *m, uint16_t i_pid, uint8_t i_table_id,
+                       indicator_e i_indicator, mtime_t i_limit )
+{
+    monitor_pid_t *p = &m->p_pids[i_pid];
+    if( p->p_timer )
+        return;
+    p->p_timer = malloc( sizeof(*p->p_timer) );
+    if( !p->p_timer )
+        return;
+    *p->p_timer = (monitor_timer_t) {
+        .i_limit = i_limit,
+        .i_indicator = i_indicator,
+        .i_table_id = i_table_id,
+        .i_packet = m->i_current,
+        .i_last_key = 0xffff,
+    };
+}
+
+static void List( ts_monitor_t *m, uint16_t i_pid )
+{
+    monitor_pid_t *p = &m->p_pids[i_pid];
+    if( p->b_listed )
+        return;
+    p->b_listed = true;
+    p->i_first_packet = m->i_current;
+    ARRAY_APPEND( m->listed, i_pid );
+}
+
+static void Reference( ts_monitor_t *m, uint16_t i_pid, uint8_t i_role )
+{
+    monitor_pid_t *p = &m->p_pids[i_pid];
+    if( i_pid == 0x1fff || (p->i_roles & i_role) )
+        return;
+    if( !p->i_roles )
+    {
+        /* The PID_error timer starts now */
+        p->i_last_packet = __MAX( p->i_last_packet, m->i_current );
+        p->b_late = false;
+    }
+    p->i_roles |= i_role;
+    List( m, i_pid );
+}
+
+/*****************************************************************************
+ * Tables
+ *****************************************************************************/
+static void ParsePAT( ts_monitor_t *m, const uint8_t *p, size_t i )
+{
+    m->b_pat = true;
+    for( size_t j = 8; j + 4 <= i - 4; j += 4 )
+    {
+        const uint16_t i_number = GetWBE( &p[j] );
+        const uint16_t i_pid = GetWBE( &p[j + 2] ) & 0x1fff;
+        if( i_number == 0 )
+        {
+            Reference( m, i_pid, ROLE_NIT );
+            WatchTable( m, i_pid, ROLE_NIT );
+            TimeTable( m, i_pid, 0x40, NIT_ERROR, NIT_INTERVAL );
+        }
+        else
+        {
+            Reference( m, i_pid, ROLE_PMT );
+            WatchTable( m, i_pid, ROLE_PMT );
+            TimeTable( m, i_pid, 0x02, PMT_ERROR, PMT_INTERVAL );
+        }
+    }
+}
+
+static void ParsePMT( ts_monitor_t *m, const uint8_t *p, size_t i )
+{
+    if( i < 16 )
+        return;
+    Reference( m, GetWBE( &p[8] ) & 0x1fff, ROLE_ES ); /* PCR */
+
+    size_t j = 12 + ( GetWBE( &p[10] ) & 0xfff );
+    while( j + 5 <= i - 4 )
+    {
+        Reference( m, GetWBE( &p[j + 1] ) & 0x1fff, ROLE_ES );
+        j += 5 + ( GetWBE( &p[j + 3] ) & 0xfff );
+    }
+}
+
+/* Table ids allowed on the fixed SI pids, stuffing (0x72) included */
+static bool TableIdAllowed( uint8_t i_roles, uint8_t i_table_id )
+{
+    if( i_table_id == 0x72 && !(i_roles & (ROLE_PAT|ROLE_CAT|ROLE_PMT)) )
+        return true;
+    if( i_roles & ROLE_PAT )
+        return i_table_id == 0x00;
+    if( i_roles & ROLE_CAT )
+        return i_table_id == 0x01;
+    if( i_roles & ROLE_PMT )
+        return true; /* PMT pids may carry other private sections */
+    if( i_roles & ROLE_NIT )
+        return i_table_id == 0x40 || i_table_id == 0x41;
+    if( i_roles & ROLE_SDT )
+        return i_table_id == 0x42 || i_table_id == 0x46 || i_table_id == 0x4a;
+    if( i_roles & ROLE_EIT )
+        return i_table_id >= 0x4e && i_table_id <= 0x6f;
+    if( i_roles & ROLE_TDT )
+        return i_table_id == 0x70 || i_table_id == 0x73;
+    return true;
+}
+
+static void SectionDone( void *p_cb_data, uint16_t i_pid, const uint8_t *p, size_t i )
+{
+    ts_monitor_t *m = p_cb_data;
+    monitor_pid_t *pid = &m->p_pids[i_pid];
+    const uint8_t i_table_id = p[0];
+
+    if( !TableIdAllowed( pid->i_roles, i_table_id ) )
+    {
+        const char *psz_number =
+            (pid->i_roles & ROLE_PAT) ? "1.3.b" : (pid->i_roles & ROLE_CAT) ? "2.6.b" :
+            (pid->i_roles & ROLE_NIT) ? "3.1.b" : (pid->i_roles & ROLE_SDT) ? "3.5.b" :
+            (pid->i_roles & ROLE_EIT) ? "3.6.b" : "3.8.b";
+        const indicator_e i_indicator =
+            (pid->i_roles & ROLE_PAT) ? PAT_ERROR : (pid->i_roles & ROLE_CAT) ? CAT_ERROR :
+            (pid->i_roles & ROLE_NIT) ? NIT_ERROR : (pid->i_roles & ROLE_SDT) ? SDT_ERROR :
+            (pid->i_roles & ROLE_EIT) ? EIT_ERROR : TDT_ERROR;
+        Alarm( m, i_indicator, i_pid, psz_number,
+               "table_id 0x%02x not allowed", i_table_id );
+        return;
+    }
+
+    /* Every section with the syntax indicator has a CRC, and so has the TOT */
+    if( ( (p[1] & 0x80) || i_table_id == 0x73 ) && i_table_id != 0x72 )
+    {
+        if( i < 7 || ts_section_CRC( p, i ) != 0 )
+        {
+            Alarm( m, CRC_ERROR, i_pid, "2.2", "table_id 0x%02x", i_table_id );
+            return;
+        }
+    }
+
+    monitor_timer_t *p_timer = pid->p_timer;
+    if( p_timer && i_table_id == p_timer->i_table_id )
+    {
+        /* Same section again, too soon */
+        const uint16_t i_key = ( p[1] & 0x80 ) && i >= 8 ?
+                               GetWBE( &p[3] ) ^ p[6] : 0;
+        if( ( pid->i_roles & (ROLE_NIT|ROLE_SDT|ROLE_EIT|ROLE_TDT) ) &&
+            p_timer->i_last_key == i_key &&
+            PacketTime( m, m->i_current ) - PacketTime( m, p_timer->i_last_packet )
+                < SI_MIN_INTERVAL )
+        {
+            Alarm( m, SI_REPETITION_ERROR, i_pid, "3.2",
+                   "table_id 0x%02x repeated within %d ms", i_table_id,
+                   (int)( SI_MIN_INTERVAL / 1000 ) );
+        }
+        p_timer->i_last_key = i_key;
+        p_timer->i_last_packet = m->i_current;
+        p_timer->i_packet = m->i_current;
+        p_timer->b_late = false;
+    }
+
+    if( i_table_id == 0x01 && (pid->i_roles & ROLE_CAT) )
+    {
+        m->b_cat = true;
+        return;
+    }
+
+    /* The PAT and PMT parsed have the section syntax, their whole header
+     * and a CRC, and are current */
+    if( !( p[1] & 0x80 ) || i < 12 || !( p[5] & 0x01 ) )
+        return;
+    if( i_table_id == 0x00 && (pid->i_roles & ROLE_PAT) )
+        ParsePAT( m, p, i );
+    else if( i_table_id == 0x02 && (pid->i_roles & ROLE_PMT) )
+        ParsePMT( m, p, i );
+}
+
+/*****************************************************************************
+ * Timers
+ *****************************************************************************/
+static const char *TimerNumber( indicator_e i_indicator )
+{
+    switch( i_indicator )
+    {
+        case PAT_ERROR: return "1.3.a";
+        case PMT_ERROR: return "1.5.a";
+        case NIT_ERROR: return "3.1.a";
+        case SDT_ERROR: return "3.5.a";
+        case EIT_ERROR: return "3.6.a";
+        default:        return "3.8.a";
+    }
+}
+
+static void Sweep( ts_monitor_t *m, mtime_t i_now )
+{
+    for( int i = 0; i < m->listed.i_size; i++ )
+    {
+        const uint16_t i_pid = m->listed.p_elems[i];
+        monitor_pid_t *p = &m->p_pids[i_pid];
+
+        if( (p->i_roles & ROLE_ES) && !p->b_late &&
+            i_now - PacketTime( m, p->i_last_packet ) > PID_INTERVAL )
+        {
+            p->b_late = true;
+            Alarm( m, PID_ERROR, i_pid, "1.6", "missing for more than %d s",
+                   (int)( PID_INTERVAL / CLOCK_FREQ ) );
+        }
+        if( p->b_pts && !p->b_pts_late &&
+            i_now - PacketTime( m, p->i_pts_packet ) > PTS_INTERVAL )
+        {
+            p->b_pts_late = true;
+            Alarm( m, PTS_ERROR, i_pid, "2.5", "no PTS for more than %d ms",
+                   (int)( PTS_INTERVAL / 1000 ) );
+        }
+        if( !p->i_roles && !p->b_late && m->b_pat && i_pid >= 0x20 &&
+            i_pid != 0x1fff &&
+            i_now - PacketTime( m, p->i_first_packet ) > UNREFERENCED_INTERVAL )
+        {
+            p->b_late = true; /* once */
+            Alarm( m, UNREFERENCED_PID, i_pid, "3.4", "not referenced" );
+        }
+    }
+
+    /* Table pids are checked even if they were never seen */
+    for( unsigned i_pid = 0; i_pid < MONITOR_PID_COUNT; i_pid++ )
+    {
+        monitor_timer_t *p_timer = m->p_pids[i_pid].p_timer;
+        if( !p_timer )
+            continue;
+        if( !p_timer->b_late &&
+            i_now - PacketTime( m, p_timer->i_packet ) > p_timer->i_limit )
+        {
+            p_timer->b_late = true;
+            Alarm( m, p_timer->i_indicator, i_pid,
+                   TimerNumber( p_timer->i_indicator ),
+                   "table_id 0x%02x missing for more than %d ms",
+                   p_timer->i_table_id, (int)( p_timer->i_limit / 1000 ) );
+        }
+    }
+
+    if( m->b_scrambled && !m->b_cat && !m->b_cat_late )
+    {
+        m->b_cat_late = true;
+        Alarm( m, CAT_ERROR, -1, "2.6.a", "scrambled packets without CAT" );
+    }
+}
+
+/*****************************************************************************
+ * Packets
+ *****************************************************************************/
+static void CheckEvents( ts_monitor_t *m, uint16_t i_pid, unsigned i_events )
+{
+    if( i_events & TS_STATS_TEI )
+        Alarm( m, TRANSPORT_ERROR, i_pid, "2.1", "transport_error_indicator set" );
+    if( i_events & TS_STATS_CC_ERROR )
+        Alarm( m, CONTINUITY_COUNT_ERROR, i_pid, "1.4", "continuity counter discontinuity" );
+    if( i_events & TS_STATS_PCR_INTERVAL )
+        Alarm( m, PCR_REPETITION_ERROR, i_pid, "2.3a", "PCR interval above 40 ms" );
+    if( i_events & TS_STATS_PCR_DISCONTINUITY )
+        Alarm( m, PCR_DISCONTINUITY_ERROR, i_pid, "2.3b",
+               "PCR discontinuity without discontinuity_indicator" );
+    if( i_events & TS_STATS_PCR_ACCURACY )
+        Alarm( m, PCR_ACCURACY_ERROR, i_pid, "2.4", "PCR accuracy above 500 ns" );
+}
+
+static void UpdateRate( ts_monitor_t *m, ts_stats_t *p_stats, uint16_t i_pid,
+                        unsigned i_events )
+{
+    if( i_events & TS_STATS_PCR )
+    {
+        const ts_stats_pid_t *s = ts_stats_GetPID( p_stats, i_pid );
+        if( m->i_rate_pid < 0 && s->i_rate > 0 )
+            m->i_rate_pid = i_pid;
+        if( m->i_rate_pid == i_pid && s->i_rate > 0 && s->i_rate != m->i_rate )
+            SetRate( m, s->i_rate );
+    }
+    else if( m->i_rate_pid < 0 && m->i_current % MONITOR_SWEEP_PACKETS == 0 )
+    {
+        /* No PCR: the reading pace, once it can be measured */
+        const mtime_t i_elapsed = mdate() - m->i_start_date;
+        if( i_elapsed >= CLOCK_FREQ / 10 )
+            SetRate( m, m->i_current * PACKET_BITS * CLOCK_FREQ / i_elapsed );
+    }
+}
+
+static void CheckPayload( ts_monitor_t *m, monitor_pid_t *pid, uint16_t i_pid,
+                          const uint8_t *p_pkt )
+{
+    const bool b_unit_start = p_pkt[1] & 0x40;
+    size_t i_offset = 4;
+
+    if( !(p_pkt[3] & 0x10) )
+        return;
+    if( p_pkt[3] & 0x20 )
+        i_offset += 1 + p_pkt[4];
+    if( i_offset >= 188 )
+        return;
+
+    if( pid->p_section )
+        ts_section_Push( pid->p_section, i_pid, &p_pkt[i_offset], 188 - i_offset,
+                         b_unit_start, SectionDone, m );
+
+    if( (pid->i_roles & ROLE_ES) && b_unit_start && i_offset + 14 <= 188 )
+    {
+        const uint8_t *p = &p_pkt[i_offset];
+        if( p[0] == 0 && p[1] == 0 && p[2] == 1 && (p[6] & 0xc0) == 0x80 &&
+            (p[7] & 0x80) )
+        {
+            pid->b_pts = true;
+            pid->b_pts_late = false;
+            pid->i_pts_packet = m->i_current;
+        }
+    }
+}
+
+void ts_monitor_Packet( ts_monitor_t *m, ts_stats_t *p_stats,
+                        const uint8_t *p_pkt, unsigned i_events )
+{
+    const uint16_t i_pid = ( (p_pkt[1] & 0x1f) << 8 ) | p_pkt[2];
+    monitor_pid_t *pid = &m->p_pids[i_pid];
+
+    m->i_current = m->i_packets++;
+    if( unlikely(m->i_current == 0) )
+        m->i_start_date = mdate();
+
+    UpdateRate( m, p_stats, i_pid, i_events );
+
+    if( unlikely(p_stats->i_sync_losses != m->i_sync_losses) )
+    {
+        m->i_sync_losses = p_stats->i_sync_losses;
+        Alarm( m, TS_SYNC_LOSS, -1, "1.1", "synchronization lost" );
+        Alarm( m, SYNC_BYTE_ERROR, -1, "1.2", "sync byte missing" );
+    }
+
+    if( unlikely(!pid->b_listed) )
+        List( m, i_pid );
+    pid->i_last_packet = m->i_current;
+    if( pid->i_roles & ROLE_ES )
+        pid->b_late = false;
+
+    if( unlikely(i_events & ~TS_STATS_PCR) )
+        CheckEvents( m, i_pid, i_events );
+
+    if( p_pkt[3] & 0xc0 )
+    {
+        m->b_scrambled = true;
+        if( pid->i_roles & ROLE_PAT )
+            Alarm( m, PAT_ERROR, i_pid, "1.3.c", "scrambled PAT" );
+        else if( pid->i_roles & ROLE_PMT )
+            Alarm( m, PMT_ERROR, i_pid, "1.5.b", "scrambled PMT" );
+    }
+    else if( !(p_pkt[1] & 0x80) && (pid->p_section || (pid->i_roles & ROLE_ES)) )
+    {
+        CheckPayload( m, pid, i_pid, p_pkt );
+    }
+
+    if( m->i_current % MONITOR_SWEEP_PACKETS == 0 && m->i_rate > 0 )
+    {
+        const mtime_t i_now = PacketTime( m, m->i_current );
+        if( i_now - m->i_sweep_time >= MONITOR_SWEEP_PERIOD )
+        {
+            m->i_sweep_time = i_now;
+            Sweep( m, i_now );
+        }
+    }
+}
+
+/*****************************************************************************
+ * Lifetime
+ *****************************************************************************/
+ts_monitor_t *ts_monitor_New( vlc_object_t *p_obj, ts_output_t *p_out )
+{
+    ts_monitor_t *m = calloc( 1, sizeof(*m) );
+    if( !m )
+        return NULL;
+
+    m->p_pids = calloc( MONITOR_PID_COUNT, sizeof(*m->p_pids) );
+    if( !m->p_pids )
+    {
+        free( m );
+        return NULL;
+    }
+    m->p_obj = p_obj;
+    m->p_out = p_out;
+    m->i_rate_pid = -1;
+    ARRAY_INIT( m->listed );
+
+    WatchTable( m, 0x00, ROLE_PAT );
+    TimeTable( m, 0x00, 0x00, PAT_ERROR, PAT_INTERVAL );
+    WatchTable( m, 0x01, ROLE_CAT );
+    WatchTable( m, 0x10, ROLE_NIT );
+    TimeTable( m, 0x10, 0x40, NIT_ERROR, NIT_INTERVAL );
+    WatchTable( m, 0x11, ROLE_SDT );
+    TimeTable( m, 0x11, 0x42, SDT_ERROR, SDT_INTERVAL );
+    WatchTable( m, 0x12, ROLE_EIT );
+    TimeTable( m, 0x12, 0x4e, EIT_ERROR, EIT_INTERVAL );
+    WatchTable( m, 0x14, ROLE_TDT );
+    TimeTable( m, 0x14, 0x70, TDT_ERROR, TDT_INTERVAL );
+
+    return m;
+}
+
+void ts_monitor_Delete( ts_monitor_t *m )
+{
+    uint64_t i_alarms = 0;
+
+    for( unsigned i = 0; i < INDICATOR_COUNT; i++ )
+    {
+        const ts_output_field_t fields[] = {
+            TS_OUTPUT_INT( "priority", indicators[i].i_priority ),
+            TS_OUTPUT_STR( "name", indicators[i].psz_name ),
+            TS_OUTPUT_INT( "count", m->pi_counts[i] ),
+        };
+        ts_output_Record( m->p_out, "MONITOR", fields, ARRAY_SIZE(fields) );
+        i_alarms += m->pi_counts[i];
+    }
+    msg_Dbg( m->p_obj, "TR 101 290 monitor: %"PRIu64" alarms over %"PRIu64
+             " packets", i_alarms, m->i_packets );
+
+    for( unsigned i = 0; i < MONITOR_PID_COUNT; i++ )
+    {
+        free( m->p_pids[i].p_section );
+        free( m->p_pids[i].p_timer );
+    }
+    ARRAY_RESET( m->listed );
+    free( m->p_pids );
+    free( m );
+}
@@ -0,0 +1,50 @@
+/*****************************************************************************
+ * ts_monitor.h: MPEG-TS ETSI TR 101 290 monitor
+ *****************************************************************************
+ * Copyright (C) 2004-2015 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifndef VLC_TS_MONITOR_H
+#define VLC_TS_MONITOR_H
+
+/* Checks the ETSI TR 101 290 priority 1, 2 and 3 indicators that can be
+ * measured on the transport stream alone, with a constant amount of work
+ * per packet. Repetition timers are checked every few packets.
+ *
+ * Time is the position in the stream, from the transport rate measured on
+ * the PCR, or on the reading pace when there is no PCR, so that recordings
+ * are checked as if they were received.
+ *
+ * Every alarm is written as an ALARM record:
+ *  time      microseconds since the start of the stream
+ *  priority  1, 2 or 3
+ *  indicator indicator number, as "1.3.a"
+ *  name      indicator name, as "PAT_error"
+ *  pid       -1 if it is not pid specific
+ *  text      details
+ * and every indicator is counted in a MONITOR record when deleting.
+ */
+typedef struct ts_monitor_t ts_monitor_t;
+
+ts_monitor_t *ts_monitor_New( vlc_object_t *, ts_output_t *p_out );
+void ts_monitor_Delete( ts_monitor_t * );
+
+/* Checks one packet, starting with its sync byte, once the statistics
+ * have been updated with it. i_events are the TS_STATS_* it raised */
+void ts_monitor_Packet( ts_monitor_t *, ts_stats_t *, const uint8_t *p_pkt,
+                        unsigned i_events );
+
+#endif
@@ -0,0 +1,528 @@
+/*****************************************************************************
+ * ts_output.c: MPEG-TS analyser record output
+ *****************************************************************************
+ * Copyright (C) 2004-2015 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/*****************************************************************************
+ * Preamble
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <vlc_common.h>
+#include <vlc_fs.h>
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "ts_output.h"
+
+/* Size of each of the two write buffers, a buffer is handed to the writer
+ * thread when full or when it has been pending for TS_OUTPUT_FLUSH_DELAY */
+#define TS_OUTPUT_BUFFER_SIZE (1 << 20)
+#define TS_OUTPUT_FLUSH_DELAY CLOCK_FREQ
+
+typedef struct
+{
+    char   *p;
+    size_t  i_size;
+    size_t  i_max;
+} ts_output_buffer_t;
+
+struct ts_output_t
+{
+    ts_output_t       *p_shared;   /* output written to, if not this one */
+    char              *psz_input;
+
+    vlc_object_t      *p_obj;
+    ts_output_format_t format;
+    int                fd;
+    bool               b_close_fd;
+    bool               b_error;
+
+    vlc_thread_t       thread;
+    vlc_mutex_t        lock;
+    vlc_cond_t         wait_data;  /* writer waits for a full buffer */
+    vlc_cond_t         wait_space; /* producer waits for the writer */
+    bool               b_exit;
+    bool               b_pending;  /* buffer[!i_fill] belongs to the writer */
+    unsigned           i_fill;     /* buffer being filled by producer */
+    ts_output_buffer_t buffer[2];
+
+    ts_output_buffer_t line;       /* record being serialized */
+};
+
+ts_output_format_t ts_output_ParseFormat( const char *psz_format )
+{
+    if( psz_format == NULL )
+        return TS_OUTPUT_NONE;
+    if( !strcasecmp( psz_format, "csv" ) )
+        return TS_OUTPUT_CSV;
+    if( !strcasecmp( psz_format, "json" ) )
+        return TS_OUTPUT_JSON;
+    if( !strcasecmp( psz_format, "binary" ) )
+        return TS_OUTPUT_BINARY;
+    return TS_OUTPUT_NONE;
+}
+
+void ts_output_Log( vlc_object_t *p_obj, int i_type, const char *psz_format, ... )
+{
+    va_list args;
+
+    va_start( args, psz_format );
+    if( p_obj != NULL )
+        msg_GenericVa( p_obj, i_type, psz_format, args );
+    else if( i_type == VLC_MSG_ERR || i_type == VLC_MSG_WARN )
+    {
+        vfprintf( stderr, psz_format, args );
+        fputc( '\n', stderr );
+    }
+    va_end( args );
+}
+
+/*****************************************************************************
+ * Serialization
+ *****************************************************************************/
+static bool BufferReserve( ts_output_buffer_t *p_buf, size_t i_extra )
+{
+    if( p_buf->i_size + i_extra <= p_buf->i_max )
+        return true;
+
+    size_t i_max = __MAX( p_buf->i_max * 2, p_buf->i_size + i_extra );
+    char *p = realloc( p_buf->p, i_max );
+    if( unlikely(p == NULL) )
+        return false;
+    p_buf->p = p;
+    p_buf->i_max = i_max;
+    return true;
+}
+
+static void LineAppend( ts_output_buffer_t *p_line, const void *p_data, size_t i_data )
+{
+    if( !BufferReserve( p_line, i_data ) )
+        return;
+    memcpy( &p_line->p[p_line->i_size], p_data, i_data );
+    p_line->i_size += i_data;
+}
+
+static void LineAppendChar( ts_output_buffer_t *p_line, char c )
+{
+    LineAppend( p_line, &c, 1 );
+}
+
+static void LineAppendString( ts_output_buffer_t *p_line, const char *psz )
+{
+    LineAppend( p_line, psz, strlen( psz ) );
+}
+
+static void LineAppendCSVString( ts_output_buffer_t *p_line, const char *psz )
+{
+    LineAppendChar( p_line, '"' );
+    for( const char *p = psz; *p; p++ )
+    {
+        if( *p == '"' )
+            LineAppendChar( p_line, '"' );
+        LineAppendChar( p_line, *p );
+    }
+    LineAppendChar( p_line, '"' );
+}
+
+static void LineAppendJSONString( ts_output_buffer_t *p_line, const char *psz )
+{
+    LineAppendChar( p_line, '"' );
+    for( const unsigned char *p = (const unsigned char *)psz; *p; p++ )
+    {
+        if( *p == '"' || *p == '\\' )
+        {
+            LineAppendChar( p_line, '\\' );
+            LineAppendChar( p_line, *p );
+        }
+        else if( *p < 0x20 )
+        {
+            char esc[7];
+            snprintf( esc, sizeof(esc), "\\u%04x", *p );
+            LineAppendString( p_line, esc );
+        }
+        else
+            LineAppendChar( p_line, *p );
+    }
+    LineAppendChar( p_line, '"' );
+}
+
+static void LineAppendBinaryName( ts_output_buffer_t *p_line, const char *psz )
+{
+    size_t i_len = __MIN( strlen( psz ), UINT8_MAX );
+    LineAppendChar( p_line, i_len );
+    LineAppend( p_line, psz, i_len );
+}
+
+static void FormatCSV( ts_output_buffer_t *p_line, const char *psz_type,
+                       const ts_output_field_t *p_fields, size_t i_fields )
+{
+    char psz_int[24];
+
+    LineAppendString( p_line, psz_type );
+    for( size_t i = 0; i < i_fields; i++ )
+    {
+        const ts_output_field_t *p_field = &p_fields[i];
+        LineAppendChar( p_line, ',' );
+        switch( p_field->kind )
+        {
+            case TS_FIELD_INT:
+                snprintf( psz_int, sizeof(psz_int), "%"PRId64, p_field->u.i );
+                LineAppendString( p_line, psz_int );
+                break;
+            case TS_FIELD_HEX:
+                snprintf( psz_int, sizeof(psz_int), "%"PRIx64, p_field->u.i );
+                LineAppendString( p_line, psz_int );
+                break;
+            case TS_FIELD_STR:
+                LineAppendCSVString( p_line, p_field->u.psz ? p_field->u.psz : "" );
+                break;
+        }
+    }
+    LineAppendChar( p_line, '\n' );
+}
+
+static void FormatJSON( ts_output_buffer_t *p_line, const char *psz_type,
+                        const ts_output_field_t *p_fields, size_t i_fields )
+{
+    char psz_int[24];
+
+    LineAppendString( p_line, "{\"type\":" );
+    LineAppendJSONString( p_line, psz_type );
+    for( size_t i = 0; i < i_fields; i++ )
+    {
+        const ts_output_field_t *p_field = &p_fields[i];
+        LineAppendChar( p_line, ',' );
+        LineAppendJSONString( p_line, p_field->psz_name );
+        LineAppendChar( p_line, ':' );
+        if( p_field->kind == TS_FIELD_STR )
+        {
+            LineAppendJSONString( p_line, p_field->u.psz ? p_field->u.psz : "" );
+        }
+        else
+        {
+            snprintf( psz_int, sizeof(psz_int), "%"PRId64, p_field->u.i );
+            LineAppendString( p_line, psz_int );
+        }
+    }
+    LineAppendString( p_line, "}\n" );
+}
+
+static void FormatBinary( ts_output_buffer_t *p_line, const char *psz_type,
+                          const ts_output_field_t *p_fields, size_t i_fields )
+{
+    uint8_t val[8];
+
+    i_fields = __MIN( i_fields, UINT8_MAX );
+    LineAppendBinaryName( p_line, psz_type );
+    LineAppendChar( p_line, i_fields );
+    for( size_t i = 0; i < i_fields; i++ )
+    {
+        const ts_output_field_t *p_field = &p_fields[i];
+        LineAppendChar( p_line, p_field->kind );
+        LineAppendBinaryName( p_line, p_field->psz_name );
+        if( p_field->kind == TS_FIELD_STR )
+        {
+            const char *psz = p_field->u.psz ? p_field->u.psz : "";
+            size_t i_len = __MIN( strlen( psz ), UINT16_MAX );
+            SetWBE( val, i_len );
+            LineAppend( p_line, val, 2 );
+            LineAppend( p_line, psz, i_len );
+        }
+        else
+        {
+            SetQWBE( val, p_field->u.i );
+            LineAppend( p_line, val, 8 );
+        }
+    }
+}
+
+/*****************************************************************************
+ * Writer
+ *****************************************************************************/
+static void WriteBuffer( ts_output_t *p_out, ts_output_buffer_t *p_buf )
+{
+    size_t i_done = 0;
+
+    while( i_done < p_buf->i_size && !p_out->b_error )
+    {
+        ssize_t i_ret = vlc_write( p_out->fd, &p_buf->p[i_done],
+                                   p_buf->i_size - i_done );
+        if( i_ret < 0 )
+        {
+            if( errno == EINTR )
+                continue;
+            ts_output_Log( p_out->p_obj, VLC_MSG_ERR,
+                           "analyser output write error: %s",
+                           vlc_strerror_c(errno) );
+            p_out->b_error = true;
+        }
+        else
+            i_done += i_ret;
+    }
+    p_buf->i_size = 0;
+}
+
+static void *WriterThread( void *data )
+{
+    ts_output_t *p_out = data;
+
+    vlc_mutex_lock( &p_out->lock );
+    for( ;; )
+    {
+        mtime_t i_deadline = mdate() + TS_OUTPUT_FLUSH_DELAY;
+        while( !p_out->b_pending && !p_out->b_exit )
+        {
+            if( vlc_cond_timedwait( &p_out->wait_data, &p_out->lock, i_deadline ) )
+            {
+                /* Partially filled buffer is taking too long, take it */
+                if( p_out->buffer[p_out->i_fill].i_size > 0 )
+                {
+                    p_out->b_pending = true;
+                    p_out->i_fill ^= 1;
+                }
+                i_deadline = mdate() + TS_OUTPUT_FLUSH_DELAY;
+            }
+        }
+        if( !p_out->b_pending )
+            break;
+
+        ts_output_buffer_t *p_buf = &p_out->buffer[!p_out->i_fill];
+        vlc_mutex_unlock( &p_out->lock );
+
+        WriteBuffer( p_out, p_buf );
+
+        vlc_mutex_lock( &p_out->lock );
+        p_out->b_pending = false;
+        vlc_cond_signal( &p_out->wait_space );
+    }
+    vlc_mutex_unlock( &p_out->lock );
+
+    return NULL;
+}
+
+void ts_output_Record( ts_output_t *p_out, const char *psz_type,
+                       const ts_output_field_t *p_fields, size_t i_fields )
+{
+    if( p_out->p_shared )
+    {
+        ts_output_field_t fields[1 + i_fields];
+        fields[0] = (ts_output_field_t)TS_OUTPUT_STR( "input", p_out->psz_input );
+        memcpy( &fields[1], p_fields, i_fields * sizeof(*p_fields) );
+        ts_output_Record( p_out->p_shared, psz_type, fields, 1 + i_fields );
+        return;
+    }
+
+    vlc_mutex_lock( &p_out->lock );
+
+    ts_output_buffer_t *p_line = &p_out->line;
+    p_line->i_size = 0;
+    switch( p_out->format )
+    {
+        case TS_OUTPUT_CSV:
+            FormatCSV( p_line, psz_type, p_fields, i_fields );
+            break;
+        case TS_OUTPUT_JSON:
+            FormatJSON( p_line, psz_type, p_fields, i_fields );
+            break;
+        case TS_OUTPUT_BINARY:
+            FormatBinary( p_line, psz_type, p_fields, i_fields );
+            break;
+        default:
+            vlc_assert_unreachable();
+    }
+
+    ts_output_buffer_t *p_buf = &p_out->buffer[p_out->i_fill];
+    if( p_buf->i_size + p_line->i_size > p_buf->i_max )
+    {
+        /* Hand the full buffer over, waiting for the writer if both are full */
+        while( p_out->b_pending )
+            vlc_cond_wait( &p_out->wait_space, &p_out->lock );
+        if( p_out->buffer[p_out->i_fill].i_size > 0 )
+        {
+            p_out->b_pending = true;
+            p_out->i_fill ^= 1;
+            vlc_cond_signal( &p_out->wait_data );
+        }
+        p_buf = &p_out->buffer[p_out->i_fill];
+    }
+
+    if( BufferReserve( p_buf, p_line->i_size ) )
+    {
+        memcpy( &p_buf->p[p_buf->i_size], p_line->p, p_line->i_size );
+        p_buf->i_size += p_line->i_size;
+    }
+
+    vlc_mutex_unlock( &p_out->lock );
+}
+
+void ts_output_ServiceRecord( ts_output_t *p_out, uint16_t i_sid, uint16_t i_tsid,
+                              uint16_t i_onid, const char *psz_name )
+{
+    char psz_key[16];
+    snprintf( psz_key, sizeof(psz_key), "%x.%x.%x", i_sid, i_tsid, i_onid );
+
+    const ts_output_field_t fields[] = {
+        TS_OUTPUT_STR( "key", psz_key ),
+        TS_OUTPUT_HEX( "sid", i_sid ),
+        TS_OUTPUT_HEX( "tsid", i_tsid ),
+        TS_OUTPUT_HEX( "onid", i_onid ),
+        TS_OUTPUT_STR( "name", psz_name ),
+    };
+    ts_output_Record( p_out, "SDT", fields, ARRAY_SIZE(fields) );
+}
+
+void ts_output_EventRecord( ts_output_t *p_out, const char *psz_service,
+                            uint16_t i_sid, uint16_t i_tsid, uint16_t i_onid,
+                            uint16_t i_event_id, int64_t i_start, int i_duration,
+                            const char *psz_name )
+{
+    char psz_key[16];
+    snprintf( psz_key, sizeof(psz_key), "%x.%x.%x", i_sid, i_tsid, i_onid );
+
+    const ts_output_field_t fields[] = {
+        TS_OUTPUT_STR( "service", psz_service ),
+        TS_OUTPUT_STR( "key", psz_key ),
+        TS_OUTPUT_HEX( "sid", i_sid ),
+        TS_OUTPUT_HEX( "tsid", i_tsid ),
+        TS_OUTPUT_HEX( "onid", i_onid ),
+        TS_OUTPUT_HEX( "event_id", i_event_id ),
+        TS_OUTPUT_INT( "start", i_start ),
+        TS_OUTPUT_INT( "duration", i_duration ),
+        TS_OUTPUT_STR( "name", psz_name ),
+    };
+    ts_output_Record( p_out, "EIT", fields, ARRAY_SIZE(fields) );
+}
+
+/*****************************************************************************
+ * New/Delete
+ *****************************************************************************/
+ts_output_t *ts_output_New( vlc_object_t *p_obj, ts_output_format_t format,
+                            const char *psz_path )
+{
+    if( format == TS_OUTPUT_NONE )
+        return NULL;
+
+    ts_output_t *p_out = calloc( 1, sizeof(*p_out) );
+    if( unlikely(p_out == NULL) )
+        return NULL;
+
+    p_out->p_obj = p_obj;
+    p_out->format = format;
+
+    if( psz_path == NULL || *psz_path == '\0' || !strcmp( psz_path, "-" ) )
+    {
+        p_out->fd = STDOUT_FILENO;
+    }
+    else
+    {
+        p_out->fd = vlc_open( psz_path, O_WRONLY | O_CREAT | O_TRUNC, 0666 );
+        if( p_out->fd == -1 )
+        {
+            ts_output_Log( p_obj, VLC_MSG_ERR,
+                           "cannot open analyser output %s: %s", psz_path,
+                           vlc_strerror_c(errno) );
+            free( p_out );
+            return NULL;
+        }
+        p_out->b_close_fd = true;
+    }
+
+    for( int i = 0; i < 2; i++ )
+    {
+        p_out->buffer[i].p = malloc( TS_OUTPUT_BUFFER_SIZE );
+        p_out->buffer[i].i_max = TS_OUTPUT_BUFFER_SIZE;
+    }
+    if( unlikely(!p_out->buffer[0].p || !p_out->buffer[1].p) )
+        goto error;
+
+    vlc_mutex_init( &p_out->lock );
+    vlc_cond_init( &p_out->wait_data );
+    vlc_cond_init( &p_out->wait_space );
+
+    if( vlc_clone( &p_out->thread, WriterThread, p_out, VLC_THREAD_PRIORITY_LOW ) )
+    {
+        vlc_cond_destroy( &p_out->wait_space );
+        vlc_cond_destroy( &p_out->wait_data );
+        vlc_mutex_destroy( &p_out->lock );
+        goto error;
+    }
+
+    return p_out;
+
+error:
+    free( p_out->buffer[0].p );
+    free( p_out->buffer[1].p );
+    if( p_out->b_close_fd )
+        close( p_out->fd );
+    free( p_out );
+    return NULL;
+}
+
+ts_output_t *ts_output_NewInput( ts_output_t *p_shared, const char *psz_input )
+{
+    ts_output_t *p_out = calloc( 1, sizeof(*p_out) );
+    if( unlikely(p_out == NULL) )
+        return NULL;
+
+    p_out->p_shared = p_shared;
+    if( psz_input != NULL )
+        p_out->psz_input = strdup( psz_input );
+    if( unlikely(psz_input != NULL && p_out->psz_input == NULL) )
+    {
+        free( p_out );
+        return NULL;
+    }
+    return p_out;
+}
+
+void ts_output_Delete( ts_output_t *p_out )
+{
+    if( p_out->p_shared )
+    {
+        free( p_out->psz_input );
+        free( p_out );
+        return;
+    }
+
+    vlc_mutex_lock( &p_out->lock );
+    p_out->b_exit = true;
+    vlc_cond_signal( &p_out->wait_data );
+    vlc_mutex_unlock( &p_out->lock );
+
+    /* writer drains the pending buffer before exiting */
+    vlc_join( p_out->thread, NULL );
+    WriteBuffer( p_out, &p_out->buffer[p_out->i_fill] );
+
+    vlc_cond_destroy( &p_out->wait_space );
+    vlc_cond_destroy( &p_out->wait_data );
+    vlc_mutex_destroy( &p_out->lock );
+
+    if( p_out->b_close_fd )
+        close( p_out->fd );
+    free( p_out->buffer[0].p );
+    free( p_out->buffer[1].p );
+    free( p_out->line.p );
+    free( p_out );
+}
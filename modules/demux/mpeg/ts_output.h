@@ -0,0 +1,98 @@
+/*****************************************************************************
+ * ts_output.h: MPEG-TS analyser record output
+ *****************************************************************************
+ * Copyright (C) 2004-2015 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifndef VLC_TS_OUTPUT_H
+#define VLC_TS_OUTPUT_H
+
+/* Records are a type name followed by an ordered list of named fields.
+ * They are serialized in the selected format into a large buffer which
+ * is written out by a background thread.
+ *
+ *  csv:    TYPE,field,field,...\n  (strings are always "quoted", with
+ *          embedded quotes doubled)
+ *  json:   {"type":"TYPE","name":value,...}\n
+ *  binary: u8 type length, type, u8 field count, then for each field
+ *          u8 kind, u8 name length, name, and either a big endian int64
+ *          (TS_FIELD_INT/TS_FIELD_HEX) or a big endian u16 length
+ *          followed by the bytes (TS_FIELD_STR). Names and strings longer
+ *          than their length field are truncated.
+ */
+typedef enum
+{
+    TS_OUTPUT_NONE = 0,
+    TS_OUTPUT_CSV,
+    TS_OUTPUT_JSON,
+    TS_OUTPUT_BINARY,
+} ts_output_format_t;
+
+typedef enum
+{
+    TS_FIELD_INT = 0,
+    TS_FIELD_HEX,   /* integer, printed in hexadecimal in csv */
+    TS_FIELD_STR,
+} ts_output_kind_t;
+
+typedef struct
+{
+    const char      *psz_name;
+    ts_output_kind_t kind;
+    union
+    {
+        int64_t     i;
+        const char *psz; /* NULL is output as an empty string */
+    } u;
+} ts_output_field_t;
+
+#define TS_OUTPUT_INT(name, val) { name, TS_FIELD_INT, { .i = (val) } }
+#define TS_OUTPUT_HEX(name, val) { name, TS_FIELD_HEX, { .i = (val) } }
+#define TS_OUTPUT_STR(name, val) { name, TS_FIELD_STR, { .psz = (val) } }
+
+typedef struct ts_output_t ts_output_t;
+
+ts_output_format_t ts_output_ParseFormat( const char *psz_format );
+
+/* The analysis core also runs without any libvlc instance (vlc-ts-scan):
+ * with a NULL object, errors and warnings go to the standard error and
+ * the other messages are dropped */
+void ts_output_Log( vlc_object_t *, int i_type, const char *psz_format, ... )
+    VLC_FORMAT( 3, 4 );
+
+/* psz_path NULL, empty or "-" means stdout.
+ * Returns NULL for TS_OUTPUT_NONE or on error */
+ts_output_t *ts_output_New( vlc_object_t *, ts_output_format_t, const char *psz_path );
+/* Writes to p_shared, with an "input" field set to psz_input first in each
+ * record, so that several demuxers can share one analyser output. The field
+ * is left empty when psz_input is NULL. The returned output must be deleted
+ * before p_shared */
+ts_output_t *ts_output_NewInput( ts_output_t *p_shared, const char *psz_input );
+/* Flushes all pending records */
+void ts_output_Delete( ts_output_t * );
+
+void ts_output_Record( ts_output_t *, const char *psz_type,
+                       const ts_output_field_t *p_fields, size_t i_fields );
+
+/* Service and event rows, keyed by "sid.tsid.onid" in hexadecimal */
+void ts_output_ServiceRecord( ts_output_t *, uint16_t i_sid, uint16_t i_tsid,
+                              uint16_t i_onid, const char *psz_name );
+void ts_output_EventRecord( ts_output_t *, const char *psz_service,
+                            uint16_t i_sid, uint16_t i_tsid, uint16_t i_onid,
+                            uint16_t i_event_id, int64_t i_start, int i_duration,
+                            const char *psz_name );
+
+#endif
@@ -0,0 +1,828 @@
+/*****************************************************************************
+ * ts_records.c: MPEG-TS analyser records of the tables
+ *****************************************************************************
+ * Copyright (C) 2004-2015 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/*****************************************************************************
+ * Preamble
+ *****************************************************************************/
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <vlc_common.h>
+#include <vlc_arrays.h>
+#include <vlc_demux.h>
+
+#include "ts_output.h"
+#include "ts_section.h"
+#include "ts_si.h"
+#include "ts_stats.h"
+#include "ts_text.h"
+#include "ts_records.h"
+
+#define RECORD_PID_COUNT      8192
+#define RECORD_SET_INIT       1024
+/* Service ids of a transport stream of a network or bouquet */
+#define RECORD_SERVICES_SIZE  1024
+/* Name and text of an event, each at most 255 bytes of source text that
+ * ARIB expands the most */
+#define RECORD_ARENA_SIZE     4096
+/* Past this, the events of unnamed services are written without waiting */
+#define RECORD_MAX_PENDING    4096
+
+/*****************************************************************************
+ * Reader
+ *****************************************************************************/
+struct ts_record_reader_t
+{
+    bool          b_network_si;
+    ts_record_cb  pf_record;
+    void         *p_cb_data;
+    uint64_t      i_offset;     /* of the packet being read */
+    ts_section_t *pp_sections[RECORD_PID_COUNT]; /* NULL for the pids not read */
+};
+
+static ts_section_t *Watch( ts_record_reader_t *r, uint16_t i_pid )
+{
+    ts_section_t *p_sec = malloc( sizeof(*p_sec) );
+    if( unlikely(p_sec == NULL) )
+        return NULL;
+    ts_section_Reset( p_sec );
+    r->pp_sections[i_pid] = p_sec;
+    return p_sec;
+}
+
+/* First descriptor of a loop with that tag */
+static const uint8_t *FindDescriptor( const uint8_t *p, size_t i, uint8_t i_tag,
+                                      size_t *pi_length )
+{
+    for( size_t k = 0; k + 2 <= i && k + 2 + p[k + 1] <= i; k += 2 + p[k + 1] )
+    {
+        if( p[k] == i_tag )
+        {
+            *pi_length = p[k + 1];
+            return &p[k + 2];
+        }
+    }
+    return NULL;
+}
+
+/* Service descriptor (type, provider, name) of the SDT service at *pj,
+ * which moves on to the next service */
+static const uint8_t *NextService( const uint8_t *p, size_t i, size_t *pj,
+                                   uint16_t *pi_sid )
+{
+    const size_t j = *pj;
+    const size_t i_loop = GetWBE( &p[j + 3] ) & 0xfff;
+
+    *pi_sid = GetWBE( &p[j] );
+    if( j + 5 + i_loop > i )
+    {
+        *pj = i;
+        return NULL;
+    }
+    *pj = j + 5 + i_loop;
+
+    size_t i_dr;
+    const uint8_t *d = FindDescriptor( &p[j + 5], i_loop, 0x48, &i_dr );
+    if( d == NULL || i_dr < 3 || 3u + d[1] > i_dr || 3u + d[1] + d[2 + d[1]] > i_dr )
+        return NULL;
+    return d;
+}
+
+/* Same workarounds as the demux for the broadcasters with a broken EPG */
+static bool IsBrokenProvider( const uint8_t *p, size_t i )
+{
+    /* List of providers using ISO8859-1 */
+    static const char ppsz_broken_providers[][8] = {
+        "CSAT",     /* CanalSat FR */
+        "GR1",      /* France televisions */
+        "MULTI4",   /* NT1 */
+        "MR5",      /* France 2/M6 HD */
+    };
+
+    for( size_t k = 0; k < ARRAY_SIZE(ppsz_broken_providers); k++ )
+    {
+        if( i == strlen( ppsz_broken_providers[k] ) &&
+            !memcmp( p, ppsz_broken_providers[k], i ) )
+            return true;
+    }
+    return false;
+}
+
+static void ParseSDT( ts_record_reader_t *r, const uint8_t *p, size_t i )
+{
+    ts_record_t rec = {
+        .i_type = TS_RECORD_CHARSET,
+        .i_table_id = p[0],
+        .i_tsid = GetWBE( &p[3] ),
+        .i_onid = GetWBE( &p[8] ),
+        .i_offset = r->i_offset,
+    };
+    const uint8_t *d;
+    uint16_t i_sid;
+
+    i -= 4; /* CRC */
+    if( rec.i_table_id == 0x42 )
+    {
+        /* SKY DE & BetaDigital use ISO8859-1 */
+        rec.b_broken_charset = rec.i_onid == 133;
+        for( size_t j = 11; j + 5 <= i && !rec.b_broken_charset; )
+        {
+            if( ( d = NextService( p, i, &j, &i_sid ) ) )
+                rec.b_broken_charset = IsBrokenProvider( &d[2], d[1] );
+        }
+        r->pf_record( r->p_cb_data, &rec );
+    }
+
+    rec.i_type = TS_RECORD_SERVICE;
+    for( size_t j = 11; j + 5 <= i; )
+    {
+        if( !( d = NextService( p, i, &j, &i_sid ) ) )
+            continue;
+        rec.i_sid = i_sid;
+        rec.p_name = &d[3 + d[1]];
+        rec.i_name = d[2 + d[1]];
+        r->pf_record( r->p_cb_data, &rec );
+    }
+}
+
+static void ParseEIT( ts_record_reader_t *r, const uint8_t *p, size_t i )
+{
+    ts_record_t rec = {
+        .i_type = TS_RECORD_EVENT,
+        .i_table_id = p[0],
+        .i_sid = GetWBE( &p[3] ),
+        .i_tsid = GetWBE( &p[8] ),
+        .i_onid = GetWBE( &p[10] ),
+        .i_offset = r->i_offset,
+    };
+
+    i -= 4; /* CRC */
+    for( size_t j = 14; j + 12 <= i; )
+    {
+        rec.i_event_id = GetWBE( &p[j] );
+        rec.i_start = EITConvertStartTime( ( (uint64_t)GetDWBE( &p[j + 2] ) << 8 ) | p[j + 6] );
+        rec.i_duration = EITConvertDuration( ( GetWBE( &p[j + 7] ) << 8 ) | p[j + 9] );
+        const size_t i_loop = GetWBE( &p[j + 10] ) & 0xfff;
+        j += 12;
+        if( j + i_loop > i )
+            break;
+
+        /* Only the first short event, as the demux for the EPG */
+        size_t i_dr;
+        const uint8_t *d = FindDescriptor( &p[j], i_loop, 0x4d, &i_dr );
+        j += i_loop;
+        if( d == NULL || i_dr < 5 || 5u + d[3] > i_dr || 5u + d[3] + d[4 + d[3]] > i_dr ||
+            rec.i_start <= 0 )
+            continue;
+
+        rec.p_name = &d[4];
+        rec.i_name = d[3];
+        rec.p_text = &d[5 + d[3]];
+        rec.i_text = d[4 + d[3]];
+        r->pf_record( r->p_cb_data, &rec );
+    }
+}
+
+/* Space separated service ids of the service list descriptors, in
+ * hexadecimal as in the record keys */
+static void GetServiceList( char *psz_list, const uint8_t *p, size_t i )
+{
+    size_t i_len = 0;
+
+    for( size_t k = 0; k + 2 <= i && k + 2 + p[k + 1] <= i; k += 2 + p[k + 1] )
+    {
+        if( p[k] != 0x41 )
+            continue;
+        /* service_id, service_type */
+        for( size_t l = 0; l + 3 <= p[k + 1] && RECORD_SERVICES_SIZE - i_len > 5; l += 3 )
+            i_len += sprintf( &psz_list[i_len], i_len ? " %x" : "%x",
+                              GetWBE( &p[k + 2 + l] ) );
+    }
+    psz_list[i_len] = '\0';
+}
+
+/* NIT actual or other, or BAT: one record per transport stream */
+static void ParseNIT( ts_record_reader_t *r, const uint8_t *p, size_t i )
+{
+    char psz_services[RECORD_SERVICES_SIZE];
+    ts_record_t rec = {
+        .i_type = TS_RECORD_NETWORK,
+        .i_table_id = p[0],
+        .i_version = ( p[5] >> 1 ) & 0x1f,
+        .i_id = GetWBE( &p[3] ),
+        .i_offset = r->i_offset,
+        .psz_services = psz_services,
+    };
+
+    i -= 4; /* CRC */
+    size_t j = 10 + ( GetWBE( &p[8] ) & 0xfff );
+    if( j + 2 > i )
+        return;
+
+    /* Network or bouquet name */
+    size_t i_name;
+    rec.p_name = FindDescriptor( &p[10], j - 10, rec.i_table_id == 0x4a ? 0x47 : 0x40,
+                                 &i_name );
+    rec.i_name = rec.p_name ? i_name : 0;
+
+    const size_t i_end = __MIN( i, j + 2 + ( GetWBE( &p[j] ) & 0xfff ) );
+    for( j += 2; j + 6 <= i_end; )
+    {
+        const size_t i_loop = GetWBE( &p[j + 4] ) & 0xfff;
+        if( j + 6 + i_loop > i_end )
+            break;
+
+        rec.i_tsid = GetWBE( &p[j] );
+        rec.i_onid = GetWBE( &p[j + 2] );
+        GetServiceList( psz_services, &p[j + 6], i_loop );
+        r->pf_record( r->p_cb_data, &rec );
+        j += 6 + i_loop;
+    }
+}
+
+static void SectionDone( void *p_cb_data, uint16_t i_pid, const uint8_t *p, size_t i )
+{
+    ts_record_reader_t *r = p_cb_data;
+    const uint8_t i_table_id = p[0];
+
+    if( !( p[1] & 0x80 ) ) /* Short section (TDT...), no version */
+        return;
+    if( i < 12 || ts_section_CRC( p, i ) != 0 )
+        return;
+    if( !( p[5] & 0x01 ) ) /* not current */
+        return;
+
+    const ts_record_t table = {
+        .i_type = TS_RECORD_TABLE,
+        .i_table_id = i_table_id,
+        .i_version = ( p[5] >> 1 ) & 0x1f,
+        .i_pid = i_pid,
+        .i_id = GetWBE( &p[3] ),
+        .i_offset = r->i_offset,
+    };
+    r->pf_record( r->p_cb_data, &table );
+
+    if( i_table_id == 0x42 && i >= 15 )
+        ParseSDT( r, p, i );
+    else if( i_table_id >= 0x50 && i_table_id <= 0x5f && i >= 18 )
+        ParseEIT( r, p, i ); /* schedule, actual TS */
+    else if( !r->b_network_si )
+        return;
+    else if( ( i_table_id == 0x40 || i_table_id == 0x41 || i_table_id == 0x4a ) &&
+             i >= 16 )
+        ParseNIT( r, p, i );
+    else if( i_table_id == 0x46 && i >= 15 )
+        ParseSDT( r, p, i ); /* other TS */
+    else if( ( i_table_id == 0x4f || ( i_table_id >= 0x60 && i_table_id <= 0x6f ) ) &&
+             i >= 18 )
+        ParseEIT( r, p, i ); /* present/following and schedule, other TS */
+}
+
+ts_record_reader_t *ts_record_reader_New( bool b_network_si, ts_record_cb pf_record,
+                                          void *p_cb_data )
+{
+    ts_record_reader_t *r = calloc( 1, sizeof(*r) );
+    if( unlikely(r == NULL) )
+        return NULL;
+
+    r->b_network_si = b_network_si;
+    r->pf_record = pf_record;
+    r->p_cb_data = p_cb_data;
+
+    /* PSI/SI pids always carry tables */
+    static const uint16_t pi_si_pids[] = { 0x00, 0x01, 0x10, 0x11, 0x12, 0x14 };
+    for( size_t i = 0; i < ARRAY_SIZE(pi_si_pids); i++ )
+    {
+        if( !Watch( r, pi_si_pids[i] ) )
+        {
+            ts_record_reader_Delete( r );
+            return NULL;
+        }
+    }
+    return r;
+}
+
+void ts_record_reader_Delete( ts_record_reader_t *r )
+{
+    for( int i = 0; i < RECORD_PID_COUNT; i++ )
+        free( r->pp_sections[i] );
+    free( r );
+}
+
+void ts_record_reader_Packet( ts_record_reader_t *r, const uint8_t *p,
+                              uint64_t i_offset, bool b_discontinuity )
+{
+    const uint16_t i_pid = ( (p[1]&0x1f)<<8 )|p[2];
+    ts_section_t *p_sec = r->pp_sections[i_pid];
+
+    /* Damaged or scrambled: nothing can be read there */
+    if( ( p[1] & 0x80 ) || ( p[3] & 0xc0 ) )
+    {
+        if( p_sec )
+            ts_section_Reset( p_sec );
+        return;
+    }
+    if( p_sec && b_discontinuity )
+        ts_section_Reset( p_sec );
+    if( !( p[3] & 0x10 ) )
+        return;
+
+    const size_t i_skip = ( p[3] & 0x20 ) ? 5 + p[4] : 4;
+    if( i_skip >= 188 )
+        return;
+
+    if( p_sec == NULL )
+    {
+        /* A program is read from its first PMT section on, without waiting
+         * for a PAT: a reader may start anywhere in the stream */
+        const size_t i_table = i_skip + 1 + p[i_skip];
+        if( !( p[1] & 0x40 ) || i_table >= 188 || p[i_table] != 0x02 ||
+            !( p_sec = Watch( r, i_pid ) ) )
+            return;
+    }
+
+    r->i_offset = i_offset;
+    ts_section_Push( p_sec, i_pid, &p[i_skip], 188 - i_skip, p[1] & 0x40,
+                     SectionDone, r );
+}
+
+bool ts_record_reader_IsGathering( const ts_record_reader_t *r, uint16_t i_pid )
+{
+    const ts_section_t *p_sec = r->pp_sections[i_pid];
+    return p_sec && p_sec->b_gathering && p_sec->i_size > 0;
+}
+
+void ts_record_reader_Continue( ts_record_reader_t *r, uint16_t i_pid,
+                                const uint8_t *p, size_t i, uint64_t i_offset )
+{
+    r->i_offset = i_offset;
+    ts_section_Push( r->pp_sections[i_pid], i_pid, p, i, false, SectionDone, r );
+}
+
+/*****************************************************************************
+ * Set
+ *****************************************************************************/
+typedef struct
+{
+    uint64_t i_key;
+    uint64_t i_key2;    /* with the record type */
+    uint8_t  i_name;
+    uint8_t  p_name[];
+} record_key_t;
+
+/* Open addressing, with the 32 bits hash of each slot beside */
+struct ts_record_set_t
+{
+    record_key_t **pp_slots;
+    uint32_t      *pi_hashes;
+    size_t         i_mask;
+    size_t         i_count;
+};
+
+static inline uint32_t HashMix( uint64_t i_value )
+{
+    return ( i_value * UINT64_C(0x9E3779B97F4A7C15) ) >> 32;
+}
+
+static bool SetAlloc( ts_record_set_t *s, size_t i_slots )
+{
+    s->pp_slots = calloc( i_slots, sizeof(*s->pp_slots) );
+    s->pi_hashes = malloc( i_slots * sizeof(*s->pi_hashes) );
+    if( !s->pp_slots || !s->pi_hashes )
+    {
+        free( s->pp_slots );
+        free( s->pi_hashes );
+        return false;
+    }
+    s->i_mask = i_slots - 1;
+    return true;
+}
+
+ts_record_set_t *ts_record_set_New( void )
+{
+    ts_record_set_t *s = malloc( sizeof(*s) );
+    if( unlikely(s == NULL) )
+        return NULL;
+    if( !SetAlloc( s, RECORD_SET_INIT ) )
+    {
+        free( s );
+        return NULL;
+    }
+    s->i_count = 0;
+    return s;
+}
+
+void ts_record_set_Delete( ts_record_set_t *s )
+{
+    for( size_t i = 0; i <= s->i_mask; i++ )
+        free( s->pp_slots[i] );
+    free( s->pp_slots );
+    free( s->pi_hashes );
+    free( s );
+}
+
+static bool SetGrow( ts_record_set_t *s )
+{
+    ts_record_set_t grown;
+    if( !SetAlloc( &grown, ( s->i_mask + 1 ) * 2 ) )
+        return false;
+
+    for( size_t i = 0; i <= s->i_mask; i++ )
+    {
+        if( s->pp_slots[i] == NULL )
+            continue;
+        size_t j = s->pi_hashes[i] & grown.i_mask;
+        while( grown.pp_slots[j] )
+            j = ( j + 1 ) & grown.i_mask;
+        grown.pp_slots[j] = s->pp_slots[i];
+        grown.pi_hashes[j] = s->pi_hashes[i];
+    }
+    free( s->pp_slots );
+    free( s->pi_hashes );
+    s->pp_slots = grown.pp_slots;
+    s->pi_hashes = grown.pi_hashes;
+    s->i_mask = grown.i_mask;
+    return true;
+}
+
+int ts_record_set_Add( ts_record_set_t *s, const ts_record_t *p_rec )
+{
+    uint64_t i_key, i_key2 = (uint64_t)p_rec->i_type << 61;
+    const uint8_t *p_name = NULL;
+    uint8_t i_name = 0;
+
+    switch( p_rec->i_type )
+    {
+        case TS_RECORD_TABLE:
+            i_key = ( (uint64_t)p_rec->i_pid << 32 ) | ( (uint32_t)p_rec->i_table_id << 24 ) |
+                    ( (uint32_t)p_rec->i_id << 8 ) | p_rec->i_version;
+            break;
+        case TS_RECORD_SERVICE:
+            i_key = ( (uint64_t)p_rec->i_sid << 32 ) | ( (uint32_t)p_rec->i_tsid << 16 ) |
+                    p_rec->i_onid;
+            p_name = p_rec->p_name;
+            i_name = p_rec->i_name;
+            break;
+        case TS_RECORD_EVENT:
+            i_key = ( (uint64_t)p_rec->i_sid << 48 ) | ( (uint64_t)p_rec->i_tsid << 32 ) |
+                    ( (uint32_t)p_rec->i_onid << 16 ) | p_rec->i_event_id;
+            /* Seconds since 1970 fit in 40 bits, a duration in 20 */
+            i_key2 |= ( ( (uint64_t)p_rec->i_start & UINT64_C(0xffffffffff) ) << 20 ) |
+                      ( p_rec->i_duration & 0xfffff );
+            p_name = p_rec->p_name;
+            i_name = p_rec->i_name;
+            break;
+        case TS_RECORD_NETWORK:
+            i_key = ( (uint64_t)p_rec->i_table_id << 56 ) | ( (uint64_t)p_rec->i_version << 48 ) |
+                    ( (uint64_t)p_rec->i_id << 32 ) | ( (uint32_t)p_rec->i_tsid << 16 ) |
+                    p_rec->i_onid;
+            break;
+        default:
+            return 1;
+    }
+
+    /* FNV-1a over the name */
+    uint32_t i_hash = HashMix( i_key ^ ( i_key2 * UINT64_C(0xff51afd7ed558ccd) ) );
+    for( size_t i = 0; i < i_name; i++ )
+        i_hash = ( i_hash ^ p_name[i] ) * 16777619;
+
+    size_t i_slot;
+    for( i_slot = i_hash & s->i_mask; s->pp_slots[i_slot]; i_slot = ( i_slot + 1 ) & s->i_mask )
+    {
+        const record_key_t *k = s->pp_slots[i_slot];
+        if( s->pi_hashes[i_slot] == i_hash && k->i_key == i_key && k->i_key2 == i_key2 &&
+            k->i_name == i_name && !memcmp( k->p_name, p_name, i_name ) )
+            return 0;
+    }
+
+    /* Over half full, double it, or keep a free slot at least */
+    if( ( s->i_count + 1 ) * 2 > s->i_mask + 1 )
+    {
+        if( SetGrow( s ) )
+        {
+            for( i_slot = i_hash & s->i_mask; s->pp_slots[i_slot];
+                 i_slot = ( i_slot + 1 ) & s->i_mask );
+        }
+        else if( s->i_count + 1 > s->i_mask )
+            return -1;
+    }
+
+    record_key_t *k = malloc( sizeof(*k) + i_name );
+    if( unlikely(k == NULL) )
+        return -1;
+    k->i_key = i_key;
+    k->i_key2 = i_key2;
+    k->i_name = i_name;
+    if( i_name )
+        memcpy( k->p_name, p_name, i_name );
+    s->pp_slots[i_slot] = k;
+    s->pi_hashes[i_slot] = i_hash;
+    s->i_count++;
+    return 1;
+}
+
+/*****************************************************************************
+ * Writer
+ *****************************************************************************/
+
+/* EIT row waiting for the SDT to name its service */
+typedef struct
+{
+    char     psz_key[16]; /* "sid.tsid.onid" */
+    uint16_t i_sid;
+    uint16_t i_tsid;
+    uint16_t i_onid;
+    uint16_t i_event_id;
+    int64_t  i_start;
+    int      i_duration;
+    char    *psz_name;
+} record_event_t;
+
+struct ts_records_t
+{
+    ts_output_t        *p_out;
+    ts_record_set_t    *p_set;
+    bool                b_network_si;
+    ts_record_reader_t *p_reader;   /* of ts_records_Packet() */
+    bool                b_broken_charset;
+
+    ts_record_text_cb   pf_text;
+    void               *p_cb_data;
+    ts_text_t          *p_text;
+    char                p_arena[RECORD_ARENA_SIZE];
+
+    vlc_dictionary_t    services;   /* first names, by "sid.tsid.onid" */
+    DECL_ARRAY( record_event_t * ) pending_events;
+};
+
+/* The string is valid until the arena is reset */
+static const char *Text( ts_records_t *p_records, ts_text_arena_t *p_arena,
+                         const uint8_t *p, size_t i )
+{
+    if( p_records->pf_text )
+        return p_records->pf_text( p_records->p_cb_data, p_arena, p, i,
+                                   p_records->b_broken_charset );
+    /* The providers no longer broken send a selector */
+    if( p_records->b_broken_charset && i && *p > 0x20 )
+        return ts_text_DecodeLatin1( p_arena, p, i );
+    return ts_text_Decode( p_records->p_text, p_arena, p, i );
+}
+
+static void PutService( ts_records_t *p_records, const ts_record_t *p_rec,
+                        ts_text_arena_t *p_arena )
+{
+    const char *psz_name = Text( p_records, p_arena, p_rec->p_name, p_rec->i_name );
+    if( !psz_name )
+        return;
+
+    ts_output_ServiceRecord( p_records->p_out, p_rec->i_sid, p_rec->i_tsid,
+                             p_rec->i_onid, psz_name );
+
+    //ServiceID, TSID, ONID
+    char psz_key[16];
+    snprintf( psz_key, sizeof(psz_key), "%x.%x.%x",
+              p_rec->i_sid, p_rec->i_tsid, p_rec->i_onid );
+    char *psz_first;
+    if( vlc_dictionary_value_for_key( &p_records->services, psz_key ) ||
+        !( psz_first = strdup( psz_name ) ) )
+        return;
+    vlc_dictionary_insert( &p_records->services, psz_key, psz_first );
+
+    /* Release the events that were waiting for this name */
+    for( int i = 0; i < p_records->pending_events.i_size; )
+    {
+        record_event_t *p_evt = p_records->pending_events.p_elems[i];
+        if( strcmp( p_evt->psz_key, psz_key ) )
+        {
+            i++;
+            continue;
+        }
+        ts_output_EventRecord( p_records->p_out, psz_first, p_evt->i_sid,
+                               p_evt->i_tsid, p_evt->i_onid, p_evt->i_event_id,
+                               p_evt->i_start, p_evt->i_duration, p_evt->psz_name );
+        ARRAY_REMOVE( p_records->pending_events, i );
+        free( p_evt->psz_name );
+        free( p_evt );
+    }
+}
+
+static void PutEvent( ts_records_t *p_records, const ts_record_t *p_rec,
+                      ts_text_arena_t *p_arena )
+{
+    const char *psz_name = Text( p_records, p_arena, p_rec->p_name, p_rec->i_name );
+    const char *psz_text = Text( p_records, p_arena, p_rec->p_text, p_rec->i_text );
+    if( !psz_name || !psz_text )
+        return;
+
+    record_event_t evt = {
+        .i_sid = p_rec->i_sid,
+        .i_tsid = p_rec->i_tsid,
+        .i_onid = p_rec->i_onid,
+        .i_event_id = p_rec->i_event_id,
+        .i_start = p_rec->i_start,
+        .i_duration = p_rec->i_duration,
+    };
+    snprintf( evt.psz_key, sizeof(evt.psz_key), "%x.%x.%x",
+              evt.i_sid, evt.i_tsid, evt.i_onid );
+    const char *psz_service = vlc_dictionary_value_for_key( &p_records->services,
+                                                            evt.psz_key );
+    record_event_t *p_evt;
+    if( !psz_service && p_records->pending_events.i_size < RECORD_MAX_PENDING &&
+        ( p_evt = malloc( sizeof(*p_evt) ) ) )
+    {
+        *p_evt = evt;
+        if( ( p_evt->psz_name = strdup( psz_name ) ) )
+        {
+            ARRAY_APPEND( p_records->pending_events, p_evt );
+            return;
+        }
+        free( p_evt );
+    }
+    ts_output_EventRecord( p_records->p_out, psz_service, evt.i_sid, evt.i_tsid,
+                           evt.i_onid, evt.i_event_id, evt.i_start,
+                           evt.i_duration, psz_name );
+}
+
+static void WriteNetwork( ts_records_t *p_records, const ts_record_t *p_rec,
+                          ts_text_arena_t *p_arena )
+{
+    const char *psz_name = p_rec->p_name ?
+                           Text( p_records, p_arena, p_rec->p_name, p_rec->i_name ) : NULL;
+
+    if( p_rec->i_table_id == 0x4a )
+    {
+        const ts_output_field_t fields[] = {
+            TS_OUTPUT_HEX( "bouquet_id", p_rec->i_id ),
+            TS_OUTPUT_STR( "name", psz_name ),
+            TS_OUTPUT_HEX( "tsid", p_rec->i_tsid ),
+            TS_OUTPUT_HEX( "onid", p_rec->i_onid ),
+            TS_OUTPUT_STR( "services", p_rec->psz_services ),
+        };
+        ts_output_Record( p_records->p_out, "BOUQUET", fields, ARRAY_SIZE(fields) );
+    }
+    else
+    {
+        const ts_output_field_t fields[] = {
+            TS_OUTPUT_HEX( "table_id", p_rec->i_table_id ),
+            TS_OUTPUT_HEX( "network_id", p_rec->i_id ),
+            TS_OUTPUT_STR( "name", psz_name ),
+            TS_OUTPUT_HEX( "tsid", p_rec->i_tsid ),
+            TS_OUTPUT_HEX( "onid", p_rec->i_onid ),
+            TS_OUTPUT_STR( "services", p_rec->psz_services ),
+        };
+        ts_output_Record( p_records->p_out, "NETWORK", fields, ARRAY_SIZE(fields) );
+    }
+}
+
+static void WriteTable( ts_records_t *p_records, const ts_record_t *p_rec )
+{
+    const ts_output_field_t fields[] = {
+        TS_OUTPUT_INT( "pid", p_rec->i_pid ),
+        TS_OUTPUT_HEX( "table_id", p_rec->i_table_id ),
+        TS_OUTPUT_HEX( "extension", p_rec->i_id ),
+        TS_OUTPUT_INT( "version", p_rec->i_version ),
+        TS_OUTPUT_INT( "offset", p_rec->i_offset ),
+    };
+    ts_output_Record( p_records->p_out, "TABLE", fields, ARRAY_SIZE(fields) );
+}
+
+void ts_records_Put( ts_records_t *p_records, const ts_record_t *p_rec )
+{
+    if( p_rec->i_type == TS_RECORD_CHARSET )
+    {
+        p_records->b_broken_charset = p_rec->b_broken_charset;
+        return;
+    }
+    /* Without memory, a record is rather written twice than lost */
+    if( ts_record_set_Add( p_records->p_set, p_rec ) == 0 )
+        return;
+
+    ts_text_arena_t arena;
+    ts_text_ArenaInit( &arena, p_records->p_arena, sizeof(p_records->p_arena) );
+
+    switch( p_rec->i_type )
+    {
+        case TS_RECORD_TABLE:
+            WriteTable( p_records, p_rec );
+            break;
+        case TS_RECORD_SERVICE:
+            PutService( p_records, p_rec, &arena );
+            break;
+        case TS_RECORD_EVENT:
+            PutEvent( p_records, p_rec, &arena );
+            break;
+        case TS_RECORD_NETWORK:
+            WriteNetwork( p_records, p_rec, &arena );
+            break;
+        default:
+            break;
+    }
+}
+
+static void PutRecord( void *p_cb_data, const ts_record_t *p_rec )
+{
+    ts_records_Put( p_cb_data, p_rec );
+}
+
+void ts_records_Packet( ts_records_t *p_records, const uint8_t *p,
+                        uint64_t i_offset, bool b_discontinuity )
+{
+    if( unlikely(p_records->p_reader == NULL) )
+    {
+        p_records->p_reader = ts_record_reader_New( p_records->b_network_si,
+                                                    PutRecord, p_records );
+        if( p_records->p_reader == NULL )
+            return;
+    }
+    ts_record_reader_Packet( p_records->p_reader, p, i_offset, b_discontinuity );
+}
+
+ts_records_t *ts_records_New( ts_output_t *p_out, bool b_network_si,
+                              ts_record_text_cb pf_text, void *p_cb_data )
+{
+    ts_records_t *p_records = malloc( sizeof(*p_records) );
+    if( unlikely(p_records == NULL) )
+        return NULL;
+
+    p_records->p_out = p_out;
+    p_records->b_network_si = b_network_si;
+    p_records->p_reader = NULL;
+    p_records->b_broken_charset = false;
+    p_records->pf_text = pf_text;
+    p_records->p_cb_data = p_cb_data;
+    p_records->p_text = pf_text ? NULL : ts_text_New();
+    p_records->p_set = ts_record_set_New();
+    if( ( !pf_text && !p_records->p_text ) || !p_records->p_set )
+    {
+        if( p_records->p_text )
+            ts_text_Delete( p_records->p_text );
+        if( p_records->p_set )
+            ts_record_set_Delete( p_records->p_set );
+        free( p_records );
+        return NULL;
+    }
+    vlc_dictionary_init( &p_records->services, 0 );
+    ARRAY_INIT( p_records->pending_events );
+    return p_records;
+}
+
+static void FreeName( void *p_value, void *p_obj )
+{
+    VLC_UNUSED(p_obj);
+    free( p_value );
+}
+
+void ts_records_Delete( ts_records_t *p_records, const ts_stats_t *p_stats )
+{
+    for( int i = 0; i < p_records->pending_events.i_size; i++ )
+    {
+        record_event_t *p_evt = p_records->pending_events.p_elems[i];
+        ts_output_EventRecord( p_records->p_out, NULL, p_evt->i_sid,
+                               p_evt->i_tsid, p_evt->i_onid, p_evt->i_event_id,
+                               p_evt->i_start, p_evt->i_duration, p_evt->psz_name );
+        free( p_evt->psz_name );
+        free( p_evt );
+    }
+    ARRAY_RESET( p_records->pending_events );
+
+    for( int i = 0; p_stats && i < TS_STATS_PID_COUNT; i++ )
+    {
+        if( !p_stats->pi_slot[i] )
+            continue;
+        const ts_stats_pid_t *s = &p_stats->p_pids[p_stats->pi_slot[i] - 1];
+        const ts_output_field_t fields[] = {
+            TS_OUTPUT_INT( "pid", i ),
+            TS_OUTPUT_INT( "packets", s->i_packets ),
+            TS_OUTPUT_INT( "cc_errors", s->i_cc_errors ),
+            TS_OUTPUT_INT( "scrambled", s->i_scrambled ),
+            TS_OUTPUT_INT( "transport_errors", s->i_tei_errors ),
+        };
+        ts_output_Record( p_records->p_out, "PID", fields, ARRAY_SIZE(fields) );
+    }
+
+    vlc_dictionary_clear( &p_records->services, FreeName, NULL );
+    if( p_records->p_reader )
+        ts_record_reader_Delete( p_records->p_reader );
+    if( p_records->p_text )
+        ts_text_Delete( p_records->p_text );
+    ts_record_set_Delete( p_records->p_set );
+    free( p_records );
+}
@@ -0,0 +1,130 @@
+/*****************************************************************************
+ * ts_records.h: MPEG-TS analyser records of the tables
+ *****************************************************************************
+ * Copyright (C) 2004-2015 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifndef VLC_TS_RECORDS_H
+#define VLC_TS_RECORDS_H
+
+/* The records the demux and the whole file scan write about the tables,
+ * from the same code, so that both write the same records for a file:
+ *  TABLE   one per pid/table_id/extension/version, with the offset of the
+ *          packet ending its first section
+ *  SDT     one per service and name
+ *  EIT     one per event of the schedule, joined with the first name of
+ *          its service
+ *  PID     one per pid, with its packet and error counts, once done
+ * With b_network_si, as with --ts-network-si, the SDT and EIT of the other
+ * transport streams are written too (the EIT present/following as well),
+ * and:
+ *  NETWORK one per transport stream of a NIT version, actual or other
+ *  BOUQUET one per transport stream of a BAT version
+ *
+ * The tables are read section by section, from the PSI/SI pids and from the
+ * pids starting with a PMT section, so that a reader can start anywhere in
+ * a stream. Each section gives ts_record_t, which only keep the raw DVB
+ * texts. A writer drops those already written, then decodes the texts with
+ * the charset of the last SDT, as the demux does for the EPG.
+ *
+ * The demux reads and writes at once with ts_records_Packet(). The scan has
+ * a reader per range, and writes the records of all ranges in file order.
+ * Requires ts_output.h, ts_text.h and ts_stats.h. */
+
+typedef enum
+{
+    TS_RECORD_TABLE,
+    TS_RECORD_CHARSET,  /* SDT actual: charset of the texts from there */
+    TS_RECORD_SERVICE,
+    TS_RECORD_EVENT,
+    TS_RECORD_NETWORK,
+} ts_record_type_t;
+
+typedef struct
+{
+    ts_record_type_t i_type;
+    uint8_t  i_table_id;
+    uint8_t  i_version;
+    bool     b_broken_charset;  /* ISO/IEC 8859-1 without a selector */
+    uint16_t i_pid;
+    uint16_t i_id;              /* table id extension (TABLE), network or
+                                   bouquet id (NETWORK) */
+    uint16_t i_sid;
+    uint16_t i_tsid;
+    uint16_t i_onid;
+    uint16_t i_event_id;
+    int64_t  i_start;
+    int      i_duration;
+    uint64_t i_offset;          /* of the packet ending the section */
+    const uint8_t *p_name;      /* NULL if none */
+    uint8_t  i_name;
+    const uint8_t *p_text;      /* EVENT */
+    uint8_t  i_text;
+    const char *psz_services;   /* NETWORK */
+} ts_record_t;
+
+typedef void (*ts_record_cb)( void *p_cb_data, const ts_record_t * );
+
+/* Reader: the records are only valid during the callback */
+typedef struct ts_record_reader_t ts_record_reader_t;
+
+ts_record_reader_t *ts_record_reader_New( bool b_network_si, ts_record_cb,
+                                          void *p_cb_data );
+void ts_record_reader_Delete( ts_record_reader_t * );
+
+/* p is a whole packet read at i_offset, from its sync byte.
+ * b_discontinuity tells a continuity error, as ts_stats_Packet() counts it:
+ * the section being gathered is lost, the ones starting there are not */
+void ts_record_reader_Packet( ts_record_reader_t *, const uint8_t *p,
+                              uint64_t i_offset, bool b_discontinuity );
+
+/* A section of that pid is waiting for its end */
+bool ts_record_reader_IsGathering( const ts_record_reader_t *, uint16_t i_pid );
+/* Ends it with the payload bytes of the packet at i_offset, from another
+ * reader: the scan ends the sections cut between two ranges this way */
+void ts_record_reader_Continue( ts_record_reader_t *, uint16_t i_pid,
+                                const uint8_t *p, size_t i, uint64_t i_offset );
+
+/* Keys of the records already seen: everything but the offset of a TABLE,
+ * the text of an EVENT, and the name and services of a NETWORK */
+typedef struct ts_record_set_t ts_record_set_t;
+
+ts_record_set_t *ts_record_set_New( void );
+void ts_record_set_Delete( ts_record_set_t * );
+/* Returns 1 and adds the key if it was not in the set, 0 if it was,
+ * -1 without memory. CHARSET records have no key: 1 */
+int ts_record_set_Add( ts_record_set_t *, const ts_record_t * );
+
+/* Writer. pf_text decodes the texts of the records, ts_text_Decode() does
+ * when it is NULL */
+typedef const char *(*ts_record_text_cb)( void *p_cb_data, ts_text_arena_t *,
+                                          const uint8_t *p, size_t i,
+                                          bool b_broken_charset );
+
+typedef struct ts_records_t ts_records_t;
+
+ts_records_t *ts_records_New( ts_output_t *, bool b_network_si,
+                              ts_record_text_cb pf_text, void *p_cb_data );
+/* Writes the events still waiting for the name of their service, then the
+ * PID records of p_stats, if not NULL */
+void ts_records_Delete( ts_records_t *, const ts_stats_t *p_stats );
+
+void ts_records_Put( ts_records_t *, const ts_record_t * );
+/* Reads a packet with a reader of its own, and writes its records */
+void ts_records_Packet( ts_records_t *, const uint8_t *p, uint64_t i_offset,
+                        bool b_discontinuity );
+
+#endif
@@ -0,0 +1,519 @@
+/*****************************************************************************
+ * ts_scan.c: MPEG-TS parallel whole file analysis
+ *****************************************************************************
+ * Copyright (C) 2004-2015 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/*****************************************************************************
+ * Preamble
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <vlc_common.h>
+#include <vlc_demux.h>
+#include <vlc_fs.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef HAVE_MMAP
+# include <sys/mman.h>
+#endif
+#include <unistd.h>
+
+#include "ts_output.h"
+#include "ts_scan.h"
+#include "ts_sync.h"
+#include "ts_stats.h"
+#include "ts_text.h"
+#include "ts_records.h"
+
+#define SCAN_PID_COUNT   8192
+
+/* Smallest range given to a walker, below that threads cost more than
+ * they bring */
+#define SCAN_MIN_RANGE   (4 << 20)
+/* Packets of a pid kept at the start of a range, to end a section of the
+ * previous range: 4096 bytes of section, with room for packets without
+ * payload and duplicates */
+#define SCAN_LEAD_PACKETS 32
+
+/* First packet of a pid in a range, checked against the previous range */
+typedef struct
+{
+    bool    b_seen;
+    uint8_t i_cc;
+    bool    b_payload;
+    bool    b_discontinuity;
+} scan_first_t;
+
+/* Offsets of the packets of a pid up to its first unit start */
+typedef struct
+{
+    unsigned i_count;
+    bool     b_done;
+    uint64_t pi_offsets[SCAN_LEAD_PACKETS];
+} scan_lead_t;
+
+/* Record of a range, with a copy of its texts */
+typedef struct
+{
+    ts_record_t rec;
+    uint8_t    *p_data;
+    size_t      i_order;    /* in all the ranges, once merged */
+} scan_record_t;
+
+typedef struct
+{
+    const uint8_t *p_base;
+    uint64_t       i_file_size;
+    unsigned       i_packet_size;
+    unsigned       i_header_size;
+} scan_file_t;
+
+typedef struct
+{
+    const scan_file_t *p_file;
+    uint64_t        i_begin;
+    uint64_t        i_end;
+    vlc_thread_t    thread;
+
+    ts_stats_t         *p_stats;
+    scan_first_t       *p_first;    /* SCAN_PID_COUNT */
+    scan_lead_t       **pp_leads;   /* SCAN_PID_COUNT, NULL for the first range */
+    ts_record_reader_t *p_reader;
+    ts_record_set_t    *p_set;      /* records already logged */
+
+    /* In the order the range gave them, then those of the sections the
+     * range ended with the start of the next one */
+    DECL_ARRAY( scan_record_t ) records;
+} scan_walker_t;
+
+/*****************************************************************************
+ * Records
+ *****************************************************************************/
+static void LogRecord( void *p_cb_data, const ts_record_t *p_rec )
+{
+    scan_walker_t *w = p_cb_data;
+
+    /* The first one of a range is the only one the writer can keep */
+    if( ts_record_set_Add( w->p_set, p_rec ) == 0 )
+        return;
+
+    scan_record_t log = { .rec = *p_rec, .p_data = NULL, .i_order = 0 };
+    const size_t i_services = p_rec->psz_services ? strlen( p_rec->psz_services ) + 1 : 0;
+    const size_t i_data = p_rec->i_name + p_rec->i_text + i_services;
+    if( i_data )
+    {
+        uint8_t *p = log.p_data = xmalloc( i_data );
+        if( p_rec->p_name )
+        {
+            log.rec.p_name = memcpy( p, p_rec->p_name, p_rec->i_name );
+            p += p_rec->i_name;
+        }
+        if( p_rec->p_text )
+        {
+            log.rec.p_text = memcpy( p, p_rec->p_text, p_rec->i_text );
+            p += p_rec->i_text;
+        }
+        if( i_services )
+            log.rec.psz_services = memcpy( p, p_rec->psz_services, i_services );
+    }
+    ARRAY_APPEND( w->records, log );
+}
+
+/* By offset, then in the order the ranges gave them */
+static int RecordCmp( const void *a, const void *b )
+{
+    const scan_record_t *p_a = *(const scan_record_t **)a;
+    const scan_record_t *p_b = *(const scan_record_t **)b;
+
+    if( p_a->rec.i_offset != p_b->rec.i_offset )
+        return p_a->rec.i_offset < p_b->rec.i_offset ? -1 : 1;
+    return ( p_a->i_order > p_b->i_order ) - ( p_a->i_order < p_b->i_order );
+}
+
+/*****************************************************************************
+ * Walker
+ *****************************************************************************/
+static void WalkLead( scan_walker_t *w, uint16_t i_pid, const uint8_t *p,
+                      uint64_t i_offset )
+{
+    scan_lead_t *p_lead = w->pp_leads[i_pid];
+
+    if( p_lead == NULL )
+    {
+        p_lead = w->pp_leads[i_pid] = malloc( sizeof(*p_lead) );
+        if( unlikely(p_lead == NULL) )
+            return;
+        p_lead->i_count = 0;
+        p_lead->b_done = false;
+    }
+    else if( p_lead->b_done )
+        return;
+
+    p_lead->pi_offsets[p_lead->i_count++] = i_offset;
+    if( ( p[1] & 0x40 ) || p_lead->i_count == SCAN_LEAD_PACKETS )
+        p_lead->b_done = true;
+}
+
+static inline bool HasDiscontinuity( const uint8_t *p )
+{
+    return ( p[3] & 0x20 ) && p[4] > 0 && ( p[5] & 0x80 );
+}
+
+/* As the demux does for every packet it reads */
+static void WalkPacket( scan_walker_t *w, const uint8_t *p, uint64_t i_offset )
+{
+    const uint16_t i_pid = ( (p[1]&0x1f)<<8 )|p[2];
+
+    if( !w->p_stats->pi_slot[i_pid] )
+    {
+        w->p_first[i_pid] = (scan_first_t) {
+            .b_seen = true,
+            .i_cc = p[3] & 0x0f,
+            .b_payload = p[3] & 0x10,
+            .b_discontinuity = HasDiscontinuity( p ),
+        };
+    }
+    const unsigned i_events = ts_stats_Packet( w->p_stats, p );
+
+    if( w->pp_leads && i_pid != 0x1fff )
+        WalkLead( w, i_pid, p, i_offset );
+    ts_record_reader_Packet( w->p_reader, p, i_offset, i_events & TS_STATS_CC_ERROR );
+}
+
+/* Ends the sections cut at the end of the range of w with the packets at
+ * the start of the next range, as a single reader would have. Only the
+ * bytes before the pointer field of the first unit start are used, the
+ * sections starting there belong to p_next. */
+static void WalkNextLeads( scan_walker_t *w, const scan_walker_t *p_next )
+{
+    const scan_file_t *p_file = w->p_file;
+
+    for( int i_pid = 0; i_pid < SCAN_PID_COUNT; i_pid++ )
+    {
+        const scan_lead_t *p_lead = p_next->pp_leads[i_pid];
+        if( p_lead == NULL || !ts_record_reader_IsGathering( w->p_reader, i_pid ) )
+            continue;
+
+        uint8_t i_cc = w->p_stats->p_pids[w->p_stats->pi_slot[i_pid] - 1].i_cc;
+        for( unsigned i = 0; i < p_lead->i_count &&
+                             ts_record_reader_IsGathering( w->p_reader, i_pid ); i++ )
+        {
+            const uint64_t i_offset = p_lead->pi_offsets[i];
+            const uint8_t *p = &p_file->p_base[i_offset + p_file->i_header_size];
+            const uint8_t i_last = i_cc;
+
+            i_cc = p[3] & 0x0f;
+            if( ts_stats_CCError( i_pid, i_last, i_cc, p[3] & 0x10, HasDiscontinuity( p ) ) ||
+                ( p[1] & 0x80 ) || ( p[3] & 0xc0 ) )
+                break;
+            if( !( p[3] & 0x10 ) )
+                continue;
+
+            const size_t i_skip = ( p[3] & 0x20 ) ? 5 + p[4] : 4;
+            if( i_skip >= 188 )
+                continue;
+            if( p[1] & 0x40 )
+            {
+                const size_t i_pointer = p[i_skip];
+                if( i_skip + 1 + i_pointer < 188 )
+                    ts_record_reader_Continue( w->p_reader, i_pid, &p[i_skip + 1],
+                                               i_pointer, i_offset );
+                break;
+            }
+            ts_record_reader_Continue( w->p_reader, i_pid, &p[i_skip], 188 - i_skip,
+                                       i_offset );
+        }
+    }
+}
+
+static uint64_t Resync( const scan_file_t *p_file, uint64_t i_offset, uint64_t i_end )
+{
+    const unsigned i_size = p_file->i_packet_size;
+    const unsigned i_hdr = p_file->i_header_size;
+
+    if( i_offset >= i_end || i_offset + i_hdr + i_size > p_file->i_file_size )
+        return i_end;
+
+    /* Two sync bytes one packet apart, starting before i_end */
+    const size_t i_scan = __MIN( i_end - i_offset + i_size,
+                                 p_file->i_file_size - i_offset - i_hdr );
+    const uint8_t *p = &p_file->p_base[i_offset + i_hdr];
+    const size_t i_found = ts_sync_Find( p, i_scan, i_size, 2 );
+    if( i_found < ts_sync_Candidates( i_scan, i_size, 2 ) )
+        return i_offset + i_found;
+
+    /* The last packet of the file has no following sync byte */
+    const uint64_t i_last = p_file->i_file_size - i_hdr - i_size;
+    if( i_last >= i_offset && i_last < i_end &&
+        p_file->p_base[i_last + i_hdr] == 0x47 )
+        return i_last;
+    return i_end;
+}
+
+static void *WalkerThread( void *data )
+{
+    scan_walker_t *w = data;
+    const scan_file_t *p_file = w->p_file;
+    const unsigned i_size = p_file->i_packet_size;
+    const unsigned i_hdr = p_file->i_header_size;
+
+    for( uint64_t i_offset = w->i_begin;
+         i_offset < w->i_end && i_offset + i_hdr + 188 <= p_file->i_file_size; )
+    {
+        const uint8_t *p = &p_file->p_base[i_offset + i_hdr];
+        if( p[0] != 0x47 )
+        {
+            i_offset = Resync( p_file, i_offset + 1, w->i_end );
+            continue;
+        }
+        WalkPacket( w, p, i_offset );
+        i_offset += i_size;
+    }
+
+    return NULL;
+}
+
+static bool WalkerInit( scan_walker_t *w, const scan_file_t *p_file,
+                        uint64_t i_begin, uint64_t i_end, bool b_first,
+                        bool b_network_si )
+{
+    w->p_file = p_file;
+    w->i_begin = i_begin;
+    w->i_end = i_end;
+    ARRAY_INIT( w->records );
+    w->p_stats = ts_stats_New();
+    w->p_first = calloc( SCAN_PID_COUNT, sizeof(*w->p_first) );
+    if( !b_first )
+        w->pp_leads = calloc( SCAN_PID_COUNT, sizeof(*w->pp_leads) );
+    w->p_reader = ts_record_reader_New( b_network_si, LogRecord, w );
+    w->p_set = ts_record_set_New();
+    return w->p_stats && w->p_first && ( b_first || w->pp_leads ) &&
+           w->p_reader && w->p_set;
+}
+
+static void WalkerClean( scan_walker_t *w )
+{
+    if( w->pp_leads )
+    {
+        for( int i = 0; i < SCAN_PID_COUNT; i++ )
+            free( w->pp_leads[i] );
+    }
+    free( w->pp_leads );
+    free( w->p_first );
+    if( w->p_stats )
+        ts_stats_Delete( w->p_stats );
+    if( w->p_reader )
+        ts_record_reader_Delete( w->p_reader );
+    if( w->p_set )
+        ts_record_set_Delete( w->p_set );
+    for( int i = 0; i < w->records.i_size; i++ )
+        free( w->records.p_elems[i].p_data );
+    ARRAY_RESET( w->records );
+}
+
+/*****************************************************************************
+ * Merge and output
+ *****************************************************************************/
+static bool MergeStats( ts_stats_t *p_total, const scan_walker_t *w )
+{
+    for( int i = 0; i < SCAN_PID_COUNT; i++ )
+    {
+        if( !w->p_stats->pi_slot[i] )
+            continue;
+        const ts_stats_pid_t *b = &w->p_stats->p_pids[w->p_stats->pi_slot[i] - 1];
+        const scan_first_t *p_first = &w->p_first[i];
+        ts_stats_pid_t *a = ts_stats_GetPID( p_total, i );
+        if( unlikely(a == NULL) )
+            return false;
+
+        a->i_packets += b->i_packets;
+        a->i_cc_errors += b->i_cc_errors;
+        a->i_tei_errors += b->i_tei_errors;
+        a->i_discontinuities += b->i_discontinuities;
+        a->i_scrambled += b->i_scrambled;
+
+        /* Continuity across the range boundary */
+        if( ts_stats_CCError( i, a->i_cc, p_first->i_cc, p_first->b_payload,
+                              p_first->b_discontinuity ) )
+            a->i_cc_errors++;
+        a->i_cc = b->i_cc;
+    }
+    p_total->i_packets += w->p_stats->i_packets;
+    return true;
+}
+
+/* Writes the records of all ranges in file order, as the demux would have */
+static bool Output( ts_output_t *p_out, scan_walker_t *p_walkers,
+                    unsigned i_walkers, const ts_stats_t *p_stats, bool b_network_si )
+{
+    size_t i_records = 0;
+    for( unsigned i = 0; i < i_walkers; i++ )
+        i_records += p_walkers[i].records.i_size;
+
+    scan_record_t **pp_records = malloc( i_records * sizeof(*pp_records) + 1 );
+    ts_records_t *p_records = ts_records_New( p_out, b_network_si, NULL, NULL );
+    if( !pp_records || !p_records )
+    {
+        free( pp_records );
+        if( p_records )
+            ts_records_Delete( p_records, NULL );
+        return false;
+    }
+
+    /* Only the sections ended with the start of the next range are out of
+     * order. Those ended in the same packet keep the order they were read */
+    size_t i_count = 0;
+    for( unsigned i = 0; i < i_walkers; i++ )
+    {
+        for( int j = 0; j < p_walkers[i].records.i_size; j++ )
+        {
+            pp_records[i_count] = &p_walkers[i].records.p_elems[j];
+            pp_records[i_count]->i_order = i_count;
+            i_count++;
+        }
+    }
+    qsort( pp_records, i_count, sizeof(*pp_records), RecordCmp );
+
+    for( size_t i = 0; i < i_count; i++ )
+        ts_records_Put( p_records, &pp_records[i]->rec );
+    ts_records_Delete( p_records, p_stats );
+    free( pp_records );
+    return true;
+}
+
+/*****************************************************************************
+ * ts_scan_File
+ *****************************************************************************/
+int ts_scan_File( vlc_object_t *p_obj, ts_output_t *p_out, const char *psz_path,
+                  uint64_t i_start, unsigned i_packet_size,
+                  unsigned i_header_size, unsigned i_threads, bool b_network_si )
+{
+#ifdef HAVE_MMAP
+    int fd = vlc_open( psz_path, O_RDONLY );
+    if( fd == -1 )
+        return VLC_EGENERIC;
+
+    struct stat st;
+    if( fstat( fd, &st ) || !S_ISREG( st.st_mode ) || (uint64_t)st.st_size <= i_start ||
+        (uint64_t)st.st_size > SIZE_MAX )
+    {
+        close( fd );
+        return VLC_EGENERIC;
+    }
+
+    scan_file_t file = {
+        .i_file_size = st.st_size,
+        .i_packet_size = i_packet_size,
+        .i_header_size = i_header_size,
+    };
+    void *p_map = mmap( NULL, file.i_file_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    close( fd );
+    if( p_map == MAP_FAILED )
+    {
+        ts_output_Log( p_obj, VLC_MSG_ERR, "cannot map %s: %s", psz_path,
+                       vlc_strerror_c(errno) );
+        return VLC_EGENERIC;
+    }
+    file.p_base = p_map;
+    if( file.p_base[i_start + i_header_size] != 0x47 )
+    {
+        /* Not the bytes the demux reads (filtered stream) */
+        munmap( p_map, file.i_file_size );
+        return VLC_EGENERIC;
+    }
+#ifdef HAVE_POSIX_MADVISE
+    posix_madvise( p_map, file.i_file_size, POSIX_MADV_SEQUENTIAL );
+#endif
+
+    /* Split on packet boundaries */
+    const uint64_t i_packets = ( file.i_file_size - i_start ) / i_packet_size;
+    if( i_threads == 0 )
+        i_threads = 1;
+    if( i_threads > 1 && i_packets * i_packet_size / i_threads < SCAN_MIN_RANGE )
+        i_threads = __MAX( 1, i_packets * i_packet_size / SCAN_MIN_RANGE );
+
+    scan_walker_t *p_walkers = calloc( i_threads, sizeof(*p_walkers) );
+    ts_stats_t *p_stats = ts_stats_New();
+    int i_ret = VLC_ENOMEM;
+    unsigned i_started = 0;
+
+    if( !p_walkers || !p_stats )
+        goto end;
+
+    for( unsigned i = 0; i < i_threads; i++ )
+    {
+        const uint64_t i_begin = i_start + i_packets * i / i_threads * i_packet_size;
+        const uint64_t i_end = ( i + 1 == i_threads ) ? file.i_file_size :
+                               i_start + i_packets * ( i + 1 ) / i_threads * i_packet_size;
+        if( !WalkerInit( &p_walkers[i], &file, i_begin, i_end, i == 0,
+                         b_network_si ) )
+            goto end;
+    }
+
+    ts_output_Log( p_obj, VLC_MSG_DBG, "analysing %"PRIu64" bytes with %u threads",
+                   file.i_file_size - i_start, i_threads );
+
+    for( ; i_started < i_threads; i_started++ )
+    {
+        scan_walker_t *w = &p_walkers[i_started];
+        if( vlc_clone( &w->thread, WalkerThread, w, VLC_THREAD_PRIORITY_INPUT ) )
+            goto end;
+    }
+
+    /* Merge in file order, each range once the sections it left unfinished
+     * are ended with the start of the next one */
+    bool b_merged = true;
+    for( unsigned i = 0; i < i_threads; i++ )
+    {
+        scan_walker_t *w = &p_walkers[i];
+        vlc_join( w->thread, NULL );
+        b_merged &= MergeStats( p_stats, w );
+        if( i > 0 )
+            WalkNextLeads( &p_walkers[i - 1], w );
+    }
+    i_started = 0;
+
+    if( b_merged && Output( p_out, p_walkers, i_threads, p_stats, b_network_si ) )
+        i_ret = VLC_SUCCESS;
+
+end:
+    for( unsigned i = 0; i < i_started; i++ )
+        vlc_join( p_walkers[i].thread, NULL );
+    if( p_walkers )
+    {
+        for( unsigned i = 0; i < i_threads; i++ )
+            WalkerClean( &p_walkers[i] );
+    }
+    free( p_walkers );
+    if( p_stats )
+        ts_stats_Delete( p_stats );
+    munmap( p_map, file.i_file_size );
+    return i_ret;
+#else
+    VLC_UNUSED(p_obj); VLC_UNUSED(p_out); VLC_UNUSED(psz_path);
+    VLC_UNUSED(i_start); VLC_UNUSED(i_packet_size); VLC_UNUSED(i_header_size);
+    VLC_UNUSED(i_threads); VLC_UNUSED(b_network_si);
+    return VLC_EGENERIC;
+#endif
+}
@@ -0,0 +1,35 @@
+/*****************************************************************************
+ * ts_scan.h: MPEG-TS parallel whole file analysis
+ *****************************************************************************
+ * Copyright (C) 2004-2015 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifndef VLC_TS_SCAN_H
+#define VLC_TS_SCAN_H
+
+/* Maps the file and splits it, from the first packet at i_start, into
+ * packet aligned byte ranges walked by i_threads threads, each with its own
+ * ts_records.h reader and per pid counters. The records of the ranges are
+ * then written to p_out in file order, by a single writer: they are those
+ * the demux writes for the same file, whatever the thread scheduling, with
+ * neither the statistics nor the monitor records.
+ */
+int ts_scan_File( vlc_object_t *, ts_output_t *p_out, const char *psz_path,
+                  uint64_t i_start, unsigned i_packet_size,
+                  unsigned i_header_size, unsigned i_threads,
+                  bool b_network_si );
+
+#endif
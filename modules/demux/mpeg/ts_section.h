@@ -0,0 +1,51 @@
+/*****************************************************************************
+ * ts_section.h: MPEG-TS PSI/SI section assembly
+ *****************************************************************************
+ * Copyright (C) 2004-2015 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifndef VLC_TS_SECTION_H
+#define VLC_TS_SECTION_H
+
+#define TS_SECTION_MAX 4096
+
+/* Called for every complete section, whatever its CRC */
+typedef void (*ts_section_cb)( void *p_cb_data, uint16_t i_pid,
+                               const uint8_t *p_section, size_t i_section );
+
+/* Gathers the sections of one pid from the packet payloads */
+typedef struct
+{
+    size_t  i_size;
+    size_t  i_need;
+    bool    b_gathering;
+    uint8_t p_buf[TS_SECTION_MAX];
+} ts_section_t;
+
+static inline void ts_section_Reset( ts_section_t *p_sec )
+{
+    p_sec->i_size = 0;
+    p_sec->b_gathering = false;
+}
+
+/* p points to the packet payload, after any adaptation field */
+void ts_section_Push( ts_section_t *, uint16_t i_pid, const uint8_t *p, size_t i,
+                      bool b_unit_start, ts_section_cb, void *p_cb_data );
+
+/* MPEG-2 CRC32 over the whole section, 0 if it is valid */
+uint32_t ts_section_CRC( const uint8_t *p, size_t i );
+
+#endif
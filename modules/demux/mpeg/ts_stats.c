@@ -0,0 +1,226 @@
+/*****************************************************************************
+ * ts_stats.c: MPEG-TS per pid statistics
+ *****************************************************************************
+ * Copyright (C) 2004-2015 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/*****************************************************************************
+ * Preamble
+ *****************************************************************************/
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <vlc_common.h>
+#include <vlc_demux.h>
+
+#include "ts_stats.h"
+
+#define PCR_FREQ            INT64_C(27000000)
+#define PCR_WRAP            ( (INT64_C(1) << 33) * 300 )
+#define PACKET_BITS         (188 * 8)
+
+/* ETSI TR 101 290 PCR_repetition_error, PCR_discontinuity_indicator_error
+ * and PCR_accuracy_error limits */
+#define PCR_INTERVAL_LIMIT  ( PCR_FREQ * 40 / 1000 )
+#define PCR_JUMP_LIMIT      ( PCR_FREQ * 100 / 1000 )
+#define PCR_ACCURACY_LIMIT  500 /* ns */
+
+ts_stats_t *ts_stats_New( void )
+{
+    ts_stats_t *p_stats = calloc( 1, sizeof(*p_stats) );
+    if( !p_stats )
+        return NULL;
+    p_stats->i_window_date = mdate();
+    return p_stats;
+}
+
+void ts_stats_Delete( ts_stats_t *p_stats )
+{
+    free( p_stats->p_pids );
+    free( p_stats );
+}
+
+ts_stats_pid_t *ts_stats_AddPID( ts_stats_t *p_stats, uint16_t i_pid )
+{
+    if( p_stats->i_pids == p_stats->i_alloc )
+    {
+        const size_t i_alloc = p_stats->i_alloc ? 2 * p_stats->i_alloc : 16;
+        ts_stats_pid_t *p_pids = realloc( p_stats->p_pids,
+                                          i_alloc * sizeof(*p_pids) );
+        if( !p_pids )
+            return NULL;
+        p_stats->p_pids = p_pids;
+        p_stats->i_alloc = i_alloc;
+    }
+
+    ts_stats_pid_t *s = &p_stats->p_pids[p_stats->i_pids];
+    memset( s, 0, sizeof(*s) );
+    s->i_pid = i_pid;
+    s->i_cc = TS_STATS_CC_UNSEEN;
+    s->i_pcr_last = -1;
+    s->i_rate_pcr = -1;
+    p_stats->pi_slot[i_pid] = ++p_stats->i_pids;
+    return s;
+}
+
+static int64_t PCRDelta( int64_t i_from, int64_t i_to )
+{
+    int64_t i_delta = i_to - i_from;
+    if( i_delta < 0 )
+        i_delta += PCR_WRAP;
+    return i_delta;
+}
+
+unsigned ts_stats_PCR( ts_stats_t *p_stats, ts_stats_pid_t *s, const uint8_t *p,
+                       bool b_discontinuity )
+{
+    unsigned i_events = TS_STATS_PCR;
+    const int64_t i_base = ( (int64_t)p[6] << 25 ) | ( p[7] << 17 ) |
+                           ( p[8] << 9 ) | ( p[9] << 1 ) | ( p[10] >> 7 );
+    const int64_t i_pcr = i_base * 300 + ( ( (p[10] & 0x01) << 8 ) | p[11] );
+    const uint64_t i_packet = p_stats->i_packets - 1;
+
+    s->i_pcrs++;
+
+    if( s->i_pcr_last < 0 || b_discontinuity )
+    {
+        /* New time base, nothing to compare with */
+        s->i_rate_pcr = i_pcr;
+        s->i_rate_packet = i_packet;
+    }
+    else
+    {
+        const int64_t i_delta = PCRDelta( s->i_pcr_last, i_pcr );
+        if( i_delta > s->i_pcr_interval_max )
+            s->i_pcr_interval_max = i_delta;
+        if( i_delta > PCR_INTERVAL_LIMIT )
+        {
+            s->i_pcr_interval_errors++;
+            i_events |= TS_STATS_PCR_INTERVAL;
+        }
+        /* Going back wraps to a huge delta. The rate is measured again
+         * from there, as after a signalled discontinuity */
+        if( i_delta > PCR_JUMP_LIMIT )
+        {
+            s->i_pcr_discontinuity_errors++;
+            i_events |= TS_STATS_PCR_DISCONTINUITY;
+            s->i_rate_pcr = i_pcr;
+            s->i_rate_packet = i_packet;
+        }
+        /* The PCR should match the time the bytes since the previous one
+         * take at the transport rate */
+        else if( s->i_rate > 0 )
+        {
+            const int64_t i_expected = (i_packet - s->i_pcr_last_packet) *
+                                       PACKET_BITS * PCR_FREQ / s->i_rate;
+            int64_t i_jitter = ( i_delta - i_expected ) * 1000 / 27;
+            if( i_jitter < 0 )
+                i_jitter = -i_jitter;
+            if( i_jitter > s->i_pcr_accuracy_max )
+                s->i_pcr_accuracy_max = i_jitter;
+            if( i_jitter > PCR_ACCURACY_LIMIT )
+            {
+                s->i_pcr_accuracy_errors++;
+                i_events |= TS_STATS_PCR_ACCURACY;
+            }
+        }
+
+        const int64_t i_span = PCRDelta( s->i_rate_pcr, i_pcr );
+        if( i_span >= PCR_FREQ )
+        {
+            s->i_rate = (i_packet - s->i_rate_packet) * PACKET_BITS *
+                        PCR_FREQ / i_span;
+            s->i_rate_pcr = i_pcr;
+            s->i_rate_packet = i_packet;
+        }
+    }
+
+    s->i_pcr_last = i_pcr;
+    s->i_pcr_last_packet = i_packet;
+    return i_events;
+}
+
+bool ts_stats_Tick( ts_stats_t *p_stats, mtime_t i_now )
+{
+    const mtime_t i_elapsed = i_now - p_stats->i_window_date;
+    if( i_elapsed < TS_STATS_WINDOW )
+        return false;
+
+    const uint64_t i_packets = p_stats->i_packets - p_stats->i_window_packets;
+
+    /* The transport rate from the PCR is right whatever the reading pace,
+     * the reading rate is only a fallback */
+    uint64_t i_rate = 0;
+    for( size_t i = 0; i < p_stats->i_pids && i_rate == 0; i++ )
+        i_rate = p_stats->p_pids[i].i_rate;
+    if( i_rate == 0 )
+        i_rate = i_packets * PACKET_BITS * CLOCK_FREQ / i_elapsed;
+    p_stats->i_bitrate = i_rate;
+
+    for( size_t i = 0; i < p_stats->i_pids; i++ )
+    {
+        ts_stats_pid_t *s = &p_stats->p_pids[i];
+        const uint64_t i_pid_packets = s->i_packets - s->i_window_packets;
+        s->i_bitrate = i_packets ? i_rate * i_pid_packets / i_packets : 0;
+        s->i_window_packets = s->i_packets;
+    }
+
+    p_stats->i_window_packets = p_stats->i_packets;
+    p_stats->i_window_date = i_now;
+    return true;
+}
+
+demux_ts_stats_t *ts_stats_Get( const ts_stats_t *p_stats )
+{
+    demux_ts_stats_t *p_snap = malloc( sizeof(*p_snap) +
+                                       p_stats->i_pids * sizeof(*p_snap->p_pids) );
+    if( !p_snap )
+        return NULL;
+
+    p_snap->i_date = p_stats->i_window_date;
+    p_snap->i_packets = p_stats->i_packets;
+    p_snap->i_bitrate = p_stats->i_bitrate;
+    p_snap->i_sync_losses = p_stats->i_sync_losses;
+    p_snap->i_pids = p_stats->i_pids;
+    p_snap->p_pids = (demux_ts_pid_stats_t *)&p_snap[1];
+
+    demux_ts_pid_stats_t *p_pid = p_snap->p_pids;
+    for( unsigned i_pid = 0; i_pid < TS_STATS_PID_COUNT; i_pid++ )
+    {
+        if( !p_stats->pi_slot[i_pid] )
+            continue;
+        const ts_stats_pid_t *s = &p_stats->p_pids[p_stats->pi_slot[i_pid] - 1];
+
+        p_pid->i_pid = i_pid;
+        p_pid->i_packets = s->i_packets;
+        p_pid->i_bytes = s->i_packets * 188;
+        p_pid->i_bitrate = s->i_bitrate;
+        p_pid->i_cc_errors = s->i_cc_errors;
+        p_pid->i_tei_errors = s->i_tei_errors;
+        p_pid->i_discontinuities = s->i_discontinuities;
+        p_pid->i_scrambled = s->i_scrambled;
+        p_pid->i_pcrs = s->i_pcrs;
+        p_pid->i_pcr_interval_errors = s->i_pcr_interval_errors;
+        p_pid->i_pcr_discontinuity_errors = s->i_pcr_discontinuity_errors;
+        p_pid->i_pcr_interval_max = s->i_pcr_interval_max / 27;
+        p_pid->i_pcr_accuracy_errors = s->i_pcr_accuracy_errors;
+        p_pid->i_pcr_accuracy_max = s->i_pcr_accuracy_max;
+        p_pid++;
+    }
+    return p_snap;
+}
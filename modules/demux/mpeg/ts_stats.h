@@ -0,0 +1,159 @@
+/*****************************************************************************
+ * ts_stats.h: MPEG-TS per pid statistics
+ *****************************************************************************
+ * Copyright (C) 2004-2015 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifndef VLC_TS_STATS_H
+#define VLC_TS_STATS_H
+
+/* Per pid counters, updated for every packet with a few increments.
+ * PCR checks are done out of line, and the windowed values (bitrates)
+ * are only computed every TS_STATS_WINDOW by ts_stats_Tick(). */
+
+#define TS_STATS_WINDOW      CLOCK_FREQ
+#define TS_STATS_PID_COUNT   8192
+#define TS_STATS_CC_UNSEEN   0xff
+
+/* Events of one packet, returned by ts_stats_Packet() */
+#define TS_STATS_CC_ERROR           0x01
+#define TS_STATS_TEI                0x02
+#define TS_STATS_PCR                0x04 /* carries a PCR */
+#define TS_STATS_PCR_INTERVAL       0x08 /* above 40 ms since the previous */
+#define TS_STATS_PCR_DISCONTINUITY  0x10 /* jump, or going back, unsignalled */
+#define TS_STATS_PCR_ACCURACY       0x20 /* jitter above 500 ns */
+
+typedef struct
+{
+    uint64_t i_packets;
+    uint64_t i_cc_errors;
+    uint64_t i_tei_errors;
+    uint64_t i_discontinuities;
+    uint64_t i_scrambled;
+    uint16_t i_pid;
+    uint8_t  i_cc;
+
+    /* PCR, in 27 MHz units, and packet index in the whole stream */
+    uint64_t i_pcrs;
+    int64_t  i_pcr_last;            /* -1 if none */
+    uint64_t i_pcr_last_packet;
+    uint64_t i_pcr_interval_errors;
+    uint64_t i_pcr_discontinuity_errors;
+    int64_t  i_pcr_interval_max;    /* 27 MHz */
+    uint64_t i_pcr_accuracy_errors;
+    int64_t  i_pcr_accuracy_max;    /* ns */
+
+    /* Transport rate measured between PCRs at least a second apart,
+     * the reference for the accuracy of the next PCRs */
+    int64_t  i_rate_pcr;            /* -1 if none */
+    uint64_t i_rate_packet;
+    uint64_t i_rate;                /* bits per second, 0 if unknown */
+
+    /* Window */
+    uint64_t i_window_packets;
+    uint64_t i_bitrate;
+} ts_stats_pid_t;
+
+typedef struct
+{
+    uint64_t i_packets;
+    uint64_t i_sync_losses;
+
+    /* Slot + 1 of each pid in p_pids, 0 if not seen yet */
+    uint16_t pi_slot[TS_STATS_PID_COUNT];
+    ts_stats_pid_t *p_pids;
+    size_t   i_pids;
+    size_t   i_alloc;
+
+    /* Window */
+    mtime_t  i_window_date;
+    uint64_t i_window_packets;
+    uint64_t i_bitrate;
+} ts_stats_t;
+
+ts_stats_t *ts_stats_New( void );
+void ts_stats_Delete( ts_stats_t * );
+
+ts_stats_pid_t *ts_stats_AddPID( ts_stats_t *, uint16_t i_pid );
+unsigned ts_stats_PCR( ts_stats_t *, ts_stats_pid_t *, const uint8_t *p_pkt,
+                       bool b_discontinuity );
+
+/* Closes the window once TS_STATS_WINDOW has elapsed since the previous one,
+ * returns true if it did */
+bool ts_stats_Tick( ts_stats_t *, mtime_t i_now );
+
+/* Allocated snapshot, to be released with free() */
+demux_ts_stats_t *ts_stats_Get( const ts_stats_t * );
+
+static inline ts_stats_pid_t *ts_stats_GetPID( ts_stats_t *p_stats, uint16_t i_pid )
+{
+    if( likely(p_stats->pi_slot[i_pid]) )
+        return &p_stats->p_pids[p_stats->pi_slot[i_pid] - 1];
+    return ts_stats_AddPID( p_stats, i_pid );
+}
+
+/* Same rules as the demuxer: a duplicate or a packet without payload
+ * keeps the counter, null packets have none */
+static inline bool ts_stats_CCError( uint16_t i_pid, uint8_t i_last, uint8_t i_cc,
+                                     bool b_payload, bool b_discontinuity )
+{
+    const uint8_t i_diff = ( i_cc - i_last ) & 0x0f;
+    return i_last != TS_STATS_CC_UNSEEN && !( b_payload && i_diff == 1 ) &&
+           i_diff != 0 && !b_discontinuity && i_pid != 0x1fff;
+}
+
+/* Accounts one packet, starting with its sync byte.
+ * Returns the TS_STATS_* events it raised */
+static inline unsigned ts_stats_Packet( ts_stats_t *p_stats, const uint8_t *p )
+{
+    const uint16_t i_pid = ( (p[1] & 0x1f) << 8 ) | p[2];
+    ts_stats_pid_t *s = ts_stats_GetPID( p_stats, i_pid );
+    unsigned i_events = 0;
+
+    if( unlikely(s == NULL) )
+        return 0;
+
+    p_stats->i_packets++;
+    s->i_packets++;
+    if( p[1] & 0x80 )
+    {
+        s->i_tei_errors++;
+        i_events |= TS_STATS_TEI;
+    }
+    if( p[3] & 0xc0 )
+        s->i_scrambled++;
+
+    bool b_discontinuity = false;
+    if( (p[3] & 0x20) && p[4] > 0 )
+    {
+        b_discontinuity = p[5] & 0x80;
+        if( b_discontinuity )
+            s->i_discontinuities++;
+        if( (p[5] & 0x10) && p[4] >= 7 )
+            i_events |= ts_stats_PCR( p_stats, s, p, b_discontinuity );
+    }
+
+    const uint8_t i_cc = p[3] & 0x0f;
+    if( ts_stats_CCError( i_pid, s->i_cc, i_cc, p[3] & 0x10, b_discontinuity ) )
+    {
+        s->i_cc_errors++;
+        i_events |= TS_STATS_CC_ERROR;
+    }
+    s->i_cc = i_cc;
+    return i_events;
+}
+
+#endif
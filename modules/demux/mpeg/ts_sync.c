@@ -0,0 +1,152 @@
+/*****************************************************************************
+ * ts_sync.c: MPEG-TS sync byte scanner
+ *****************************************************************************
+ * Copyright (C) 2004-2015 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/*****************************************************************************
+ * Preamble
+ *****************************************************************************/
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <vlc_common.h>
+#include <vlc_cpu.h>
+
+#include "ts_sync.h"
+
+#if defined(__SSE2__)
+# define TS_SYNC_SSE2
+#endif
+#if (defined(__i386__) || defined(__x86_64__)) && \
+    (defined(__AVX2__) || VLC_GCC_VERSION(4, 9) || defined(__clang__))
+# define TS_SYNC_AVX2
+#endif
+
+#if defined(TS_SYNC_SSE2) || defined(TS_SYNC_AVX2)
+# include <immintrin.h>
+#endif
+
+#define TS_SYNC_BYTE 0x47
+
+static size_t FindC( const uint8_t *p, size_t i_candidates,
+                     size_t i_stride, unsigned i_count, size_t i )
+{
+    for( ; i < i_candidates; i++ )
+    {
+        unsigned k = 0;
+        while( k < i_count && p[i + k * i_stride] == TS_SYNC_BYTE )
+            k++;
+        if( k == i_count )
+            return i;
+    }
+    return i_candidates;
+}
+
+/* The vector versions test 16 or 32 consecutive candidates at once: one
+ * unaligned load per spaced sync byte, compared against 0x47 and and'ed
+ * together. The remaining loads are skipped as soon as no lane is left. */
+#ifdef TS_SYNC_SSE2
+static size_t FindSSE2( const uint8_t *p, size_t i_candidates,
+                        size_t i_stride, unsigned i_count )
+{
+    const __m128i sync = _mm_set1_epi8( TS_SYNC_BYTE );
+    size_t i = 0;
+
+    for( ; i + 16 <= i_candidates; i += 16 )
+    {
+        __m128i m = _mm_cmpeq_epi8( _mm_loadu_si128( (const __m128i *)&p[i] ), sync );
+        unsigned i_mask = _mm_movemask_epi8( m );
+        for( unsigned k = 1; k < i_count && i_mask; k++ )
+        {
+            const __m128i v = _mm_loadu_si128( (const __m128i *)&p[i + k * i_stride] );
+            m = _mm_and_si128( m, _mm_cmpeq_epi8( v, sync ) );
+            i_mask = _mm_movemask_epi8( m );
+        }
+        if( i_mask )
+            return i + ctz( i_mask );
+    }
+    return FindC( p, i_candidates, i_stride, i_count, i );
+}
+#endif
+
+#ifdef TS_SYNC_AVX2
+__attribute__ ((__target__ ("avx2")))
+static size_t FindAVX2( const uint8_t *p, size_t i_candidates,
+                        size_t i_stride, unsigned i_count )
+{
+    const __m256i sync = _mm256_set1_epi8( TS_SYNC_BYTE );
+    size_t i = 0;
+
+    for( ; i + 32 <= i_candidates; i += 32 )
+    {
+        __m256i m = _mm256_cmpeq_epi8( _mm256_loadu_si256( (const __m256i *)&p[i] ), sync );
+        unsigned i_mask = _mm256_movemask_epi8( m );
+        for( unsigned k = 1; k < i_count && i_mask; k++ )
+        {
+            const __m256i v = _mm256_loadu_si256( (const __m256i *)&p[i + k * i_stride] );
+            m = _mm256_and_si256( m, _mm256_cmpeq_epi8( v, sync ) );
+            i_mask = _mm256_movemask_epi8( m );
+        }
+        if( i_mask )
+            return i + ctz( i_mask );
+    }
+    return FindC( p, i_candidates, i_stride, i_count, i );
+}
+#endif
+
+size_t ts_sync_Find( const uint8_t *p_buf, size_t i_size,
+                     size_t i_stride, unsigned i_count )
+{
+    if( i_count == 0 )
+        return 0;
+    const size_t i_candidates = ts_sync_Candidates( i_size, i_stride, i_count );
+
+#ifdef TS_SYNC_AVX2
+    if( vlc_CPU_AVX2() )
+        return FindAVX2( p_buf, i_candidates, i_stride, i_count );
+#endif
+#ifdef TS_SYNC_SSE2
+    return FindSSE2( p_buf, i_candidates, i_stride, i_count );
+#else
+    return FindC( p_buf, i_candidates, i_stride, i_count, 0 );
+#endif
+}
+
+int ts_sync_DetectPacketSize( const uint8_t *p_buf, size_t i_size,
+                              size_t *pi_sync, unsigned *pi_header_size )
+{
+    static const unsigned pi_sizes[] = { 188, 192, 204 };
+
+    int i_packet_size = -1;
+    size_t i_sync = 204;
+    for( size_t i = 0; i < ARRAY_SIZE(pi_sizes); i++ )
+    {
+        const size_t i_scan = __MIN( i_size, i_sync + 3 * pi_sizes[i] );
+        const size_t i_found = ts_sync_Find( p_buf, i_scan, pi_sizes[i], 4 );
+        if( i_found < ts_sync_Candidates( i_scan, pi_sizes[i], 4 ) )
+        {
+            i_sync = i_found;
+            i_packet_size = pi_sizes[i];
+        }
+    }
+
+    *pi_sync = i_sync;
+    *pi_header_size = ( i_packet_size == 192 && i_sync == 4 ) ? 4 : 0;
+    return i_packet_size;
+}
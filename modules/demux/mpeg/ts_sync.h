@@ -0,0 +1,48 @@
+/*****************************************************************************
+ * ts_sync.h: MPEG-TS sync byte scanner
+ *****************************************************************************
+ * Copyright (C) 2004-2015 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifndef VLC_TS_SYNC_H
+#define VLC_TS_SYNC_H
+
+/* Looks for the first offset in p_buf holding i_count sync bytes spaced by
+ * i_stride bytes. Candidate offsets are the i_size - (i_count - 1) * i_stride
+ * first ones, so that every checked byte lies within the buffer.
+ * Returns the offset found or, if there is none, the number of candidates
+ * (0 when the buffer is too small), all of which can then be skipped. */
+size_t ts_sync_Find( const uint8_t *p_buf, size_t i_size,
+                     size_t i_stride, unsigned i_count );
+
+/* Number of candidate offsets for ts_sync_Find() */
+static inline size_t ts_sync_Candidates( size_t i_size, size_t i_stride,
+                                         unsigned i_count )
+{
+    const size_t i_span = (size_t)(i_count - 1) * i_stride;
+    return i_size > i_span ? i_size - i_span : 0;
+}
+
+/* Packet size of the stream starting in p_buf, 188, 192 or 204, given by
+ * the earliest offset followed by 3 more sync bytes at that size, the
+ * smallest size winning at the same offset. That offset is stored in
+ * *pi_sync, and the size of the header before the sync byte of BluRay
+ * packets in *pi_header_size. Returns -1 without any sync within the
+ * first 204 bytes. */
+int ts_sync_DetectPacketSize( const uint8_t *p_buf, size_t i_size,
+                              size_t *pi_sync, unsigned *pi_header_size );
+
+#endif
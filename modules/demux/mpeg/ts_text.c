@@ -0,0 +1,651 @@
+/*****************************************************************************
+ * ts_text.c: DVB SI text decoding
+ *****************************************************************************
+ * Copyright (C) 2004-2015 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/*****************************************************************************
+ * Preamble
+ *****************************************************************************/
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <errno.h>
+
+#include <vlc_common.h>
+#include <vlc_charset.h>
+
+#include "ts_text.h"
+
+#define DIACRITIC 0xffff
+
+/* ISO/IEC 8859-1 to 15 from 0xA0, 0 where undefined.
+ * 0x00-0x9F are the same code points in all of them */
+static const uint16_t iso8859[16][96] =
+{
+    [1] = {
+        0x00a0, 0x00a1, 0x00a2, 0x00a3, 0x00a4, 0x00a5, 0x00a6, 0x00a7,
+        0x00a8, 0x00a9, 0x00aa, 0x00ab, 0x00ac, 0x00ad, 0x00ae, 0x00af,
+        0x00b0, 0x00b1, 0x00b2, 0x00b3, 0x00b4, 0x00b5, 0x00b6, 0x00b7,
+        0x00b8, 0x00b9, 0x00ba, 0x00bb, 0x00bc, 0x00bd, 0x00be, 0x00bf,
+        0x00c0, 0x00c1, 0x00c2, 0x00c3, 0x00c4, 0x00c5, 0x00c6, 0x00c7,
+        0x00c8, 0x00c9, 0x00ca, 0x00cb, 0x00cc, 0x00cd, 0x00ce, 0x00cf,
+        0x00d0, 0x00d1, 0x00d2, 0x00d3, 0x00d4, 0x00d5, 0x00d6, 0x00d7,
+        0x00d8, 0x00d9, 0x00da, 0x00db, 0x00dc, 0x00dd, 0x00de, 0x00df,
+        0x00e0, 0x00e1, 0x00e2, 0x00e3, 0x00e4, 0x00e5, 0x00e6, 0x00e7,
+        0x00e8, 0x00e9, 0x00ea, 0x00eb, 0x00ec, 0x00ed, 0x00ee, 0x00ef,
+        0x00f0, 0x00f1, 0x00f2, 0x00f3, 0x00f4, 0x00f5, 0x00f6, 0x00f7,
+        0x00f8, 0x00f9, 0x00fa, 0x00fb, 0x00fc, 0x00fd, 0x00fe, 0x00ff,
+    },
+    [2] = {
+        0x00a0, 0x0104, 0x02d8, 0x0141, 0x00a4, 0x013d, 0x015a, 0x00a7,
+        0x00a8, 0x0160, 0x015e, 0x0164, 0x0179, 0x00ad, 0x017d, 0x017b,
+        0x00b0, 0x0105, 0x02db, 0x0142, 0x00b4, 0x013e, 0x015b, 0x02c7,
+        0x00b8, 0x0161, 0x015f, 0x0165, 0x017a, 0x02dd, 0x017e, 0x017c,
+        0x0154, 0x00c1, 0x00c2, 0x0102, 0x00c4, 0x0139, 0x0106, 0x00c7,
+        0x010c, 0x00c9, 0x0118, 0x00cb, 0x011a, 0x00cd, 0x00ce, 0x010e,
+        0x0110, 0x0143, 0x0147, 0x00d3, 0x00d4, 0x0150, 0x00d6, 0x00d7,
+        0x0158, 0x016e, 0x00da, 0x0170, 0x00dc, 0x00dd, 0x0162, 0x00df,
+        0x0155, 0x00e1, 0x00e2, 0x0103, 0x00e4, 0x013a, 0x0107, 0x00e7,
+        0x010d, 0x00e9, 0x0119, 0x00eb, 0x011b, 0x00ed, 0x00ee, 0x010f,
+        0x0111, 0x0144, 0x0148, 0x00f3, 0x00f4, 0x0151, 0x00f6, 0x00f7,
+        0x0159, 0x016f, 0x00fa, 0x0171, 0x00fc, 0x00fd, 0x0163, 0x02d9,
+    },
+    [3] = {
+        0x00a0, 0x0126, 0x02d8, 0x00a3, 0x00a4, 0x0000, 0x0124, 0x00a7,
+        0x00a8, 0x0130, 0x015e, 0x011e, 0x0134, 0x00ad, 0x0000, 0x017b,
+        0x00b0, 0x0127, 0x00b2, 0x00b3, 0x00b4, 0x00b5, 0x0125, 0x00b7,
+        0x00b8, 0x0131, 0x015f, 0x011f, 0x0135, 0x00bd, 0x0000, 0x017c,
+        0x00c0, 0x00c1, 0x00c2, 0x0000, 0x00c4, 0x010a, 0x0108, 0x00c7,
+        0x00c8, 0x00c9, 0x00ca, 0x00cb, 0x00cc, 0x00cd, 0x00ce, 0x00cf,
+        0x0000, 0x00d1, 0x00d2, 0x00d3, 0x00d4, 0x0120, 0x00d6, 0x00d7,
+        0x011c, 0x00d9, 0x00da, 0x00db, 0x00dc, 0x016c, 0x015c, 0x00df,
+        0x00e0, 0x00e1, 0x00e2, 0x0000, 0x00e4, 0x010b, 0x0109, 0x00e7,
+        0x00e8, 0x00e9, 0x00ea, 0x00eb, 0x00ec, 0x00ed, 0x00ee, 0x00ef,
+        0x0000, 0x00f1, 0x00f2, 0x00f3, 0x00f4, 0x0121, 0x00f6, 0x00f7,
+        0x011d, 0x00f9, 0x00fa, 0x00fb, 0x00fc, 0x016d, 0x015d, 0x02d9,
+    },
+    [4] = {
+        0x00a0, 0x0104, 0x0138, 0x0156, 0x00a4, 0x0128, 0x013b, 0x00a7,
+        0x00a8, 0x0160, 0x0112, 0x0122, 0x0166, 0x00ad, 0x017d, 0x00af,
+        0x00b0, 0x0105, 0x02db, 0x0157, 0x00b4, 0x0129, 0x013c, 0x02c7,
+        0x00b8, 0x0161, 0x0113, 0x0123, 0x0167, 0x014a, 0x017e, 0x014b,
+        0x0100, 0x00c1, 0x00c2, 0x00c3, 0x00c4, 0x00c5, 0x00c6, 0x012e,
+        0x010c, 0x00c9, 0x0118, 0x00cb, 0x0116, 0x00cd, 0x00ce, 0x012a,
+        0x0110, 0x0145, 0x014c, 0x0136, 0x00d4, 0x00d5, 0x00d6, 0x00d7,
+        0x00d8, 0x0172, 0x00da, 0x00db, 0x00dc, 0x0168, 0x016a, 0x00df,
+        0x0101, 0x00e1, 0x00e2, 0x00e3, 0x00e4, 0x00e5, 0x00e6, 0x012f,
+        0x010d, 0x00e9, 0x0119, 0x00eb, 0x0117, 0x00ed, 0x00ee, 0x012b,
+        0x0111, 0x0146, 0x014d, 0x0137, 0x00f4, 0x00f5, 0x00f6, 0x00f7,
+        0x00f8, 0x0173, 0x00fa, 0x00fb, 0x00fc, 0x0169, 0x016b, 0x02d9,
+    },
+    [5] = {
+        0x00a0, 0x0401, 0x0402, 0x0403, 0x0404, 0x0405, 0x0406, 0x0407,
+        0x0408, 0x0409, 0x040a, 0x040b, 0x040c, 0x00ad, 0x040e, 0x040f,
+        0x0410, 0x0411, 0x0412, 0x0413, 0x0414, 0x0415, 0x0416, 0x0417,
+        0x0418, 0x0419, 0x041a, 0x041b, 0x041c, 0x041d, 0x041e, 0x041f,
+        0x0420, 0x0421, 0x0422, 0x0423, 0x0424, 0x0425, 0x0426, 0x0427,
+        0x0428, 0x0429, 0x042a, 0x042b, 0x042c, 0x042d, 0x042e, 0x042f,
+        0x0430, 0x0431, 0x0432, 0x0433, 0x0434, 0x0435, 0x0436, 0x0437,
+        0x0438, 0x0439, 0x043a, 0x043b, 0x043c, 0x043d, 0x043e, 0x043f,
+        0x0440, 0x0441, 0x0442, 0x0443, 0x0444, 0x0445, 0x0446, 0x0447,
+        0x0448, 0x0449, 0x044a, 0x044b, 0x044c, 0x044d, 0x044e, 0x044f,
+        0x2116, 0x0451, 0x0452, 0x0453, 0x0454, 0x0455, 0x0456, 0x0457,
+        0x0458, 0x0459, 0x045a, 0x045b, 0x045c, 0x00a7, 0x045e, 0x045f,
+    },
+    [6] = {
+        0x00a0, 0x0000, 0x0000, 0x0000, 0x00a4, 0x0000, 0x0000, 0x0000,
+        0x0000, 0x0000, 0x0000, 0x0000, 0x060c, 0x00ad, 0x0000, 0x0000,
+        0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+        0x0000, 0x0000, 0x0000, 0x061b, 0x0000, 0x0000, 0x0000, 0x061f,
+        0x0000, 0x0621, 0x0622, 0x0623, 0x0624, 0x0625, 0x0626, 0x0627,
+        0x0628, 0x0629, 0x062a, 0x062b, 0x062c, 0x062d, 0x062e, 0x062f,
+        0x0630, 0x0631, 0x0632, 0x0633, 0x0634, 0x0635, 0x0636, 0x0637,
+        0x0638, 0x0639, 0x063a, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+        0x0640, 0x0641, 0x0642, 0x0643, 0x0644, 0x0645, 0x0646, 0x0647,
+        0x0648, 0x0649, 0x064a, 0x064b, 0x064c, 0x064d, 0x064e, 0x064f,
+        0x0650, 0x0651, 0x0652, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+        0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+    },
+    [7] = {
+        0x00a0, 0x2018, 0x2019, 0x00a3, 0x20ac, 0x20af, 0x00a6, 0x00a7,
+        0x00a8, 0x00a9, 0x037a, 0x00ab, 0x00ac, 0x00ad, 0x0000, 0x2015,
+        0x00b0, 0x00b1, 0x00b2, 0x00b3, 0x0384, 0x0385, 0x0386, 0x00b7,
+        0x0388, 0x0389, 0x038a, 0x00bb, 0x038c, 0x00bd, 0x038e, 0x038f,
+        0x0390, 0x0391, 0x0392, 0x0393, 0x0394, 0x0395, 0x0396, 0x0397,
+        0x0398, 0x0399, 0x039a, 0x039b, 0x039c, 0x039d, 0x039e, 0x039f,
+        0x03a0, 0x03a1, 0x0000, 0x03a3, 0x03a4, 0x03a5, 0x03a6, 0x03a7,
+        0x03a8, 0x03a9, 0x03aa, 0x03ab, 0x03ac, 0x03ad, 0x03ae, 0x03af,
+        0x03b0, 0x03b1, 0x03b2, 0x03b3, 0x03b4, 0x03b5, 0x03b6, 0x03b7,
+        0x03b8, 0x03b9, 0x03ba, 0x03bb, 0x03bc, 0x03bd, 0x03be, 0x03bf,
+        0x03c0, 0x03c1, 0x03c2, 0x03c3, 0x03c4, 0x03c5, 0x03c6, 0x03c7,
+        0x03c8, 0x03c9, 0x03ca, 0x03cb, 0x03cc, 0x03cd, 0x03ce, 0x0000,
+    },
+    [8] = {
+        0x00a0, 0x0000, 0x00a2, 0x00a3, 0x00a4, 0x00a5, 0x00a6, 0x00a7,
+        0x00a8, 0x00a9, 0x00d7, 0x00ab, 0x00ac, 0x00ad, 0x00ae, 0x00af,
+        0x00b0, 0x00b1, 0x00b2, 0x00b3, 0x00b4, 0x00b5, 0x00b6, 0x00b7,
+        0x00b8, 0x00b9, 0x00f7, 0x00bb, 0x00bc, 0x00bd, 0x00be, 0x0000,
+        0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+        0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+        0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+        0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x2017,
+        0x05d0, 0x05d1, 0x05d2, 0x05d3, 0x05d4, 0x05d5, 0x05d6, 0x05d7,
+        0x05d8, 0x05d9, 0x05da, 0x05db, 0x05dc, 0x05dd, 0x05de, 0x05df,
+        0x05e0, 0x05e1, 0x05e2, 0x05e3, 0x05e4, 0x05e5, 0x05e6, 0x05e7,
+        0x05e8, 0x05e9, 0x05ea, 0x0000, 0x0000, 0x200e, 0x200f, 0x0000,
+    },
+    [9] = {
+        0x00a0, 0x00a1, 0x00a2, 0x00a3, 0x00a4, 0x00a5, 0x00a6, 0x00a7,
+        0x00a8, 0x00a9, 0x00aa, 0x00ab, 0x00ac, 0x00ad, 0x00ae, 0x00af,
+        0x00b0, 0x00b1, 0x00b2, 0x00b3, 0x00b4, 0x00b5, 0x00b6, 0x00b7,
+        0x00b8, 0x00b9, 0x00ba, 0x00bb, 0x00bc, 0x00bd, 0x00be, 0x00bf,
+        0x00c0, 0x00c1, 0x00c2, 0x00c3, 0x00c4, 0x00c5, 0x00c6, 0x00c7,
+        0x00c8, 0x00c9, 0x00ca, 0x00cb, 0x00cc, 0x00cd, 0x00ce, 0x00cf,
+        0x011e, 0x00d1, 0x00d2, 0x00d3, 0x00d4, 0x00d5, 0x00d6, 0x00d7,
+        0x00d8, 0x00d9, 0x00da, 0x00db, 0x00dc, 0x0130, 0x015e, 0x00df,
+        0x00e0, 0x00e1, 0x00e2, 0x00e3, 0x00e4, 0x00e5, 0x00e6, 0x00e7,
+        0x00e8, 0x00e9, 0x00ea, 0x00eb, 0x00ec, 0x00ed, 0x00ee, 0x00ef,
+        0x011f, 0x00f1, 0x00f2, 0x00f3, 0x00f4, 0x00f5, 0x00f6, 0x00f7,
+        0x00f8, 0x00f9, 0x00fa, 0x00fb, 0x00fc, 0x0131, 0x015f, 0x00ff,
+    },
+    [10] = {
+        0x00a0, 0x0104, 0x0112, 0x0122, 0x012a, 0x0128, 0x0136, 0x00a7,
+        0x013b, 0x0110, 0x0160, 0x0166, 0x017d, 0x00ad, 0x016a, 0x014a,
+        0x00b0, 0x0105, 0x0113, 0x0123, 0x012b, 0x0129, 0x0137, 0x00b7,
+        0x013c, 0x0111, 0x0161, 0x0167, 0x017e, 0x2015, 0x016b, 0x014b,
+        0x0100, 0x00c1, 0x00c2, 0x00c3, 0x00c4, 0x00c5, 0x00c6, 0x012e,
+        0x010c, 0x00c9, 0x0118, 0x00cb, 0x0116, 0x00cd, 0x00ce, 0x00cf,
+        0x00d0, 0x0145, 0x014c, 0x00d3, 0x00d4, 0x00d5, 0x00d6, 0x0168,
+        0x00d8, 0x0172, 0x00da, 0x00db, 0x00dc, 0x00dd, 0x00de, 0x00df,
+        0x0101, 0x00e1, 0x00e2, 0x00e3, 0x00e4, 0x00e5, 0x00e6, 0x012f,
+        0x010d, 0x00e9, 0x0119, 0x00eb, 0x0117, 0x00ed, 0x00ee, 0x00ef,
+        0x00f0, 0x0146, 0x014d, 0x00f3, 0x00f4, 0x00f5, 0x00f6, 0x0169,
+        0x00f8, 0x0173, 0x00fa, 0x00fb, 0x00fc, 0x00fd, 0x00fe, 0x0138,
+    },
+    [11] = {
+        0x00a0, 0x0e01, 0x0e02, 0x0e03, 0x0e04, 0x0e05, 0x0e06, 0x0e07,
+        0x0e08, 0x0e09, 0x0e0a, 0x0e0b, 0x0e0c, 0x0e0d, 0x0e0e, 0x0e0f,
+        0x0e10, 0x0e11, 0x0e12, 0x0e13, 0x0e14, 0x0e15, 0x0e16, 0x0e17,
+        0x0e18, 0x0e19, 0x0e1a, 0x0e1b, 0x0e1c, 0x0e1d, 0x0e1e, 0x0e1f,
+        0x0e20, 0x0e21, 0x0e22, 0x0e23, 0x0e24, 0x0e25, 0x0e26, 0x0e27,
+        0x0e28, 0x0e29, 0x0e2a, 0x0e2b, 0x0e2c, 0x0e2d, 0x0e2e, 0x0e2f,
+        0x0e30, 0x0e31, 0x0e32, 0x0e33, 0x0e34, 0x0e35, 0x0e36, 0x0e37,
+        0x0e38, 0x0e39, 0x0e3a, 0x0000, 0x0000, 0x0000, 0x0000, 0x0e3f,
+        0x0e40, 0x0e41, 0x0e42, 0x0e43, 0x0e44, 0x0e45, 0x0e46, 0x0e47,
+        0x0e48, 0x0e49, 0x0e4a, 0x0e4b, 0x0e4c, 0x0e4d, 0x0e4e, 0x0e4f,
+        0x0e50, 0x0e51, 0x0e52, 0x0e53, 0x0e54, 0x0e55, 0x0e56, 0x0e57,
+        0x0e58, 0x0e59, 0x0e5a, 0x0e5b, 0x0000, 0x0000, 0x0000, 0x0000,
+    },
+    [13] = {
+        0x00a0, 0x201d, 0x00a2, 0x00a3, 0x00a4, 0x201e, 0x00a6, 0x00a7,
+        0x00d8, 0x00a9, 0x0156, 0x00ab, 0x00ac, 0x00ad, 0x00ae, 0x00c6,
+        0x00b0, 0x00b1, 0x00b2, 0x00b3, 0x201c, 0x00b5, 0x00b6, 0x00b7,
+        0x00f8, 0x00b9, 0x0157, 0x00bb, 0x00bc, 0x00bd, 0x00be, 0x00e6,
+        0x0104, 0x012e, 0x0100, 0x0106, 0x00c4, 0x00c5, 0x0118, 0x0112,
+        0x010c, 0x00c9, 0x0179, 0x0116, 0x0122, 0x0136, 0x012a, 0x013b,
+        0x0160, 0x0143, 0x0145, 0x00d3, 0x014c, 0x00d5, 0x00d6, 0x00d7,
+        0x0172, 0x0141, 0x015a, 0x016a, 0x00dc, 0x017b, 0x017d, 0x00df,
+        0x0105, 0x012f, 0x0101, 0x0107, 0x00e4, 0x00e5, 0x0119, 0x0113,
+        0x010d, 0x00e9, 0x017a, 0x0117, 0x0123, 0x0137, 0x012b, 0x013c,
+        0x0161, 0x0144, 0x0146, 0x00f3, 0x014d, 0x00f5, 0x00f6, 0x00f7,
+        0x0173, 0x0142, 0x015b, 0x016b, 0x00fc, 0x017c, 0x017e, 0x2019,
+    },
+    [14] = {
+        0x00a0, 0x1e02, 0x1e03, 0x00a3, 0x010a, 0x010b, 0x1e0a, 0x00a7,
+        0x1e80, 0x00a9, 0x1e82, 0x1e0b, 0x1ef2, 0x00ad, 0x00ae, 0x0178,
+        0x1e1e, 0x1e1f, 0x0120, 0x0121, 0x1e40, 0x1e41, 0x00b6, 0x1e56,
+        0x1e81, 0x1e57, 0x1e83, 0x1e60, 0x1ef3, 0x1e84, 0x1e85, 0x1e61,
+        0x00c0, 0x00c1, 0x00c2, 0x00c3, 0x00c4, 0x00c5, 0x00c6, 0x00c7,
+        0x00c8, 0x00c9, 0x00ca, 0x00cb, 0x00cc, 0x00cd, 0x00ce, 0x00cf,
+        0x0174, 0x00d1, 0x00d2, 0x00d3, 0x00d4, 0x00d5, 0x00d6, 0x1e6a,
+        0x00d8, 0x00d9, 0x00da, 0x00db, 0x00dc, 0x00dd, 0x0176, 0x00df,
+        0x00e0, 0x00e1, 0x00e2, 0x00e3, 0x00e4, 0x00e5, 0x00e6, 0x00e7,
+        0x00e8, 0x00e9, 0x00ea, 0x00eb, 0x00ec, 0x00ed, 0x00ee, 0x00ef,
+        0x0175, 0x00f1, 0x00f2, 0x00f3, 0x00f4, 0x00f5, 0x00f6, 0x1e6b,
+        0x00f8, 0x00f9, 0x00fa, 0x00fb, 0x00fc, 0x00fd, 0x0177, 0x00ff,
+    },
+    [15] = {
+        0x00a0, 0x00a1, 0x00a2, 0x00a3, 0x20ac, 0x00a5, 0x0160, 0x00a7,
+        0x0161, 0x00a9, 0x00aa, 0x00ab, 0x00ac, 0x00ad, 0x00ae, 0x00af,
+        0x00b0, 0x00b1, 0x00b2, 0x00b3, 0x017d, 0x00b5, 0x00b6, 0x00b7,
+        0x017e, 0x00b9, 0x00ba, 0x00bb, 0x0152, 0x0153, 0x0178, 0x00bf,
+        0x00c0, 0x00c1, 0x00c2, 0x00c3, 0x00c4, 0x00c5, 0x00c6, 0x00c7,
+        0x00c8, 0x00c9, 0x00ca, 0x00cb, 0x00cc, 0x00cd, 0x00ce, 0x00cf,
+        0x00d0, 0x00d1, 0x00d2, 0x00d3, 0x00d4, 0x00d5, 0x00d6, 0x00d7,
+        0x00d8, 0x00d9, 0x00da, 0x00db, 0x00dc, 0x00dd, 0x00de, 0x00df,
+        0x00e0, 0x00e1, 0x00e2, 0x00e3, 0x00e4, 0x00e5, 0x00e6, 0x00e7,
+        0x00e8, 0x00e9, 0x00ea, 0x00eb, 0x00ec, 0x00ed, 0x00ee, 0x00ef,
+        0x00f0, 0x00f1, 0x00f2, 0x00f3, 0x00f4, 0x00f5, 0x00f6, 0x00f7,
+        0x00f8, 0x00f9, 0x00fa, 0x00fb, 0x00fc, 0x00fd, 0x00fe, 0x00ff,
+    },
+};
+
+/* ISO/IEC 6937 from 0xA0, 0 where undefined, and DIACRITIC for the
+ * non spacing diacritical marks prefixing a letter */
+static const uint16_t iso6937[96] =
+{
+    0x00a0, 0x00a1, 0x00a2, 0x00a3, 0x0000, 0x00a5, 0x0000, 0x00a7,
+    0x00a4, 0x2018, 0x201c, 0x00ab, 0x2190, 0x2191, 0x2192, 0x2193,
+    0x00b0, 0x00b1, 0x00b2, 0x00b3, 0x00d7, 0x00b5, 0x00b6, 0x00b7,
+    0x00f7, 0x2019, 0x201d, 0x00bb, 0x00bc, 0x00bd, 0x00be, 0x00bf,
+    0x0000, DIACRITIC, DIACRITIC, DIACRITIC, DIACRITIC, DIACRITIC, DIACRITIC, DIACRITIC,
+    DIACRITIC, DIACRITIC, DIACRITIC, DIACRITIC, DIACRITIC, DIACRITIC, DIACRITIC, DIACRITIC,
+    0x2014, 0x00b9, 0x00ae, 0x00a9, 0x2122, 0x266a, 0x00ac, 0x00a6,
+    0x0000, 0x0000, 0x0000, 0x0000, 0x215b, 0x215c, 0x215d, 0x215e,
+    0x2126, 0x00c6, 0x00d0, 0x00aa, 0x0126, 0x0000, 0x0132, 0x013f,
+    0x0141, 0x00d8, 0x0152, 0x00ba, 0x00de, 0x0166, 0x014a, 0x0149,
+    0x0138, 0x00e6, 0x0111, 0x00f0, 0x0127, 0x0131, 0x0133, 0x0140,
+    0x0142, 0x00f8, 0x0153, 0x00df, 0x00fe, 0x0167, 0x014b, 0x00ad,
+};
+
+/* ISO/IEC 6937 diacritical mark and letter pairs */
+static const uint16_t iso6937_diacritics[16][128] =
+{
+    [0x1] = {
+        ['A'] = 0x00c0, ['E'] = 0x00c8, ['I'] = 0x00cc, ['O'] = 0x00d2,
+        ['U'] = 0x00d9, ['a'] = 0x00e0, ['e'] = 0x00e8, ['i'] = 0x00ec,
+        ['o'] = 0x00f2, ['u'] = 0x00f9,
+    },
+    [0x2] = {
+        [' '] = 0x00b4, ['A'] = 0x00c1, ['C'] = 0x0106, ['E'] = 0x00c9,
+        ['I'] = 0x00cd, ['L'] = 0x0139, ['N'] = 0x0143, ['O'] = 0x00d3,
+        ['R'] = 0x0154, ['S'] = 0x015a, ['U'] = 0x00da, ['Y'] = 0x00dd,
+        ['Z'] = 0x0179, ['a'] = 0x00e1, ['c'] = 0x0107, ['e'] = 0x00e9,
+        ['i'] = 0x00ed, ['l'] = 0x013a, ['n'] = 0x0144, ['o'] = 0x00f3,
+        ['r'] = 0x0155, ['s'] = 0x015b, ['u'] = 0x00fa, ['y'] = 0x00fd,
+        ['z'] = 0x017a,
+    },
+    [0x3] = {
+        ['A'] = 0x00c2, ['C'] = 0x0108, ['E'] = 0x00ca, ['G'] = 0x011c,
+        ['H'] = 0x0124, ['I'] = 0x00ce, ['J'] = 0x0134, ['O'] = 0x00d4,
+        ['S'] = 0x015c, ['U'] = 0x00db, ['W'] = 0x0174, ['Y'] = 0x0176,
+        ['a'] = 0x00e2, ['c'] = 0x0109, ['e'] = 0x00ea, ['g'] = 0x011d,
+        ['h'] = 0x0125, ['i'] = 0x00ee, ['j'] = 0x0135, ['o'] = 0x00f4,
+        ['s'] = 0x015d, ['u'] = 0x00fb, ['w'] = 0x0175, ['y'] = 0x0177,
+    },
+    [0x4] = {
+        ['A'] = 0x00c3, ['I'] = 0x0128, ['N'] = 0x00d1, ['O'] = 0x00d5,
+        ['U'] = 0x0168, ['a'] = 0x00e3, ['i'] = 0x0129, ['n'] = 0x00f1,
+        ['o'] = 0x00f5, ['u'] = 0x0169,
+    },
+    [0x5] = {
+        [' '] = 0x00af, ['A'] = 0x0100, ['E'] = 0x0112, ['I'] = 0x012a,
+        ['O'] = 0x014c, ['U'] = 0x016a, ['a'] = 0x0101, ['e'] = 0x0113,
+        ['i'] = 0x012b, ['o'] = 0x014d, ['u'] = 0x016b,
+    },
+    [0x6] = {
+        [' '] = 0x02d8, ['A'] = 0x0102, ['G'] = 0x011e, ['U'] = 0x016c,
+        ['a'] = 0x0103, ['g'] = 0x011f, ['u'] = 0x016d,
+    },
+    [0x7] = {
+        [' '] = 0x02d9, ['C'] = 0x010a, ['E'] = 0x0116, ['G'] = 0x0120,
+        ['I'] = 0x0130, ['Z'] = 0x017b, ['c'] = 0x010b, ['e'] = 0x0117,
+        ['g'] = 0x0121, ['z'] = 0x017c,
+    },
+    [0x8] = {
+        [' '] = 0x00a8, ['A'] = 0x00c4, ['E'] = 0x00cb, ['I'] = 0x00cf,
+        ['O'] = 0x00d6, ['U'] = 0x00dc, ['Y'] = 0x0178, ['a'] = 0x00e4,
+        ['e'] = 0x00eb, ['i'] = 0x00ef, ['o'] = 0x00f6, ['u'] = 0x00fc,
+        ['y'] = 0x00ff,
+    },
+    [0xa] = {
+        [' '] = 0x02da, ['A'] = 0x00c5, ['U'] = 0x016e, ['a'] = 0x00e5,
+        ['u'] = 0x016f,
+    },
+    [0xb] = {
+        [' '] = 0x00b8, ['C'] = 0x00c7, ['G'] = 0x0122, ['K'] = 0x0136,
+        ['L'] = 0x013b, ['N'] = 0x0145, ['R'] = 0x0156, ['S'] = 0x015e,
+        ['T'] = 0x0162, ['c'] = 0x00e7, ['g'] = 0x0123, ['k'] = 0x0137,
+        ['l'] = 0x013c, ['n'] = 0x0146, ['r'] = 0x0157, ['s'] = 0x015f,
+        ['t'] = 0x0163,
+    },
+    [0xd] = {
+        [' '] = 0x02dd, ['O'] = 0x0150, ['U'] = 0x0170, ['o'] = 0x0151,
+        ['u'] = 0x0171,
+    },
+    [0xe] = {
+        [' '] = 0x02db, ['A'] = 0x0104, ['E'] = 0x0118, ['I'] = 0x012e,
+        ['U'] = 0x0172, ['a'] = 0x0105, ['e'] = 0x0119, ['i'] = 0x012f,
+        ['u'] = 0x0173,
+    },
+    [0xf] = {
+        [' '] = 0x02c7, ['C'] = 0x010c, ['D'] = 0x010e, ['E'] = 0x011a,
+        ['L'] = 0x013d, ['N'] = 0x0147, ['R'] = 0x0158, ['S'] = 0x0160,
+        ['T'] = 0x0164, ['Z'] = 0x017d, ['c'] = 0x010d, ['d'] = 0x010f,
+        ['e'] = 0x011b, ['l'] = 0x013e, ['n'] = 0x0148, ['r'] = 0x0159,
+        ['s'] = 0x0161, ['t'] = 0x0165, ['z'] = 0x017e,
+    },
+};
+
+/* Character sets decoded through iconv */
+enum
+{
+    ICONV_EUC_KR = 0,
+    ICONV_GB2312,
+    ICONV_COUNT
+};
+
+static const char *const ppsz_iconv_charsets[ICONV_COUNT] =
+{
+    [ICONV_EUC_KR] = "EUC-KR",
+    [ICONV_GB2312] = "GB2312",
+};
+
+struct ts_text_t
+{
+    vlc_iconv_t handles[ICONV_COUNT]; /* (vlc_iconv_t)(-1) until opened */
+};
+
+typedef struct
+{
+    char *p;
+    char *p_end;    /* one byte is kept for the nul */
+    bool  b_ended;  /* nul character seen, the rest is only checked */
+} text_writer_t;
+
+static bool WriteBytes( text_writer_t *w, const char *p, size_t i )
+{
+    if( w->b_ended )
+        return true;
+    if( (size_t)(w->p_end - w->p) < i )
+        return false;
+    memcpy( w->p, p, i );
+    w->p += i;
+    return true;
+}
+
+/* Writes one character as UTF-8, with the DVB control codes of the C1 and
+ * private use areas interpreted as vlc_from_EIT() does */
+static bool WriteChar( text_writer_t *w, uint16_t i_char )
+{
+    char p[3];
+
+    switch( i_char )
+    {
+        case 0x0000:
+            w->b_ended = true;
+            return true;
+        case 0x0086: /* character emphasis on/off */
+        case 0x0087:
+        case 0xe086:
+        case 0xe087:
+            return true;
+        case 0x008a: /* CR/LF */
+            return WriteBytes( w, "\r\n", 2 );
+        case 0xe08a:
+            return WriteBytes( w, "\r\r\n", 3 );
+    }
+
+    if( i_char < 0x80 )
+    {
+        p[0] = i_char;
+        return WriteBytes( w, p, 1 );
+    }
+    if( i_char < 0x800 )
+    {
+        p[0] = 0xc0 | ( i_char >> 6 );
+        p[1] = 0x80 | ( i_char & 0x3f );
+        return WriteBytes( w, p, 2 );
+    }
+    p[0] = 0xe0 | ( i_char >> 12 );
+    p[1] = 0x80 | ( ( i_char >> 6 ) & 0x3f );
+    p[2] = 0x80 | ( i_char & 0x3f );
+    return WriteBytes( w, p, 3 );
+}
+
+/* Interprets the control codes of a valid UTF-8 string in place */
+static void FilterControls( char *psz )
+{
+    char *p_out = psz;
+
+    for( const char *p = psz; *p; )
+    {
+        if( p[0] == '\xc2' && ( p[1] == '\x86' || p[1] == '\x87' ) )
+            p += 2;
+        else if( p[0] == '\xc2' && p[1] == '\x8a' )
+        {
+            memcpy( p_out, "\r\n", 2 );
+            p_out += 2;
+            p += 2;
+        }
+        else if( p[0] == '\xee' && p[1] == '\x82' &&
+                 ( p[2] == '\x86' || p[2] == '\x87' ) )
+            p += 3;
+        else if( p[0] == '\xee' && p[1] == '\x82' && p[2] == '\x8a' )
+        {
+            memcpy( p_out, "\r\r\n", 3 );
+            p_out += 3;
+            p += 3;
+        }
+        else
+            *p_out++ = *p++;
+    }
+    *p_out = '\0';
+}
+
+/* Return values of the decoders */
+enum
+{
+    DECODE_OK = 0,
+    DECODE_INVALID, /* not in the character set, the bytes are kept */
+    DECODE_FULL,
+};
+
+static int DecodeISO6937( text_writer_t *w, const uint8_t *p, size_t i )
+{
+    for( size_t j = 0; j < i; j++ )
+    {
+        uint16_t i_char = p[j];
+        if( i_char >= 0xa0 )
+        {
+            i_char = iso6937[i_char - 0xa0];
+            if( i_char == DIACRITIC )
+            {
+                if( j + 1 >= i || p[j + 1] >= 0x80 )
+                    return DECODE_INVALID;
+                i_char = iso6937_diacritics[p[j] - 0xc0][p[j + 1]];
+                j++;
+            }
+            if( i_char == 0 )
+                return DECODE_INVALID;
+        }
+        if( !WriteChar( w, i_char ) )
+            return DECODE_FULL;
+    }
+    return DECODE_OK;
+}
+
+static int DecodeISO8859( text_writer_t *w, unsigned i_part,
+                          const uint8_t *p, size_t i )
+{
+    const uint16_t *p_table = iso8859[i_part];
+
+    for( size_t j = 0; j < i; j++ )
+    {
+        uint16_t i_char = p[j];
+        if( i_char >= 0xa0 && ( i_char = p_table[i_char - 0xa0] ) == 0 )
+            return DECODE_INVALID;
+        if( !WriteChar( w, i_char ) )
+            return DECODE_FULL;
+    }
+    return DECODE_OK;
+}
+
+static int DecodeUCS2( text_writer_t *w, const uint8_t *p, size_t i )
+{
+    if( i & 1 )
+        return DECODE_INVALID;
+    for( size_t j = 0; j < i; j += 2 )
+    {
+        const uint16_t i_char = GetWBE( &p[j] );
+        if( i_char >= 0xd800 && i_char < 0xe000 ) /* surrogates */
+            return DECODE_INVALID;
+        if( !WriteChar( w, i_char ) )
+            return DECODE_FULL;
+    }
+    return DECODE_OK;
+}
+
+static int DecodeIconv( ts_text_t *p_text, unsigned i_charset, text_writer_t *w,
+                        const uint8_t *p, size_t i )
+{
+    vlc_iconv_t *p_handle = &p_text->handles[i_charset];
+
+    if( *p_handle == (vlc_iconv_t)(-1) )
+    {
+        *p_handle = vlc_iconv_open( "UTF-8", ppsz_iconv_charsets[i_charset] );
+        if( *p_handle == (vlc_iconv_t)(-1) )
+            return DECODE_INVALID;
+    }
+    else if( vlc_iconv( *p_handle, NULL, NULL, NULL, NULL ) == (size_t)(-1) )
+        return DECODE_INVALID; /* cannot go back to the initial state */
+
+    const char *p_in = (const char *)p;
+    size_t i_in = i;
+    char *p_out = w->p;
+    size_t i_out = w->p_end - w->p;
+
+    if( vlc_iconv( *p_handle, &p_in, &i_in, &p_out, &i_out ) == (size_t)(-1) )
+        return errno == E2BIG ? DECODE_FULL : DECODE_INVALID;
+
+    /* Up to the first nul, and with the control codes */
+    *p_out = '\0';
+    FilterControls( w->p );
+    w->p += strlen( w->p );
+    return DECODE_OK;
+}
+
+/* Copies the bytes, up to the first nul, with the invalid UTF-8 sequences
+ * replaced, as vlc_from_EIT() does for the strings it cannot convert */
+static int CopyUTF8( text_writer_t *w, const uint8_t *p, size_t i )
+{
+    i = strnlen( (const char *)p, i );
+    if( (size_t)(w->p_end - w->p) < i )
+        return DECODE_FULL;
+    memcpy( w->p, p, i );
+    w->p[i] = '\0';
+    EnsureUTF8( w->p );
+    FilterControls( w->p );
+    w->p += strlen( w->p );
+    return DECODE_OK;
+}
+
+const char *ts_text_Decode( ts_text_t *p_text, ts_text_arena_t *p_arena,
+                            const uint8_t *p, size_t i )
+{
+    if( unlikely(i == 0) || p_arena->i_used >= p_arena->i_size )
+        return NULL;
+
+    char *psz = &p_arena->p_buf[p_arena->i_used];
+    text_writer_t w = {
+        .p = psz,
+        .p_end = &p_arena->p_buf[p_arena->i_size - 1],
+        .b_ended = false,
+    };
+    const uint8_t c = p[0];
+    int i_ret;
+
+    if( c >= 0x20 )
+        i_ret = DecodeISO6937( &w, p, i );
+    else if( (1u << c) & 0x0EFE ) /* 1-7, 9-11 -> ISO 8859-(c+4) */
+        i_ret = DecodeISO8859( &w, 4 + c, &p[1], i - 1 );
+    else switch( c )
+    {
+        case 0x10: /* two more bytes */
+            if( i < 3 || p[1] != 0x00 || p[2] >= 16 ||
+                !( (1u << p[2]) & 0xEFFE ) ) /* 1-11, 13-15 -> ISO 8859-(c) */
+                return NULL;
+            i_ret = DecodeISO8859( &w, p[2], &p[3], i - 3 );
+            break;
+        case 0x11: /* the BMP */
+        case 0x14: /* Big5 subset of the BMP */
+            i_ret = DecodeUCS2( &w, &p[1], i - 1 );
+            break;
+        case 0x12: /* assumed to be EUC-KR, see vlc_from_EIT() */
+            i_ret = DecodeIconv( p_text, ICONV_EUC_KR, &w, &p[1], i - 1 );
+            break;
+        case 0x13: /* GB-2312-1980 */
+            i_ret = DecodeIconv( p_text, ICONV_GB2312, &w, &p[1], i - 1 );
+            break;
+        case 0x15:
+            i_ret = CopyUTF8( &w, &p[1], i - 1 );
+            break;
+        default:
+            return NULL;
+    }
+
+    if( i_ret == DECODE_INVALID )
+    {
+        /* Fallback, on the bytes after the selector */
+        const size_t i_offset = c >= 0x20 ? 0 : c == 0x10 ? 3 : 1;
+        w.p = psz;
+        i_ret = CopyUTF8( &w, &p[i_offset], i - i_offset );
+    }
+    if( i_ret != DECODE_OK )
+        return NULL;
+
+    *w.p = '\0';
+    p_arena->i_used = w.p + 1 - p_arena->p_buf;
+    return psz;
+}
+
+const char *ts_text_DecodeLatin1( ts_text_arena_t *p_arena,
+                                  const uint8_t *p, size_t i )
+{
+    if( p_arena->i_used >= p_arena->i_size )
+        return NULL;
+
+    char *psz = &p_arena->p_buf[p_arena->i_used];
+    char *p_out = psz;
+    char *p_end = &p_arena->p_buf[p_arena->i_size - 1];
+
+    for( size_t j = 0; j < i && p[j]; j++ )
+    {
+        if( p_end - p_out < 2 )
+            return NULL;
+        if( p[j] < 0x80 )
+            *p_out++ = p[j];
+        else
+        {
+            *p_out++ = 0xc0 | ( p[j] >> 6 );
+            *p_out++ = 0x80 | ( p[j] & 0x3f );
+        }
+    }
+    *p_out = '\0';
+    p_arena->i_used = p_out + 1 - p_arena->p_buf;
+    return psz;
+}
+
+ts_text_t *ts_text_New( void )
+{
+    ts_text_t *p_text = malloc( sizeof(*p_text) );
+    if( !p_text )
+        return NULL;
+    for( unsigned i = 0; i < ICONV_COUNT; i++ )
+        p_text->handles[i] = (vlc_iconv_t)(-1);
+    return p_text;
+}
+
+void ts_text_Delete( ts_text_t *p_text )
+{
+    for( unsigned i = 0; i < ICONV_COUNT; i++ )
+        if( p_text->handles[i] != (vlc_iconv_t)(-1) )
+            vlc_iconv_close( p_text->handles[i] );
+    free( p_text );
+}
@@ -0,0 +1,61 @@
+/*****************************************************************************
+ * ts_text.h: DVB SI text decoding
+ *****************************************************************************
+ * Copyright (C) 2004-2015 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifndef VLC_TS_TEXT_H
+#define VLC_TS_TEXT_H
+
+/* Converts DVB SI text items (EN 300 468 annex A) to UTF-8, as
+ * vlc_from_EIT() does, without an allocation per string.
+ *
+ * ISO/IEC 6937, ISO/IEC 8859-1 to 15, UCS-2 and UTF-8 are decoded with
+ * static tables. EUC-KR and GB2312 go through iconv handles opened once
+ * per decoder, so a decoder must only be used by one thread at a time.
+ *
+ * Strings are appended to a caller provided arena, and stay valid until
+ * the arena is reset or rewound. */
+typedef struct ts_text_t ts_text_t;
+
+typedef struct
+{
+    char   *p_buf;
+    size_t  i_size;
+    size_t  i_used;     /* may be rewound to drop the last strings */
+} ts_text_arena_t;
+
+static inline void ts_text_ArenaInit( ts_text_arena_t *p_arena,
+                                      char *p_buf, size_t i_size )
+{
+    p_arena->p_buf = p_buf;
+    p_arena->i_size = i_size;
+    p_arena->i_used = 0;
+}
+
+ts_text_t *ts_text_New( void );
+void ts_text_Delete( ts_text_t * );
+
+/* Returns a nul-terminated string in the arena, or NULL if the encoding is
+ * not supported or the arena is full */
+const char *ts_text_Decode( ts_text_t *, ts_text_arena_t *,
+                            const uint8_t *p, size_t i );
+
+/* For the providers sending ISO/IEC 8859-1 without a selector: no control
+ * code is interpreted */
+const char *ts_text_DecodeLatin1( ts_text_arena_t *, const uint8_t *p, size_t i );
+
+#endif
@@ -177,6 +177,7 @@ static vlc_log_cb Open(vlc_object_t *obj, void **restrict sysp)
     fputs(header, sys->stream);
 
     *sysp = sys;
+    vlc_LogSetVerbosity(obj, verbosity);
     return cb;
 }
 
@@ -26,10 +26,25 @@
 # include "config.h"
 #endif
 
+#include <assert.h>
+
 #include <vlc_common.h>
+#include <vlc_cpu.h>
 
 #include "csa.h"
 
+#if defined(__SSE2__)
+# define CSA_SSE2
+#endif
+#if (defined(__i386__) || defined(__x86_64__)) && \
+    (defined(__AVX2__) || VLC_GCC_VERSION(4, 9) || defined(__clang__))
+# define CSA_AVX2
+#endif
+
+/* Below this many packets with the same key, the bitsliced stream cypher
+ * costs more than running them one by one */
+#define CSA_BATCH_MIN 2
+
 struct csa_t
 {
     /* odd and even keys */
@@ -56,6 +71,60 @@ static void csa_StreamCypher( csa_t *c, int b_init, uint8_t *ck, uint8_t *sb, ui
 static void csa_BlockDecypher( uint8_t kk[57], uint8_t ib[8], uint8_t bd[8] );
 static void csa_BlockCypher( uint8_t kk[57], uint8_t bd[8], uint8_t ib[8] );
 
+static void csa_BlockDecypher8( const uint8_t kk[57], uint8_t (*ib)[8],
+                                uint8_t (*bd)[8], unsigned i_lanes );
+static uint64_t csa_Transpose8x8( uint64_t x );
+
+/* Bitsliced descrambling, 64 packets per uint64_t, and 128 or 256 per SSE2
+ * or AVX2 vector */
+#define CSA_FN_( n, s ) n ## _ ## s
+#define CSA_FN__( n, s ) CSA_FN_( n, s )
+#define CSA_FN( n ) CSA_FN__( n, CSA_SUFFIX )
+
+#define csa_word_t  uint64_t
+#define CSA_LANES   64
+#define CSA_SUFFIX  c
+#define CSA_TARGET
+#include "csa_bitslice.h"
+#undef csa_word_t
+#undef CSA_LANES
+#undef CSA_SUFFIX
+#undef CSA_TARGET
+
+#ifdef CSA_SSE2
+typedef uint64_t csa_sse2_t __attribute__((vector_size(16)));
+# define csa_word_t  csa_sse2_t
+# define CSA_LANES   128
+# define CSA_SUFFIX  sse2
+# define CSA_TARGET
+# include "csa_bitslice.h"
+# undef csa_word_t
+# undef CSA_LANES
+# undef CSA_SUFFIX
+# undef CSA_TARGET
+#endif
+
+#ifdef CSA_AVX2
+typedef uint64_t csa_avx2_t __attribute__((vector_size(32)));
+# define csa_word_t  csa_avx2_t
+# define CSA_LANES   256
+# define CSA_SUFFIX  avx2
+# define CSA_TARGET  __attribute__ ((__target__ ("avx2")))
+# include "csa_bitslice.h"
+# undef csa_word_t
+# undef CSA_LANES
+# undef CSA_SUFFIX
+# undef CSA_TARGET
+#endif
+
+#ifdef CSA_AVX2
+# define CSA_LANES_MAX 256
+#elif defined(CSA_SSE2)
+# define CSA_LANES_MAX 128
+#else
+# define CSA_LANES_MAX 64
+#endif
+
 /*****************************************************************************
  * csa_New:
  *****************************************************************************/
@@ -224,6 +293,99 @@ void csa_Decrypt( csa_t *c, uint8_t *pkt, int i_pkt_size )
     }
 }
 
+/*****************************************************************************
+ * csa_DecryptBatch:
+ *****************************************************************************/
+static void csa_DecryptLanes( csa_t *c, bool b_odd, uint8_t **pp_pkts,
+                              const unsigned *pi_hdr, unsigned i_pkts,
+                              int i_pkt_size )
+{
+    uint8_t *ck = b_odd ? c->o_ck : c->e_ck;
+    uint8_t *kk = b_odd ? c->o_kk : c->e_kk;
+
+    /* The cost only depends on the number of runs, not of lanes used */
+    while( i_pkts >= CSA_BATCH_MIN )
+    {
+        void (*pf_decrypt)( uint8_t *, uint8_t *, uint8_t *const *,
+                            const unsigned *, unsigned, int );
+        unsigned i_lanes;
+#ifdef CSA_AVX2
+        if( i_pkts > 128 && vlc_CPU_AVX2() )
+        {
+            pf_decrypt = DecryptLanes_avx2;
+            i_lanes = __MIN( i_pkts, 256 );
+        }
+        else
+#endif
+#ifdef CSA_SSE2
+        if( i_pkts > 64 )
+        {
+            pf_decrypt = DecryptLanes_sse2;
+            i_lanes = __MIN( i_pkts, 128 );
+        }
+        else
+#endif
+        {
+            pf_decrypt = DecryptLanes_c;
+            i_lanes = __MIN( i_pkts, 64 );
+        }
+
+        /* clear transport scrambling control */
+        for( unsigned i = 0; i < i_lanes; i++ )
+            pp_pkts[i][3] &= 0x3f;
+
+        pf_decrypt( ck, kk, pp_pkts, pi_hdr, i_lanes, i_pkt_size );
+        pp_pkts += i_lanes;
+        pi_hdr += i_lanes;
+        i_pkts -= i_lanes;
+    }
+
+    for( unsigned i = 0; i < i_pkts; i++ )
+        csa_Decrypt( c, pp_pkts[i], i_pkt_size );
+}
+
+void csa_DecryptBatch( csa_t *c, uint8_t **pp_pkts, int i_pkts, int i_pkt_size )
+{
+    /* Packets are grouped by key, even then odd */
+    uint8_t *pp_lanes[2][CSA_LANES_MAX];
+    unsigned pi_hdr[2][CSA_LANES_MAX];
+    unsigned pi_lanes[2] = { 0, 0 };
+
+    for( int i = 0; i < i_pkts; i++ )
+    {
+        uint8_t *pkt = pp_pkts[i];
+
+        /* transport scrambling control */
+        if( (pkt[3]&0x80) == 0 )
+            continue;
+
+        unsigned i_hdr = 4;
+        if( pkt[3]&0x20 )
+            i_hdr += pkt[4] + 1;
+
+        /* Not even one block to descramble, only the scalar way knows */
+        if( 188 - i_hdr < 8 || i_pkt_size - (int)i_hdr < 8 )
+        {
+            csa_Decrypt( c, pkt, i_pkt_size );
+            continue;
+        }
+
+        const bool b_odd = pkt[3]&0x40;
+        pp_lanes[b_odd][pi_lanes[b_odd]] = pkt;
+        pi_hdr[b_odd][pi_lanes[b_odd]] = i_hdr;
+        if( ++pi_lanes[b_odd] == CSA_LANES_MAX )
+        {
+            csa_DecryptLanes( c, b_odd, pp_lanes[b_odd], pi_hdr[b_odd],
+                              CSA_LANES_MAX, i_pkt_size );
+            pi_lanes[b_odd] = 0;
+        }
+    }
+
+    for( int i_odd = 0; i_odd < 2; i_odd++ )
+        csa_DecryptLanes( c, i_odd, pp_lanes[i_odd], pi_hdr[i_odd],
+                          pi_lanes[i_odd], i_pkt_size );
+}
+
 /*****************************************************************************
  * csa_Encrypt:
  *****************************************************************************/
@@ -610,3 +772,62 @@ static void csa_BlockCypher( uint8_t kk[57], uint8_t bd[8], uint8_t ib[8] )
     }
 }
 
+/* csa_BlockDecypher() on up to 8 lanes, byte l of each register being the
+ * one of lane l */
+static void csa_BlockDecypher8( const uint8_t kk[57], uint8_t (*ib)[8],
+                                uint8_t (*bd)[8], unsigned i_lanes )
+{
+    uint64_t R[9];
+    int i;
+
+    for( i = 0; i < 8; i++ )
+    {
+        R[i+1] = 0;
+        for( unsigned l = 0; l < i_lanes; l++ )
+            R[i+1] |= (uint64_t)ib[l][i] << ( 8 * l );
+    }
+
+    // loop over kk[56]..kk[1]
+    for( i = 56; i > 0; i-- )
+    {
+        const uint64_t in = R[7] ^ ( kk[i] * UINT64_C(0x0101010101010101) );
+        uint64_t sbox_out = 0;
+        uint64_t perm_out = 0;
+
+        for( unsigned l = 0; l < 64; l += 8 )
+        {
+            const uint8_t out = block_sbox[ ( in >> l ) & 0xff ];
+            sbox_out |= (uint64_t)out << l;
+            perm_out |= (uint64_t)block_perm[out] << l;
+        }
+
+        const uint64_t next_R8 = R[7];
+        R[7] = R[6] ^ perm_out;
+        R[6] = R[5];
+        R[5] = R[4] ^ R[8] ^ sbox_out;
+        R[4] = R[3] ^ R[8] ^ sbox_out;
+        R[3] = R[2] ^ R[8] ^ sbox_out;
+        R[2] = R[1];
+        R[1] = R[8] ^ sbox_out;
+
+        R[8] = next_R8;
+    }
+
+    for( i = 0; i < 8; i++ )
+        for( unsigned l = 0; l < i_lanes; l++ )
+            bd[l][i] = R[i+1] >> ( 8 * l );
+}
+
+/* Bit c of byte r becomes bit r of byte c */
+static uint64_t csa_Transpose8x8( uint64_t x )
+{
+    uint64_t t;
+
+    t = ( x ^ ( x >> 7 ) ) & UINT64_C(0x00AA00AA00AA00AA);
+    x ^= t ^ ( t << 7 );
+    t = ( x ^ ( x >> 14 ) ) & UINT64_C(0x0000CCCC0000CCCC);
+    x ^= t ^ ( t << 14 );
+    t = ( x ^ ( x >> 28 ) ) & UINT64_C(0x00000000F0F0F0F0);
+    x ^= t ^ ( t << 28 );
+    return x;
+}
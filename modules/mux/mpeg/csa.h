@@ -30,6 +30,7 @@ typedef struct csa_t csa_t;
 #define csa_SetCW  __csa_SetCW
 #define csa_UseKey  __csa_UseKey
 #define csa_Decrypt __csa_decrypt
+#define csa_DecryptBatch __csa_decrypt_batch
 #define csa_Encrypt __csa_encrypt
 
 csa_t *csa_New( void );
@@ -39,6 +40,9 @@ int    csa_SetCW( vlc_object_t *p_caller, csa_t *c, char *psz_ck, bool odd );
 int    csa_UseKey( vlc_object_t *p_caller, csa_t *, bool use_odd );
 
 void   csa_Decrypt( csa_t *, uint8_t *pkt, int i_pkt_size );
+/* Same as csa_Decrypt() on each packet, packets sharing a key are
+ * descrambled in parallel */
+void   csa_DecryptBatch( csa_t *, uint8_t **pp_pkts, int i_pkts, int i_pkt_size );
 void   csa_Encrypt( csa_t *, uint8_t *pkt, int i_pkt_size );
 
 #endif /* _CSA_H */
@@ -0,0 +1,480 @@
+/*****************************************************************************
+ * csa_bitslice.h: bitsliced CSA descrambler core
+ *****************************************************************************
+ * Copyright (C) 2004-2015 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/* Included by csa.c once per word type, with:
+ *  csa_word_t  an integer or vector type of CSA_LANES bits
+ *  CSA_LANES   its width in bits, a multiple of 64
+ *  CSA_FN(n)   the name of n for this word type
+ *  CSA_TARGET  the function attributes for this word type
+ *
+ * The stream cypher runs one packet per bit of the words: each bit of its
+ * state is a word, and the s-boxes are boolean circuits. Its input and
+ * output blocks are transposed from and to the packet bytes. The block
+ * cypher keeps its table lookups, on 8 packets at once. */
+
+/* Nibbles 1..10 of the A and B registers are at [i_pos + 1..10], shifting
+ * only moves i_pos until the start of the ring is reached */
+#define CSA_RING 32
+
+typedef struct
+{
+    csa_word_t A[CSA_RING][4];
+    csa_word_t B[CSA_RING][4];
+    unsigned   i_pos;
+    csa_word_t X[4], Y[4], Z[4];
+    csa_word_t D[4], E[4], F[4];
+    csa_word_t p, q, r;
+} CSA_FN(stream_t);
+
+/* s-boxes 1 to 7 of the stream cypher, from 5 bits of A (a being the most
+ * significant bit of the index) to 2 bits */
+static inline CSA_TARGET void CSA_FN(Sbox1)( csa_word_t *restrict p_hi,
+                                             csa_word_t *restrict p_lo,
+                                             csa_word_t a, csa_word_t b, csa_word_t c,
+                                             csa_word_t d, csa_word_t e )
+{
+    const csa_word_t t0 = c | ~a;
+    const csa_word_t t1 = c | a;
+    const csa_word_t t2 = t0 ^ ( ( t0 ^ t1 ) & e );
+    const csa_word_t t3 = ~c;
+    const csa_word_t t4 = c ^ a;
+    const csa_word_t t5 = t4 & ~e;
+    const csa_word_t t6 = t2 ^ ( ( t2 ^ t5 ) & d );
+    const csa_word_t t7 = ~t4;
+    const csa_word_t t8 = t7 ^ e;
+    const csa_word_t t9 = t3 ^ ( ( t3 ^ t8 ) & d );
+    const csa_word_t t10 = t6 ^ ( ( t6 ^ t9 ) & b );
+    const csa_word_t t11 = t4 & e;
+    const csa_word_t t12 = t11 ^ d;
+    const csa_word_t t13 = ~t3;
+    const csa_word_t t14 = t0 ^ ( ( t0 ^ t13 ) & e );
+    const csa_word_t t15 = c & a;
+    const csa_word_t t16 = t15 ^ ( ( t15 ^ t4 ) & e );
+    const csa_word_t t17 = t14 ^ ( ( t14 ^ t16 ) & d );
+    const csa_word_t t18 = t12 ^ ( ( t12 ^ t17 ) & b );
+    *p_hi = t10;
+    *p_lo = t18;
+}
+
+static inline CSA_TARGET void CSA_FN(Sbox2)( csa_word_t *restrict p_hi,
+                                             csa_word_t *restrict p_lo,
+                                             csa_word_t a, csa_word_t b, csa_word_t c,
+                                             csa_word_t d, csa_word_t e )
+{
+    const csa_word_t t0 = ~d;
+    const csa_word_t t1 = t0 | c;
+    const csa_word_t t2 = ~t1;
+    const csa_word_t t3 = t1 ^ b;
+    const csa_word_t t4 = ~t0;
+    const csa_word_t t5 = t4 ^ c;
+    const csa_word_t t6 = ~t5;
+    const csa_word_t t7 = t5 ^ b;
+    const csa_word_t t8 = t3 ^ ( ( t3 ^ t7 ) & e );
+    const csa_word_t t9 = t0 ^ ( ( t0 ^ c ) & b );
+    const csa_word_t t10 = t4 | c;
+    const csa_word_t t11 = t10 ^ ( ( t10 ^ t2 ) & b );
+    const csa_word_t t12 = t9 ^ ( ( t9 ^ t11 ) & e );
+    const csa_word_t t13 = t8 ^ ( ( t8 ^ t12 ) & a );
+    const csa_word_t t14 = ~c;
+    const csa_word_t t15 = t0 ^ ( ( t0 ^ t14 ) & b );
+    const csa_word_t t16 = t6 ^ ( ( t6 ^ t15 ) & e );
+    const csa_word_t t17 = t0 ^ b;
+    const csa_word_t t18 = t14 ^ b;
+    const csa_word_t t19 = t17 ^ ( ( t17 ^ t18 ) & e );
+    const csa_word_t t20 = t16 ^ ( ( t16 ^ t19 ) & a );
+    *p_hi = t13;
+    *p_lo = t20;
+}
+
+static inline CSA_TARGET void CSA_FN(Sbox3)( csa_word_t *restrict p_hi,
+                                             csa_word_t *restrict p_lo,
+                                             csa_word_t a, csa_word_t b, csa_word_t c,
+                                             csa_word_t d, csa_word_t e )
+{
+    const csa_word_t t0 = ~d;
+    const csa_word_t t1 = t0 & ~a;
+    const csa_word_t t2 = t1 | c;
+    const csa_word_t t3 = ~t0;
+    const csa_word_t t4 = t3 ^ a;
+    const csa_word_t t5 = t4 ^ c;
+    const csa_word_t t6 = t2 ^ ( ( t2 ^ t5 ) & e );
+    const csa_word_t t7 = t0 & a;
+    const csa_word_t t8 = t7 ^ c;
+    const csa_word_t t9 = t3 ^ ( ( t3 ^ t7 ) & c );
+    const csa_word_t t10 = t8 ^ ( ( t8 ^ t9 ) & e );
+    const csa_word_t t11 = t6 ^ ( ( t6 ^ t10 ) & b );
+    const csa_word_t t12 = a ^ c;
+    const csa_word_t t13 = t4 ^ ( ( t4 ^ t12 ) & e );
+    const csa_word_t t14 = t13 ^ b;
+    *p_hi = t11;
+    *p_lo = t14;
+}
+
+static inline CSA_TARGET void CSA_FN(Sbox4)( csa_word_t *restrict p_hi,
+                                             csa_word_t *restrict p_lo,
+                                             csa_word_t a, csa_word_t b, csa_word_t c,
+                                             csa_word_t d, csa_word_t e )
+{
+    const csa_word_t t0 = ~e;
+    const csa_word_t t1 = t0 | d;
+    const csa_word_t t2 = ~t0;
+    const csa_word_t t3 = t1 ^ ( ( t1 ^ t2 ) & c );
+    const csa_word_t t4 = ~t1;
+    const csa_word_t t5 = t0 ^ d;
+    const csa_word_t t6 = t4 ^ ( ( t4 ^ t5 ) & c );
+    const csa_word_t t7 = t3 ^ ( ( t3 ^ t6 ) & b );
+    const csa_word_t t8 = t0 & d;
+    const csa_word_t t9 = t8 ^ c;
+    const csa_word_t t10 = ~t5;
+    const csa_word_t t11 = t9 ^ ( ( t9 ^ t10 ) & b );
+    const csa_word_t t12 = t7 ^ ( ( t7 ^ t11 ) & a );
+    const csa_word_t t13 = ~t11;
+    const csa_word_t t14 = t13 ^ ( ( t13 ^ t7 ) & a );
+    *p_hi = t12;
+    *p_lo = t14;
+}
+
+static inline CSA_TARGET void CSA_FN(Sbox5)( csa_word_t *restrict p_hi,
+                                             csa_word_t *restrict p_lo,
+                                             csa_word_t a, csa_word_t b, csa_word_t c,
+                                             csa_word_t d, csa_word_t e )
+{
+    const csa_word_t t0 = ~b;
+    const csa_word_t t1 = ~t0;
+    const csa_word_t t2 = t0 ^ d;
+    const csa_word_t t3 = t0 | d;
+    const csa_word_t t4 = t2 ^ ( ( t2 ^ t3 ) & c );
+    const csa_word_t t5 = t3 ^ c;
+    const csa_word_t t6 = t4 ^ ( ( t4 ^ t5 ) & a );
+    const csa_word_t t7 = t1 & d;
+    const csa_word_t t8 = t7 ^ ( ( t7 ^ t0 ) & c );
+    const csa_word_t t9 = t8 ^ ( ( t8 ^ t2 ) & a );
+    const csa_word_t t10 = t6 ^ ( ( t6 ^ t9 ) & e );
+    const csa_word_t t11 = t7 ^ c;
+    const csa_word_t t12 = ~t0;
+    const csa_word_t t13 = ~t2;
+    const csa_word_t t14 = t12 ^ ( ( t12 ^ t13 ) & c );
+    const csa_word_t t15 = t11 ^ ( ( t11 ^ t14 ) & a );
+    const csa_word_t t16 = t1 | d;
+    const csa_word_t t17 = t16 ^ ( ( t16 ^ t7 ) & c );
+    const csa_word_t t18 = t17 ^ a;
+    const csa_word_t t19 = t15 ^ ( ( t15 ^ t18 ) & e );
+    *p_hi = t10;
+    *p_lo = t19;
+}
+
+static inline CSA_TARGET void CSA_FN(Sbox6)( csa_word_t *restrict p_hi,
+                                             csa_word_t *restrict p_lo,
+                                             csa_word_t a, csa_word_t b, csa_word_t c,
+                                             csa_word_t d, csa_word_t e )
+{
+    const csa_word_t t0 = ~d;
+    const csa_word_t t1 = d ^ a;
+    const csa_word_t t2 = d | a;
+    const csa_word_t t3 = t2 ^ c;
+    const csa_word_t t4 = t1 ^ ( ( t1 ^ t3 ) & e );
+    const csa_word_t t5 = t1 ^ c;
+    const csa_word_t t6 = d & a;
+    const csa_word_t t7 = ~t6;
+    const csa_word_t t8 = t6 ^ c;
+    const csa_word_t t9 = t5 ^ ( ( t5 ^ t8 ) & e );
+    const csa_word_t t10 = t4 ^ ( ( t4 ^ t9 ) & b );
+    const csa_word_t t11 = t0 | a;
+    const csa_word_t t12 = t11 & c;
+    const csa_word_t t13 = ~t8;
+    const csa_word_t t14 = t12 ^ ( ( t12 ^ t13 ) & e );
+    const csa_word_t t15 = ~d;
+    const csa_word_t t16 = t15 ^ ( ( t15 ^ t7 ) & c );
+    const csa_word_t t17 = d ^ ( ( d ^ t16 ) & e );
+    const csa_word_t t18 = t14 ^ ( ( t14 ^ t17 ) & b );
+    *p_hi = t10;
+    *p_lo = t18;
+}
+
+static inline CSA_TARGET void CSA_FN(Sbox7)( csa_word_t *restrict p_hi,
+                                             csa_word_t *restrict p_lo,
+                                             csa_word_t a, csa_word_t b, csa_word_t c,
+                                             csa_word_t d, csa_word_t e )
+{
+    const csa_word_t t0 = ~c;
+    const csa_word_t t1 = c ^ e;
+    const csa_word_t t2 = t1 & ~a;
+    const csa_word_t t3 = t2 ^ b;
+    const csa_word_t t4 = t0 | e;
+    const csa_word_t t5 = t0 ^ ( ( t0 ^ t4 ) & a );
+    const csa_word_t t6 = c & e;
+    const csa_word_t t7 = t1 ^ ( ( t1 ^ t6 ) & a );
+    const csa_word_t t8 = t5 ^ ( ( t5 ^ t7 ) & b );
+    const csa_word_t t9 = t3 ^ ( ( t3 ^ t8 ) & d );
+    const csa_word_t t10 = t1 ^ a;
+    const csa_word_t t11 = ~e;
+    const csa_word_t t12 = t11 ^ a;
+    const csa_word_t t13 = t10 ^ ( ( t10 ^ t12 ) & b );
+    const csa_word_t t14 = t6 ^ a;
+    const csa_word_t t15 = t0 & ~e;
+    const csa_word_t t16 = t4 ^ ( ( t4 ^ t15 ) & a );
+    const csa_word_t t17 = t14 ^ ( ( t14 ^ t16 ) & b );
+    const csa_word_t t18 = t13 ^ ( ( t13 ^ t17 ) & d );
+    *p_hi = t9;
+    *p_lo = t18;
+}
+
+/* One clock of the stream cypher. During initialisation in_a and in_b are
+ * the input nibbles, otherwise they are NULL and 2 output bits are given */
+static inline CSA_TARGET void CSA_FN(Clock)( CSA_FN(stream_t) *s,
+                                             const csa_word_t *in_a,
+                                             const csa_word_t *in_b,
+                                             csa_word_t *p_hi, csa_word_t *p_lo )
+{
+    if( s->i_pos == 0 )
+    {
+        memmove( &s->A[CSA_RING - 10], &s->A[1], 10 * sizeof(s->A[0]) );
+        memmove( &s->B[CSA_RING - 10], &s->B[1], 10 * sizeof(s->B[0]) );
+        s->i_pos = CSA_RING - 11;
+    }
+    csa_word_t (*A)[4] = &s->A[s->i_pos];
+    csa_word_t (*B)[4] = &s->B[s->i_pos];
+
+    csa_word_t s1h, s1l, s2h, s2l, s3h, s3l, s4h, s4l, s5h, s5l, s6h, s6l, s7h, s7l;
+    CSA_FN(Sbox1)( &s1h, &s1l, A[4][0], A[1][2], A[6][1], A[7][3], A[9][0] );
+    CSA_FN(Sbox2)( &s2h, &s2l, A[2][1], A[3][2], A[6][3], A[7][0], A[9][1] );
+    CSA_FN(Sbox3)( &s3h, &s3l, A[1][3], A[2][0], A[5][1], A[5][3], A[6][2] );
+    CSA_FN(Sbox4)( &s4h, &s4l, A[3][3], A[1][1], A[2][3], A[4][2], A[8][0] );
+    CSA_FN(Sbox5)( &s5h, &s5l, A[5][2], A[4][3], A[6][0], A[8][1], A[9][2] );
+    CSA_FN(Sbox6)( &s6h, &s6l, A[3][1], A[4][1], A[5][0], A[7][2], A[9][3] );
+    CSA_FN(Sbox7)( &s7h, &s7l, A[2][2], A[3][0], A[7][1], A[8][2], A[8][3] );
+
+    /* extra nibble for T3 */
+    csa_word_t extra_B[4];
+    extra_B[3] = B[3][0] ^ B[6][1] ^ B[7][2] ^ B[9][3];
+    extra_B[2] = B[6][0] ^ B[8][1] ^ B[3][3] ^ B[4][2];
+    extra_B[1] = B[5][3] ^ B[8][2] ^ B[4][0] ^ B[5][1];
+    extra_B[0] = B[9][2] ^ B[6][3] ^ B[3][1] ^ B[8][0];
+
+    /* T1 and T2 */
+    csa_word_t next_A1[4], next_B1[4];
+    for( unsigned i = 0; i < 4; i++ )
+    {
+        next_A1[i] = A[10][i] ^ s->X[i];
+        next_B1[i] = B[7][i] ^ B[10][i] ^ s->Y[i];
+        if( in_a )
+        {
+            next_A1[i] ^= s->D[i] ^ in_a[i];
+            next_B1[i] ^= in_b[i];
+        }
+    }
+    /* rotated left if p */
+    const csa_word_t b3 = next_B1[3];
+    for( unsigned i = 3; i > 0; i-- )
+        next_B1[i] ^= ( next_B1[i] ^ next_B1[i - 1] ) & s->p;
+    next_B1[0] ^= ( next_B1[0] ^ b3 ) & s->p;
+
+    /* T3, and T4: F becomes Z + E + r if q, E otherwise, r is the carry */
+    csa_word_t carry = s->r;
+    for( unsigned i = 0; i < 4; i++ )
+    {
+        const csa_word_t e = s->E[i];
+        const csa_word_t z = s->Z[i];
+        const csa_word_t t = z ^ e;
+        const csa_word_t sum = t ^ carry;
+
+        s->D[i] = t ^ extra_B[i];
+        carry = ( z & e ) | ( carry & t );
+        s->E[i] = s->F[i];
+        s->F[i] = e ^ ( ( e ^ sum ) & s->q );
+    }
+    s->r ^= ( s->r ^ carry ) & s->q;
+
+    memcpy( A[0], next_A1, sizeof(next_A1) );
+    memcpy( B[0], next_B1, sizeof(next_B1) );
+    s->i_pos--;
+
+    s->X[3] = s4l; s->X[2] = s3l; s->X[1] = s2h; s->X[0] = s1h;
+    s->Y[3] = s6l; s->Y[2] = s5l; s->Y[1] = s4h; s->Y[0] = s3h;
+    s->Z[3] = s2l; s->Z[2] = s1l; s->Z[1] = s6h; s->Z[0] = s5h;
+    s->p = s7h;
+    s->q = s7l;
+
+    *p_hi = s->D[2] ^ s->D[3];
+    *p_lo = s->D[0] ^ s->D[1];
+}
+
+/* Loads the key into every lane and runs the 32 initialisation clocks on
+ * the first block, bit k of its byte i being in[8 * i + k] */
+static CSA_TARGET void CSA_FN(Init)( CSA_FN(stream_t) *s, const uint8_t ck[8],
+                                     const csa_word_t in[64] )
+{
+    const csa_word_t zero = { 0 };
+    const csa_word_t ones = ~zero;
+
+    memset( s, 0, sizeof(*s) );
+    s->i_pos = CSA_RING - 11;
+
+    csa_word_t (*A)[4] = &s->A[s->i_pos];
+    csa_word_t (*B)[4] = &s->B[s->i_pos];
+    for( unsigned i = 0; i < 4; i++ )
+    {
+        for( unsigned k = 0; k < 4; k++ )
+        {
+            A[1 + 2 * i][k] = ( ck[i] >> (4 + k) ) & 1 ? ones : zero;
+            A[2 + 2 * i][k] = ( ck[i] >> k ) & 1 ? ones : zero;
+            B[1 + 2 * i][k] = ( ck[4 + i] >> (4 + k) ) & 1 ? ones : zero;
+            B[2 + 2 * i][k] = ( ck[4 + i] >> k ) & 1 ? ones : zero;
+        }
+    }
+
+    for( unsigned i = 0; i < 8; i++ )
+    {
+        const csa_word_t *in1 = &in[8 * i + 4];
+        const csa_word_t *in2 = &in[8 * i];
+        csa_word_t hi, lo;
+        for( unsigned j = 0; j < 4; j++ )
+            CSA_FN(Clock)( s, (j & 1) ? in2 : in1, (j & 1) ? in1 : in2, &hi, &lo );
+    }
+}
+
+/* Next 8 bytes of stream, in the same layout as the Init() input */
+static CSA_TARGET void CSA_FN(Generate)( CSA_FN(stream_t) *s, csa_word_t out[64] )
+{
+    for( unsigned i = 0; i < 8; i++ )
+        for( unsigned j = 0; j < 4; j++ )
+            CSA_FN(Clock)( s, NULL, NULL, &out[8 * i + 7 - 2 * j],
+                           &out[8 * i + 6 - 2 * j] );
+}
+
+/* Bit k of the block of lane l goes to bit l of word k, lane l being bit
+ * l % 8 of byte l / 8 of the words in memory */
+static CSA_TARGET void CSA_FN(Slice)( csa_word_t words[64],
+                                      uint8_t *const *pp_blocks, unsigned i_lanes )
+{
+    uint8_t bytes[64][CSA_LANES / 8];
+
+    memset( bytes, 0, sizeof(bytes) );
+    for( unsigned b = 0; b < CSA_LANES / 8 && 8 * b < i_lanes; b++ )
+    {
+        const unsigned i_count = __MIN( i_lanes - 8 * b, 8 );
+        for( unsigned i = 0; i < 8; i++ )
+        {
+            uint64_t x = 0;
+            for( unsigned c = 0; c < i_count; c++ )
+                x |= (uint64_t)pp_blocks[8 * b + c][i] << ( 8 * c );
+            x = csa_Transpose8x8( x );
+            for( unsigned k = 0; k < 8; k++ )
+                bytes[8 * i + k][b] = x >> ( 8 * k );
+        }
+    }
+    memcpy( words, bytes, sizeof(bytes) );
+}
+
+static CSA_TARGET void CSA_FN(Unslice)( uint8_t (*p_blocks)[8],
+                                        const csa_word_t words[64], unsigned i_lanes )
+{
+    uint8_t bytes[64][CSA_LANES / 8];
+
+    memcpy( bytes, words, sizeof(bytes) );
+    for( unsigned b = 0; b < CSA_LANES / 8 && 8 * b < i_lanes; b++ )
+    {
+        const unsigned i_count = __MIN( i_lanes - 8 * b, 8 );
+        for( unsigned i = 0; i < 8; i++ )
+        {
+            uint64_t x = 0;
+            for( unsigned k = 0; k < 8; k++ )
+                x |= (uint64_t)bytes[8 * i + k][b] << ( 8 * k );
+            x = csa_Transpose8x8( x );
+            for( unsigned c = 0; c < i_count; c++ )
+                p_blocks[8 * b + c][i] = x >> ( 8 * c );
+        }
+    }
+}
+
+/* Descrambles up to CSA_LANES packets with the same key, as csa_Decrypt()
+ * would, once their scrambling control is cleared. The payload of each
+ * packet, from pi_hdr[l], holds at least one block. */
+static CSA_TARGET void CSA_FN(DecryptLanes)( uint8_t ck[8], uint8_t kk[57],
+                                             uint8_t *const *pp_pkts,
+                                             const unsigned *pi_hdr,
+                                             unsigned i_lanes, int i_pkt_size )
+{
+    CSA_FN(stream_t) s;
+    csa_word_t words[64];
+    uint8_t *pp_first[CSA_LANES];
+    uint8_t ib[CSA_LANES][8];
+    uint8_t stream[CSA_LANES][8];
+    unsigned pi_blocks[CSA_LANES];
+    unsigned i_max_blocks = 0, i_streams = 0;
+
+    assert( i_lanes <= CSA_LANES );
+
+    for( unsigned l = 0; l < i_lanes; l++ )
+    {
+        const unsigned i_blocks = ( i_pkt_size - pi_hdr[l] ) / 8;
+        const bool b_residue = ( i_pkt_size - pi_hdr[l] ) % 8 > 0;
+
+        pp_first[l] = &pp_pkts[l][pi_hdr[l]];
+        memcpy( ib[l], pp_first[l], 8 );
+        pi_blocks[l] = i_blocks;
+        i_max_blocks = __MAX( i_max_blocks, i_blocks );
+        /* one stream block per following block, and one for the residue */
+        i_streams = __MAX( i_streams, i_blocks - 1 + b_residue );
+    }
+
+    CSA_FN(Slice)( words, pp_first, i_lanes );
+    CSA_FN(Init)( &s, ck, words );
+
+    for( unsigned i = 1; i <= i_max_blocks; i++ )
+    {
+        if( i <= i_streams )
+        {
+            CSA_FN(Generate)( &s, words );
+            CSA_FN(Unslice)( stream, words, i_lanes );
+        }
+
+        /* the block cypher runs on 8 lanes at once, even ended ones */
+        uint8_t block[CSA_LANES][8];
+        for( unsigned l = 0; l < i_lanes; l += 8 )
+            csa_BlockDecypher8( kk, &ib[l], &block[l], __MIN( i_lanes - l, 8 ) );
+
+        for( unsigned l = 0; l < i_lanes; l++ )
+        {
+            if( i > pi_blocks[l] )
+                continue;
+
+            uint8_t *p_block = &pp_first[l][8 * (i - 1)];
+
+            if( i != pi_blocks[l] )
+            {
+                for( unsigned j = 0; j < 8; j++ )
+                    ib[l][j] = p_block[8 + j] ^ stream[l][j];
+            }
+            else
+            {
+                /* last block, then the residue */
+                memset( ib[l], 0, 8 );
+                const unsigned i_residue = ( i_pkt_size - pi_hdr[l] ) % 8;
+                for( unsigned j = 0; j < i_residue; j++ )
+                    pp_pkts[l][i_pkt_size - i_residue + j] ^= stream[l][j];
+            }
+            for( unsigned j = 0; j < 8; j++ )
+                p_block[j] = ib[l][j] ^ block[l][j];
+        }
+    }
+}
+
+#undef CSA_RING
@@ -480,10 +480,12 @@ static int AStreamControl(stream_t *s, int i_query, va_list args)
         case STREAM_GET_META:
         case STREAM_GET_CONTENT_TYPE:
         case STREAM_GET_SIGNAL:
+        case STREAM_GET_NET_STATS:
         case STREAM_SET_PAUSE_STATE:
         case STREAM_SET_PRIVATE_ID_STATE:
         case STREAM_SET_PRIVATE_ID_CA:
         case STREAM_GET_PRIVATE_ID_STATE:
+        case STREAM_SET_PRIVATE_ID_SECTION:
             return stream_vaControl(s->p_source, i_query, args);
 
         case STREAM_SET_TITLE:
@@ -495,6 +497,22 @@ static int AStreamControl(stream_t *s, int i_query, va_list args)
             return ret;
         }
 
+        case STREAM_GET_BUFFERED:
+        {
+            uint64_t *pi_size = va_arg(args, uint64_t *);
+            bool *pb_eof = va_arg(args, bool *);
+            const stream_track_t *tk = &sys->tk[sys->i_tk];
+
+            if (stream_Control(s->p_source, STREAM_GET_BUFFERED, pi_size, pb_eof))
+                return VLC_EGENERIC;
+            if (sys->i_pos >= tk->i_start && sys->i_pos < tk->i_end)
+                *pi_size += tk->i_end - sys->i_pos;
+            return VLC_SUCCESS;
+        }
+
+        case STREAM_IS_MAPPED:
+            return VLC_EGENERIC; /* the data is copied out of the cache */
+
         case STREAM_SET_RECORD_STATE:
         default:
             msg_Err(s, "invalid stream_vaControl query=0x%x", i_query);
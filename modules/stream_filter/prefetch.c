@@ -390,7 +390,21 @@ static int Control(stream_t *stream, int query, va_list args)
             *va_arg(args, char **) = strdup(sys->content_type);
             return VLC_SUCCESS;
         case STREAM_GET_SIGNAL:
+        case STREAM_GET_NET_STATS:
+        case STREAM_IS_MAPPED:
             return VLC_EGENERIC;
+        case STREAM_GET_BUFFERED:
+        {
+            uint64_t *size = va_arg(args, uint64_t *);
+            bool *eof = va_arg(args, bool *);
+
+            vlc_mutex_lock(&sys->lock);
+            *size = BufferLevel(stream, eof);
+            /* All the rest is buffered once the source hit its end */
+            *eof = sys->eof;
+            vlc_mutex_unlock(&sys->lock);
+            break;
+        }
         case STREAM_SET_PAUSE_STATE:
         {
             bool paused = va_arg(args, unsigned);
@@ -406,6 +420,7 @@ static int Control(stream_t *stream, int query, va_list args)
         case STREAM_SET_PRIVATE_ID_STATE:
         case STREAM_SET_PRIVATE_ID_CA:
         case STREAM_GET_PRIVATE_ID_STATE:
+        case STREAM_SET_PRIVATE_ID_SECTION:
             return VLC_EGENERIC;
         default:
             msg_Err(stream, "unimplemented query (%d) in control", query);
@@ -65,6 +65,7 @@ struct stream_sys_t
  * Local prototypes
  ****************************************************************************/
 static ssize_t Read( stream_t *, void *p_read, size_t i_read );
+static block_t *Block( stream_t *, bool *restrict pb_eof );
 static int  Seek   ( stream_t *, uint64_t );
 static int  Control( stream_t *, int i_query, va_list );
 
@@ -89,6 +90,9 @@ static int Open ( vlc_object_t *p_this )
 
     /* */
     s->pf_read = Read;
+    /* Pass the blocks through when the source has them without copy */
+    if( s->p_source->pf_block != NULL )
+        s->pf_block = Block;
     s->pf_seek = Seek;
     s->pf_control = Control;
     stream_FilterSetDefaultReadDir( s );
@@ -137,6 +141,24 @@ static ssize_t Read( stream_t *s, void *p_read, size_t i_read )
     return i_record;
 }
 
+static block_t *Block( stream_t *s, bool *restrict pb_eof )
+{
+    stream_sys_t *p_sys = s->p_sys;
+    block_t *p_block = stream_ReadBlock( s->p_source );
+
+    if( p_block == NULL )
+    {
+        *pb_eof = true;
+        return NULL;
+    }
+
+    /* Dump read data */
+    if( p_sys->f )
+        Write( s, p_block->p_buffer, p_block->i_buffer );
+
+    return p_block;
+}
+
 static int Seek( stream_t *s, uint64_t offset )
 {
     return stream_Seek( s->p_source, offset );
@@ -0,0 +1,287 @@
+/*****************************************************************************
+ * tsfilter.c: MPEG-TS software pid filter stream filter
+ *****************************************************************************
+ * Copyright (C) 2004-2015 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <vlc_common.h>
+#include <vlc_plugin.h>
+#include <vlc_stream.h>
+#include <vlc_block.h>
+
+#include "../demux/mpeg/ts_filter.h"
+#include "../demux/mpeg/ts_sync.h"
+
+static int  Open( vlc_object_t * );
+static void Close( vlc_object_t * );
+
+vlc_module_begin ()
+    set_category( CAT_INPUT )
+    set_subcategory( SUBCAT_INPUT_STREAM_FILTER )
+    set_capability( "stream_filter", 0 )
+    add_shortcut( "tsfilter" )
+    set_description( N_("MPEG-TS pid filter") )
+    set_callbacks( Open, Close )
+vlc_module_end ()
+
+/* Largest packet, BluRay packets being smaller */
+#define TS_PACKET_MAX 204
+
+struct stream_sys_t
+{
+    ts_filter_t *p_filter;
+    bool         b_enabled;     /* the demuxer selected pids */
+
+    block_t     *p_next;        /* filtered data not read yet */
+    size_t       i_packet_size; /* 0 until synchronized */
+    unsigned     i_header;
+    size_t       i_tail;        /* start of a packet cut between blocks */
+    uint8_t      p_tail[TS_PACKET_MAX];
+};
+
+/* Filters a block of the source, and keeps the end of its last packet */
+static block_t *Filter( stream_t *s, block_t *p_block )
+{
+    stream_sys_t *p_sys = s->p_sys;
+
+    if( p_sys->i_tail > 0 )
+    {
+        p_block = block_Realloc( p_block, p_sys->i_tail, p_block->i_buffer );
+        if( unlikely(p_block == NULL) )
+        {
+            p_sys->i_tail = 0;
+            return NULL;
+        }
+        memcpy( p_block->p_buffer, p_sys->p_tail, p_sys->i_tail );
+        p_sys->i_tail = 0;
+    }
+
+    uint8_t *p = p_block->p_buffer;
+    size_t i_size = p_block->i_buffer;
+    size_t i_start = 0;
+
+    if( p_sys->i_packet_size == 0 )
+    {
+        size_t i_sync;
+        int i_packet_size = ts_sync_DetectPacketSize( p, i_size, &i_sync,
+                                                      &p_sys->i_header );
+        /* The bytes out of sync are left to the demuxer */
+        if( i_packet_size < 0 )
+            return p_block;
+        p_sys->i_packet_size = i_packet_size;
+        i_start = i_sync - p_sys->i_header;
+        msg_Dbg( s, "filtering %d bytes packets", i_packet_size );
+    }
+
+    size_t i_read;
+    size_t i_kept = ts_filter_Packets( p_sys->p_filter, &p[i_start],
+                                       i_size - i_start, p_sys->i_packet_size,
+                                       p_sys->i_header, &i_read );
+    size_t i_left = i_size - i_start - i_read;
+
+    if( i_left >= p_sys->i_packet_size )
+    {
+        /* Sync lost: the rest is passed, until the next block */
+        msg_Warn( s, "synchronization lost" );
+        p_sys->i_packet_size = 0;
+        memmove( &p[i_start + i_kept], &p[i_start + i_read], i_left );
+        i_kept += i_left;
+    }
+    else
+    {
+        memcpy( p_sys->p_tail, &p[i_start + i_read], i_left );
+        p_sys->i_tail = i_left;
+    }
+
+    p_block->i_buffer = i_start + i_kept;
+    return p_block;
+}
+
+static block_t *Block( stream_t *s, bool *pb_eof )
+{
+    stream_sys_t *p_sys = s->p_sys;
+    block_t *p_block = p_sys->p_next;
+
+    if( p_block != NULL )
+    {
+        p_sys->p_next = NULL;
+        return p_block;
+    }
+
+    p_block = stream_ReadBlock( s->p_source );
+    if( p_block == NULL )
+    {
+        *pb_eof = true;
+        return NULL;
+    }
+
+    /* Everything is passed until the demuxer selects pids */
+    if( !p_sys->b_enabled )
+        return p_block;
+
+    p_block = Filter( s, p_block );
+    if( p_block != NULL && p_block->i_buffer == 0 )
+    {
+        block_Release( p_block );
+        p_block = NULL;
+    }
+    return p_block;
+}
+
+static ssize_t Read( stream_t *s, void *p_buf, size_t i_len )
+{
+    stream_sys_t *p_sys = s->p_sys;
+    block_t *p_block = p_sys->p_next;
+
+    while( p_block == NULL )
+    {
+        bool b_eof = false;
+
+        p_block = Block( s, &b_eof );
+        if( b_eof )
+            return 0;
+    }
+
+    size_t i_copy = __MIN( i_len, p_block->i_buffer );
+    if( p_buf != NULL )
+        memcpy( p_buf, p_block->p_buffer, i_copy );
+    p_block->p_buffer += i_copy;
+    p_block->i_buffer -= i_copy;
+
+    if( p_block->i_buffer == 0 )
+    {
+        block_Release( p_block );
+        p_block = NULL;
+    }
+    p_sys->p_next = p_block;
+    return i_copy;
+}
+
+static int Control( stream_t *s, int i_query, va_list args )
+{
+    stream_sys_t *p_sys = s->p_sys;
+
+    switch( i_query )
+    {
+        case STREAM_SET_PRIVATE_ID_STATE:
+        {
+            unsigned i_pid = va_arg( args, int );
+            bool b_selected = va_arg( args, int );
+
+            if( unlikely(i_pid > 0x1FFF) )
+                return VLC_EGENERIC;
+            ts_filter_SetPID( p_sys->p_filter, i_pid, b_selected );
+            p_sys->b_enabled = true;
+            return VLC_SUCCESS;
+        }
+
+        case STREAM_GET_PRIVATE_ID_STATE:
+        {
+            unsigned i_pid = va_arg( args, int );
+            bool *pb_selected = va_arg( args, bool * );
+
+            *pb_selected = likely(i_pid <= 0x1FFF)
+                         ? ts_filter_GetPID( p_sys->p_filter, i_pid ) : false;
+            return VLC_SUCCESS;
+        }
+
+        case STREAM_SET_PRIVATE_ID_SECTION:
+        {
+            unsigned i_pid = va_arg( args, int );
+            int i_table_id = va_arg( args, int );
+            int i_mask = va_arg( args, int );
+            int i_extension = va_arg( args, int );
+            bool b_selected = va_arg( args, int );
+
+            if( unlikely(i_pid > 0x1FFF) )
+                return VLC_EGENERIC;
+            return ts_filter_SetSection( p_sys->p_filter, i_pid, i_table_id,
+                                         i_mask, i_extension, b_selected );
+        }
+
+        case STREAM_GET_BUFFERED:
+        {
+            uint64_t *pi_size = va_arg( args, uint64_t * );
+            bool *pb_eof = va_arg( args, bool * );
+
+            if( stream_Control( s->p_source, STREAM_GET_BUFFERED,
+                                pi_size, pb_eof ) )
+                return VLC_EGENERIC;
+            *pi_size += p_sys->i_tail;
+            if( p_sys->p_next != NULL )
+                *pi_size += p_sys->p_next->i_buffer;
+            return VLC_SUCCESS;
+        }
+
+        default:
+            return stream_vaControl( s->p_source, i_query, args );
+    }
+}
+
+static int Open( vlc_object_t *p_this )
+{
+    stream_t *s = (stream_t *)p_this;
+    bool b_can_seek;
+
+    /* The packets dropped would shift the offsets of seekable streams */
+    if( stream_Control( s->p_source, STREAM_CAN_SEEK, &b_can_seek ) ||
+        b_can_seek )
+        return VLC_EGENERIC;
+
+    /* The source filters the pids by itself */
+    if( stream_Control( s->p_source, STREAM_GET_PRIVATE_ID_STATE, 0,
+                        &(bool){ false } ) == VLC_SUCCESS )
+        return VLC_EGENERIC;
+
+    stream_sys_t *p_sys = malloc( sizeof( *p_sys ) );
+    if( unlikely(p_sys == NULL) )
+        return VLC_ENOMEM;
+
+    p_sys->p_filter = ts_filter_New();
+    if( unlikely(p_sys->p_filter == NULL) )
+    {
+        free( p_sys );
+        return VLC_ENOMEM;
+    }
+    p_sys->b_enabled = false;
+    p_sys->p_next = NULL;
+    p_sys->i_packet_size = 0;
+    p_sys->i_header = 0;
+    p_sys->i_tail = 0;
+
+    s->p_sys = p_sys;
+    s->pf_read = Read;
+    s->pf_block = Block;
+    s->pf_seek = NULL;
+    s->pf_control = Control;
+    return VLC_SUCCESS;
+}
+
+static void Close( vlc_object_t *p_this )
+{
+    stream_t *s = (stream_t *)p_this;
+    stream_sys_t *p_sys = s->p_sys;
+
+    if( p_sys->p_next != NULL )
+        block_Release( p_sys->p_next );
+    ts_filter_Delete( p_sys->p_filter );
+    free( p_sys );
+}
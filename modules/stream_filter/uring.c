@@ -0,0 +1,685 @@
+/*****************************************************************************
+ * uring.c: io_uring read-ahead stream filter
+ *****************************************************************************
+ * Copyright (C) 2004-2015 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <sys/vfs.h>
+#include <linux/io_uring.h>
+#include <linux/magic.h>
+
+#include <vlc_common.h>
+#include <vlc_plugin.h>
+#include <vlc_stream.h>
+#include <vlc_fs.h>
+#include <vlc_url.h>
+#include <vlc_interrupt.h>
+#include <vlc_atomic.h>
+
+/* The file is cut into chunks of the read size, aligned on their size. A
+ * buffer per chunk is registered with the kernel once, and the reads of
+ * the chunks following the read position are kept in flight, each buffer
+ * being recycled for the next chunk as soon as it was read through. */
+
+/* Offset, address and length alignment of direct I/O */
+#define URING_DIRECT_ALIGN 4096
+
+typedef struct
+{
+    uint8_t *data;
+    struct iovec iov;   /* without registered buffers */
+    uint64_t chunk;
+    size_t length;      /* bytes read so far */
+    size_t start;       /* of the read in flight, within the chunk */
+    int error;
+    bool pending;       /* read in flight */
+    bool end;           /* the file ends within the chunk */
+} uring_buffer_t;
+
+struct stream_sys_t
+{
+    int fd;
+    int ring;
+    bool fixed;         /* registered buffers */
+    size_t align;       /* of the reads, URING_DIRECT_ALIGN with O_DIRECT */
+
+    struct
+    {
+        atomic_uint *tail;
+        unsigned *head, *mask, *array;
+        unsigned pending;  /* entries not yet submitted */
+        void *map;
+        size_t map_size;
+    } sq;
+    struct
+    {
+        atomic_uint *head, *tail;
+        unsigned *mask;
+        struct io_uring_cqe *cqes;
+        void *map;
+        size_t map_size;
+    } cq;
+    struct io_uring_sqe *sqes;
+    size_t sqes_size;
+
+    uint8_t *memory;
+    uring_buffer_t *buffers;
+    unsigned depth;
+    size_t read_size;
+
+    unsigned head;      /* buffer of the chunk at the read position */
+    uint64_t head_chunk;
+    unsigned queued;    /* buffers assigned to the chunks from head_chunk */
+
+    uint64_t offset;
+    uint64_t size;
+};
+
+#ifndef __NR_io_uring_setup
+# define __NR_io_uring_setup    425
+# define __NR_io_uring_enter    426
+# define __NR_io_uring_register 427
+#endif
+
+static int uring_setup(unsigned entries, struct io_uring_params *p)
+{
+    return syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int uring_enter(int fd, unsigned submit, unsigned complete,
+                       unsigned flags)
+{
+    return syscall(__NR_io_uring_enter, fd, submit, complete, flags, NULL, 0);
+}
+
+static int uring_register(int fd, unsigned op, const void *arg, unsigned n)
+{
+    return syscall(__NR_io_uring_register, fd, op, arg, n);
+}
+
+static bool IsRemote(int fd)
+{
+    struct statfs stf;
+
+    if (fstatfs(fd, &stf))
+        return false;
+
+    switch ((unsigned long)stf.f_type)
+    {
+        case AFS_SUPER_MAGIC:
+        case CODA_SUPER_MAGIC:
+        case NCP_SUPER_MAGIC:
+        case NFS_SUPER_MAGIC:
+        case SMB_SUPER_MAGIC:
+        case 0xFF534D42 /*CIFS_MAGIC_NUMBER*/:
+        case 0xFE534D42 /*SMB2_MAGIC_NUMBER*/:
+        case CEPH_SUPER_MAGIC:
+        case FUSE_SUPER_MAGIC: /* sshfs and other network file systems */
+            return true;
+    }
+    return false;
+}
+
+static void Submit(stream_t *stream, unsigned index)
+{
+    stream_sys_t *sys = stream->p_sys;
+    uring_buffer_t *buf = &sys->buffers[index];
+    unsigned tail = atomic_load_explicit(sys->sq.tail, memory_order_relaxed);
+    unsigned slot = tail & *sys->sq.mask;
+    struct io_uring_sqe *sqe = &sys->sqes[slot];
+
+    assert(!buf->pending);
+    /* The rest of a short read starts on the aligned offset before it,
+     * reading the bytes in between again */
+    buf->start = buf->length & ~(sys->align - 1);
+
+    memset(sqe, 0, sizeof (*sqe));
+    sqe->fd = sys->fd;
+    sqe->off = buf->chunk * sys->read_size + buf->start;
+    sqe->user_data = index;
+
+    if (sys->fixed)
+    {
+        sqe->opcode = IORING_OP_READ_FIXED;
+        sqe->addr = (uintptr_t)(buf->data + buf->start);
+        sqe->len = sys->read_size - buf->start;
+        sqe->buf_index = 0;
+    }
+    else
+    {
+        buf->iov.iov_base = buf->data + buf->start;
+        buf->iov.iov_len = sys->read_size - buf->start;
+        sqe->opcode = IORING_OP_READV;
+        sqe->addr = (uintptr_t)&buf->iov;
+        sqe->len = 1;
+    }
+
+    sys->sq.array[slot] = slot;
+    atomic_store_explicit(sys->sq.tail, tail + 1, memory_order_release);
+    sys->sq.pending++;
+    buf->pending = true;
+}
+
+/* Takes the reads the kernel refused back out of the ring, failing their
+ * buffers: no completion would ever come for them */
+static void Withdraw(stream_t *stream, int error)
+{
+    stream_sys_t *sys = stream->p_sys;
+    unsigned tail = atomic_load_explicit(sys->sq.tail, memory_order_relaxed);
+
+    for (; sys->sq.pending > 0; sys->sq.pending--)
+    {
+        tail--;
+        const struct io_uring_sqe *sqe =
+            &sys->sqes[sys->sq.array[tail & *sys->sq.mask]];
+        uring_buffer_t *buf = &sys->buffers[sqe->user_data];
+
+        assert(buf->pending);
+        buf->pending = false;
+        buf->error = error;
+    }
+    atomic_store_explicit(sys->sq.tail, tail, memory_order_release);
+}
+
+/* Passes the queued reads to the kernel */
+static void Flush(stream_t *stream)
+{
+    stream_sys_t *sys = stream->p_sys;
+
+    while (sys->sq.pending > 0)
+    {
+        int val = uring_enter(sys->ring, sys->sq.pending, 0, 0);
+        if (val < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EBUSY)
+                break; /* left in the ring for the next attempt */
+            msg_Err(stream, "cannot submit reads: %s", vlc_strerror_c(errno));
+            Withdraw(stream, errno);
+            break;
+        }
+        sys->sq.pending -= val;
+    }
+}
+
+/* Collects the completed reads, without waiting */
+static void Reap(stream_t *stream)
+{
+    stream_sys_t *sys = stream->p_sys;
+    unsigned head = atomic_load_explicit(sys->cq.head, memory_order_relaxed);
+    unsigned tail = atomic_load_explicit(sys->cq.tail, memory_order_acquire);
+
+    for (; head != tail; head++)
+    {
+        const struct io_uring_cqe *cqe = &sys->cq.cqes[head & *sys->cq.mask];
+        uring_buffer_t *buf = &sys->buffers[cqe->user_data];
+
+        assert(buf->pending);
+        buf->pending = false;
+
+        if (cqe->res > 0 && buf->start + cqe->res > buf->length)
+            buf->length = buf->start + cqe->res;
+        else if (cqe->res >= 0)
+            buf->end = true; /* nothing past the bytes already read */
+        else if (cqe->res != -EINTR && cqe->res != -EAGAIN)
+            buf->error = -cqe->res;
+        /* otherwise, the read is resubmitted when needed */
+    }
+    atomic_store_explicit(sys->cq.head, head, memory_order_release);
+}
+
+/* Waits for some read to complete. */
+static int Wait(stream_t *stream, bool interruptible)
+{
+    stream_sys_t *sys = stream->p_sys;
+    struct pollfd ufd = { .fd = sys->ring, .events = POLLIN };
+
+    Flush(stream);
+
+    bool busy = false;
+    for (unsigned i = 0; i < sys->depth; i++)
+        busy |= sys->buffers[i].pending;
+    if (!busy)
+        return 0; /* the reads were refused, nothing will complete */
+
+    /* The reads still in the ring are submitted again on the next call */
+    int timeout = sys->sq.pending > 0 ? 10 : -1;
+    int val = interruptible ? vlc_poll_i11e(&ufd, 1, timeout)
+                            : poll(&ufd, 1, timeout);
+    if (val < 0 && errno != EINTR)
+        return -1;
+    if (val < 0 && interruptible)
+        return -1;
+
+    Reap(stream);
+    return 0;
+}
+
+/* Waits for a buffer before reusing it */
+static void Drain(stream_t *stream, uring_buffer_t *buf)
+{
+    while (buf->pending)
+        Wait(stream, false);
+}
+
+/* Assigns the idle buffers to the next chunks, and reads them */
+static void Fill(stream_t *stream)
+{
+    stream_sys_t *sys = stream->p_sys;
+
+    while (sys->queued < sys->depth)
+    {
+        uint64_t chunk = sys->head_chunk + sys->queued;
+        if (chunk * sys->read_size >= sys->size)
+            break;
+
+        unsigned index = (sys->head + sys->queued) % sys->depth;
+        uring_buffer_t *buf = &sys->buffers[index];
+
+        buf->chunk = chunk;
+        buf->length = 0;
+        buf->start = 0;
+        buf->error = 0;
+        buf->end = false;
+        Submit(stream, index);
+        sys->queued++;
+    }
+    Flush(stream);
+}
+
+/* Moves the read-ahead window to the chunk of the read position */
+static void Move(stream_t *stream)
+{
+    stream_sys_t *sys = stream->p_sys;
+    uint64_t chunk = sys->offset / sys->read_size;
+
+    if (chunk < sys->head_chunk || chunk >= sys->head_chunk + sys->queued)
+    {   /* Out of the window: start over */
+        for (unsigned i = 0; i < sys->depth; i++)
+            Drain(stream, &sys->buffers[i]);
+        sys->head_chunk = chunk;
+        sys->queued = 0;
+    }
+
+    while (sys->head_chunk < chunk)
+    {   /* Skip the chunks behind, recycling their buffers */
+        Drain(stream, &sys->buffers[sys->head]);
+        sys->head = (sys->head + 1) % sys->depth;
+        sys->head_chunk++;
+        sys->queued--;
+    }
+
+    Fill(stream);
+}
+
+static ssize_t Read(stream_t *stream, void *buf, size_t length)
+{
+    stream_sys_t *sys = stream->p_sys;
+
+    Move(stream);
+
+    for (;;)
+    {
+        if (sys->queued == 0)
+        {   /* At the end, unless the file grew */
+            struct stat st;
+
+            if (fstat(sys->fd, &st) || (uint64_t)st.st_size <= sys->size)
+                return 0;
+            sys->size = st.st_size;
+            Move(stream);
+            continue;
+        }
+
+        uring_buffer_t *b = &sys->buffers[sys->head];
+        size_t inner = sys->offset - b->chunk * sys->read_size;
+
+        if (b->length > inner)
+        {
+            size_t copy = b->length - inner;
+            if (copy > length)
+                copy = length;
+            if (buf != NULL)
+                memcpy(buf, b->data + inner, copy);
+            sys->offset += copy;
+
+            if (inner + copy == sys->read_size)
+                Move(stream); /* recycle the buffer at once */
+            return copy;
+        }
+
+        if (b->error)
+        {
+            msg_Err(stream, "read error: %s", vlc_strerror_c(b->error));
+            return 0;
+        }
+
+        if (!b->pending)
+        {
+            if (b->end || b->chunk * sys->read_size + b->length >= sys->size)
+            {   /* At the end, unless the file grew */
+                struct stat st;
+
+                if (fstat(sys->fd, &st)
+                 || (uint64_t)st.st_size <= b->chunk * sys->read_size + b->length)
+                    return 0;
+                sys->size = st.st_size;
+                b->end = false;
+            }
+            Submit(stream, sys->head); /* short read: read the rest */
+        }
+
+        if (Wait(stream, true))
+            return -1;
+    }
+}
+
+static int Seek(stream_t *stream, uint64_t offset)
+{
+    stream_sys_t *sys = stream->p_sys;
+
+    sys->offset = offset;
+    return VLC_SUCCESS;
+}
+
+static int Control(stream_t *stream, int query, va_list args)
+{
+    stream_sys_t *sys = stream->p_sys;
+
+    switch (query)
+    {
+        case STREAM_CAN_SEEK:
+        case STREAM_CAN_FASTSEEK:
+        case STREAM_CAN_PAUSE:
+        case STREAM_CAN_CONTROL_PACE:
+            *va_arg(args, bool *) = true;
+            break;
+        case STREAM_GET_SIZE:
+        {
+            struct stat st;
+
+            if (fstat(sys->fd, &st))
+                return VLC_EGENERIC;
+            *va_arg(args, uint64_t *) = st.st_size;
+            break;
+        }
+        case STREAM_GET_BUFFERED:
+        {
+            uint64_t *size = va_arg(args, uint64_t *);
+            bool *eof = va_arg(args, bool *);
+            uint64_t end = sys->offset;
+
+            Reap(stream);
+            for (unsigned i = 0; i < sys->queued; i++)
+            {
+                const uring_buffer_t *b =
+                    &sys->buffers[(sys->head + i) % sys->depth];
+                uint64_t b_end = b->chunk * sys->read_size + b->length;
+
+                if (b_end > end)
+                    end = b_end;
+                if (b->length < sys->read_size)
+                    break;
+            }
+            *size = end - sys->offset;
+            *eof = end >= sys->size;
+            break;
+        }
+        case STREAM_IS_MAPPED:
+            return VLC_EGENERIC; /* the data is read into the ring */
+        default:
+            return stream_vaControl(stream->p_source, query, args);
+    }
+    return VLC_SUCCESS;
+}
+
+static int MapRings(stream_t *stream, const struct io_uring_params *p)
+{
+    stream_sys_t *sys = stream->p_sys;
+
+    sys->sq.map_size = p->sq_off.array + p->sq_entries * sizeof (unsigned);
+    sys->cq.map_size = p->cq_off.cqes
+                     + p->cq_entries * sizeof (struct io_uring_cqe);
+    if (p->features & IORING_FEAT_SINGLE_MMAP)
+    {
+        if (sys->cq.map_size > sys->sq.map_size)
+            sys->sq.map_size = sys->cq.map_size;
+    }
+
+    sys->sq.map = mmap(NULL, sys->sq.map_size, PROT_READ|PROT_WRITE,
+                       MAP_SHARED|MAP_POPULATE, sys->ring, IORING_OFF_SQ_RING);
+    if (sys->sq.map == MAP_FAILED)
+        return -1;
+
+    if (p->features & IORING_FEAT_SINGLE_MMAP)
+        sys->cq.map = sys->sq.map;
+    else
+    {
+        sys->cq.map = mmap(NULL, sys->cq.map_size, PROT_READ|PROT_WRITE,
+                           MAP_SHARED|MAP_POPULATE, sys->ring,
+                           IORING_OFF_CQ_RING);
+        if (sys->cq.map == MAP_FAILED)
+        {
+            munmap(sys->sq.map, sys->sq.map_size);
+            return -1;
+        }
+    }
+
+    sys->sqes_size = p->sq_entries * sizeof (struct io_uring_sqe);
+    sys->sqes = mmap(NULL, sys->sqes_size, PROT_READ|PROT_WRITE,
+                     MAP_SHARED|MAP_POPULATE, sys->ring, IORING_OFF_SQES);
+    if (sys->sqes == MAP_FAILED)
+    {
+        if (sys->cq.map != sys->sq.map)
+            munmap(sys->cq.map, sys->cq.map_size);
+        munmap(sys->sq.map, sys->sq.map_size);
+        return -1;
+    }
+
+    uint8_t *sq = sys->sq.map, *cq = sys->cq.map;
+
+    sys->sq.head = (unsigned *)(sq + p->sq_off.head);
+    sys->sq.tail = (atomic_uint *)(sq + p->sq_off.tail);
+    sys->sq.mask = (unsigned *)(sq + p->sq_off.ring_mask);
+    sys->sq.array = (unsigned *)(sq + p->sq_off.array);
+    sys->sq.pending = 0;
+    sys->cq.head = (atomic_uint *)(cq + p->cq_off.head);
+    sys->cq.tail = (atomic_uint *)(cq + p->cq_off.tail);
+    sys->cq.mask = (unsigned *)(cq + p->cq_off.ring_mask);
+    sys->cq.cqes = (struct io_uring_cqe *)(cq + p->cq_off.cqes);
+    return 0;
+}
+
+static void UnmapRings(stream_t *stream)
+{
+    stream_sys_t *sys = stream->p_sys;
+
+    munmap(sys->sqes, sys->sqes_size);
+    if (sys->cq.map != sys->sq.map)
+        munmap(sys->cq.map, sys->cq.map_size);
+    munmap(sys->sq.map, sys->sq.map_size);
+}
+
+static int Open(vlc_object_t *obj)
+{
+    stream_t *stream = (stream_t *)obj;
+
+    if (stream->psz_url == NULL)
+        return VLC_EGENERIC;
+
+    /* Only files are read directly, in place of the source stream */
+    char *path = make_path(stream->psz_url);
+    if (path == NULL)
+        return VLC_EGENERIC;
+
+    bool direct = var_InheritBool(obj, "uring-direct");
+    int fd = vlc_open(path, O_RDONLY | (direct ? O_DIRECT : 0));
+    if (fd == -1 && direct)
+    {   /* Some file systems (e.g. tmpfs) refuse direct I/O */
+        direct = false;
+        fd = vlc_open(path, O_RDONLY);
+    }
+    free(path);
+    if (fd == -1)
+        return VLC_EGENERIC;
+
+    struct stat st;
+    if (fstat(fd, &st) || !S_ISREG(st.st_mode))
+        goto error;
+
+    /* Local storage is fast enough for the regular read-ahead */
+    if (!IsRemote(fd) && !var_InheritBool(obj, "uring-local"))
+        goto error;
+
+    stream_sys_t *sys = malloc(sizeof (*sys));
+    if (unlikely(sys == NULL))
+        goto error;
+
+    sys->fd = fd;
+    sys->align = direct ? URING_DIRECT_ALIGN : 1;
+    sys->depth = var_InheritInteger(obj, "uring-depth");
+    sys->read_size = var_InheritInteger(obj, "uring-read-size") << 10;
+    /* Aligned for direct I/O */
+    sys->read_size = (sys->read_size + URING_DIRECT_ALIGN - 1)
+                   & ~(size_t)(URING_DIRECT_ALIGN - 1);
+    sys->head = 0;
+    sys->head_chunk = 0;
+    sys->queued = 0;
+    sys->offset = 0;
+    sys->size = st.st_size;
+    stream->p_sys = sys;
+
+    struct io_uring_params params;
+    memset(&params, 0, sizeof (params));
+    sys->ring = uring_setup(sys->depth, &params);
+    if (sys->ring == -1)
+    {
+        msg_Dbg(stream, "io_uring unavailable: %s", vlc_strerror_c(errno));
+        goto error_sys;
+    }
+
+    if (MapRings(stream, &params))
+        goto error_ring;
+
+    sys->memory = vlc_memalign(URING_DIRECT_ALIGN, sys->depth * sys->read_size);
+    sys->buffers = calloc(sys->depth, sizeof (*sys->buffers));
+    if (unlikely(sys->memory == NULL || sys->buffers == NULL))
+        goto error_mem;
+
+    for (unsigned i = 0; i < sys->depth; i++)
+        sys->buffers[i].data = sys->memory + i * sys->read_size;
+
+    /* Registered buffers are pinned once, rather than for each read. The
+     * locked memory limit can forbid it though. */
+    const struct iovec iov = {
+        .iov_base = sys->memory,
+        .iov_len = sys->depth * sys->read_size,
+    };
+    sys->fixed = uring_register(sys->ring, IORING_REGISTER_BUFFERS, &iov,
+                                1) == 0;
+    if (!sys->fixed)
+        msg_Dbg(stream, "cannot register buffers: %s",
+                vlc_strerror_c(errno));
+
+    stream->pf_read = Read;
+    stream->pf_seek = Seek;
+    stream->pf_control = Control;
+    stream_FilterSetDefaultReadDir(stream);
+
+    msg_Dbg(stream, "%u reads of %zu bytes in flight%s%s", sys->depth,
+            sys->read_size, sys->fixed ? ", registered buffers" : "",
+            direct ? ", direct I/O" : "");
+    Fill(stream);
+    return VLC_SUCCESS;
+
+error_mem:
+    free(sys->buffers);
+    vlc_free(sys->memory);
+    UnmapRings(stream);
+error_ring:
+    close(sys->ring);
+error_sys:
+    free(sys);
+error:
+    close(fd);
+    return VLC_EGENERIC;
+}
+
+static void Close(vlc_object_t *obj)
+{
+    stream_t *stream = (stream_t *)obj;
+    stream_sys_t *sys = stream->p_sys;
+
+    /* The kernel must be done with the buffers before they are freed */
+    for (unsigned i = 0; i < sys->depth; i++)
+        Drain(stream, &sys->buffers[i]);
+
+    UnmapRings(stream);
+    close(sys->ring);
+    close(sys->fd);
+    free(sys->buffers);
+    vlc_free(sys->memory);
+    free(sys);
+}
+
+#define DEPTH_TEXT N_("Reads in flight")
+#define DEPTH_LONGTEXT N_( \
+    "Number of reads of the file kept in flight ahead of the read position.")
+#define READ_SIZE_TEXT N_("Read size (KiB)")
+#define READ_SIZE_LONGTEXT N_( \
+    "Size of each read. Large reads suit high-latency storage.")
+#define DIRECT_TEXT N_("Direct I/O")
+#define DIRECT_LONGTEXT N_( \
+    "Read the file around the page cache (O_DIRECT).")
+#define LOCAL_TEXT N_("Also read local files")
+#define LOCAL_LONGTEXT N_( \
+    "Use the io_uring read-ahead for files on local file systems too, " \
+    "rather than only for network file systems.")
+
+vlc_module_begin()
+    set_category(CAT_INPUT)
+    set_subcategory(SUBCAT_INPUT_STREAM_FILTER)
+    set_capability("stream_filter", 0)
+    add_shortcut("uring")
+
+    set_shortname(N_("io_uring"))
+    set_description(N_("io_uring read-ahead"))
+    set_callbacks(Open, Close)
+
+    add_integer_with_range("uring-depth", 8, 1, 64,
+                           DEPTH_TEXT, DEPTH_LONGTEXT, true)
+    add_integer_with_range("uring-read-size", 1024, 4, 65536,
+                           READ_SIZE_TEXT, READ_SIZE_LONGTEXT, true)
+    add_bool("uring-direct", false, DIRECT_TEXT, DIRECT_LONGTEXT, true)
+    add_bool("uring-local", false, LOCAL_TEXT, LOCAL_LONGTEXT, true)
+vlc_module_end()
@@ -211,6 +211,46 @@ static ssize_t AStreamReadBlock(stream_t *s, void *buf, size_t len)
     return copy;
 }
 
+/* Block access, without copy */
+static block_t *AStreamBlock(stream_t *s, bool *restrict eof)
+{
+    stream_sys_t *sys = s->p_sys;
+    input_thread_t *input = s->p_input;
+    block_t *block = sys->block;
+
+    if (block != NULL)
+    {   /* Left over by AStreamReadBlock() */
+        sys->block = NULL;
+        return block;
+    }
+
+    if (vlc_access_Eof(sys->access))
+    {
+        *eof = true;
+        return NULL;
+    }
+
+    block = vlc_access_Block(sys->access);
+    if (block == NULL)
+    {
+        *eof = vlc_access_Eof(sys->access);
+        return NULL;
+    }
+
+    if (input != NULL)
+    {
+        uint64_t total;
+
+        vlc_mutex_lock(&input->p->counters.counters_lock);
+        stats_Update(input->p->counters.p_read_bytes, block->i_buffer, &total);
+        stats_Update(input->p->counters.p_input_bitrate, total, NULL);
+        stats_Update(input->p->counters.p_read_packets, 1, NULL);
+        vlc_mutex_unlock(&input->p->counters.counters_lock);
+    }
+
+    return block;
+}
+
 /* Read access */
 static ssize_t AStreamReadStream(stream_t *s, void *buf, size_t len)
 {
@@ -281,6 +321,7 @@ static int AStreamControl(stream_t *s, int cmd, va_list args)
     static_control_match(CAN_CONTROL_PACE);
     static_control_match(GET_SIZE);
     static_control_match(IS_DIRECTORY);
+    static_control_match(IS_MAPPED);
     static_control_match(GET_PTS_DELAY);
     static_control_match(GET_TITLE_INFO);
     static_control_match(GET_TITLE);
@@ -288,12 +329,15 @@ static int AStreamControl(stream_t *s, int cmd, va_list args)
     static_control_match(GET_META);
     static_control_match(GET_CONTENT_TYPE);
     static_control_match(GET_SIGNAL);
+    static_control_match(GET_NET_STATS);
+    static_control_match(GET_BUFFERED);
     static_control_match(SET_PAUSE_STATE);
     static_control_match(SET_TITLE);
     static_control_match(SET_SEEKPOINT);
     static_control_match(SET_PRIVATE_ID_STATE);
     static_control_match(SET_PRIVATE_ID_CA);
     static_control_match(GET_PRIVATE_ID_STATE);
+    static_control_match(SET_PRIVATE_ID_SECTION);
 
     switch (cmd)
     {
@@ -365,14 +409,22 @@ stream_t *stream_AccessNew(vlc_object_t *parent, input_thread_t *input,
 
     if (sys->access->pf_block != NULL)
     {
+        bool mapped;
+
         s->pf_read = AStreamReadBlock;
-        cachename = "cache_block";
+        s->pf_block = AStreamBlock;
+        /* Caching memory mappings would only copy them */
+        if (access_Control(sys->access, ACCESS_IS_MAPPED, &mapped)
+         || !mapped)
+            cachename = "cache_block";
+        else
+            cachename = NULL;
     }
     else
     if (sys->access->pf_read != NULL)
     {
         s->pf_read = AStreamReadStream;
-        cachename = "prefetch,cache_read";
+        cachename = "uring,prefetch,cache_read";
     }
     else
     {
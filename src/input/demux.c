@@ -350,6 +350,7 @@ int demux_vaControlHelper( stream_t *s,
         case DEMUX_CAN_RECORD:
         case DEMUX_SET_RECORD_STATE:
         case DEMUX_GET_SIGNAL:
+        case DEMUX_GET_TS_STATS:
             return VLC_EGENERIC;
 
         default:
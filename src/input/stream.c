@@ -41,6 +41,9 @@
 #include <libvlc.h>
 #include "stream.h"
 
+/* Size of the blocks read by stream_ReadBlock() through pf_read */
+#define STREAM_READ_BLOCK_SIZE 65536
+
 typedef struct stream_priv_t
 {
     stream_t stream;
@@ -79,6 +82,7 @@ stream_t *stream_CommonNew(vlc_object_t *parent, void (*destroy)(stream_t *))
     s->psz_url = NULL;
     s->p_source = NULL;
     s->pf_read = NULL;
+    s->pf_block = NULL;
     s->pf_readdir = NULL;
     s->pf_control = NULL;
     s->p_sys = NULL;
@@ -357,6 +361,33 @@ static ssize_t stream_ReadRaw(stream_t *s, void *buf, size_t len)
     return (copy > 0) ? (ssize_t)copy : ret;
 }
 
+static block_t *stream_ReadRawBlock(stream_t *s)
+{
+    stream_priv_t *priv = (stream_priv_t *)s;
+    block_t *block;
+    bool eof = false;
+
+    assert(s->pf_block != NULL);
+
+    do
+    {
+        if (vlc_killed())
+            return NULL;
+
+        block = s->pf_block(s, &eof);
+        if (block != NULL && block->i_buffer == 0)
+        {
+            block_Release(block);
+            block = NULL;
+        }
+    }
+    while (block == NULL && !eof);
+
+    if (block != NULL)
+        priv->offset += block->i_buffer;
+    return block;
+}
+
 ssize_t stream_Read(stream_t *s, void *buf, size_t len)
 {
     stream_priv_t *priv = (stream_priv_t *)s;
@@ -398,6 +429,12 @@ ssize_t stream_Peek(stream_t *s, const uint8_t **restrict bufp, size_t len)
     stream_priv_t *priv = (stream_priv_t *)s;
     block_t *peek = priv->peek;
 
+    if (peek == NULL && s->pf_block != NULL && len > 0)
+    {   /* Peek into the next block itself rather than into a copy */
+        peek = stream_ReadRawBlock(s);
+        priv->peek = peek;
+    }
+
     if (peek == NULL)
     {
         peek = block_Alloc(len);
@@ -616,6 +653,40 @@ block_t *stream_Block( stream_t *s, size_t size )
     return block;
 }
 
+block_t *stream_ReadBlock(stream_t *s)
+{
+    stream_priv_t *priv = (stream_priv_t *)s;
+    block_t *block = priv->peek;
+
+    if (block != NULL)
+    {   /* Hand the peeked data over */
+        priv->peek = NULL;
+        if (block->i_buffer > 0)
+            return block;
+        block_Release(block);
+    }
+
+    if (s->pf_block != NULL)
+        return stream_ReadRawBlock(s);
+
+    /* No natural block size: copy whatever the stream has at hand */
+    block = block_Alloc(STREAM_READ_BLOCK_SIZE);
+    if (unlikely(block == NULL))
+        return NULL;
+
+    ssize_t val = vlc_killed() ? -1 : s->pf_read(s, block->p_buffer,
+                                                 block->i_buffer);
+    if (val <= 0)
+    {
+        block_Release(block);
+        return NULL;
+    }
+
+    block->i_buffer = val;
+    priv->offset += val;
+    return block;
+}
+
 /**
  * Read the next input_item_t from the directory stream. It returns the next
  * input item on success or NULL in case of error or end of stream. The item
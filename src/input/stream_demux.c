@@ -226,6 +226,9 @@ static int DStreamControl( stream_t *s, int i_query, va_list args )
         case STREAM_GET_META:
         case STREAM_GET_CONTENT_TYPE:
         case STREAM_GET_SIGNAL:
+        case STREAM_GET_NET_STATS:
+        case STREAM_IS_MAPPED:
+        case STREAM_GET_BUFFERED:
         case STREAM_SET_PAUSE_STATE:
         case STREAM_SET_TITLE:
         case STREAM_SET_SEEKPOINT:
@@ -233,6 +236,7 @@ static int DStreamControl( stream_t *s, int i_query, va_list args )
         case STREAM_SET_PRIVATE_ID_STATE:
         case STREAM_SET_PRIVATE_ID_CA:
         case STREAM_GET_PRIVATE_ID_STATE:
+        case STREAM_SET_PRIVATE_ID_SECTION:
             return VLC_EGENERIC;
 
         default:
@@ -112,12 +112,19 @@ static int Control( stream_t *s, int i_query, va_list args )
             *va_arg( args, int64_t * ) = 0;
             break;
 
+        case STREAM_GET_BUFFERED:
+            *va_arg( args, uint64_t * ) = p_sys->i_size - p_sys->i_pos;
+            *va_arg( args, bool * ) = true;
+            break;
+
         case STREAM_GET_TITLE_INFO:
         case STREAM_GET_TITLE:
         case STREAM_GET_SEEKPOINT:
         case STREAM_GET_META:
         case STREAM_GET_CONTENT_TYPE:
         case STREAM_GET_SIGNAL:
+        case STREAM_GET_NET_STATS:
+        case STREAM_IS_MAPPED:
         case STREAM_SET_TITLE:
         case STREAM_SET_SEEKPOINT:
             return VLC_EGENERIC;
@@ -128,6 +135,7 @@ static int Control( stream_t *s, int i_query, va_list args )
         case STREAM_SET_PRIVATE_ID_STATE:
         case STREAM_SET_PRIVATE_ID_CA:
         case STREAM_GET_PRIVATE_ID_STATE:
+        case STREAM_SET_PRIVATE_ID_SECTION:
             msg_Err( s, "Hey, what are you thinking? "
                      "DO NOT USE PRIVATE STREAM CONTROLS!!!" );
             return VLC_EGENERIC;
@@ -487,6 +487,7 @@ dbus_out:
         free( psz_val );
     }
 
+    block_pool_Init();
     return VLC_SUCCESS;
 }
 
@@ -534,6 +535,7 @@ void libvlc_InternalCleanup( libvlc_int_t *p_libvlc )
 
     /* Free module bank. It is refcounted, so we call this each time  */
     vlc_LogDeinit (p_libvlc);
+    block_pool_Deinit ();
     module_EndBank (true);
 #if defined(_WIN32) || defined(__OS2__)
     system_End( );
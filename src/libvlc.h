@@ -79,6 +79,12 @@ int vlc_LogPreinit(libvlc_int_t *);
 int vlc_LogInit(libvlc_int_t *);
 void vlc_LogDeinit(libvlc_int_t *);
 
+/*
+ * Block pool
+ */
+void block_pool_Init(void);
+void block_pool_Deinit(void);
+
 /*
  * LibVLC exit event handling
  */
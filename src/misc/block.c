@@ -35,8 +35,10 @@
 #include <fcntl.h>
 
 #include <vlc_common.h>
+#include <vlc_atomic.h>
 #include <vlc_block.h>
 #include <vlc_fs.h>
+#include "libvlc.h"
 
 /**
  * @section Block handling functions.
@@ -123,8 +125,249 @@ static void BlockMetaCopy( block_t *restrict out, const block_t *in )
 /** Initial reserved header and footer size. */
 #define BLOCK_PADDING      32
 
+static void block_Setup (block_t *b, size_t alloc, size_t size)
+{
+    block_Init (b, b + 1, alloc - sizeof (*b));
+    static_assert ((BLOCK_PADDING % BLOCK_ALIGN) == 0,
+                   "BLOCK_PADDING must be a multiple of BLOCK_ALIGN");
+    b->p_buffer += BLOCK_PADDING + BLOCK_ALIGN - 1;
+    b->p_buffer = (void *)(((uintptr_t)b->p_buffer) & ~(BLOCK_ALIGN - 1));
+    b->i_buffer = size;
+}
+
+/**
+ * @section Block pool.
+ *
+ * Blocks of the most common sizes are recycled instead of being freed:
+ * TS packets (with a timestamp or FEC), UDP datagrams and DVB reads.
+ * Each thread caches the blocks it released, and hands the excess over by
+ * batches to a shared depot, where the threads allocating them take them
+ * back. The lock is thus taken once per batch at most.
+ */
+static const size_t block_pool_sizes[] = { 204, 7 * 188, 1500, 20 * 188 };
+#define BLOCK_POOL_CLASSES ARRAY_SIZE(block_pool_sizes)
+
+/** Blocks moved at once between a thread cache and the depot. */
+#define BLOCK_POOL_BATCH   16
+
+/** Batches kept by the depot, per size. */
+#define BLOCK_POOL_DEPOT   32
+
+typedef struct
+{
+    block_t *first[BLOCK_POOL_CLASSES];
+    unsigned count[BLOCK_POOL_CLASSES];
+} block_cache_t;
+
+static vlc_mutex_t block_pool_lock = VLC_STATIC_MUTEX;
+static block_t *block_depot[BLOCK_POOL_CLASSES][BLOCK_POOL_DEPOT];
+static unsigned block_depot_count[BLOCK_POOL_CLASSES];
+static vlc_threadvar_t block_cache_var;
+static atomic_bool block_cache_ready = ATOMIC_VAR_INIT(false);
+static unsigned block_pool_usage = 0;
+
+static size_t block_pool_Alloc (unsigned i)
+{
+    return sizeof (block_t) + BLOCK_ALIGN + (2 * BLOCK_PADDING)
+         + block_pool_sizes[i];
+}
+
+/* Size class of a request, rounded up by less than twice */
+static int block_pool_Class (size_t size)
+{
+    for (unsigned i = 0; i < BLOCK_POOL_CLASSES; i++)
+        if (size <= block_pool_sizes[i])
+            return (i == 0 || size > block_pool_sizes[i] / 2) ? (int)i : -1;
+    return -1;
+}
+
+static void block_cache_Delete (void *data)
+{
+    block_cache_t *cache = data;
+
+    for (unsigned i = 0; i < BLOCK_POOL_CLASSES; i++)
+        while (cache->first[i] != NULL)
+        {
+            block_t *b = cache->first[i];
+            cache->first[i] = b->p_next;
+            free (b);
+        }
+    free (cache);
+}
+
+static block_cache_t *block_cache_Get (void)
+{
+    if (unlikely(!atomic_load_explicit (&block_cache_ready,
+                                        memory_order_acquire)))
+    {
+        vlc_mutex_lock (&block_pool_lock);
+        if (!atomic_load_explicit (&block_cache_ready, memory_order_relaxed)
+         && vlc_threadvar_create (&block_cache_var, block_cache_Delete) == 0)
+            atomic_store_explicit (&block_cache_ready, true,
+                                   memory_order_release);
+        vlc_mutex_unlock (&block_pool_lock);
+        if (!atomic_load_explicit (&block_cache_ready, memory_order_acquire))
+            return NULL;
+    }
+
+    block_cache_t *cache = vlc_threadvar_get (block_cache_var);
+    if (unlikely(cache == NULL))
+    {
+        cache = calloc (1, sizeof (*cache));
+        if (cache != NULL && vlc_threadvar_set (block_cache_var, cache))
+        {
+            free (cache);
+            cache = NULL;
+        }
+    }
+    return cache;
+}
+
+static void block_pool_Release (block_t *block)
+{
+    block_Invalidate (block);
+
+    const size_t size = block->i_size - BLOCK_ALIGN - (2 * BLOCK_PADDING);
+    unsigned i = 0;
+    while (block_pool_sizes[i] != size)
+        i++;
+    assert (i < BLOCK_POOL_CLASSES);
+
+    block_cache_t *cache = block_cache_Get ();
+    if (unlikely(cache == NULL))
+    {
+        free (block);
+        return;
+    }
+
+    block->p_next = cache->first[i];
+    cache->first[i] = block;
+    if (++cache->count[i] < 2 * BLOCK_POOL_BATCH)
+        return;
+
+    /* Hand the most recently released half over */
+    block_t *batch = cache->first[i], **pp = &batch;
+    for (unsigned j = 0; j < BLOCK_POOL_BATCH; j++)
+        pp = &(*pp)->p_next;
+    cache->first[i] = *pp;
+    cache->count[i] -= BLOCK_POOL_BATCH;
+    *pp = NULL;
+
+    vlc_mutex_lock (&block_pool_lock);
+    if (block_depot_count[i] < BLOCK_POOL_DEPOT)
+    {
+        block_depot[i][block_depot_count[i]++] = batch;
+        batch = NULL;
+    }
+    vlc_mutex_unlock (&block_pool_lock);
+
+    while (batch != NULL)
+    {
+        block_t *next = batch->p_next;
+        free (batch);
+        batch = next;
+    }
+}
+
+/**
+ * Registers a LibVLC instance using the pool.
+ */
+void block_pool_Init (void)
+{
+    vlc_mutex_lock (&block_pool_lock);
+    block_pool_usage++;
+    vlc_mutex_unlock (&block_pool_lock);
+}
+
+/**
+ * Frees the depot and the cache of the calling thread, and the thread
+ * variable, once the last LibVLC instance is gone. The other threads have
+ * exited by then, freeing their own caches. The pool is set up again by the
+ * next allocation, if any.
+ */
+void block_pool_Deinit (void)
+{
+    block_t *depot[BLOCK_POOL_CLASSES][BLOCK_POOL_DEPOT];
+    unsigned depot_count[BLOCK_POOL_CLASSES];
+    block_cache_t *cache = NULL;
+
+    vlc_mutex_lock (&block_pool_lock);
+    assert (block_pool_usage > 0);
+    if (--block_pool_usage > 0)
+    {
+        vlc_mutex_unlock (&block_pool_lock);
+        return;
+    }
+
+    memcpy (depot, block_depot, sizeof (depot));
+    memcpy (depot_count, block_depot_count, sizeof (depot_count));
+    memset (block_depot_count, 0, sizeof (block_depot_count));
+
+    if (atomic_load_explicit (&block_cache_ready, memory_order_relaxed))
+    {
+        cache = vlc_threadvar_get (block_cache_var);
+        vlc_threadvar_set (block_cache_var, NULL);
+        vlc_threadvar_delete (&block_cache_var);
+        atomic_store_explicit (&block_cache_ready, false,
+                               memory_order_relaxed);
+    }
+    vlc_mutex_unlock (&block_pool_lock);
+
+    if (cache != NULL)
+        block_cache_Delete (cache);
+
+    for (unsigned i = 0; i < BLOCK_POOL_CLASSES; i++)
+        for (unsigned j = 0; j < depot_count[i]; j++)
+            while (depot[i][j] != NULL)
+            {
+                block_t *b = depot[i][j];
+                depot[i][j] = b->p_next;
+                free (b);
+            }
+}
+
+static block_t *block_pool_Get (unsigned i)
+{
+    block_cache_t *cache = block_cache_Get ();
+    if (unlikely(cache == NULL))
+        return NULL;
+
+    if (cache->first[i] == NULL)
+    {
+        vlc_mutex_lock (&block_pool_lock);
+        if (block_depot_count[i] > 0)
+        {
+            cache->first[i] = block_depot[i][--block_depot_count[i]];
+            cache->count[i] = BLOCK_POOL_BATCH;
+        }
+        vlc_mutex_unlock (&block_pool_lock);
+        if (cache->first[i] == NULL)
+            return NULL;
+    }
+
+    block_t *b = cache->first[i];
+    cache->first[i] = b->p_next;
+    cache->count[i]--;
+    return b;
+}
+
 block_t *block_Alloc (size_t size)
 {
+    const int i = block_pool_Class (size);
+    if (i >= 0)
+    {
+        const size_t alloc = block_pool_Alloc (i);
+        block_t *b = block_pool_Get (i);
+        if (b == NULL)
+            b = malloc (alloc);
+        if (unlikely(b == NULL))
+            return NULL;
+
+        block_Setup (b, alloc, size);
+        b->pf_release = block_pool_Release;
+        return b;
+    }
+
     /* 2 * BLOCK_PADDING: pre + post padding */
     const size_t alloc = sizeof (block_t) + BLOCK_ALIGN + (2 * BLOCK_PADDING)
                        + size;
@@ -135,12 +378,7 @@ block_t *block_Alloc (size_t size)
     if (unlikely(b == NULL))
         return NULL;
 
-    block_Init (b, b + 1, alloc - sizeof (*b));
-    static_assert ((BLOCK_PADDING % BLOCK_ALIGN) == 0,
-                   "BLOCK_PADDING must be a multiple of BLOCK_ALIGN");
-    b->p_buffer += BLOCK_PADDING + BLOCK_ALIGN - 1;
-    b->p_buffer = (void *)(((uintptr_t)b->p_buffer) & ~(BLOCK_ALIGN - 1));
-    b->i_buffer = size;
+    block_Setup (b, alloc, size);
     b->pf_release = block_generic_Release;
     return b;
 }
@@ -38,11 +38,14 @@
 #include <assert.h>
 
 #include <vlc_common.h>
+#include <vlc_atomic.h>
 #include <vlc_interface.h>
 #include <vlc_charset.h>
 #include <vlc_modules.h>
 #include "../libvlc.h"
 
+typedef struct vlc_logger_async_t vlc_logger_async_t;
+
 struct vlc_logger_t
 {
     VLC_COMMON_MEMBERS
@@ -50,6 +53,7 @@ struct vlc_logger_t
     vlc_log_cb log;
     void *sys;
     module_t *module;
+    vlc_logger_async_t *async; /* in front of the module, if any */
 };
 
 static void vlc_vaLogCallback(libvlc_int_t *vlc, int type,
@@ -90,7 +94,7 @@ void vlc_vaLog (vlc_object_t *obj, int type, const char *module,
                 const char *file, unsigned line, const char *func,
                 const char *format, va_list args)
 {
-    if (obj != NULL && obj->i_flags & OBJECT_FLAGS_QUIET)
+    if (!msg_Enabled(obj, type))
         return;
 
     /* Get basename from the module filename */
@@ -154,11 +158,22 @@ void vlc_Log(vlc_object_t *obj, int type, const char *module,
              const char *file, unsigned line, const char *func,
              const char *format, ... )
 {
-    //va_list ap;
+    va_list ap;
+
+    va_start(ap, format);
+    vlc_vaLog(obj, type, module, file, line, func, format, ap);
+    va_end(ap);
+}
 
-    //va_start(ap, format);
-    //vlc_vaLog(obj, type, module, file, line, func, format, ap);
-    //va_end(ap);
+/**
+ * Sets the most verbose message type output by the logger: the messages of
+ * the other types are skipped by msg_Enabled(), before being formatted.
+ * \param obj logger object, or any object of the instance
+ * \param type VLC_MSG_* message type, or -1 for none
+ */
+void vlc_LogSetVerbosity(vlc_object_t *obj, int type)
+{
+    obj->p_libvlc->i_log_verbosity = type;
 }
 
 #ifdef _WIN32
@@ -204,6 +219,184 @@ static void Win32DebugOutputMsg (void* d, int type, const vlc_log_t *p_item,
 }
 #endif
 
+/* Asynchronous logging: the emitting thread formats its message into a
+ * slot of a bounded ring, and a background thread hands the slots over to
+ * the logger module, so that emitting never waits for the output.
+ *
+ * The ring has several producers and one consumer. Each slot carries a
+ * sequence number: equal to the producer position when the slot is free,
+ * to the position + 1 once its message is filled. Producers claim their
+ * position with a compare and swap; a message finding the ring full is
+ * dropped, and the drops are reported once the ring has room again. */
+#define VLC_LOG_ASYNC_SLOTS 512 /* must be a power of 2 */
+#define VLC_LOG_ASYNC_TEXT  400
+
+typedef struct
+{
+    atomic_size_t seq;
+    int type;
+    vlc_log_t meta;
+    char object_type[16];
+    char module[32];
+    char header[64];
+    char text[VLC_LOG_ASYNC_TEXT];
+} vlc_log_slot_t;
+
+struct vlc_logger_async_t
+{
+    vlc_log_cb log; /* of the logger module */
+    void *sys;
+    vlc_thread_t thread;
+    vlc_sem_t ready; /* posted for each filled slot, and to exit */
+    atomic_bool exit;
+    atomic_size_t enqueue;
+    atomic_uint dropped;
+    size_t dequeue;
+    vlc_log_slot_t slots[VLC_LOG_ASYNC_SLOTS];
+};
+
+static void vlc_vaLogAsync(void *d, int type, const vlc_log_t *item,
+                           const char *format, va_list ap)
+{
+    vlc_logger_async_t *async = d;
+    size_t pos = atomic_load_explicit(&async->enqueue, memory_order_relaxed);
+    vlc_log_slot_t *slot;
+
+    for (;;)
+    {
+        slot = &async->slots[pos & (VLC_LOG_ASYNC_SLOTS - 1)];
+
+        size_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        ptrdiff_t diff = (ptrdiff_t)(seq - pos);
+        if (diff == 0)
+        {
+            if (atomic_compare_exchange_weak(&async->enqueue, &pos, pos + 1))
+                break;
+        }
+        else if (diff < 0)
+        {   /* Full: the output cannot keep up */
+            atomic_fetch_add_explicit(&async->dropped, 1,
+                                      memory_order_relaxed);
+            return;
+        }
+        else
+            pos = atomic_load_explicit(&async->enqueue, memory_order_relaxed);
+    }
+
+    slot->type = type;
+    slot->meta = *item;
+    /* The names and the header do not outlive the call */
+    strlcpy(slot->object_type, item->psz_object_type,
+            sizeof (slot->object_type));
+    slot->meta.psz_object_type = slot->object_type;
+    strlcpy(slot->module, item->psz_module, sizeof (slot->module));
+    slot->meta.psz_module = slot->module;
+    if (item->psz_header != NULL)
+    {
+        strlcpy(slot->header, item->psz_header, sizeof (slot->header));
+        slot->meta.psz_header = slot->header;
+    }
+    vsnprintf(slot->text, sizeof (slot->text), format, ap);
+
+    atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+    vlc_sem_post(&async->ready);
+}
+
+static void vlc_LogAsyncOutput(vlc_logger_async_t *async, int type,
+                               const vlc_log_t *item, const char *format, ...)
+{
+    va_list ap;
+
+    va_start(ap, format);
+    async->log(async->sys, type, item, format, ap);
+    va_end(ap);
+}
+
+/* Outputs the filled slots at the head of the ring */
+static void vlc_LogAsyncDrain(vlc_logger_async_t *async)
+{
+    for (;;)
+    {
+        vlc_log_slot_t *slot =
+            &async->slots[async->dequeue & (VLC_LOG_ASYNC_SLOTS - 1)];
+
+        if (atomic_load_explicit(&slot->seq, memory_order_acquire)
+                != async->dequeue + 1)
+            break; /* empty, or still being filled */
+
+        vlc_LogAsyncOutput(async, slot->type, &slot->meta, "%s", slot->text);
+
+        atomic_store_explicit(&slot->seq,
+                              async->dequeue + VLC_LOG_ASYNC_SLOTS,
+                              memory_order_release);
+        async->dequeue++;
+    }
+
+    unsigned dropped = atomic_exchange_explicit(&async->dropped, 0,
+                                                memory_order_relaxed);
+    if (dropped > 0)
+    {
+        const vlc_log_t meta = {
+            .psz_object_type = "logger",
+            .psz_module = "core",
+            .line = -1,
+        };
+        vlc_LogAsyncOutput(async, VLC_MSG_WARN, &meta,
+                           "%u messages dropped (logging too fast)", dropped);
+    }
+}
+
+static void *vlc_LogAsyncThread(void *data)
+{
+    vlc_logger_async_t *async = data;
+
+    for (;;)
+    {
+        /* Spurious posts are harmless: a wake up drains all there is */
+        vlc_sem_wait(&async->ready);
+        vlc_LogAsyncDrain(async);
+        if (atomic_load_explicit(&async->exit, memory_order_acquire))
+            break;
+    }
+    return NULL;
+}
+
+static vlc_logger_async_t *vlc_LogAsyncStart(vlc_log_cb cb, void *sys)
+{
+    vlc_logger_async_t *async = malloc(sizeof (*async));
+    if (unlikely(async == NULL))
+        return NULL;
+
+    async->log = cb;
+    async->sys = sys;
+    vlc_sem_init(&async->ready, 0);
+    atomic_init(&async->exit, false);
+    atomic_init(&async->enqueue, 0);
+    atomic_init(&async->dropped, 0);
+    async->dequeue = 0;
+    for (size_t i = 0; i < VLC_LOG_ASYNC_SLOTS; i++)
+        atomic_init(&async->slots[i].seq, i);
+
+    if (vlc_clone(&async->thread, vlc_LogAsyncThread, async,
+                  VLC_THREAD_PRIORITY_LOW))
+    {
+        vlc_sem_destroy(&async->ready);
+        free(async);
+        return NULL;
+    }
+    return async;
+}
+
+/* Outputs the last messages. No message may be emitted anymore. */
+static void vlc_LogAsyncStop(vlc_logger_async_t *async)
+{
+    atomic_store_explicit(&async->exit, true, memory_order_release);
+    vlc_sem_post(&async->ready);
+    vlc_join(async->thread, NULL);
+    vlc_sem_destroy(&async->ready);
+    free(async);
+}
+
 typedef struct vlc_log_early_t
 {
     struct vlc_log_early_t *next;
@@ -263,6 +456,7 @@ static int vlc_LogEarlyOpen(vlc_logger_t *logger)
 
     logger->log = vlc_vaLogEarly;
     logger->sys = sys;
+    logger->async = NULL;
     return 0;
 }
 
@@ -328,6 +522,9 @@ int vlc_LogPreinit(libvlc_int_t *vlc)
     if (unlikely(logger == NULL))
         return -1;
 
+    /* Keep everything until the logger is known */
+    vlc->i_log_verbosity = VLC_MSG_DBG;
+
     vlc_rwlock_init(&logger->lock);
 
     if (vlc_LogEarlyOpen(logger))
@@ -358,19 +555,34 @@ int vlc_LogInit(libvlc_int_t *vlc)
 
     vlc_log_cb cb;
     void *sys, *early_sys = NULL;
+    vlc_logger_async_t *async = NULL;
+
+    /* The logger module lowers the verbosity if it filters messages */
+    vlc_LogSetVerbosity(VLC_OBJECT(vlc), VLC_MSG_DBG);
 
     /* TODO: module configuration item */
     module_t *module = vlc_module_load(logger, "logger", NULL, false,
                                        vlc_logger_load, logger, &cb, &sys);
     if (module == NULL)
+    {
         cb = vlc_vaLogDiscard;
+        vlc_LogSetVerbosity(VLC_OBJECT(vlc), -1);
+    }
+    else if (var_InheritBool(vlc, "log-async"))
+        async = vlc_LogAsyncStart(cb, sys);
 
     vlc_rwlock_wrlock(&logger->lock);
     if (logger->log == vlc_vaLogEarly)
         early_sys = logger->sys;
 
+    if (async != NULL)
+    {
+        cb = vlc_vaLogAsync;
+        sys = async;
+    }
     logger->log = cb;
     logger->sys = sys;
+    logger->async = async;
     assert(logger->module == NULL); /* Only one call to vlc_LogInit()! */
     logger->module = module;
     vlc_rwlock_unlock(&logger->lock);
@@ -394,20 +606,30 @@ void vlc_LogSet(libvlc_int_t *vlc, vlc_log_cb cb, void *opaque)
         return;
 
     module_t *module;
+    vlc_logger_async_t *async;
     void *sys;
 
+    /* The callback does its own filtering */
+    vlc_LogSetVerbosity(VLC_OBJECT(vlc), (cb != NULL) ? VLC_MSG_DBG : -1);
     if (cb == NULL)
         cb = vlc_vaLogDiscard;
 
     vlc_rwlock_wrlock(&logger->lock);
     sys = logger->sys;
     module = logger->module;
+    async = logger->async;
 
     logger->log = cb;
     logger->sys = opaque;
     logger->module = NULL;
+    logger->async = NULL;
     vlc_rwlock_unlock(&logger->lock);
 
+    if (async != NULL)
+    {
+        sys = async->sys;
+        vlc_LogAsyncStop(async);
+    }
     if (module != NULL)
         vlc_module_unload(module, vlc_logger_unload, sys);
 
@@ -425,8 +647,18 @@ void vlc_LogDeinit(libvlc_int_t *vlc)
     if (unlikely(logger == NULL))
         return;
 
+    /* Later messages would have no logger */
+    vlc_LogSetVerbosity(VLC_OBJECT(vlc), -1);
+
+    void *sys = logger->sys;
+    if (logger->async != NULL)
+    {
+        sys = logger->async->sys;
+        vlc_LogAsyncStop(logger->async);
+    }
+
     if (logger->module != NULL)
-        vlc_module_unload(logger->module, vlc_logger_unload, logger->sys);
+        vlc_module_unload(logger->module, vlc_logger_unload, sys);
     else
     /* Flush early log messages (corner case: no call to vlc_LogInit()) */
     if (logger->log == vlc_vaLogEarly)
@@ -0,0 +1,170 @@
+/*****************************************************************************
+ * mdi.c: test for the datagram reception statistics
+ *****************************************************************************
+ * Copyright (C) 2004-2015 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include "../../libvlc/test.h"
+
+#include "../../../modules/access/mdi.c"
+
+#define DATAGRAM_PACKETS 7
+#define DATAGRAM_IAT     1000 /* 1316 bytes per ms: 10.528 Mbit/s */
+
+/* 7 TS packets on two pids, optionally after an RTP header */
+static size_t WriteDatagram( uint8_t *p, unsigned i_index, int i_seq )
+{
+    size_t i_size = 0;
+
+    if( i_seq >= 0 )
+    {
+        memset( p, 0, 12 );
+        p[0] = 0x80;
+        p[1] = 33;
+        SetWBE( &p[2], i_seq );
+        i_size = 12;
+    }
+    for( unsigned i = 0; i < DATAGRAM_PACKETS; i++ )
+    {
+        const unsigned i_packet = i_index * DATAGRAM_PACKETS + i;
+        uint8_t *pkt = &p[i_size];
+        memset( pkt, 0xff, 188 );
+        pkt[0] = 0x47;
+        pkt[1] = 0x01;
+        pkt[2] = i_packet % 2;
+        pkt[3] = 0x10 | ( ( i_packet / 2 ) & 0x0F );
+        i_size += 188;
+    }
+    return i_size;
+}
+
+static void test_Regular( bool b_rtp )
+{
+    mdi_t *p_mdi = mdi_New();
+    uint8_t p[12 + 188 * DATAGRAM_PACKETS];
+    stream_net_stats_t stats;
+    assert( p_mdi );
+
+    /* 3 seconds, the 1000th datagram lost, the 2000th late */
+    mtime_t i_date = 1;
+    unsigned i_count = 0;
+    for( unsigned i = 0; i < 3000; i++ )
+    {
+        if( i == 1000 || i == 2000 )
+            continue;
+        size_t i_size = WriteDatagram( p, i, b_rtp ? (int)( i % 65536 ) : -1 );
+        mdi_Datagram( p_mdi, p, i_size, i_date );
+        i_date += DATAGRAM_IAT;
+        i_count++;
+        if( i == 2001 )
+        {
+            i_size = WriteDatagram( p, 2000, b_rtp ? 2000 : -1 );
+            mdi_Datagram( p_mdi, p, i_size, i_date );
+            i_date += DATAGRAM_IAT;
+            i_count++;
+        }
+    }
+    mdi_Get( p_mdi, &stats );
+
+    assert( stats.i_datagrams == i_count );
+    assert( stats.pi_iat[4] == i_count - 1 ); /* 1000us is in [512, 1024[ */
+    assert( stats.i_iat_max == DATAGRAM_IAT );
+    assert( stats.i_burst_max == 1 );
+    assert( stats.i_bitrate > 10000000 && stats.i_bitrate < 11000000 );
+    /* A constant rate stream waits for about one datagram */
+    assert( stats.i_delay_factor >= DATAGRAM_IAT * 9 / 10 &&
+            stats.i_delay_factor <= DATAGRAM_IAT * 11 / 10 );
+    if( b_rtp )
+    {
+        assert( stats.i_rtp_lost == 2 );
+        assert( stats.i_rtp_reordered == 1 );
+    }
+    else
+        assert( stats.i_rtp_lost == 0 && stats.i_rtp_reordered == 0 );
+    /* The lost datagram, and the late one, in the second window */
+    assert( stats.i_ts_lost >= DATAGRAM_PACKETS );
+    assert( stats.i_loss_rate > 0 );
+
+    /* A burst, then a stall: each shows once its second is over */
+    for( unsigned i = 3000; i < 3010; i++ )
+    {
+        const size_t i_size = WriteDatagram( p, i, b_rtp ? (int)i : -1 );
+        mdi_Datagram( p_mdi, p, i_size, i_date );
+        i_date += 10;
+    }
+    i_date += 2 * CLOCK_FREQ;
+    size_t i_size = WriteDatagram( p, 3020, b_rtp ? 3020 : -1 );
+    mdi_Datagram( p_mdi, p, i_size, i_date );
+    mdi_Get( p_mdi, &stats );
+    assert( stats.i_burst_max == 10 );
+    assert( stats.pi_iat[STREAM_NET_IAT_BUCKETS - 1] == 1 );
+
+    i_date += CLOCK_FREQ;
+    i_size = WriteDatagram( p, 3021, b_rtp ? 3021 : -1 );
+    mdi_Datagram( p_mdi, p, i_size, i_date );
+    mdi_Get( p_mdi, &stats );
+    assert( stats.i_burst_max == 1 );
+    assert( stats.i_iat_max == 2 * CLOCK_FREQ + 10 );
+    assert( stats.i_gap_max == ( b_rtp ? 10 : 0 ) );
+    assert( stats.i_loss_rate > 0 );
+
+    mdi_Delete( p_mdi );
+}
+
+/* Datagrams without a date are counted, but left out of the timing */
+static void test_Undated( void )
+{
+    mdi_t *p_mdi = mdi_New();
+    uint8_t p[12 + 188 * DATAGRAM_PACKETS];
+    stream_net_stats_t stats;
+    assert( p_mdi );
+
+    mtime_t i_date = 1;
+    for( unsigned i = 0; i < 100; i++ )
+    {
+        const size_t i_size = WriteDatagram( p, i, -1 );
+        if( i % 10 == 5 )
+            mdi_Datagram( p_mdi, p, i_size, VLC_TS_INVALID );
+        else
+        {
+            mdi_Datagram( p_mdi, p, i_size, i_date );
+            i_date += DATAGRAM_IAT;
+        }
+    }
+    mdi_Get( p_mdi, &stats );
+
+    assert( stats.i_datagrams == 100 );
+    assert( stats.pi_iat[4] == 89 );
+    for( unsigned i = 0; i < STREAM_NET_IAT_BUCKETS; i++ )
+        assert( i == 4 || stats.pi_iat[i] == 0 );
+    assert( stats.i_ts_lost == 0 );
+
+    mdi_Delete( p_mdi );
+}
+
+int main( void )
+{
+    alarm( 10 );
+
+    log( "Testing the reception statistics of raw TS\n" );
+    test_Regular( false );
+    log( "Testing the reception statistics of RTP\n" );
+    test_Regular( true );
+    log( "Testing datagrams without a date\n" );
+    test_Undated();
+    return 0;
+}
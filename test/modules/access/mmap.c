@@ -0,0 +1,177 @@
+/*****************************************************************************
+ * mmap.c: memory-mapped file access test
+ *****************************************************************************
+ * Copyright (C) 2004-2015 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include "../../libvlc/test.h"
+#include "../../../lib/libvlc_internal.h"
+
+#include <vlc_common.h>
+#include <vlc_stream.h>
+#include <vlc_block.h>
+#include <vlc_url.h>
+
+#include <unistd.h>
+
+/* Several windows, not a whole number of pages */
+#define FILE_SIZE (10 * 1024 * 1024 + 1234)
+
+static uint8_t Byte( uint64_t i_offset )
+{
+    return i_offset * 7 + ( i_offset >> 12 );
+}
+
+static void CheckData( const uint8_t *p, size_t i_size, uint64_t i_offset )
+{
+    for( size_t i = 0; i < i_size; i++ )
+        assert( p[i] == Byte( i_offset + i ) );
+}
+
+static void test_Blocks( stream_t *s )
+{
+    bool b_mapped = false;
+    const uint8_t *p_peek;
+    block_t *p_block;
+    uint64_t i_offset = 0;
+    int i_ret;
+
+    i_ret = stream_Control( s, STREAM_IS_MAPPED, &b_mapped );
+    assert( i_ret == VLC_SUCCESS && b_mapped );
+    assert( stream_Size( s ) == FILE_SIZE );
+
+    /* Peeking maps the first window, reading hands it over */
+    ssize_t i_peek = stream_Peek( s, &p_peek, 188 );
+    assert( i_peek == 188 );
+    CheckData( p_peek, 188, 0 );
+    assert( stream_Tell( s ) == 0 );
+
+    p_block = stream_ReadBlock( s );
+    assert( p_block != NULL );
+    assert( p_block->p_buffer == p_peek );
+    assert( p_block->i_buffer > 188 );
+
+    /* The whole file, window by window */
+    while( p_block != NULL )
+    {
+        CheckData( p_block->p_buffer, p_block->i_buffer, i_offset );
+        i_offset += p_block->i_buffer;
+        assert( stream_Tell( s ) == i_offset );
+
+        /* Writable, without touching the file */
+        p_block->p_buffer[0] ^= 0xff;
+        block_Release( p_block );
+        p_block = stream_ReadBlock( s );
+    }
+    assert( i_offset == FILE_SIZE );
+
+    /* Windows from an unaligned offset */
+    i_ret = stream_Seek( s, 5000001 );
+    assert( i_ret == VLC_SUCCESS );
+    p_block = stream_ReadBlock( s );
+    assert( p_block != NULL );
+    CheckData( p_block->p_buffer, p_block->i_buffer, 5000001 );
+    assert( stream_Tell( s ) == 5000001 + p_block->i_buffer );
+    block_Release( p_block );
+
+    /* Reads and blocks mixed */
+    uint8_t p_buf[1000];
+    i_ret = stream_Seek( s, 0 );
+    assert( i_ret == VLC_SUCCESS );
+    ssize_t i_read = stream_Read( s, p_buf, sizeof (p_buf) );
+    assert( i_read == sizeof (p_buf) );
+    CheckData( p_buf, sizeof (p_buf), 0 );
+    p_block = stream_ReadBlock( s );
+    assert( p_block != NULL );
+    CheckData( p_block->p_buffer, p_block->i_buffer, sizeof (p_buf) );
+    block_Release( p_block );
+
+    /* A peek across two windows is gathered */
+    i_ret = stream_Seek( s, 4 * 1024 * 1024 - 100 );
+    assert( i_ret == VLC_SUCCESS );
+    i_peek = stream_Peek( s, &p_peek, 1000 );
+    assert( i_peek == 1000 );
+    CheckData( p_peek, 1000, 4 * 1024 * 1024 - 100 );
+    i_read = stream_Read( s, p_buf, sizeof (p_buf) );
+    assert( i_read == sizeof (p_buf) );
+    CheckData( p_buf, sizeof (p_buf), 4 * 1024 * 1024 - 100 );
+}
+
+/* Without a memory mapping, blocks are copies of any size */
+static void test_Copies( stream_t *s )
+{
+    uint64_t i_offset = 0;
+    block_t *p_block;
+
+    while( ( p_block = stream_ReadBlock( s ) ) != NULL )
+    {
+        CheckData( p_block->p_buffer, p_block->i_buffer, i_offset );
+        i_offset += p_block->i_buffer;
+        assert( stream_Tell( s ) == i_offset );
+        block_Release( p_block );
+    }
+    assert( i_offset == FILE_SIZE );
+}
+
+int main( void )
+{
+    char psz_path[] = "/tmp/vlc-test-mmap-XXXXXX";
+    libvlc_instance_t *p_vlc;
+
+    test_init();
+
+    int fd = mkstemp( psz_path );
+    assert( fd != -1 );
+    for( uint64_t i_offset = 0; i_offset < FILE_SIZE; )
+    {
+        uint8_t p_buf[65536];
+        size_t i_size = __MIN( sizeof (p_buf), FILE_SIZE - i_offset );
+
+        for( size_t i = 0; i < i_size; i++ )
+            p_buf[i] = Byte( i_offset + i );
+        ssize_t i_write = write( fd, p_buf, i_size );
+        assert( i_write == (ssize_t)i_size );
+        i_offset += i_size;
+    }
+    close( fd );
+
+    p_vlc = libvlc_new( test_defaults_nargs, test_defaults_args );
+    assert( p_vlc != NULL );
+
+    char *psz_url = vlc_path2uri( psz_path, "mmap" );
+    assert( psz_url != NULL );
+
+    log( "Testing the memory-mapped file access\n" );
+    stream_t *s = stream_UrlNew( p_vlc->p_libvlc_int, psz_url );
+    assert( s != NULL );
+    test_Blocks( s );
+    stream_Delete( s );
+    free( psz_url );
+
+    psz_url = vlc_path2uri( psz_path, "file" );
+    assert( psz_url != NULL );
+
+    log( "Testing blocks of a regular file\n" );
+    s = stream_UrlNew( p_vlc->p_libvlc_int, psz_url );
+    assert( s != NULL );
+    test_Copies( s );
+    stream_Delete( s );
+    free( psz_url );
+    libvlc_release( p_vlc );
+    unlink( psz_path );
+    return 0;
+}
@@ -0,0 +1,179 @@
+/*****************************************************************************
+ * udp_sender.c: loopback benchmark of the paced UDP sender
+ *****************************************************************************
+ * Copyright (C) 2004-2015 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/* Before test.h, which enables the assertions */
+#include "../../../modules/access_output/udp_sender.c"
+
+#include "../../libvlc/test.h"
+#include "../../../lib/libvlc_internal.h"
+
+#define BENCH_RATE     100000000 /* bits per second */
+#define BENCH_DURATION CLOCK_FREQ
+#define BENCH_DELAY    (CLOCK_FREQ / 10)
+#define BENCH_PACKETS  (BENCH_RATE / 8 / BENCH_MTU * BENCH_DURATION / CLOCK_FREQ * 7)
+#define BENCH_MTU      (7 * 188)
+
+typedef struct
+{
+    int      fd;
+    unsigned i_datagrams;
+    unsigned i_lost;
+    uint64_t i_bytes;
+    mtime_t  i_first, i_last;
+    double   f_gap_sum, f_gap_sum2;
+} bench_receiver_t;
+
+static void *Receive( void *data )
+{
+    bench_receiver_t *p_rcv = data;
+    uint8_t p[65536];
+    uint32_t i_next = 0;
+    mtime_t i_prev = 0;
+
+    while( i_next < BENCH_PACKETS )
+    {
+        ssize_t i_len = recv( p_rcv->fd, p, sizeof (p), 0 );
+        if( i_len <= 0 )
+            break; /* timed out */
+
+        const mtime_t now = mdate();
+        if( p_rcv->i_datagrams == 0 )
+            p_rcv->i_first = now;
+        else
+        {
+            const double f_gap = now - i_prev;
+            p_rcv->f_gap_sum += f_gap;
+            p_rcv->f_gap_sum2 += f_gap * f_gap;
+        }
+        i_prev = p_rcv->i_last = now;
+        p_rcv->i_datagrams++;
+        p_rcv->i_bytes += i_len;
+
+        assert( i_len % 188 == 0 );
+        for( ssize_t i = 0; i < i_len; i += 188 )
+        {
+            assert( p[i] == 0x47 );
+            const uint32_t i_index = GetDWBE( &p[i + 4] );
+            assert( i_index >= i_next );
+            p_rcv->i_lost += i_index - i_next;
+            i_next = i_index + 1;
+        }
+    }
+    p_rcv->i_lost += BENCH_PACKETS - i_next;
+    return NULL;
+}
+
+static void test_Pacing( vlc_object_t *p_obj, unsigned i_group )
+{
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_addr.s_addr = htonl( INADDR_LOOPBACK ),
+    };
+    socklen_t i_addrlen = sizeof (addr);
+    const struct timeval timeout = { .tv_sec = 2 };
+    const int i_rcvbuf = 8 << 20;
+    bench_receiver_t rcv = { .fd = socket( AF_INET, SOCK_DGRAM, 0 ) };
+    vlc_thread_t thread;
+    int i_ret;
+
+    assert( rcv.fd != -1 );
+    i_ret = bind( rcv.fd, (struct sockaddr *)&addr, sizeof (addr) );
+    assert( i_ret == 0 );
+    i_ret = getsockname( rcv.fd, (struct sockaddr *)&addr, &i_addrlen );
+    assert( i_ret == 0 );
+    setsockopt( rcv.fd, SOL_SOCKET, SO_RCVBUF, &i_rcvbuf, sizeof (i_rcvbuf) );
+    setsockopt( rcv.fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof (timeout) );
+
+    int fd = socket( AF_INET, SOCK_DGRAM, 0 );
+    assert( fd != -1 );
+    i_ret = connect( fd, (struct sockaddr *)&addr, sizeof (addr) );
+    assert( i_ret == 0 );
+
+    udp_sender_t *p_sender = udp_sender_New( p_obj, fd, BENCH_MTU,
+                                             BENCH_DELAY, i_group );
+    assert( p_sender != NULL );
+    i_ret = vlc_clone( &thread, Receive, &rcv, VLC_THREAD_PRIORITY_LOW );
+    assert( i_ret == 0 );
+
+    /* TS packets dated at the constant rate, written by chains of 7 like
+     * the muxer does */
+    const mtime_t i_start = mdate();
+    for( unsigned i = 0; i < BENCH_PACKETS; )
+    {
+        block_t *p_chain = NULL, **pp = &p_chain;
+
+        for( unsigned j = 0; j < 7 && i < BENCH_PACKETS; j++, i++ )
+        {
+            block_t *p_pkt = block_Alloc( 188 );
+            assert( p_pkt != NULL );
+            memset( p_pkt->p_buffer, 0xff, 188 );
+            p_pkt->p_buffer[0] = 0x47;
+            SetDWBE( &p_pkt->p_buffer[4], i );
+            p_pkt->i_dts = i_start + (mtime_t)i * 188 * 8 * CLOCK_FREQ
+                                     / BENCH_RATE;
+            *pp = p_pkt;
+            pp = &p_pkt->p_next;
+        }
+        ssize_t i_len = udp_sender_Write( p_sender, p_chain );
+        assert( i_len > 0 );
+    }
+
+    vlc_join( thread, NULL );
+    udp_sender_Delete( p_sender );
+    close( fd );
+    close( rcv.fd );
+
+    assert( rcv.i_datagrams > 1 );
+    const double f_rate = rcv.i_bytes * 8. * CLOCK_FREQ
+                        / ( rcv.i_last - rcv.i_first );
+    const unsigned i_gaps = rcv.i_datagrams - 1;
+    const double f_mean = rcv.f_gap_sum / i_gaps;
+    const double f_var = rcv.f_gap_sum2 / i_gaps - f_mean * f_mean;
+
+    log( "group %u: %u datagrams, %u packets lost, %.2f Mbit/s, "
+         "gap %.1f us, variance %.1f us^2\n", i_group, rcv.i_datagrams,
+         rcv.i_lost, f_rate / 1000000, f_mean, f_var );
+
+    /* Loose bounds: this runs on loaded build machines */
+    assert( rcv.i_lost <= BENCH_PACKETS / 100 );
+    assert( f_rate > BENCH_RATE * 0.8 && f_rate < BENCH_RATE * 1.2 );
+}
+
+int main( void )
+{
+    libvlc_instance_t *p_vlc;
+
+    test_init();
+
+    p_vlc = libvlc_new( test_defaults_nargs, test_defaults_args );
+    assert( p_vlc != NULL );
+
+    /* No datagram fits in a zero MTU */
+    assert( udp_sender_New( VLC_OBJECT(p_vlc->p_libvlc_int), -1, 0,
+                            BENCH_DELAY, 1 ) == NULL );
+
+    log( "Testing the UDP sender pacing, datagram by datagram\n" );
+    test_Pacing( VLC_OBJECT(p_vlc->p_libvlc_int), 1 );
+    log( "Testing the UDP sender pacing, by groups of 8\n" );
+    test_Pacing( VLC_OBJECT(p_vlc->p_libvlc_int), 8 );
+
+    libvlc_release( p_vlc );
+    return 0;
+}
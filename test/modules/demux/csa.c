@@ -0,0 +1,233 @@
+/*****************************************************************************
+ * csa.c: test and benchmark for the batched CSA descrambler
+ *****************************************************************************
+ * Copyright (C) 2004-2015 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include "../../libvlc/test.h"
+
+/* Built in, to test every lane width whatever the CPU */
+#define TS_NO_CSA_CK_MSG
+#include "../../../modules/mux/mpeg/csa.c"
+
+/* csa.c included assert.h again, after config.h defined NDEBUG */
+#undef NDEBUG
+#include <assert.h>
+
+#define CORPUS_PACKETS 1000
+
+/* Scrambled packets with either key, adaptation fields of any length, some
+ * too long to leave a block, and some packets in the clear */
+static uint8_t *BuildCorpus( csa_t *c )
+{
+    uint8_t *p = malloc( CORPUS_PACKETS * 188 );
+    assert( p );
+
+    for( unsigned i = 0; i < CORPUS_PACKETS; i++ )
+    {
+        uint8_t *pkt = &p[188 * i];
+        for( unsigned j = 0; j < 188; j++ )
+            pkt[j] = rand();
+        pkt[0] = 0x47;
+        pkt[3] = 0x10 | (i & 0x0f);
+        if( rand() % 4 == 0 )
+        {
+            pkt[3] |= 0x20;
+            pkt[4] = rand() % 8 == 0 ? 176 + rand() % 80 : rand() % 184;
+        }
+        if( rand() % 10 == 0 )
+            continue; /* in the clear */
+        csa_UseKey( NULL, c, rand() % 2 );
+        if( pkt[3] & 0x20 && pkt[4] > 183 - 8 )
+            pkt[3] |= 0x80 | (rand() % 2) << 6; /* no block to scramble */
+        else
+            csa_Encrypt( c, pkt, 188 );
+    }
+    return p;
+}
+
+static void check_Batch( csa_t *c, const uint8_t *p_corpus, unsigned i_start,
+                         unsigned i_pkts, int i_pkt_size )
+{
+    uint8_t *p_ref = malloc( i_pkts * 188 );
+    uint8_t *p_new = malloc( i_pkts * 188 );
+    uint8_t **pp_pkts = malloc( i_pkts * sizeof(*pp_pkts) );
+    assert( p_ref && p_new && pp_pkts );
+
+    memcpy( p_ref, &p_corpus[188 * i_start], i_pkts * 188 );
+    memcpy( p_new, &p_corpus[188 * i_start], i_pkts * 188 );
+
+    for( unsigned i = 0; i < i_pkts; i++ )
+    {
+        csa_Decrypt( c, &p_ref[188 * i], i_pkt_size );
+        pp_pkts[i] = &p_new[188 * i];
+    }
+    csa_DecryptBatch( c, pp_pkts, i_pkts, i_pkt_size );
+
+    for( unsigned i = 0; i < i_pkts; i++ )
+    {
+        if( memcmp( &p_ref[188 * i], &p_new[188 * i], 188 ) )
+        {
+            log( "packet %u of %u (size %d) differs\n", i, i_pkts, i_pkt_size );
+            abort();
+        }
+    }
+    free( pp_pkts );
+    free( p_new );
+    free( p_ref );
+}
+
+/* Each lane width on its own, with every lane count */
+static void check_Lanes( csa_t *c, const uint8_t *p_corpus, unsigned i_lanes,
+                         void (*pf_decrypt)( uint8_t *, uint8_t *, uint8_t *const *,
+                                             const unsigned *, unsigned, int ) )
+{
+    uint8_t *p_src = malloc( i_lanes * 188 );
+    uint8_t *p_ref = malloc( i_lanes * 188 );
+    uint8_t *p_new = malloc( i_lanes * 188 );
+    uint8_t **pp_pkts = malloc( i_lanes * sizeof(*pp_pkts) );
+    unsigned *pi_hdr = malloc( i_lanes * sizeof(*pi_hdr) );
+    assert( p_src && p_ref && p_new && pp_pkts && pi_hdr );
+
+    /* only the even key, with at least one block */
+    unsigned n = 0;
+    for( unsigned i = 0; i < CORPUS_PACKETS && n < i_lanes; i++ )
+    {
+        const uint8_t *pkt = &p_corpus[188 * i];
+        const unsigned i_hdr = 4 + ( (pkt[3] & 0x20) ? pkt[4] + 1 : 0 );
+        if( !(pkt[3] & 0x80) || (pkt[3] & 0x40) || i_hdr > 180 )
+            continue;
+        memcpy( &p_src[188 * n], pkt, 188 );
+        memcpy( &p_ref[188 * n], pkt, 188 );
+        csa_Decrypt( c, &p_ref[188 * n], 188 );
+        p_src[188 * n + 3] &= 0x3f;
+        pp_pkts[n] = &p_new[188 * n];
+        pi_hdr[n] = i_hdr;
+        n++;
+    }
+    assert( n == i_lanes );
+
+    for( unsigned i_count = 1; i_count <= i_lanes; i_count++ )
+    {
+        memcpy( p_new, p_src, i_count * 188 );
+        pf_decrypt( c->e_ck, c->e_kk, pp_pkts, pi_hdr, i_count, 188 );
+        assert( !memcmp( p_ref, p_new, i_count * 188 ) );
+    }
+    free( pi_hdr );
+    free( pp_pkts );
+    free( p_new );
+    free( p_ref );
+    free( p_src );
+}
+
+static void test_Decrypt( csa_t *c, const uint8_t *p_corpus )
+{
+    static const int pi_sizes[] = { 188, 184, 100, 13, 4 };
+
+    check_Lanes( c, p_corpus, 64, DecryptLanes_c );
+#ifdef CSA_SSE2
+    check_Lanes( c, p_corpus, 128, DecryptLanes_sse2 );
+#endif
+#ifdef CSA_AVX2
+    if( vlc_CPU_AVX2() )
+        check_Lanes( c, p_corpus, 256, DecryptLanes_avx2 );
+#endif
+
+    for( size_t i = 0; i < ARRAY_SIZE(pi_sizes); i++ )
+    {
+        check_Batch( c, p_corpus, 0, CORPUS_PACKETS, pi_sizes[i] );
+        for( unsigned j = 0; j < 20; j++ )
+        {
+            const unsigned i_pkts = 1 + rand() % 300;
+            const unsigned i_start = rand() % ( CORPUS_PACKETS - i_pkts );
+            check_Batch( c, p_corpus, i_start, i_pkts, pi_sizes[i] );
+        }
+    }
+}
+
+/* The descrambled corpus must be the clear one it was scrambled from */
+static void test_RoundTrip( csa_t *c )
+{
+    uint8_t clear[64][188];
+    uint8_t pkts[64][188];
+    uint8_t *pp_pkts[64];
+
+    for( unsigned i = 0; i < 64; i++ )
+    {
+        for( unsigned j = 0; j < 188; j++ )
+            clear[i][j] = rand();
+        clear[i][0] = 0x47;
+        clear[i][3] = 0x10 | ( i % 2 ? 0x20 : 0 );
+        clear[i][4] = i;
+        memcpy( pkts[i], clear[i], 188 );
+        csa_UseKey( NULL, c, i % 3 == 0 );
+        csa_Encrypt( c, pkts[i], 188 );
+        assert( pkts[i][3] & 0x80 );
+        pp_pkts[i] = pkts[i];
+    }
+    csa_DecryptBatch( c, pp_pkts, 64, 188 );
+    assert( !memcmp( clear, pkts, sizeof(pkts) ) );
+}
+
+static void bench_Decrypt( csa_t *c, const uint8_t *p_corpus )
+{
+    uint8_t *p = malloc( CORPUS_PACKETS * 188 );
+    uint8_t **pp_pkts = malloc( CORPUS_PACKETS * sizeof(*pp_pkts) );
+    assert( p && pp_pkts );
+    for( unsigned i = 0; i < CORPUS_PACKETS; i++ )
+        pp_pkts[i] = &p[188 * i];
+
+    memcpy( p, p_corpus, CORPUS_PACKETS * 188 );
+    mtime_t i_start = mdate();
+    for( unsigned i = 0; i < CORPUS_PACKETS; i++ )
+        csa_Decrypt( c, pp_pkts[i], 188 );
+    const mtime_t i_ref = mdate() - i_start;
+
+    memcpy( p, p_corpus, CORPUS_PACKETS * 188 );
+    i_start = mdate();
+    csa_DecryptBatch( c, pp_pkts, CORPUS_PACKETS, 188 );
+    const mtime_t i_new = mdate() - i_start;
+
+    log( "%u packets: csa_Decrypt() %"PRId64" us, csa_DecryptBatch() "
+         "%"PRId64" us\n", CORPUS_PACKETS, i_ref, i_new );
+    free( pp_pkts );
+    free( p );
+}
+
+int main( void )
+{
+    alarm( 10 );
+    srand( 0 );
+
+    csa_t *c = csa_New();
+    assert( c );
+    char psz_odd[] = "0x0123456789abcdef";
+    char psz_even[] = "fedcba9876543210";
+    assert( csa_SetCW( NULL, c, psz_odd, true ) == VLC_SUCCESS );
+    assert( csa_SetCW( NULL, c, psz_even, false ) == VLC_SUCCESS );
+
+    uint8_t *p_corpus = BuildCorpus( c );
+
+    log( "Testing csa_DecryptBatch()\n" );
+    test_Decrypt( c, p_corpus );
+    test_RoundTrip( c );
+    bench_Decrypt( c, p_corpus );
+
+    free( p_corpus );
+    csa_Delete( c );
+    return 0;
+}
@@ -0,0 +1,382 @@
+/*****************************************************************************
+ * ts_filter.c: MPEG-TS software pid and section filter test
+ *****************************************************************************
+ * Copyright (C) 2004-2015 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include "../../libvlc/test.h"
+
+#include "../../../modules/demux/mpeg/ts_filter.c"
+#include "../../../modules/demux/mpeg/ts_section.c"
+
+#define SECTIONS 3000
+#define PID_EIT  0x12
+#define PID_ES   0x100
+
+static void WritePacket( uint8_t *p, uint16_t i_pid, bool b_unit_start,
+                         uint8_t i_cc )
+{
+    p[0] = 0x47;
+    p[1] = ( b_unit_start ? 0x40 : 0 ) | ( i_pid >> 8 );
+    p[2] = i_pid & 0xff;
+    p[3] = 0x10 | ( i_cc & 0x0f );
+    memset( &p[4], 0xaa, 184 );
+}
+
+static size_t Filter( ts_filter_t *p_filter, uint8_t *p, size_t i_size )
+{
+    size_t i_read;
+    size_t i_kept = ts_filter_Packets( p_filter, p, i_size, 188, 0, &i_read );
+    assert( i_read == i_size );
+    return i_kept;
+}
+
+static void test_PIDs( void )
+{
+    static const uint16_t pi_pids[] = { 0, 0x100, 0x200, 0x1fff };
+    uint8_t p[4 * 188], p_m2ts[4 * 192];
+    size_t i_read, i_kept;
+
+    ts_filter_t *p_filter = ts_filter_New();
+    assert( p_filter != NULL );
+    for( unsigned i = 0; i < 4; i++ )
+        WritePacket( &p[i * 188], pi_pids[i], false, i );
+
+    /* Nothing is filtered until the demuxer selects pids */
+    assert( ts_filter_GetPID( p_filter, 0x200 ) );
+    i_kept = Filter( p_filter, p, sizeof (p) );
+    assert( i_kept == sizeof (p) );
+
+    /* The PAT is always passed */
+    ts_filter_SetPID( p_filter, 0x100, true );
+    ts_filter_SetPID( p_filter, 0, false );
+    assert( ts_filter_GetPID( p_filter, 0x100 ) );
+    assert( !ts_filter_GetPID( p_filter, 0x200 ) );
+    i_kept = Filter( p_filter, p, sizeof (p) );
+    assert( i_kept == 2 * 188 );
+    assert( p[2] == 0 && p[188 + 2] == 0 && p[188 + 1] == 0x01 );
+
+    /* Stops at the first packet out of sync */
+    for( unsigned i = 0; i < 4; i++ )
+        WritePacket( &p[i * 188], pi_pids[i], false, i );
+    p[2 * 188] = 0;
+    i_kept = ts_filter_Packets( p_filter, p, sizeof (p), 188, 0, &i_read );
+    assert( i_read == 2 * 188 );
+    assert( i_kept == 2 * 188 );
+
+    /* BluRay packets, with their timestamp header */
+    for( unsigned i = 0; i < 4; i++ )
+    {
+        SetDWBE( &p_m2ts[i * 192], 0x12345678 + i );
+        WritePacket( &p_m2ts[i * 192 + 4], pi_pids[3 - i], false, i );
+    }
+    i_kept = ts_filter_Packets( p_filter, p_m2ts, sizeof (p_m2ts), 192, 4,
+                                &i_read );
+    assert( i_read == sizeof (p_m2ts) );
+    assert( i_kept == 2 * 192 );
+    assert( GetDWBE( &p_m2ts[0] ) == 0x12345678 + 2 );
+    assert( GetDWBE( &p_m2ts[192] ) == 0x12345678 + 3 );
+
+    /* The section filters are limited */
+    for( unsigned i = 0; i < TS_FILTER_SECTIONS; i++ )
+        assert( ts_filter_SetSection( p_filter, 0x10 + i % 3, i, 0xff, -1,
+                                      true ) == VLC_SUCCESS );
+    assert( ts_filter_SetSection( p_filter, 0x10, 0xff, 0xff, -1, true )
+            == VLC_ENOMEM );
+    assert( ts_filter_SetSection( p_filter, 0x10, 0, 0xff, -1, true )
+            == VLC_SUCCESS );
+    assert( ts_filter_SetSection( p_filter, 0x10, 0, 0xff, -1, false )
+            == VLC_SUCCESS );
+    assert( ts_filter_SetSection( p_filter, 0x10, 0xff, 0xff, -1, true )
+            == VLC_SUCCESS );
+    ts_filter_Delete( p_filter );
+}
+
+/*****************************************************************************
+ * Sections
+ *****************************************************************************/
+typedef struct
+{
+    uint8_t *p_data;    /* the sections, back to back */
+    size_t   i_data;
+    size_t  *pi_starts;
+    unsigned i_sections;
+} sections_t;
+
+static bool Wanted( const uint8_t *p_section )
+{
+    /* EIT actual present/following and schedule */
+    return p_section[0] == 0x4e || ( p_section[0] & 0xf0 ) == 0x50;
+}
+
+static void BuildSections( sections_t *p_sec )
+{
+    static const uint8_t pi_tables[] = { 0x4e, 0x4f, 0x50, 0x51, 0x5f,
+                                         0x60, 0x61, 0x6f };
+
+    p_sec->p_data = malloc( SECTIONS * 1024 );
+    p_sec->pi_starts = malloc( SECTIONS * sizeof (size_t) );
+    assert( p_sec->p_data != NULL && p_sec->pi_starts != NULL );
+    p_sec->i_data = 0;
+    p_sec->i_sections = SECTIONS;
+
+    for( unsigned i = 0; i < SECTIONS; i++ )
+    {
+        uint8_t *p = &p_sec->p_data[p_sec->i_data];
+        /* Mostly short sections, some spanning several packets */
+        const size_t i_size = 16 + ( rand() % 5 ? rand() % 150
+                                                : rand() % 1000 );
+
+        p[0] = pi_tables[rand() % ARRAY_SIZE(pi_tables)];
+        SetWBE( &p[1], 0xb000 | ( i_size - 3 ) );
+        SetWBE( &p[3], rand() % 4 );    /* service_id */
+        for( size_t j = 5; j < i_size - 4; j++ )
+            p[j] = rand();
+        SetDWBE( &p[i_size - 4], ts_section_CRC( p, i_size - 4 ) );
+        assert( ts_section_CRC( p, i_size ) == 0 );
+
+        p_sec->pi_starts[i] = p_sec->i_data;
+        p_sec->i_data += i_size;
+    }
+}
+
+/* Packetizes the sections back to back, as most muxers do, among the packets
+ * of an elementary stream. Returns the number of packets. */
+static size_t Packetize( const sections_t *p_sec, uint8_t *p_out )
+{
+    size_t i_packets = 0, i_pos = 0;
+    unsigned i_next = 0;
+    uint8_t i_cc = 0, i_es_cc = 0;
+
+    while( i_pos < p_sec->i_data )
+    {
+        uint8_t *p = &p_out[188 * i_packets++];
+
+        while( i_next < p_sec->i_sections && p_sec->pi_starts[i_next] < i_pos )
+            i_next++;
+        const bool b_start = i_next < p_sec->i_sections &&
+                             p_sec->pi_starts[i_next] < i_pos + 183;
+
+        WritePacket( p, PID_EIT, b_start, i_cc++ );
+        size_t i_payload = 184, i = 4;
+        if( b_start )
+        {
+            p[i++] = p_sec->pi_starts[i_next] - i_pos;
+            i_payload--;
+        }
+        else if( i_next < p_sec->i_sections &&
+                 p_sec->pi_starts[i_next] == i_pos + 183 )
+        {
+            /* The next section must start in the next packet */
+            p[3] |= 0x20;
+            p[i++] = 0;
+            i_payload--;
+        }
+        const size_t i_copy = __MIN( i_payload, p_sec->i_data - i_pos );
+        memcpy( &p[i], &p_sec->p_data[i_pos], i_copy );
+        memset( &p[i + i_copy], 0xff, i_payload - i_copy );
+        i_pos += i_copy;
+
+        if( rand() % 4 == 0 )
+            WritePacket( &p_out[188 * i_packets++], PID_ES, false, i_es_cc++ );
+    }
+    return i_packets;
+}
+
+typedef struct
+{
+    const sections_t *p_sec;    /* the sections expected, or NULL */
+    unsigned i_next;            /* next wanted section expected */
+    unsigned i_wanted;
+    unsigned i_unwanted;
+} check_t;
+
+static void SectionCallback( void *p_data, uint16_t i_pid,
+                             const uint8_t *p_section, size_t i_section )
+{
+    check_t *p_check = p_data;
+    const sections_t *p_sec = p_check->p_sec;
+
+    assert( i_pid == PID_EIT );
+    assert( ts_section_CRC( p_section, i_section ) == 0 );
+    if( !Wanted( p_section ) )
+    {
+        p_check->i_unwanted++;
+        return;
+    }
+    p_check->i_wanted++;
+    if( p_sec == NULL )
+        return;
+
+    /* Every wanted section, in order */
+    while( p_check->i_next < p_sec->i_sections &&
+           !Wanted( &p_sec->p_data[p_sec->pi_starts[p_check->i_next]] ) )
+        p_check->i_next++;
+    assert( p_check->i_next < p_sec->i_sections );
+    assert( !memcmp( p_section,
+                     &p_sec->p_data[p_sec->pi_starts[p_check->i_next]],
+                     i_section ) );
+    p_check->i_next++;
+}
+
+/* Demuxes the sections passed, and returns the number of discontinuities */
+static unsigned Demux( const uint8_t *p, size_t i_packets, check_t *p_check )
+{
+    ts_section_t *p_section = malloc( sizeof (*p_section) );
+    uint8_t i_cc = 0xff;
+    unsigned i_discontinuities = 0;
+
+    assert( p_section != NULL );
+    ts_section_Reset( p_section );
+    for( size_t i = 0; i < i_packets; i++, p += 188 )
+    {
+        if( ( ( p[1] & 0x1f ) << 8 | p[2] ) != PID_EIT )
+            continue;
+
+        const uint8_t i_pkt_cc = p[3] & 0x0f;
+        if( i_cc != 0xff && i_pkt_cc != ( ( i_cc + 1 ) & 0x0f ) )
+        {
+            i_discontinuities++;
+            ts_section_Reset( p_section );
+        }
+        i_cc = i_pkt_cc;
+        const size_t i_skip = ( p[3] & 0x20 ) ? 5 + p[4] : 4;
+        ts_section_Push( p_section, PID_EIT, &p[i_skip], 188 - i_skip,
+                         p[1] & 0x40, SectionCallback, p_check );
+    }
+    free( p_section );
+    return i_discontinuities;
+}
+
+static void test_Sections( void )
+{
+    sections_t sec;
+    check_t check;
+
+    BuildSections( &sec );
+    uint8_t *p_in = malloc( 2 * 188 * ( sec.i_data / 183 + 1 ) );
+    assert( p_in != NULL );
+    const size_t i_packets = Packetize( &sec, p_in );
+    size_t i_eit = 0;
+    for( size_t i = 0; i < i_packets; i++ )
+        i_eit += p_in[i * 188 + 2] == PID_EIT;
+
+    unsigned i_wanted = 0;
+    for( unsigned i = 0; i < sec.i_sections; i++ )
+        i_wanted += Wanted( &sec.p_data[sec.pi_starts[i]] );
+
+    ts_filter_t *p_filter = ts_filter_New();
+    assert( p_filter != NULL );
+    ts_filter_SetPID( p_filter, PID_EIT, true );
+    ts_filter_SetPID( p_filter, PID_ES, true );
+    assert( ts_filter_SetSection( p_filter, PID_EIT, 0x4e, 0xff, -1, true )
+            == VLC_SUCCESS );
+    assert( ts_filter_SetSection( p_filter, PID_EIT, 0x50, 0xf0, -1, true )
+            == VLC_SUCCESS );
+
+    /* In chunks, as datagrams */
+    uint8_t *p_out = malloc( 188 * i_packets );
+    assert( p_out != NULL );
+    memcpy( p_out, p_in, 188 * i_packets );
+    size_t i_out = 0;
+    for( size_t i = 0; i < i_packets; i += 7 )
+    {
+        const size_t i_chunk = 188 * __MIN( 7, i_packets - i );
+        memmove( &p_out[i_out], &p_out[188 * i], i_chunk );
+        i_out += Filter( p_filter, &p_out[i_out], i_chunk );
+    }
+    assert( i_out % 188 == 0 );
+
+    size_t i_eit_out = 0;
+    for( size_t i = 0; i < i_out / 188; i++ )
+        i_eit_out += p_out[i * 188 + 2] == PID_EIT;
+    assert( i_out / 188 - i_eit_out == i_packets - i_eit );
+
+    /* Nothing lost, nothing looks lost */
+    memset( &check, 0, sizeof (check) );
+    check.p_sec = &sec;
+    assert( Demux( p_out, i_out / 188, &check ) == 0 );
+    assert( check.i_wanted == i_wanted );
+    log( "%u/%u sections wanted, %u unwanted passed, "
+         "%zu/%zu EIT packets passed\n", i_wanted, sec.i_sections,
+         check.i_unwanted, i_eit_out, i_eit );
+    assert( i_eit_out < i_eit );
+
+    /* A loss stays visible once renumbered */
+    ts_filter_Delete( p_filter );
+    p_filter = ts_filter_New();
+    assert( p_filter != NULL );
+    ts_filter_SetPID( p_filter, PID_EIT, true );
+    assert( ts_filter_SetSection( p_filter, PID_EIT, 0x4e, 0xff, -1, true )
+            == VLC_SUCCESS );
+    size_t i_lost = i_packets / 2;
+    while( p_in[i_lost * 188 + 2] != PID_EIT )
+        i_lost++;
+    memcpy( p_out, p_in, 188 * i_lost );
+    memcpy( &p_out[188 * i_lost], &p_in[188 * ( i_lost + 1 )],
+            188 * ( i_packets - i_lost - 1 ) );
+    i_out = Filter( p_filter, p_out, 188 * ( i_packets - 1 ) );
+    memset( &check, 0, sizeof (check) );   /* some sections are missing */
+    assert( Demux( p_out, i_out / 188, &check ) == 1 );
+
+    /* Duplicates follow the original */
+    ts_filter_Delete( p_filter );
+    p_filter = ts_filter_New();
+    assert( p_filter != NULL );
+    ts_filter_SetPID( p_filter, PID_EIT, true );
+    assert( ts_filter_SetSection( p_filter, PID_EIT, 0x4e, 0xff, -1, true )
+            == VLC_SUCCESS );
+    size_t i_dup = 0;
+    for( size_t i = 0; i < i_packets; i++ )
+    {
+        uint8_t p[2 * 188];
+        memcpy( p, &p_in[188 * i], 188 );
+        memcpy( &p[188], &p_in[188 * i], 188 );
+        const size_t i_kept = Filter( p_filter, p, sizeof (p) );
+        assert( i_kept == 0 || i_kept == sizeof (p) );
+        if( i_kept > 0 )
+        {
+            assert( !memcmp( p, &p[188], 188 ) );
+            i_dup++;
+        }
+    }
+    assert( i_dup > 0 );
+
+    /* Without any section filter left, the pid is passed again */
+    assert( ts_filter_SetSection( p_filter, PID_EIT, 0x4e, 0xff, -1, false )
+            == VLC_SUCCESS );
+    memcpy( p_out, p_in, 188 * i_packets );
+    i_out = Filter( p_filter, p_out, 188 * i_packets );
+    assert( i_out / 188 == i_eit );
+
+    ts_filter_Delete( p_filter );
+    free( p_out );
+    free( p_in );
+    free( sec.pi_starts );
+    free( sec.p_data );
+}
+
+int main( void )
+{
+    test_init();
+
+    log( "Testing the pid filter\n" );
+    test_PIDs();
+    log( "Testing the section filter\n" );
+    test_Sections();
+    return 0;
+}
@@ -0,0 +1,188 @@
+/*****************************************************************************
+ * ts_index.c: test for the MPEG-TS seek index
+ *****************************************************************************
+ * Copyright (C) 2004-2015 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include "../../libvlc/test.h"
+
+#include "../../../modules/demux/mpeg/ts_index.c"
+#include "../../../modules/demux/mpeg/ts_sync.c"
+
+#define CORPUS_PACKETS 50000
+#define PCR_PID        0x100
+#define PCR_STEP       1800 /* 20ms */
+
+/* A PCR every 10 packets, a random access point every 40 PCRs, some
+ * garbage, and a PCR wrap around in the middle. Returns the PCR of every
+ * packet carrying one, -1 for the others */
+static int64_t *WriteCorpus( const char *psz_path, unsigned i_size,
+                             uint64_t **ppi_offsets )
+{
+    int64_t *pi_pcr = malloc( CORPUS_PACKETS * sizeof(*pi_pcr) );
+    uint64_t *pi_offsets = malloc( CORPUS_PACKETS * sizeof(*pi_offsets) );
+    FILE *p_file = fopen( psz_path, "wb" );
+    assert( pi_pcr && pi_offsets && p_file );
+
+    int64_t i_pcr = PCR_WRAP - (CORPUS_PACKETS / 20) * PCR_STEP;
+    uint64_t i_offset = 0;
+    for( unsigned i = 0; i < CORPUS_PACKETS; i++ )
+    {
+        uint8_t pkt[204];
+        for( unsigned j = 0; j < i_size; j++ )
+            pkt[j] = rand();
+
+        if( rand() % 500 == 0 )
+        {
+            const size_t i_garbage = 1 + rand() % 100;
+            for( size_t j = 0; j < i_garbage; j++ )
+                fputc( rand() % 2 ? 0x47 : rand(), p_file );
+            i_offset += i_garbage;
+        }
+
+        uint8_t *p = &pkt[i_size == 192 ? 4 : 0];
+        p[0] = 0x47;
+        pi_pcr[i] = -1;
+        pi_offsets[i] = i_offset;
+        if( i % 10 == 0 )
+        {
+            p[1] = PCR_PID >> 8;
+            p[2] = PCR_PID & 0xff;
+            p[3] = 0x30;
+            p[4] = 183;
+            p[5] = 0x10 | ( i % 400 == 0 ? 0x40 : 0 );
+            p[6] = i_pcr >> 25;
+            p[7] = i_pcr >> 17;
+            p[8] = i_pcr >> 9;
+            p[9] = i_pcr >> 1;
+            p[10] = ( i_pcr << 7 ) | 0x7e;
+            p[11] = 0;
+            pi_pcr[i] = i_pcr;
+            i_pcr = ( i_pcr + PCR_STEP ) % PCR_WRAP;
+        }
+        else
+        {
+            p[1] = 0x01;
+            p[2] = 0x01;
+            p[3] = 0x10;
+        }
+        assert( fwrite( pkt, i_size, 1, p_file ) == 1 );
+        i_offset += i_size;
+    }
+    fclose( p_file );
+    *ppi_offsets = pi_offsets;
+    return pi_pcr;
+}
+
+/* Every lookup lands on a PCR packet at most a second before the time,
+ * a random access point when there is one that close */
+static void check_Find( const ts_index_t *p_index, const int64_t *pi_pcr,
+                        const uint64_t *pi_offsets )
+{
+    int64_t i_first, i_last;
+    assert( ts_index_GetRange( p_index, PCR_PID, &i_first, &i_last ) );
+    assert( i_first == pi_pcr[0] );
+    assert( i_last == pi_pcr[0] + (CORPUS_PACKETS / 10 - 1) * PCR_STEP );
+    assert( !ts_index_GetRange( p_index, 0x101, &i_first, &i_last ) );
+
+    for( unsigned i = 0; i < 10000; i++ )
+    {
+        const int64_t i_time = i_first + rand() % ( i_last - i_first + 1 );
+        uint64_t i_offset;
+        assert( ts_index_Find( p_index, PCR_PID, i_time, &i_offset ) );
+
+        unsigned k = 0, i_high = CORPUS_PACKETS;
+        while( i_high - k > 1 )
+        {
+            const unsigned i_mid = ( k + i_high ) / 2;
+            if( pi_offsets[i_mid] <= i_offset )
+                k = i_mid;
+            else
+                i_high = i_mid;
+        }
+        assert( pi_offsets[k] == i_offset && pi_pcr[k] >= 0 );
+
+        const int64_t i_found = i_first + k / 10 * PCR_STEP;
+        assert( i_found <= i_time );
+        assert( i_time - i_found < TS_INDEX_INTERVAL ||
+                ( k % 400 == 0 && i_time - i_found <= INDEX_RAP_WINDOW ) );
+    }
+    uint64_t i_offset;
+    assert( ts_index_Find( p_index, PCR_PID, i_first - 1, &i_offset ) &&
+            i_offset == pi_offsets[0] );
+    assert( !ts_index_Find( p_index, PCR_PID, i_last + 2 * TS_INDEX_INTERVAL, &i_offset ) );
+}
+
+static void test_Index( unsigned i_size )
+{
+    char psz_path[] = "/tmp/vlc-ts-index-XXXXXX";
+    int fd = mkstemp( psz_path );
+    assert( fd != -1 );
+    close( fd );
+
+    uint64_t *pi_offsets;
+    int64_t *pi_pcr = WriteCorpus( psz_path, i_size, &pi_offsets );
+
+    atomic_bool b_stop = ATOMIC_VAR_INIT( false );
+    ts_index_t *p_index = ts_index_Build( NULL, psz_path, i_size, i_size == 192 ? 4 : 0,
+                                          &b_stop );
+    assert( p_index );
+    check_Find( p_index, pi_pcr, pi_offsets );
+
+    /* Mapped back, the same */
+    assert( ts_index_Save( NULL, p_index, psz_path ) == VLC_SUCCESS );
+    ts_index_Delete( p_index );
+    assert( !ts_index_Load( NULL, psz_path, i_size == 188 ? 192 : 188 ) );
+    p_index = ts_index_Load( NULL, psz_path, i_size );
+    assert( p_index );
+    check_Find( p_index, pi_pcr, pi_offsets );
+    ts_index_Delete( p_index );
+
+    /* Out of date once the recording changed */
+    FILE *p_file = fopen( psz_path, "ab" );
+    assert( p_file );
+    fputc( 0x47, p_file );
+    fclose( p_file );
+    assert( !ts_index_Load( NULL, psz_path, i_size ) );
+
+    /* Stopped */
+    atomic_store( &b_stop, true );
+    assert( !ts_index_Build( NULL, psz_path, i_size, 0, &b_stop ) );
+
+    char *psz_sidecar = SidecarPath( psz_path );
+    assert( psz_sidecar );
+    unlink( psz_sidecar );
+    free( psz_sidecar );
+    unlink( psz_path );
+    free( pi_offsets );
+    free( pi_pcr );
+}
+
+int main( void )
+{
+    static const unsigned pi_sizes[] = { 188, 192, 204 };
+
+    alarm( 10 );
+    srand( 0 );
+
+    for( size_t i = 0; i < ARRAY_SIZE(pi_sizes); i++ )
+    {
+        log( "Testing the seek index with %u bytes packets\n", pi_sizes[i] );
+        test_Index( pi_sizes[i] );
+    }
+    return 0;
+}
@@ -0,0 +1,323 @@
+/*****************************************************************************
+ * ts_monitor.c: MPEG-TS ETSI TR 101 290 monitor test
+ *****************************************************************************
+ * Copyright (C) 2004-2015 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include "../../libvlc/test.h"
+
+#include <limits.h>
+
+#include "../../../modules/demux/mpeg/ts_monitor.c"
+#include "../../../modules/demux/mpeg/ts_stats.c"
+#include "../../../modules/demux/mpeg/ts_output.c"
+#include "../../../modules/demux/mpeg/ts_section.c"
+
+/* ts_output.c included assert.h again, after config.h defined NDEBUG */
+#undef NDEBUG
+#include <assert.h>
+
+/* 5000 packets a second: a packet every 200 us, a PCR every 20 ms and the
+ * PAT and PMT every 100 ms. The stream lasts less than the SDT and EIT
+ * repetition limits, which are not in it. */
+#define RATE_PACKETS    5000
+#define STREAM_PACKETS  ( RATE_PACKETS * 19 / 10 )
+#define PCR_PERIOD      100
+#define PSI_PERIOD      500
+#define PCR_PID         0x100
+#define PMT_PID         0x42
+#define NEVER           UINT_MAX
+
+/* Where each error is put in the stream, by packet index, after the
+ * transport rate was measured on the first second */
+typedef struct
+{
+    unsigned i_pat_stop;    /* no PAT from there */
+    unsigned i_pmt_stop;    /* no PMT from there */
+    unsigned i_cc_skip;     /* continuity counter of the PCR pid skips */
+    unsigned i_pcr_drop;    /* two PCR missing */
+    unsigned i_pcr_jump;    /* PCR one second ahead, unsignalled */
+    unsigned i_crc;         /* PAT with a wrong CRC */
+} scenario_t;
+
+static const scenario_t clean = {
+    NEVER, NEVER, NEVER, NEVER, NEVER, NEVER
+};
+
+static size_t EndSection( uint8_t *p, size_t i )
+{
+    p[1] = 0xb0 | ( ( i + 4 - 3 ) >> 8 );
+    p[2] = ( i + 4 - 3 ) & 0xff;
+    SetDWBE( &p[i], ts_section_CRC( p, i ) );
+    return i + 4;
+}
+
+static size_t BuildHeader( uint8_t *p, uint8_t i_table_id, uint16_t i_extension )
+{
+    p[0] = i_table_id;
+    SetWBE( &p[3], i_extension );
+    p[5] = 0xc1;
+    p[6] = p[7] = 0;
+    return 8;
+}
+
+static size_t BuildPAT( uint8_t *p )
+{
+    size_t i = BuildHeader( p, 0x00, 1 );
+    SetWBE( &p[i], 1 );
+    SetWBE( &p[i + 2], 0xe000 | PMT_PID );
+    return EndSection( p, i + 4 );
+}
+
+static size_t BuildPMT( uint8_t *p )
+{
+    size_t i = BuildHeader( p, 0x02, 1 );
+    SetWBE( &p[i], 0xe000 | PCR_PID );
+    SetWBE( &p[i + 2], 0xf000 );
+    p[i + 4] = 0x1b;
+    SetWBE( &p[i + 5], 0xe000 | PCR_PID );
+    SetWBE( &p[i + 7], 0xf000 );
+    return EndSection( p, i + 9 );
+}
+
+typedef struct
+{
+    ts_stats_t   *p_stats;
+    ts_monitor_t *p_monitor;
+    uint8_t       pi_cc[8192];
+} feed_t;
+
+static void Feed( feed_t *f, uint8_t *p )
+{
+    const uint16_t i_pid = ( ( p[1] & 0x1f ) << 8 ) | p[2];
+
+    p[0] = 0x47;
+    p[3] |= f->pi_cc[i_pid]++ & 0x0f;
+    ts_monitor_Packet( f->p_monitor, f->p_stats, p,
+                       ts_stats_Packet( f->p_stats, p ) );
+}
+
+static void FeedSection( feed_t *f, uint16_t i_pid, const uint8_t *p_sec,
+                         size_t i_sec )
+{
+    uint8_t p[188];
+
+    assert( i_sec < 183 );
+    memset( p, 0xff, sizeof (p) );
+    p[1] = 0x40 | ( i_pid >> 8 );
+    p[2] = i_pid & 0xff;
+    p[3] = 0x10;
+    p[4] = 0; /* pointer_field */
+    memcpy( &p[5], p_sec, i_sec );
+    Feed( f, p );
+}
+
+/* PCR pid packet, with a 7 bytes adaptation field */
+static void FeedPCR( feed_t *f, int64_t i_pcr, bool b_pcr )
+{
+    uint8_t p[188];
+
+    memset( p, 0xff, sizeof (p) );
+    p[1] = PCR_PID >> 8;
+    p[2] = PCR_PID & 0xff;
+    p[3] = 0x30;
+    p[4] = 7;
+    p[5] = b_pcr ? 0x10 : 0x00;
+
+    const int64_t i_base = i_pcr / 300;
+    const int i_ext = i_pcr % 300;
+    p[6] = i_base >> 25;
+    p[7] = i_base >> 17;
+    p[8] = i_base >> 9;
+    p[9] = i_base >> 1;
+    p[10] = ( ( i_base & 1 ) << 7 ) | 0x7e | ( i_ext >> 8 );
+    p[11] = i_ext & 0xff;
+    Feed( f, p );
+}
+
+static void FeedNull( feed_t *f )
+{
+    uint8_t p[188];
+
+    memset( p, 0xff, sizeof (p) );
+    p[1] = 0x1f;
+    p[2] = 0xff;
+    p[3] = 0x10;
+    Feed( f, p );
+}
+
+static char *ReadFile( const char *psz_path )
+{
+    FILE *p_file = fopen( psz_path, "rb" );
+    assert( p_file );
+    char *psz = calloc( 1, 1 << 16 );
+    assert( psz );
+    assert( fread( psz, 1, ( 1 << 16 ) - 1, p_file ) < ( 1 << 16 ) - 1 );
+    fclose( p_file );
+    return psz;
+}
+
+/* Runs the monitor over the stream of a scenario, and returns its records */
+static char *Monitor( const scenario_t *sc, const char *psz_out )
+{
+    ts_output_t *p_out = ts_output_New( NULL, TS_OUTPUT_CSV, psz_out );
+    assert( p_out );
+
+    feed_t f = { .p_stats = ts_stats_New(), .p_monitor = NULL };
+    assert( f.p_stats );
+    f.p_monitor = ts_monitor_New( NULL, p_out );
+    assert( f.p_monitor );
+
+    uint8_t p_pat[183], p_pmt[183];
+    const size_t i_pat = BuildPAT( p_pat );
+    const size_t i_pmt = BuildPMT( p_pmt );
+
+    for( unsigned i = 0; i < STREAM_PACKETS; i++ )
+    {
+        switch( i % PSI_PERIOD )
+        {
+            case 1:
+                if( i >= sc->i_pat_stop )
+                    break;
+                if( i == sc->i_crc )
+                {
+                    uint8_t p_bad[183];
+                    memcpy( p_bad, p_pat, i_pat );
+                    p_bad[i_pat - 1] ^= 0x01;
+                    FeedSection( &f, 0x00, p_bad, i_pat );
+                }
+                else
+                    FeedSection( &f, 0x00, p_pat, i_pat );
+                continue;
+            case 2:
+                if( i >= sc->i_pmt_stop )
+                    break;
+                FeedSection( &f, PMT_PID, p_pmt, i_pmt );
+                continue;
+        }
+
+        if( i % PCR_PERIOD == 0 )
+        {
+            int64_t i_pcr = (int64_t)i * 27000000 / RATE_PACKETS;
+            if( i >= sc->i_pcr_jump )
+                i_pcr += 27000000;
+            if( i == sc->i_cc_skip )
+                f.pi_cc[PCR_PID]++;
+            FeedPCR( &f, i_pcr, i < sc->i_pcr_drop ||
+                                i - sc->i_pcr_drop >= 2 * PCR_PERIOD );
+        }
+        else
+            FeedNull( &f );
+    }
+
+    ts_monitor_Delete( f.p_monitor );
+    ts_stats_Delete( f.p_stats );
+    ts_output_Delete( p_out );
+    return ReadFile( psz_out );
+}
+
+/* Counts the records of a type, with a string field, if any */
+static unsigned Count( const char *psz, const char *psz_type,
+                       const char *psz_field )
+{
+    unsigned i_count = 0;
+    const size_t i_type = strlen( psz_type );
+    char psz_quoted[64];
+
+    if( psz_field )
+        snprintf( psz_quoted, sizeof (psz_quoted), ",\"%s\",", psz_field );
+
+    for( const char *p = psz; *p; )
+    {
+        const char *p_end = strchr( p, '\n' );
+        assert( p_end );
+        if( !strncmp( p, psz_type, i_type ) && p[i_type] == ',' )
+        {
+            const char *p_field = psz_field ? strstr( p, psz_quoted ) : p;
+            if( p_field && p_field < p_end )
+                i_count++;
+        }
+        p = p_end + 1;
+    }
+    return i_count;
+}
+
+/* The only alarm of the scenario is raised once */
+static void Check( const char *psz_name, const scenario_t *sc,
+                   const char *psz_alarm, const char *psz_out )
+{
+    char *psz = Monitor( sc, psz_out );
+
+    log( "%s: %u alarms\n", psz_name, Count( psz, "ALARM", NULL ) );
+    assert( Count( psz, "MONITOR", NULL ) == INDICATOR_COUNT );
+    if( psz_alarm )
+    {
+        assert( Count( psz, "ALARM", psz_alarm ) == 1 );
+        /* A PCR jump is also a PCR interval above the limit */
+        if( sc->i_pcr_jump != NEVER )
+        {
+            assert( Count( psz, "ALARM", "PCR_repetition_error" ) == 1 );
+            assert( Count( psz, "ALARM", NULL ) == 2 );
+        }
+        else
+            assert( Count( psz, "ALARM", NULL ) == 1 );
+    }
+    else
+        assert( Count( psz, "ALARM", NULL ) == 0 );
+    free( psz );
+}
+
+int main( void )
+{
+    char psz_out[] = "/tmp/vlc-test-ts-monitor-XXXXXX";
+
+    alarm( 10 );
+
+    int fd = mkstemp( psz_out );
+    assert( fd != -1 );
+    close( fd );
+
+    Check( "clean", &clean, NULL, psz_out );
+
+    scenario_t sc = clean;
+    sc.i_pat_stop = RATE_PACKETS;
+    Check( "PAT repetition", &sc, "PAT_error", psz_out );
+
+    sc = clean;
+    sc.i_pmt_stop = RATE_PACKETS;
+    Check( "PMT repetition", &sc, "PMT_error", psz_out );
+
+    sc = clean;
+    sc.i_cc_skip = RATE_PACKETS * 6 / 5;
+    Check( "continuity", &sc, "Continuity_count_error", psz_out );
+
+    sc = clean;
+    sc.i_pcr_drop = RATE_PACKETS * 6 / 5;
+    Check( "PCR repetition", &sc, "PCR_repetition_error", psz_out );
+
+    sc = clean;
+    sc.i_pcr_jump = RATE_PACKETS * 6 / 5;
+    Check( "PCR discontinuity", &sc, "PCR_discontinuity_indicator_error",
+           psz_out );
+
+    sc = clean;
+    sc.i_crc = RATE_PACKETS * 6 / 5 + 1;
+    Check( "CRC", &sc, "CRC_error", psz_out );
+
+    unlink( psz_out );
+    return 0;
+}
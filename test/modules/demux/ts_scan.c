@@ -0,0 +1,425 @@
+/*****************************************************************************
+ * ts_scan.c: test for the MPEG-TS parallel whole file analysis
+ *****************************************************************************
+ * Copyright (C) 2004-2015 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include "../../libvlc/test.h"
+
+#include "../../../modules/demux/mpeg/ts_scan.c"
+#include "../../../modules/demux/mpeg/ts_records.c"
+#include "../../../modules/demux/mpeg/ts_stats.c"
+#include "../../../modules/demux/mpeg/ts_output.c"
+#include "../../../modules/demux/mpeg/ts_section.c"
+#include "../../../modules/demux/mpeg/ts_sync.c"
+#include "../../../modules/demux/mpeg/ts_text.c"
+
+/* ts_output.c included assert.h again, after config.h defined NDEBUG */
+#undef NDEBUG
+#include <assert.h>
+
+/* Four ranges of more than SCAN_MIN_RANGE */
+#define CORPUS_PACKETS  ( 4 * ( SCAN_MIN_RANGE / 188 + 1000 ) )
+#define DATA_PID        0x200
+#define EIT_EVENTS      20
+
+typedef struct
+{
+    FILE    *p_file;
+    unsigned i_packets;
+    uint8_t  pi_cc[8192];
+} corpus_t;
+
+static void WritePacket( corpus_t *c, uint16_t i_pid, bool b_start,
+                         const uint8_t *p_payload, size_t i_payload )
+{
+    uint8_t p[188];
+
+    p[0] = 0x47;
+    p[1] = ( b_start ? 0x40 : 0 ) | ( i_pid >> 8 );
+    p[2] = i_pid & 0xff;
+    p[3] = 0x10 | ( c->pi_cc[i_pid]++ & 0x0f );
+    memset( &p[4], 0xff, 184 );
+    memcpy( &p[4], p_payload, i_payload );
+    assert( fwrite( p, 188, 1, c->p_file ) == 1 );
+    c->i_packets++;
+}
+
+/* Data and null packets, with a continuity error from time to time */
+static void WriteFill( corpus_t *c, unsigned i_count )
+{
+    static const uint8_t p_zero[184];
+
+    for( unsigned i = 0; i < i_count; i++ )
+    {
+        if( c->i_packets % 3 == 0 )
+            WritePacket( c, 0x1fff, false, p_zero, 184 );
+        else
+        {
+            if( c->i_packets % 997 == 0 )
+                c->pi_cc[DATA_PID] += 3;
+            WritePacket( c, DATA_PID, false, p_zero, 184 );
+        }
+    }
+}
+
+/* Packetizes a section, with i_gap other packets after each of its own.
+ * With b_broken, its last packet is lost */
+static void WriteSectionCC( corpus_t *c, uint16_t i_pid, const uint8_t *p_sec,
+                            size_t i_sec, unsigned i_gap, bool b_broken )
+{
+    uint8_t p[184];
+    bool b_start = true;
+
+    while( i_sec > 0 )
+    {
+        const size_t i_head = b_start ? 1 : 0;
+        const size_t i_copy = __MIN( i_sec, 184 - i_head );
+        p[0] = 0; /* pointer field */
+        memcpy( &p[i_head], p_sec, i_copy );
+        if( b_broken && i_copy == i_sec )
+            c->pi_cc[i_pid]++;
+        WritePacket( c, i_pid, b_start, p, i_head + i_copy );
+        p_sec += i_copy;
+        i_sec -= i_copy;
+        b_start = false;
+        WriteFill( c, i_gap );
+    }
+}
+
+static void WriteSection( corpus_t *c, uint16_t i_pid, const uint8_t *p_sec,
+                          size_t i_sec, unsigned i_gap )
+{
+    WriteSectionCC( c, i_pid, p_sec, i_sec, i_gap, false );
+}
+
+static size_t EndSection( uint8_t *p, size_t i )
+{
+    p[1] = 0xb0 | ( ( i + 4 - 3 ) >> 8 );
+    p[2] = ( i + 4 - 3 ) & 0xff;
+    SetDWBE( &p[i], ts_section_CRC( p, i ) );
+    return i + 4;
+}
+
+static size_t BuildHeader( uint8_t *p, uint8_t i_table_id, uint16_t i_extension,
+                           uint8_t i_version )
+{
+    p[0] = i_table_id;
+    SetWBE( &p[3], i_extension );
+    p[5] = 0xc1 | ( i_version << 1 );
+    p[6] = p[7] = 0;
+    return 8;
+}
+
+static size_t BuildPAT( uint8_t *p, uint8_t i_version )
+{
+    size_t i = BuildHeader( p, 0x00, 1, i_version );
+    SetWBE( &p[i], 1 );
+    SetWBE( &p[i + 2], 0xe000 | 0x100 );
+    return EndSection( p, i + 4 );
+}
+
+static size_t BuildPMT( uint8_t *p )
+{
+    size_t i = BuildHeader( p, 0x02, 1, 0 );
+    SetWBE( &p[i], 0xe000 | DATA_PID );
+    SetWBE( &p[i + 2], 0xf000 );
+    p[i + 4] = 0x06;
+    SetWBE( &p[i + 5], 0xe000 | DATA_PID );
+    SetWBE( &p[i + 7], 0xf000 );
+    return EndSection( p, i + 9 );
+}
+
+static size_t BuildSDT( uint8_t *p, uint8_t i_table_id, uint8_t i_version,
+                        uint16_t i_sid )
+{
+    size_t i = BuildHeader( p, i_table_id, 1, i_version );
+    SetWBE( &p[i], 2 );     /* original network id */
+    p[i + 2] = 0xff;
+    i += 3;
+
+    char psz_name[16];
+    const size_t i_name = snprintf( psz_name, sizeof(psz_name), "Service %u", i_sid );
+    SetWBE( &p[i], i_sid );
+    p[i + 2] = 0xfc;
+    SetWBE( &p[i + 3], 0x8000 | ( 2 + 3 + 4 + i_name ) );
+    i += 5;
+    p[i++] = 0x48;
+    p[i++] = 3 + 4 + i_name;
+    p[i++] = 0x01;
+    p[i++] = 4;
+    memcpy( &p[i], "Prov", 4 );
+    i += 4;
+    p[i++] = i_name;
+    memcpy( &p[i], psz_name, i_name );
+    return EndSection( p, i + i_name );
+}
+
+/* NIT or BAT of i_ts transport streams, of two services each */
+static size_t BuildNIT( uint8_t *p, uint8_t i_table_id, uint8_t i_version,
+                        unsigned i_ts )
+{
+    size_t i = BuildHeader( p, i_table_id, 0x30 + i_table_id, i_version );
+    SetWBE( &p[i], 0xf000 | 6 );
+    p[i + 2] = i_table_id == 0x4a ? 0x47 : 0x40; /* bouquet/network name */
+    p[i + 3] = 4;
+    memcpy( &p[i + 4], "Name", 4 );
+    i += 8;
+    SetWBE( &p[i], 0xf000 | ( i_ts * 14 ) );
+    i += 2;
+
+    for( unsigned k = 0; k < i_ts; k++ )
+    {
+        SetWBE( &p[i], 0x100 + k );     /* transport stream id */
+        SetWBE( &p[i + 2], 2 );         /* original network id */
+        SetWBE( &p[i + 4], 0xf000 | 8 );
+        p[i + 6] = 0x41;                /* service list */
+        p[i + 7] = 6;
+        SetWBE( &p[i + 8], 0x10 * k + 1 );
+        p[i + 10] = 0x01;
+        SetWBE( &p[i + 11], 0x10 * k + 2 );
+        p[i + 13] = 0x01;
+        i += 14;
+    }
+    return EndSection( p, i );
+}
+
+/* A schedule of several packets */
+static size_t BuildEIT( uint8_t *p, uint8_t i_table_id, uint8_t i_version,
+                        uint16_t i_sid )
+{
+    size_t i = BuildHeader( p, i_table_id, i_sid, i_version );
+    SetWBE( &p[i], 1 );     /* transport stream id */
+    SetWBE( &p[i + 2], 2 ); /* original network id */
+    p[i + 4] = 0;
+    p[i + 5] = 0x50;
+    i += 6;
+
+    for( unsigned k = 0; k < EIT_EVENTS; k++ )
+    {
+        char psz_name[32];
+        const size_t i_name = snprintf( psz_name, sizeof(psz_name),
+                                        "Event %u of version %u", k, i_version );
+        SetWBE( &p[i], k );
+        SetWBE( &p[i + 2], 60000 + i_version );
+        p[i + 4] = k % 10;
+        p[i + 5] = p[i + 6] = 0;
+        p[i + 7] = 0x01;
+        p[i + 8] = p[i + 9] = 0;
+        SetWBE( &p[i + 10], 2 + 5 + i_name + 4 );
+        i += 12;
+        p[i++] = 0x4d;
+        p[i++] = 5 + i_name + 4;
+        memcpy( &p[i], "eng", 3 );
+        i += 3;
+        p[i++] = i_name;
+        memcpy( &p[i], psz_name, i_name );
+        i += i_name;
+        p[i++] = 4;
+        memcpy( &p[i], "text", 4 );
+        i += 4;
+    }
+    return EndSection( p, i );
+}
+
+/* Sections, some of which are only sent once, across the boundaries of
+ * the ranges given to 2, 3 or 4 walkers. The network wide tables are
+ * counted apart. The EIT across the middle is lost. */
+static void WriteCorpus( const char *psz_path, unsigned *pi_tables,
+                         unsigned *pi_network_tables )
+{
+    static const unsigned pi_cuts[][2] = {
+        { 1, 4 }, { 1, 3 }, { 1, 2 }, { 2, 3 }, { 3, 4 },
+    };
+    corpus_t c = { .i_packets = 0 };
+    uint8_t p_sec[TS_SECTION_MAX];
+    size_t i_sec;
+    uint8_t i_version = 0;
+
+    c.p_file = fopen( psz_path, "wb" );
+    assert( c.p_file );
+
+    i_sec = BuildPAT( p_sec, 0 );
+    WriteSection( &c, 0x00, p_sec, i_sec, 0 );
+    i_sec = BuildPMT( p_sec );
+    WriteSection( &c, 0x100, p_sec, i_sec, 0 );
+    i_sec = BuildSDT( p_sec, 0x42, 0, 1 );
+    WriteSection( &c, 0x11, p_sec, i_sec, 0 );
+    *pi_tables = 3;
+
+    /* Network actual of 2 transport streams, a bouquet of 1, and the
+     * service and the schedule of another transport stream */
+    i_sec = BuildNIT( p_sec, 0x40, 0, 2 );
+    WriteSection( &c, 0x10, p_sec, i_sec, 0 );
+    i_sec = BuildNIT( p_sec, 0x4a, 0, 1 );
+    WriteSection( &c, 0x11, p_sec, i_sec, 0 );
+    i_sec = BuildSDT( p_sec, 0x46, 0, 0x99 );
+    WriteSection( &c, 0x11, p_sec, i_sec, 0 );
+    i_sec = BuildEIT( p_sec, 0x60, 0, 0x99 );
+    WriteSection( &c, 0x12, p_sec, i_sec, 1 );
+    *pi_network_tables = 4;
+
+    for( size_t i = 0; i < ARRAY_SIZE(pi_cuts); i++ )
+    {
+        const unsigned i_cut = CORPUS_PACKETS * pi_cuts[i][0] / pi_cuts[i][1];
+
+        /* An EIT starting a few packets before the cut, interleaved */
+        const bool b_lost = pi_cuts[i][0] * 2 == pi_cuts[i][1];
+        i_sec = BuildEIT( p_sec, 0x50, ++i_version, 1 );
+        const unsigned i_sec_packets = ( i_sec + 1 + 183 ) / 184;
+        WriteFill( &c, i_cut - c.i_packets - i_sec_packets * 3 / 2 );
+        WriteSectionCC( &c, 0x12, p_sec, i_sec, 2, b_lost );
+        if( b_lost )
+            *pi_tables -= 1;
+
+        /* New PAT and SDT versions, just after the cut */
+        i_sec = BuildPAT( p_sec, i_version );
+        WriteSection( &c, 0x00, p_sec, i_sec, 0 );
+        i_sec = BuildSDT( p_sec, 0x42, i_version, 1 + i );
+        WriteFill( &c, 10 );
+        WriteSection( &c, 0x11, p_sec, i_sec, 2 );
+        *pi_tables += 3;
+
+        /* A new version of a network other, of one transport stream */
+        i_sec = BuildNIT( p_sec, 0x41, i_version, 1 );
+        WriteSection( &c, 0x10, p_sec, i_sec, 0 );
+        *pi_network_tables += 1;
+    }
+    WriteFill( &c, CORPUS_PACKETS - c.i_packets );
+    fclose( c.p_file );
+}
+
+static char *ReadFile( const char *psz_path )
+{
+    FILE *p_file = fopen( psz_path, "rb" );
+    assert( p_file );
+    char *psz = calloc( 1, 1 << 20 );
+    assert( psz );
+    assert( fread( psz, 1, ( 1 << 20 ) - 1, p_file ) < ( 1 << 20 ) - 1 );
+    fclose( p_file );
+    return psz;
+}
+
+/* As the demux reads the file with --ts-analyse-only */
+static char *Read( const char *psz_path, const char *psz_out, bool b_network_si )
+{
+    ts_output_t *p_out = ts_output_New( NULL, TS_OUTPUT_CSV, psz_out );
+    ts_stats_t *p_stats = ts_stats_New();
+    ts_records_t *p_records = ts_records_New( p_out, b_network_si, NULL, NULL );
+    FILE *p_file = fopen( psz_path, "rb" );
+    assert( p_out && p_stats && p_records && p_file );
+
+    uint8_t p[188];
+    for( uint64_t i_offset = 0; fread( p, 188, 1, p_file ) == 1; i_offset += 188 )
+    {
+        const unsigned i_events = ts_stats_Packet( p_stats, p );
+        ts_records_Packet( p_records, p, i_offset, i_events & TS_STATS_CC_ERROR );
+    }
+    fclose( p_file );
+
+    ts_records_Delete( p_records, p_stats );
+    ts_stats_Delete( p_stats );
+    ts_output_Delete( p_out );
+    return ReadFile( psz_out );
+}
+
+static char *Scan( const char *psz_path, const char *psz_out, unsigned i_threads,
+                   bool b_network_si )
+{
+    ts_output_t *p_out = ts_output_New( NULL, TS_OUTPUT_CSV, psz_out );
+    assert( p_out );
+    assert( ts_scan_File( NULL, p_out, psz_path, 0, 188, 0, i_threads,
+                          b_network_si ) == VLC_SUCCESS );
+    ts_output_Delete( p_out );
+    return ReadFile( psz_out );
+}
+
+static unsigned Count( const char *psz, const char *psz_type )
+{
+    unsigned i_count = 0;
+    const size_t i_type = strlen( psz_type );
+
+    for( const char *p = psz; *p; p = strchr( p, '\n' ) + 1 )
+    {
+        if( !strncmp( p, psz_type, i_type ) && p[i_type] == ',' )
+            i_count++;
+        if( !strchr( p, '\n' ) )
+            break;
+    }
+    return i_count;
+}
+
+int main( void )
+{
+    char psz_path[] = "/tmp/vlc-test-ts-scan-XXXXXX";
+    char psz_out[] = "/tmp/vlc-test-ts-scan-out-XXXXXX";
+    unsigned i_tables, i_network_tables;
+
+    alarm( 30 );
+
+    int fd = mkstemp( psz_path );
+    assert( fd != -1 );
+    close( fd );
+    fd = mkstemp( psz_out );
+    assert( fd != -1 );
+    close( fd );
+
+    log( "Writing %u packets\n", (unsigned)CORPUS_PACKETS );
+    WriteCorpus( psz_path, &i_tables, &i_network_tables );
+
+    /* Only the services and events of the actual transport stream */
+    char *psz_ref = Read( psz_path, psz_out, false );
+    log( "Demux: %u tables, %u services, %u events\n",
+         Count( psz_ref, "TABLE" ), Count( psz_ref, "SDT" ), Count( psz_ref, "EIT" ) );
+    assert( Count( psz_ref, "TABLE" ) == i_tables + i_network_tables );
+    assert( Count( psz_ref, "SDT" ) == 5 );
+    assert( Count( psz_ref, "EIT" ) == 4 * EIT_EVENTS );
+    assert( Count( psz_ref, "NETWORK" ) == 0 && Count( psz_ref, "BOUQUET" ) == 0 );
+    /* The null packets are counted */
+    assert( strstr( psz_ref, "\nPID,8191," ) != NULL );
+    for( unsigned i_threads = 1; i_threads <= 4; i_threads++ )
+    {
+        log( "Comparing with %u walkers\n", i_threads );
+        char *psz = Scan( psz_path, psz_out, i_threads, false );
+        assert( !strcmp( psz, psz_ref ) );
+        free( psz );
+    }
+    free( psz_ref );
+
+    psz_ref = Read( psz_path, psz_out, true );
+    log( "With the network: %u networks, %u bouquets\n",
+         Count( psz_ref, "NETWORK" ), Count( psz_ref, "BOUQUET" ) );
+    assert( Count( psz_ref, "SDT" ) == 5 + 1 );
+    assert( Count( psz_ref, "EIT" ) == 5 * EIT_EVENTS );
+    assert( Count( psz_ref, "NETWORK" ) == 2 + 5 );
+    assert( Count( psz_ref, "BOUQUET" ) == 1 );
+    assert( strstr( psz_ref, "\nNETWORK,40,70,\"Name\",100,2,\"1 2\"\n" ) != NULL );
+    assert( strstr( psz_ref, "\nBOUQUET,7a,\"Name\",100,2,\"1 2\"\n" ) != NULL );
+
+    for( unsigned i_threads = 1; i_threads <= 4; i_threads++ )
+    {
+        log( "Comparing with %u walkers\n", i_threads );
+        char *psz = Scan( psz_path, psz_out, i_threads, true );
+        assert( !strcmp( psz, psz_ref ) );
+        free( psz );
+    }
+
+    free( psz_ref );
+    unlink( psz_out );
+    unlink( psz_path );
+    return 0;
+}
@@ -0,0 +1,207 @@
+/*****************************************************************************
+ * ts_sync.c: test and benchmark for the MPEG-TS sync byte scanner
+ *****************************************************************************
+ * Copyright (C) 2004-2015 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include "../../libvlc/test.h"
+
+/* Built in, to test every implementation whatever the CPU */
+#include "../../../modules/demux/mpeg/ts_sync.c"
+
+#define CORPUS_PACKETS 20000
+
+/* Byte by byte scan, as the demuxer did it */
+static size_t FindRef( const uint8_t *p, size_t i_size,
+                       size_t i_stride, unsigned i_count )
+{
+    const size_t i_candidates = ts_sync_Candidates( i_size, i_stride, i_count );
+    for( size_t i = 0; i < i_candidates; i++ )
+    {
+        unsigned k = 0;
+        while( k < i_count && p[i + k * i_stride] == 0x47 )
+            k++;
+        if( k == i_count )
+            return i;
+    }
+    return i_candidates;
+}
+
+/* Packets of i_size bytes, with bursts of garbage, dropped and corrupted
+ * sync bytes, and garbage full of 0x47 like a flaky satellite feed */
+static uint8_t *BuildCorpus( size_t i_size, size_t *pi_corpus )
+{
+    const size_t i_max = CORPUS_PACKETS * (i_size + 64);
+    uint8_t *p = malloc( i_max );
+    assert( p );
+
+    size_t i_pos = 0;
+    for( unsigned i = 0; i < CORPUS_PACKETS; i++ )
+    {
+        const unsigned r = rand();
+        if( r % 17 == 0 )
+        {
+            /* Garbage burst, sometimes rich in sync bytes */
+            const size_t i_burst = 1 + rand() % 63;
+            for( size_t j = 0; j < i_burst; j++ )
+                p[i_pos++] = (r % 3 == 0 && rand() % 4 == 0) ? 0x47 : rand();
+        }
+        uint8_t *p_pkt = &p[i_pos];
+        for( size_t j = 0; j < i_size; j++ )
+            p_pkt[j] = rand();
+        p_pkt[i_size - 188] = ( r % 23 == 0 ) ? 0x46 : 0x47;
+        i_pos += ( r % 29 == 0 ) ? i_size / 2 : i_size; /* truncated */
+    }
+    *pi_corpus = i_pos;
+    return p;
+}
+
+static void check_Find( const uint8_t *p, size_t i_size,
+                        size_t i_stride, unsigned i_count )
+{
+    const size_t i_ref = FindRef( p, i_size, i_stride, i_count );
+    const size_t i_candidates = ts_sync_Candidates( i_size, i_stride, i_count );
+
+    assert( ts_sync_Find( p, i_size, i_stride, i_count ) == i_ref );
+    assert( FindC( p, i_candidates, i_stride, i_count, 0 ) == i_ref );
+#ifdef TS_SYNC_SSE2
+    assert( FindSSE2( p, i_candidates, i_stride, i_count ) == i_ref );
+#endif
+#ifdef TS_SYNC_AVX2
+    if( vlc_CPU_AVX2() )
+        assert( FindAVX2( p, i_candidates, i_stride, i_count ) == i_ref );
+#endif
+}
+
+static void test_Find( const uint8_t *p, size_t i_corpus, size_t i_stride )
+{
+    for( unsigned i = 0; i < 20000; i++ )
+    {
+        const size_t i_start = rand() % i_corpus;
+        const size_t i_size = __MIN( (size_t)(rand() % (10 * i_stride)),
+                                     i_corpus - i_start );
+        const unsigned i_count = 1 + rand() % 4;
+        check_Find( &p[i_start], i_size, i_stride, i_count );
+    }
+    /* Degenerated sizes */
+    for( size_t i_size = 0; i_size < 3 * i_stride; i_size++ )
+        for( unsigned i_count = 1; i_count <= 4; i_count++ )
+            check_Find( p, i_size, i_stride, i_count );
+}
+
+/* Walks the corpus as the demuxer does, resynchronizing on two sync bytes
+ * one packet apart, and returns the number of packets found */
+static unsigned Walk( const uint8_t *p, size_t i_corpus, size_t i_stride,
+                      size_t (*pf_find)( const uint8_t *, size_t, size_t, unsigned ) )
+{
+    const size_t i_offset = i_stride - 188;
+    unsigned i_packets = 0;
+
+    for( size_t i_pos = 0; i_pos + i_stride <= i_corpus; )
+    {
+        if( p[i_pos + i_offset] != 0x47 )
+        {
+            const size_t i_peek = __MIN( 10 * i_stride, i_corpus - i_pos ) - i_offset;
+            const size_t i_skip = pf_find( &p[i_pos + i_offset], i_peek, i_stride, 2 );
+            if( i_skip == 0 ) /* not even one candidate left */
+                break;
+            i_pos += i_skip;
+            continue;
+        }
+        i_packets++;
+        i_pos += i_stride;
+    }
+    return i_packets;
+}
+
+static void bench_Walk( const uint8_t *p, size_t i_corpus, size_t i_stride )
+{
+    mtime_t i_ref = 0, i_new = 0;
+    unsigned i_packets_ref = 0, i_packets_new = 0;
+
+    for( unsigned i = 0; i < 10; i++ )
+    {
+        mtime_t i_start = mdate();
+        i_packets_ref = Walk( p, i_corpus, i_stride, FindRef );
+        i_ref += mdate() - i_start;
+
+        i_start = mdate();
+        i_packets_new = Walk( p, i_corpus, i_stride, ts_sync_Find );
+        i_new += mdate() - i_start;
+    }
+    assert( i_packets_ref == i_packets_new );
+
+    log( "%zu bytes packets: %u packets, byte loop %"PRId64" us, "
+         "scanner %"PRId64" us\n", i_stride, i_packets_new,
+         i_ref / 10, i_new / 10 );
+}
+
+/* Packets of each size after some garbage, and BluRay packets */
+static void test_DetectPacketSize( void )
+{
+    static const unsigned pi_sizes[] = { 188, 192, 204 };
+    uint8_t p[8 * 204];
+    size_t i_sync;
+    unsigned i_header;
+
+    for( size_t i = 0; i < ARRAY_SIZE(pi_sizes); i++ )
+    {
+        memset( p, 0, sizeof(p) );
+        for( size_t j = 5; j < sizeof(p); j += pi_sizes[i] )
+            p[j] = 0x47;
+        assert( ts_sync_DetectPacketSize( p, sizeof(p), &i_sync, &i_header )
+                == (int)pi_sizes[i] );
+        assert( i_sync == 5 && i_header == 0 );
+    }
+
+    memset( p, 0, sizeof(p) );
+    for( size_t j = 4; j < sizeof(p); j += 192 )
+        p[j] = 0x47;
+    assert( ts_sync_DetectPacketSize( p, sizeof(p), &i_sync, &i_header ) == 192 );
+    assert( i_sync == 4 && i_header == 4 );
+
+    /* No sync within the first 204 bytes */
+    memset( p, 0, sizeof(p) );
+    for( size_t j = 300; j < sizeof(p); j += 188 )
+        p[j] = 0x47;
+    assert( ts_sync_DetectPacketSize( p, sizeof(p), &i_sync, &i_header ) == -1 );
+}
+
+int main( void )
+{
+    static const size_t pi_sizes[] = { 188, 192, 204 };
+
+    alarm( 10 );
+    srand( 0 );
+
+    for( size_t i = 0; i < ARRAY_SIZE(pi_sizes); i++ )
+    {
+        size_t i_corpus;
+        uint8_t *p = BuildCorpus( pi_sizes[i], &i_corpus );
+
+        log( "Testing ts_sync_Find() at stride %zu\n", pi_sizes[i] );
+        test_Find( p, i_corpus, pi_sizes[i] );
+        bench_Walk( p, i_corpus, pi_sizes[i] );
+
+        free( p );
+    }
+
+    log( "Testing ts_sync_DetectPacketSize()\n" );
+    test_DetectPacketSize();
+
+    return 0;
+}
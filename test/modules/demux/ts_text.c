@@ -0,0 +1,232 @@
+/*****************************************************************************
+ * ts_text.c: test and benchmark for the DVB SI text decoder
+ *****************************************************************************
+ * Copyright (C) 2004-2015 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include "../../libvlc/test.h"
+
+/* The new and the current path, built in */
+#include "../../../modules/demux/mpeg/ts_text.c"
+#include "../../../modules/demux/dvb-text.h"
+
+#define CORPUS_STRINGS 20000
+
+typedef struct
+{
+    uint8_t p[256];
+    size_t  i;
+} item_t;
+
+/* Event names and texts as broadcast, with their selector and the
+ * emphasis and line break control codes */
+static const struct
+{
+    const char *p;
+    size_t      i;
+} samples[] =
+{
+#define S(str) { str, sizeof(str) - 1 }
+    S("\x86Journal\x87 de 20h"),
+    S("Le \xc2" "e" "t\xc2" "e" " de la \xc1" "a la campagne\x8a" "Reportage"),
+    S("Die \xc8" "Uberraschung: M\xc8" "archen f\xc8" "ur \xc8" "altere Kinder"),
+    S("\xd3 2015 \xd4 Caf\xc2" "e \xe9l\xe8ve"),
+    S("\x01\xbd\xde\xd2\xde\xe1\xe2\xd8 \x86\xb2\xd5\xe7\xd5\xe0\x87"),
+    S("\x03\xc5\xe9\xdf\xe4\xf3\xe5\xe9\xf2 \xf4\xe7\xf2 \xe7\xec\xdd\xf1\xe1\xf2"),
+    S("\x05Haber B\xfclteni: \xddstanbul'da hava g\xfczel"),
+    S("\x10\x00\x02Zpr\xe1vy \xe8" "esk\xe9 televize"),
+    S("\x10\x00\x0f" "Football \xa4 \xbd" "finale"),
+    S("\x11\x65\xb0\x80\x5e\x00\x0a\x00\x86\x00\x54\x00\x56\xe0\x8a\x00\x21"),
+    S("\x15Th\xc3\xa9\xc3\xa2tre \xe2\x80\x94 \xc2\x86" "direct\xc2\x87"),
+    S("\x13\xd0\xc2\xce\xc5\xc1\xaa\xb2\xa5"),
+    S("\x12\xb4\xba\xbd\xba"),
+#undef S
+};
+
+/* Sample texts, and random bytes after every selector, with neither nul
+ * nor emphasis codes: vlc_from_EIT() does not strip two emphasis codes in
+ * a row */
+static item_t *BuildCorpus( size_t *pi_items )
+{
+    static const uint8_t pi_selectors[] = { 0x20, 0x01, 0x02, 0x03, 0x04,
+        0x05, 0x06, 0x08, 0x0a, 0x0b, 0x10, 0x11, 0x12, 0x13, 0x15, 0x1f };
+    item_t *p_items = malloc( CORPUS_STRINGS * sizeof(*p_items) );
+    assert( p_items );
+
+    for( size_t n = 0; n < CORPUS_STRINGS; n++ )
+    {
+        item_t *it = &p_items[n];
+        if( n % 2 == 0 )
+        {
+            const size_t k = ( n / 2 ) % ARRAY_SIZE(samples);
+            memcpy( it->p, samples[k].p, samples[k].i );
+            it->i = samples[k].i;
+            continue;
+        }
+
+        const uint8_t c = pi_selectors[rand() % ARRAY_SIZE(pi_selectors)];
+        size_t i_offset = 0;
+        if( c < 0x20 )
+            it->p[i_offset++] = c;
+        if( c == 0x10 )
+        {
+            static const uint8_t pi_parts[] = { 1, 2, 3, 5, 9, 15, 12, 0 };
+            it->p[i_offset++] = rand() % 16 ? 0x00 : 0x01;
+            it->p[i_offset++] = pi_parts[rand() % ARRAY_SIZE(pi_parts)];
+        }
+        it->i = i_offset + rand() % ( sizeof(it->p) - i_offset );
+        for( size_t j = i_offset; j < it->i; j++ )
+        {
+            uint8_t b;
+            do
+                b = rand() % 4 ? 0x20 + rand() % 0x60 : rand();
+            while( b == 0x00 || b == 0x86 || b == 0x87 || b == 0xe0 );
+            it->p[j] = b;
+        }
+    }
+    *pi_items = CORPUS_STRINGS;
+    return p_items;
+}
+
+/* glibc names 8859-11 and 8859-13 with a hyphen only, so vlc_from_EIT()
+ * falls back to the raw bytes for them */
+static bool RefUsable( const item_t *it )
+{
+    if( it->i > 0 && ( it->p[0] == 0x07 || it->p[0] == 0x09 ) )
+        return false;
+    if( it->i > 2 && it->p[0] == 0x10 && ( it->p[2] == 11 || it->p[2] == 13 ) )
+        return false;
+    return true;
+}
+
+static void test_Decode( ts_text_t *p_text, const item_t *p_items, size_t i_items )
+{
+    char buf[1024];
+    unsigned i_checked = 0;
+
+    for( size_t n = 0; n < i_items; n++ )
+    {
+        const item_t *it = &p_items[n];
+        ts_text_arena_t arena;
+        ts_text_ArenaInit( &arena, buf, sizeof(buf) );
+
+        const char *psz = ts_text_Decode( p_text, &arena, it->p, it->i );
+        if( psz )
+            assert( IsUTF8( psz ) );
+        if( !RefUsable( it ) )
+            continue;
+
+        char *psz_ref = vlc_from_EIT( it->p, it->i );
+        if( ( psz == NULL ) != ( psz_ref == NULL ) ||
+            ( psz && strcmp( psz, psz_ref ) ) )
+        {
+            log( "mismatch on item %zu: '%s' vs '%s'\n", n, psz, psz_ref );
+            abort();
+        }
+        free( psz_ref );
+        i_checked++;
+    }
+    log( "%u strings match vlc_from_EIT()\n", i_checked );
+}
+
+static void test_Known( ts_text_t *p_text )
+{
+    static const struct
+    {
+        const char *p_in;
+        size_t      i_in;
+        const char *psz_out;
+    } known[] =
+    {
+        { "\xc2" "e\xc8" "a", 4, "\xc3\xa9\xc3\xa4" },
+        { "\x07\xa1", 2, "\xe0\xb8\x81" },              /* 8859-11 */
+        { "\x09\xa1", 2, "\xe2\x80\x9d" },              /* 8859-13 */
+        { "\x10\x00\x0b\xa1", 4, "\xe0\xb8\x81" },
+        { "\x11\x00\x41\xe0\x8a\x00\x42", 7, "A\r\r\nB" },
+        { "\x05", 1, "" },
+        { "a\x8a" "b\x86" "c\x87", 6, "a\r\nbc" },
+    };
+    char buf[64];
+
+    for( size_t n = 0; n < ARRAY_SIZE(known); n++ )
+    {
+        ts_text_arena_t arena;
+        ts_text_ArenaInit( &arena, buf, sizeof(buf) );
+        const char *psz = ts_text_Decode( p_text, &arena,
+                                          (const uint8_t *)known[n].p_in,
+                                          known[n].i_in );
+        assert( psz && !strcmp( psz, known[n].psz_out ) );
+    }
+
+    /* Unsupported selectors, and arenas too small */
+    ts_text_arena_t arena;
+    ts_text_ArenaInit( &arena, buf, 4 );
+    assert( !ts_text_Decode( p_text, &arena, (const uint8_t *)"\x1f" "abc", 4 ) );
+    assert( !ts_text_Decode( p_text, &arena, (const uint8_t *)"abcd", 4 ) );
+    assert( ts_text_Decode( p_text, &arena, (const uint8_t *)"abc", 3 ) );
+    assert( arena.i_used == 4 );
+    assert( !ts_text_Decode( p_text, &arena, (const uint8_t *)"a", 1 ) );
+}
+
+static void bench_Decode( ts_text_t *p_text, const item_t *p_items, size_t i_items )
+{
+    char buf[4096];
+    mtime_t i_ref = 0, i_new = 0;
+
+    for( unsigned i = 0; i < 5; i++ )
+    {
+        mtime_t i_start = mdate();
+        for( size_t n = 0; n < i_items; n++ )
+            free( vlc_from_EIT( p_items[n].p, p_items[n].i ) );
+        i_ref += mdate() - i_start;
+
+        i_start = mdate();
+        ts_text_arena_t arena;
+        ts_text_ArenaInit( &arena, buf, sizeof(buf) );
+        for( size_t n = 0; n < i_items; n++ )
+        {
+            if( !ts_text_Decode( p_text, &arena, p_items[n].p, p_items[n].i ) )
+                arena.i_used = 0;
+            else if( arena.i_used > sizeof(buf) / 2 )
+                arena.i_used = 0;
+        }
+        i_new += mdate() - i_start;
+    }
+
+    log( "%zu strings: vlc_from_EIT() %"PRId64" us, ts_text_Decode() %"PRId64" us\n",
+         i_items, i_ref / 5, i_new / 5 );
+}
+
+int main( void )
+{
+    alarm( 10 );
+    srand( 0 );
+
+    ts_text_t *p_text = ts_text_New();
+    assert( p_text );
+
+    size_t i_items;
+    item_t *p_items = BuildCorpus( &i_items );
+
+    test_Known( p_text );
+    test_Decode( p_text, p_items, i_items );
+    bench_Decode( p_text, p_items, i_items );
+
+    free( p_items );
+    ts_text_Delete( p_text );
+    return 0;
+}
@@ -0,0 +1,352 @@
+/*****************************************************************************
+ * uring.c: io_uring read-ahead stream filter test and benchmark
+ *****************************************************************************
+ * Copyright (C) 2004-2015 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include "../../libvlc/test.h"
+#include "../../../lib/libvlc_internal.h"
+
+#include <vlc_common.h>
+#include <vlc_stream.h>
+#include <vlc_block.h>
+#include <vlc_url.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+/* Not a whole number of reads */
+#define FILE_SIZE  (64 * 1024 * 1024 + 1234)
+#define READ_SIZE  (7 * 188 * 20)
+
+static uint8_t Byte( uint64_t i_offset )
+{
+    return i_offset * 7 + ( i_offset >> 12 );
+}
+
+static void CheckData( const uint8_t *p, size_t i_size, uint64_t i_offset )
+{
+    for( size_t i = 0; i < i_size; i++ )
+        assert( p[i] == Byte( i_offset + i ) );
+}
+
+static void DropCache( const char *psz_path )
+{
+    int fd = open( psz_path, O_RDONLY );
+    assert( fd != -1 );
+    fdatasync( fd );
+    /* Best effort: a cold cache stands in for slow storage */
+    posix_fadvise( fd, 0, 0, POSIX_FADV_DONTNEED );
+    close( fd );
+}
+
+/*****************************************************************************
+ * Plain file source, without fast seeking, for the other read-ahead filters
+ *****************************************************************************/
+struct stream_sys_t
+{
+    int fd;
+    uint64_t i_offset;
+};
+
+static ssize_t SourceRead( stream_t *s, void *p_buf, size_t i_len )
+{
+    stream_sys_t *p_sys = s->p_sys;
+    ssize_t i_ret = pread( p_sys->fd, p_buf, i_len, p_sys->i_offset );
+
+    if( i_ret > 0 )
+        p_sys->i_offset += i_ret;
+    return i_ret;
+}
+
+static int SourceSeek( stream_t *s, uint64_t i_offset )
+{
+    stream_sys_t *p_sys = s->p_sys;
+
+    p_sys->i_offset = i_offset;
+    return VLC_SUCCESS;
+}
+
+static int SourceControl( stream_t *s, int i_query, va_list args )
+{
+    switch( i_query )
+    {
+        case STREAM_CAN_SEEK:
+        case STREAM_CAN_PAUSE:
+        case STREAM_CAN_CONTROL_PACE:
+            *va_arg( args, bool * ) = true;
+            break;
+        case STREAM_CAN_FASTSEEK:
+            *va_arg( args, bool * ) = false;
+            break;
+        case STREAM_GET_SIZE:
+            *va_arg( args, uint64_t * ) = FILE_SIZE;
+            break;
+        case STREAM_GET_PTS_DELAY:
+            *va_arg( args, int64_t * ) = DEFAULT_PTS_DELAY;
+            break;
+        case STREAM_GET_PRIVATE_BLOCK:
+        {
+            block_t **pp_block = va_arg( args, block_t ** );
+            bool *pb_eof = va_arg( args, bool * );
+            block_t *p_block = block_Alloc( 65536 );
+
+            assert( p_block != NULL );
+            ssize_t i_ret = SourceRead( s, p_block->p_buffer,
+                                        p_block->i_buffer );
+            assert( i_ret >= 0 );
+            p_block->i_buffer = i_ret;
+            *pb_eof = i_ret == 0;
+            if( i_ret == 0 )
+            {
+                block_Release( p_block );
+                p_block = NULL;
+            }
+            *pp_block = p_block;
+            break;
+        }
+        case STREAM_SET_PAUSE_STATE:
+            break;
+        default:
+            return VLC_EGENERIC;
+    }
+    return VLC_SUCCESS;
+}
+
+static void SourceDestroy( stream_t *s )
+{
+    stream_sys_t *p_sys = s->p_sys;
+
+    close( p_sys->fd );
+    free( p_sys );
+}
+
+static stream_t *SourceNew( vlc_object_t *p_obj, const char *psz_path )
+{
+    stream_t *s = stream_CustomNew( p_obj, SourceDestroy );
+    assert( s != NULL );
+
+    stream_sys_t *p_sys = malloc( sizeof (*p_sys) );
+    assert( p_sys != NULL );
+    p_sys->fd = open( psz_path, O_RDONLY );
+    assert( p_sys->fd != -1 );
+    p_sys->i_offset = 0;
+
+    s->p_sys = p_sys;
+    s->pf_read = SourceRead;
+    s->pf_seek = SourceSeek;
+    s->pf_control = SourceControl;
+    return s;
+}
+
+/*****************************************************************************
+ * Tests
+ *****************************************************************************/
+static void ReadAll( stream_t *s, uint64_t i_offset )
+{
+    uint8_t *p_buf = malloc( READ_SIZE );
+    ssize_t i_read;
+
+    assert( p_buf != NULL );
+    while( ( i_read = stream_Read( s, p_buf, READ_SIZE ) ) > 0 )
+    {
+        CheckData( p_buf, i_read, i_offset );
+        i_offset += i_read;
+        assert( stream_Tell( s ) == i_offset );
+    }
+    assert( i_read == 0 );
+    assert( i_offset == FILE_SIZE );
+    free( p_buf );
+}
+
+static void test_Uring( stream_t *s )
+{
+    const uint8_t *p_peek;
+    uint8_t p_buf[100000];
+    ssize_t i_ret;
+
+    assert( stream_Size( s ) == FILE_SIZE );
+
+    ReadAll( s, 0 );
+
+    /* Backwards, out of the read-ahead window */
+    i_ret = stream_Seek( s, 1000 );
+    assert( i_ret == VLC_SUCCESS );
+    i_ret = stream_Peek( s, &p_peek, sizeof (p_buf) );
+    assert( i_ret == sizeof (p_buf) );
+    CheckData( p_peek, sizeof (p_buf), 1000 );
+    i_ret = stream_Read( s, p_buf, sizeof (p_buf) );
+    assert( i_ret == sizeof (p_buf) );
+    CheckData( p_buf, sizeof (p_buf), 1000 );
+
+    /* Forwards, within the window, across reads */
+    i_ret = stream_Seek( s, 65536 * 2 - 10 );
+    assert( i_ret == VLC_SUCCESS );
+    i_ret = stream_Read( s, p_buf, sizeof (p_buf) );
+    assert( i_ret == sizeof (p_buf) );
+    CheckData( p_buf, sizeof (p_buf), 65536 * 2 - 10 );
+
+    /* Forwards, out of the window, up to the end */
+    i_ret = stream_Seek( s, FILE_SIZE / 2 + 3 );
+    assert( i_ret == VLC_SUCCESS );
+    ReadAll( s, FILE_SIZE / 2 + 3 );
+
+    /* Beyond the end */
+    i_ret = stream_Seek( s, FILE_SIZE + 100 );
+    assert( i_ret == VLC_SUCCESS );
+    i_ret = stream_Read( s, p_buf, sizeof (p_buf) );
+    assert( i_ret == 0 );
+}
+
+/* The rest of a short read is read once the file grew, from an offset
+ * that is not aligned for direct I/O */
+static void test_Grow( stream_t *s, const char *psz_path )
+{
+    uint8_t p_buf[5000];
+    ssize_t i_ret;
+
+    i_ret = stream_Seek( s, FILE_SIZE - 10 );
+    assert( i_ret == VLC_SUCCESS );
+    i_ret = stream_Read( s, p_buf, sizeof (p_buf) );
+    assert( i_ret == 10 );
+    CheckData( p_buf, i_ret, FILE_SIZE - 10 );
+    i_ret = stream_Read( s, p_buf, sizeof (p_buf) );
+    assert( i_ret == 0 );
+
+    int fd = open( psz_path, O_WRONLY | O_APPEND );
+    assert( fd != -1 );
+    for( size_t i = 0; i < sizeof (p_buf); i++ )
+        p_buf[i] = Byte( FILE_SIZE + i );
+    i_ret = write( fd, p_buf, sizeof (p_buf) );
+    assert( i_ret == sizeof (p_buf) );
+
+    memset( p_buf, 0, sizeof (p_buf) );
+    i_ret = stream_Read( s, p_buf, sizeof (p_buf) );
+    assert( i_ret > 0 );
+    CheckData( p_buf, i_ret, FILE_SIZE );
+
+    i_ret = ftruncate( fd, FILE_SIZE );
+    assert( i_ret == 0 );
+    close( fd );
+}
+
+/* Reads a local file with the io_uring filter, over the regular stack as
+ * any other stream filter */
+static stream_t *NewUring( vlc_object_t *p_obj, const char *psz_url )
+{
+    stream_t *p_source = stream_UrlNew( p_obj, psz_url );
+    assert( p_source != NULL );
+
+    var_SetBool( p_obj, "uring-local", true );
+    stream_t *s = stream_FilterNew( p_source, "uring" );
+    var_SetBool( p_obj, "uring-local", false );
+    if( s == NULL )
+        stream_Delete( p_source );
+    return s;
+}
+
+static void Bench( const char *psz_name, stream_t *s, const char *psz_path )
+{
+    assert( s != NULL );
+    DropCache( psz_path );
+
+    const mtime_t i_start = mdate();
+    ReadAll( s, 0 );
+    const mtime_t i_duration = mdate() - i_start;
+
+    log( "%s: %.1f MB/s\n", psz_name,
+         FILE_SIZE / 1e6 * CLOCK_FREQ / i_duration );
+    stream_Delete( s );
+}
+
+int main( void )
+{
+    char psz_path[] = "/tmp/vlc-test-uring-XXXXXX";
+    libvlc_instance_t *p_vlc;
+
+    test_init();
+
+    int fd = mkstemp( psz_path );
+    assert( fd != -1 );
+    for( uint64_t i_offset = 0; i_offset < FILE_SIZE; )
+    {
+        uint8_t p_buf[65536];
+        size_t i_size = __MIN( sizeof (p_buf), FILE_SIZE - i_offset );
+
+        for( size_t i = 0; i < i_size; i++ )
+            p_buf[i] = Byte( i_offset + i );
+        ssize_t i_write = write( fd, p_buf, i_size );
+        assert( i_write == (ssize_t)i_size );
+        i_offset += i_size;
+    }
+    close( fd );
+
+    p_vlc = libvlc_new( test_defaults_nargs, test_defaults_args );
+    assert( p_vlc != NULL );
+
+    vlc_object_t *p_obj = VLC_OBJECT(p_vlc->p_libvlc_int);
+    char *psz_url = vlc_path2uri( psz_path, NULL );
+    assert( psz_url != NULL );
+
+    /* Local files are left to the regular read-ahead by default */
+    var_Create( p_obj, "uring-local", VLC_VAR_BOOL );
+    var_Create( p_obj, "uring-direct", VLC_VAR_BOOL );
+    var_Create( p_obj, "uring-depth", VLC_VAR_INTEGER );
+    var_Create( p_obj, "uring-read-size", VLC_VAR_INTEGER );
+
+    stream_t *p_source = stream_UrlNew( p_obj, psz_url );
+    assert( p_source != NULL );
+    stream_t *s = stream_FilterNew( p_source, "uring" );
+    assert( s == NULL );
+
+    var_SetInteger( p_obj, "uring-depth", 3 );
+    var_SetInteger( p_obj, "uring-read-size", 64 );
+    for( int i = 0; i < 2; i++ )
+    {
+        var_SetBool( p_obj, "uring-direct", i );
+        log( "Testing the io_uring read-ahead%s\n",
+             i ? " with direct I/O" : "" );
+        s = NewUring( p_obj, psz_url );
+        if( s == NULL )
+        {
+            log( "Skipped: io_uring is not available\n" );
+            goto out;
+        }
+        test_Uring( s );
+        test_Grow( s, psz_path );
+        stream_Delete( s );
+    }
+
+    log( "Benchmarking the read-ahead on a cold file\n" );
+    var_SetBool( p_obj, "uring-direct", false );
+    var_SetInteger( p_obj, "uring-depth", 8 );
+    var_SetInteger( p_obj, "uring-read-size", 1024 );
+    Bench( "uring", NewUring( p_obj, psz_url ), psz_path );
+    var_SetBool( p_obj, "uring-direct", true );
+    Bench( "uring (direct)", NewUring( p_obj, psz_url ), psz_path );
+    Bench( "cache_read", stream_UrlNew( p_obj, psz_url ), psz_path );
+    Bench( "prefetch", stream_FilterNew( SourceNew( p_obj, psz_path ),
+                                         "prefetch" ), psz_path );
+    Bench( "cache_block", stream_FilterNew( SourceNew( p_obj, psz_path ),
+                                            "cache_block" ), psz_path );
+out:
+    stream_Delete( p_source );
+    free( psz_url );
+    libvlc_release( p_vlc );
+    unlink( psz_path );
+    return 0;
+}
@@ -0,0 +1,188 @@
+/*****************************************************************************
+ * block.c: test and benchmark for the block allocator
+ *****************************************************************************
+ * Copyright (C) 2004-2015 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include "../../libvlc/test.h"
+
+#include <string.h>
+#include <sys/resource.h>
+
+#include <vlc_common.h>
+#include <vlc_block.h>
+
+/* 200 Mbit/s of 7 TS packets datagrams, for 4 seconds */
+#define STREAM_BLOCKS   (4 * 200000000 / 8 / 1316)
+#define BENCH_LOOPS     1000000
+
+static void fill( block_t *b, unsigned i_seed )
+{
+    for( size_t i = 0; i < b->i_buffer; i++ )
+        b->p_buffer[i] = i_seed + i;
+}
+
+static void check( const block_t *b, unsigned i_seed )
+{
+    for( size_t i = 0; i < b->i_buffer; i++ )
+        assert( b->p_buffer[i] == (uint8_t)(i_seed + i) );
+}
+
+/* Any size, recycled or not, keeps the alignment and padding promises */
+static void test_Sizes( void )
+{
+    block_t *pp_live[64] = { NULL };
+
+    for( unsigned i = 0; i < 100000; i++ )
+    {
+        const unsigned k = rand() % ARRAY_SIZE(pp_live);
+        if( pp_live[k] )
+        {
+            check( pp_live[k], k );
+            block_Release( pp_live[k] );
+        }
+
+        static const size_t pi_sizes[] = { 188, 192, 204, 1316, 1500, 3760 };
+        const size_t i_size = rand() % 2 ? pi_sizes[rand() % ARRAY_SIZE(pi_sizes)]
+                                         : (size_t)(rand() % 5000);
+        block_t *b = block_Alloc( i_size );
+        assert( b && b->i_buffer == i_size && b->p_next == NULL );
+        assert( ((uintptr_t)b->p_buffer % 32) == 0 );
+        assert( b->p_buffer - b->p_start >= 32 );
+        assert( b->p_start + b->i_size - (b->p_buffer + b->i_buffer) >= 32 );
+        assert( b->i_flags == 0 && b->i_pts == VLC_TS_INVALID &&
+                b->i_dts == VLC_TS_INVALID && b->i_length == 0 );
+        fill( b, k );
+
+        if( rand() % 8 == 0 )
+        {
+            /* Recycled in place or copied, either way still releasable */
+            b = block_Realloc( b, 0, b->i_buffer / 2 );
+            assert( b );
+            check( b, k );
+        }
+        b->i_flags = BLOCK_FLAG_CORRUPTED;
+        b->i_pts = 1;
+        pp_live[k] = b;
+    }
+
+    for( unsigned k = 0; k < ARRAY_SIZE(pp_live); k++ )
+        if( pp_live[k] )
+            block_Release( pp_live[k] );
+}
+
+typedef struct
+{
+    block_fifo_t *p_fifo;
+    size_t        i_size;
+    unsigned      i_count;
+} producer_t;
+
+/* The UDP access thread: allocates datagrams, another thread frees them */
+static void *Producer( void *data )
+{
+    producer_t *p_producer = data;
+
+    for( unsigned i = 0; i < p_producer->i_count; i++ )
+    {
+        block_t *b = block_Alloc( p_producer->i_size );
+        assert( b );
+        fill( b, i );
+        block_FifoPut( p_producer->p_fifo, b );
+    }
+    return NULL;
+}
+
+static void test_Stream( size_t i_size, unsigned i_count, bool b_check )
+{
+    producer_t producer = {
+        .p_fifo = block_FifoNew(),
+        .i_size = i_size,
+        .i_count = i_count,
+    };
+    vlc_thread_t thread;
+    assert( producer.p_fifo );
+
+    const mtime_t i_start = mdate();
+    assert( !vlc_clone( &thread, Producer, &producer, VLC_THREAD_PRIORITY_LOW ) );
+    for( unsigned i = 0; i < i_count; i++ )
+    {
+        block_t *b = block_FifoGet( producer.p_fifo );
+        if( b_check )
+            check( b, i );
+        block_Release( b );
+    }
+    vlc_join( thread, NULL );
+    const mtime_t i_time = mdate() - i_start;
+
+    struct rusage usage;
+    getrusage( RUSAGE_SELF, &usage );
+    log( "%u blocks of %zu bytes across threads: %"PRId64" us, %.0f blocks/s, "
+         "max RSS %ld kB\n", i_count, i_size, i_time,
+         i_count * (double)CLOCK_FREQ / (i_time ? i_time : 1), usage.ru_maxrss );
+    block_FifoRelease( producer.p_fifo );
+}
+
+static void bench_Alloc( size_t i_size )
+{
+    block_t *pp_blocks[16];
+
+    mtime_t i_start = mdate();
+    for( unsigned i = 0; i < BENCH_LOOPS / 16; i++ )
+    {
+        for( unsigned j = 0; j < 16; j++ )
+            pp_blocks[j] = block_Alloc( i_size );
+        for( unsigned j = 0; j < 16; j++ )
+            block_Release( pp_blocks[j] );
+    }
+    const mtime_t i_block = mdate() - i_start;
+
+    i_start = mdate();
+    for( unsigned i = 0; i < BENCH_LOOPS / 16; i++ )
+    {
+        for( unsigned j = 0; j < 16; j++ )
+        {
+            pp_blocks[j] = malloc( sizeof(block_t) + 96 + i_size );
+            assert( pp_blocks[j] );
+            /* what block_Alloc() used to do, so that it is not optimized out */
+            block_Init( pp_blocks[j], pp_blocks[j] + 1, 96 + i_size );
+        }
+        for( unsigned j = 0; j < 16; j++ )
+            free( pp_blocks[j] );
+    }
+    const mtime_t i_malloc = mdate() - i_start;
+
+    log( "%u blocks of %zu bytes: block_Alloc() %"PRId64" us, malloc() "
+         "%"PRId64" us\n", BENCH_LOOPS, i_size, i_block, i_malloc );
+}
+
+int main( void )
+{
+    static const size_t pi_sizes[] = { 188, 1316, 1500, 3760, 9000 };
+
+    alarm( 10 );
+    srand( 0 );
+
+    log( "Testing block_Alloc()\n" );
+    test_Sizes();
+    test_Stream( 1316, 10000, true );
+
+    for( size_t i = 0; i < ARRAY_SIZE(pi_sizes); i++ )
+        bench_Alloc( pi_sizes[i] );
+    test_Stream( 1316, STREAM_BLOCKS, false );
+    return 0;
+}